@@ -4,10 +4,14 @@
     Intel definitions from https://github.com/ia32-doc/ia32-doc/blob/main/out/ia32.hpp
 */
 #pragma once
+#ifdef _WIN32
 using uint8_t = unsigned char;
 using uint16_t = unsigned short;
 using uint32_t = unsigned int;
 using uint64_t = unsigned long long;
+#else
+#include <cstdint>
+#endif
 
 #define PAGE_MASK (PAGE_SIZE - 1)
 
@@ -0,0 +1,230 @@
+/*
+	include.h
+
+	Definitions shared between projects.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#if defined(_KERNEL_MODE)
+#include <fltKernel.h>
+#elif defined(_WIN32)
+#include <Windows.h>
+#include <array>
+#else
+#include "win32_types.h"
+#include <array>
+#endif
+#include <stdint.h>
+
+typedef LARGE_INTEGER PHYSICAL_ADDRESS, * PPHYSICAL_ADDRESS;
+
+#ifndef PAGE_SIZE
+#define PAGE_SIZE 4096
+#endif
+#define TABLE_SIZE 512
+#define IOCTL_CONTROL_CODE 0x4000
+#define IOCTL_CODE CTL_CODE(FILE_DEVICE_UNKNOWN, IOCTL_CONTROL_CODE, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define IOCTL_ENUM_CONTROL_CODE 0x4001
+#define IOCTL_ENUM_CODE CTL_CODE(FILE_DEVICE_UNKNOWN, IOCTL_ENUM_CONTROL_CODE, METHOD_BUFFERED, FILE_ANY_ACCESS)
+
+//
+// Number of tables the driver returns for a single IOCTL_ENUM_CODE request.
+#define ENUM_TABLES_PER_REQUEST 256
+
+//
+// The end of the user mode part of the address space.
+#define USER_ADDRESS_END 0x0000800000000000ull
+
+//
+// Paging structure levels, in the same order as TableType in the UI.
+enum TABLE_LEVEL : ULONG
+{
+	TABLE_LEVEL_PML4 = 0,
+	TABLE_LEVEL_PDP,
+	TABLE_LEVEL_PD,
+	TABLE_LEVEL_PT,
+	TABLE_LEVEL_COUNT
+};
+
+// Offsets from virtual address:
+//   								   PML4       PDP       PD        PT        RAM
+//   						           47<--------39--------29--------20--------11--------0
+// 0x00007FF5639BF000 =                0111111111'110101011'000111001'101111110'00000000000
+#define BYTES_47_39(x) x >> 39
+#define BYTES_38_30(x) (x >> 30) & ~0b0111111111000000000
+#define BYTES_29_21(x) (x >> 21) & ~0b0111111111111111111000000000
+#define BYTES_20_12(x) (x >> 12) & ~0b0111111111111111111111111111000000000
+#define BYTES_11_0(x) x &          ~0b011111111111111111111111111111111111100000000000
+
+//
+// Stages of a single translation, timed with the TSC.
+// The driver times its own stages, the application the rest.
+enum TIMING_STAGE : ULONG
+{
+	//
+	// Driver: finding and opening the process
+	TIMING_STAGE_LOOKUP = 0,
+
+	//
+	// Driver: attaching to the process and paging the data in, if asked to
+	TIMING_STAGE_ATTACH,
+
+	//
+	// Driver: reading the tables
+	TIMING_STAGE_WALK,
+
+	//
+	// Driver: copying the page into Buffer
+	TIMING_STAGE_COPY,
+
+	TIMING_STAGE_DRIVER_COUNT,
+
+	//
+	// Application: opening the device
+	TIMING_STAGE_OPEN = TIMING_STAGE_DRIVER_COUNT,
+
+	//
+	// Application: DeviceIoControl without the driver stages, i.e. the transport
+	TIMING_STAGE_IOCTL,
+
+	//
+	// Application: formatting the page as GetPageData
+	TIMING_STAGE_FORMAT,
+
+	//
+	// Application: filling the views, DrawPT and the rest
+	TIMING_STAGE_BIND,
+
+	TIMING_STAGE_COUNT
+};
+
+struct STAGE_TIMES
+{
+	//
+	// Set by the application to have the stages timed, the timers do nothing otherwise
+	bool enabled;
+
+	//
+	// TSC ticks spent in every TIMING_STAGE
+	uint64_t ticks[TIMING_STAGE_COUNT];
+};
+
+struct IOCTL_RESPONSE
+{
+	//
+	// Registers
+	uint64_t regCR0;
+	uint64_t regCR2;
+	uint64_t regCR3;
+
+	//
+	// IA32_PAT of the processor which served the request
+	uint64_t regPAT;
+
+	//
+	// Final phys address
+	PHYSICAL_ADDRESS physAddress;
+
+	//
+	// PT Indexes
+	ULONG b47_39;
+	ULONG b38_30;
+	ULONG b29_21;
+	ULONG b20_12;
+	ULONG b11_00;
+
+	//
+	// Entries of the tables translating the address, zero below a leaf or a missing table
+	uint64_t flagsPML4;
+	uint64_t flagsPDP;
+	uint64_t flagsPD;
+	uint64_t flagsPT;
+
+	//
+	// Arrays with table addresses pointing to the next table in hierarchy.
+	PHYSICAL_ADDRESS pa47_39[TABLE_SIZE];
+	PHYSICAL_ADDRESS pa38_30[TABLE_SIZE];
+	PHYSICAL_ADDRESS pa29_21[TABLE_SIZE];
+	PHYSICAL_ADDRESS pa20_12[TABLE_SIZE];
+
+	STAGE_TIMES times;
+
+	//
+	// The data stored in a page
+	std::array<uint8_t, PAGE_SIZE> Buffer;
+};
+
+struct IOCTL_DATA
+{
+	ULONG pid;
+	PVOID address;
+	bool probe;
+	IOCTL_RESPONSE response;
+};
+
+//
+// Copy of a single paging structure found while walking the hierarchy.
+struct TABLE_PAGE
+{
+	//
+	// The first virtual address translated through this table
+	uint64_t baseVA;
+
+	//
+	// Physical address of the table itself
+	PHYSICAL_ADDRESS physAddress;
+
+	//
+	// TABLE_LEVEL of the table
+	ULONG level;
+	ULONG reserved;
+
+	uint64_t entries[TABLE_SIZE];
+};
+
+struct IOCTL_ENUM_REQUEST
+{
+	ULONG pid;
+
+	//
+	// Tables are returned ordered by (baseVA, level), which is the order of the
+	// depth-first walk. The request starts from the first table at or after
+	// (startVA, startLevel) and stops at endVA, which the driver
+	// clamps to USER_ADDRESS_END.
+	uint64_t startVA;
+	ULONG startLevel;
+	uint64_t endVA;
+
+	//
+	// Also return the tables on the path to startVA which begin before it,
+	// so the range can be translated without the rest of the hierarchy.
+	// Must be cleared when resuming from (nextVA, nextLevel).
+	bool parents;
+};
+
+struct IOCTL_ENUM_RESPONSE
+{
+	uint64_t regCR3;
+	uint64_t regPAT;
+
+	//
+	// Set if the walk reached endVA. Otherwise the next request
+	// should continue from (nextVA, nextLevel).
+	bool complete;
+	uint64_t nextVA;
+	ULONG nextLevel;
+
+	//
+	// Number of valid elements in tables
+	ULONG count;
+	TABLE_PAGE tables[ENUM_TABLES_PER_REQUEST];
+};
+
+struct IOCTL_ENUM_DATA
+{
+	IOCTL_ENUM_REQUEST request;
+	IOCTL_ENUM_RESPONSE response;
+};
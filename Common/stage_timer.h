@@ -0,0 +1,56 @@
+/*
+	stage_timer.h
+
+	TSC timers of the translation stages, shared by the driver and the application.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include "include.h"
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+/// <summary>
+/// Adds the TSC ticks of its scope to a stage.
+/// Unless the timing is enabled it costs a test of the flag.
+/// </summary>
+class StageTimer
+{
+public:
+	StageTimer(STAGE_TIMES& times, TIMING_STAGE stage) :
+		m_times(times),
+		m_stage(stage),
+		m_start(times.enabled ? __rdtsc() : 0)
+	{
+	}
+
+	~StageTimer()
+	{
+		Stop();
+	}
+
+	StageTimer(const StageTimer&) = delete;
+	StageTimer& operator=(const StageTimer&) = delete;
+
+	/// <summary>
+	/// End the stage before the end of the scope.
+	/// </summary>
+	void Stop()
+	{
+		if (m_start != 0)
+		{
+			m_times.ticks[m_stage] += __rdtsc() - m_start;
+			m_start = 0;
+		}
+	}
+
+private:
+	STAGE_TIMES& m_times;
+	TIMING_STAGE m_stage;
+	uint64_t m_start;
+};
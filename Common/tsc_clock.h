@@ -0,0 +1,73 @@
+/*
+	tsc_clock.h
+
+	Conversion of the TSC ticks to nanoseconds, calibrated against the steady clock.
+	User mode only, the driver records the raw ticks.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <chrono>
+#include <cstdint>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+/// <summary>
+/// The TSC and the clock at the start, the frequency is measured between the start and the query.
+/// </summary>
+class TscClock
+{
+public:
+	/// <summary>
+	/// Take the TSC and the clock, the zero of the ticks.
+	/// </summary>
+	void Start()
+	{
+		m_startTicks = __rdtsc();
+		m_startTime = std::chrono::steady_clock::now();
+	}
+
+	bool Started() const
+	{
+		return m_startTicks != 0;
+	}
+
+	uint64_t StartTicks() const
+	{
+		return m_startTicks;
+	}
+
+	/// <summary>
+	/// Measure the TSC frequency against the clock since the start.
+	/// </summary>
+	/// <returns>Ticks per nanosecond, 1 if not started</returns>
+	double TicksPerNanosecond() const
+	{
+		if (!Started())
+		{
+			return 1.0;
+		}
+
+		//
+		// A millisecond at least, the clock is too coarse otherwise.
+		auto now = std::chrono::steady_clock::now();
+		while (now - m_startTime < std::chrono::milliseconds(1))
+		{
+			now = std::chrono::steady_clock::now();
+		}
+
+		const uint64_t ticks = __rdtsc() - m_startTicks;
+		const double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_startTime).count());
+
+		return static_cast<double>(ticks) / ns;
+	}
+
+private:
+	uint64_t m_startTicks{ 0 };
+	std::chrono::steady_clock::time_point m_startTime;
+};
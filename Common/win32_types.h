@@ -0,0 +1,76 @@
+/*
+	win32_types.h
+
+	The Win32 definitions used by the shared headers and the core,
+	for building the platform independent part of the core elsewhere.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+//
+// Same widths as on Windows, ULONG is 32-bit there regardless of the data model.
+typedef uint8_t UCHAR;
+typedef uint8_t BYTE;
+typedef uint16_t USHORT;
+typedef int32_t LONG;
+typedef uint32_t ULONG;
+typedef uint32_t DWORD;
+typedef uint32_t UINT;
+typedef int64_t LONGLONG;
+typedef uint64_t ULONGLONG;
+typedef uintptr_t ULONG_PTR;
+typedef size_t SIZE_T;
+typedef int BOOL;
+typedef void* PVOID;
+typedef void* LPVOID;
+typedef const void* LPCVOID;
+typedef void* HANDLE;
+typedef void VOID;
+typedef uint8_t UINT8;
+typedef uint16_t UINT16;
+typedef uint32_t UINT32;
+typedef uint64_t UINT64;
+
+typedef union _LARGE_INTEGER
+{
+	struct
+	{
+		DWORD LowPart;
+		LONG HighPart;
+	};
+	LONGLONG QuadPart;
+} LARGE_INTEGER;
+
+#define FALSE 0
+#define TRUE 1
+#define MAX_PATH 260
+#define INVALID_HANDLE_VALUE (reinterpret_cast<HANDLE>(static_cast<intptr_t>(-1)))
+
+#define FILE_DEVICE_UNKNOWN 0x00000022
+#define METHOD_BUFFERED 0
+#define FILE_ANY_ACCESS 0
+#define CTL_CODE(DeviceType, Function, Method, Access) \
+	(((DeviceType) << 16) | ((Access) << 14) | ((Function) << 2) | (Method))
+
+//
+// Region types of VirtualQueryEx, kept in Region
+#define MEM_IMAGE 0x1000000
+#define MEM_MAPPED 0x40000
+#define MEM_PRIVATE 0x20000
+
+#define ERROR_SUCCESS 0L
+#define ERROR_FILE_NOT_FOUND 2L
+#define ERROR_NOT_ENOUGH_MEMORY 8L
+#define ERROR_INVALID_DATA 13L
+#define ERROR_WRITE_FAULT 29L
+#define ERROR_READ_FAULT 30L
+#define ERROR_NOT_SUPPORTED 50L
+#define ERROR_INVALID_PARAMETER 87L
+#define ERROR_OPEN_FAILED 110L
+#define ERROR_NOT_FOUND 1168L
+#define ERROR_NOT_ENOUGH_QUOTA 1816L
@@ -16,8 +16,17 @@
 #include <bitset>
 #include <thread>
 #include <format>
+#include <msclr/marshal_cppstd.h>
 #include "ia32.hpp"
+#include "buffer_pool.h"
+#include "entry_fields.h"
+#include "latency.h"
+#include "memory_type.h"
+#include "module_cache.h"
+#include "numa.h"
 #include "resource.h"
+#include "stage_timer.h"
+#include "timeline.h"
 
 #pragma comment(lib, "advapi32.lib")
 
@@ -166,6 +175,37 @@ concept AllowedTempalteTypes = std::is_same_v<T, pml4e_64> ||
                                std::is_same_v<T, pdpte_64> ||
                                std::is_same_v<T, pde_64> ||
                                std::is_same_v<T, pte_64>;
+
+/// <summary>
+/// Fill a property grid row with the fields of the entry.
+/// The grid columns follow the fields from the highest bit, the first column is the row name.
+/// </summary>
+/// <typeparam name="T">ia32.hpp entry type</typeparam>
+/// <param name="grid">Property grid</param>
+/// <param name="row">Row index</param>
+/// <param name="value">Raw entry</param>
+template <typename T>
+static void SetGridFields(DataGridView^ grid, int row, const uint64_t value)
+{
+    int column = 1;
+
+    //
+    // Lambdas cannot capture the grid handle, so the fields are iterated directly.
+    for (const auto& field : PTE::EntryFields<T>::Fields)
+    {
+        if (field.hex)
+        {
+            grid->Rows[row]->Cells[column++]->Value = gcnew String(std::format("0x{:x}", field.Get(value)).data());
+        }
+        else
+        {
+            grid->Rows[row]->Cells[column++]->Value = field.Get(value);
+        }
+    }
+
+    grid->CurrentCell = nullptr;
+}
+
 /// <summary>
 /// Set the data for the table properties.
 /// </summary>
@@ -174,73 +214,48 @@ concept AllowedTempalteTypes = std::is_same_v<T, pml4e_64> ||
 template <AllowedTempalteTypes T>
 void SetPTProperties(const uint64_t value)
 {
-    T val;
-    
     //
-    // Set the property structure.
-    val.flags = value;
-    auto pageFrameNumber = gcnew String(std::format("0x{:x}", std::bit_cast<uint64_t>(val.page_frame_number)).data());
-
-    //
-    // PT has different set of attributes.
-    // Since this is a template method, T type needs to be compile-time evaluated,
-    // otherwise, it would error out on type members. 
+    // PT has different set of attributes and its own grid.
     if constexpr (std::is_same_v<T, pte_64>)
     {
-        PTE::MainForm::GetInstance()->dgvPTProperties->Rows[1]->Cells[1]->Value = val.execute_disable;
-        PTE::MainForm::GetInstance()->dgvPTProperties->Rows[1]->Cells[2]->Value = val.protection_key;
-        PTE::MainForm::GetInstance()->dgvPTProperties->Rows[1]->Cells[3]->Value = val.ignored_2;
-        PTE::MainForm::GetInstance()->dgvPTProperties->Rows[1]->Cells[4]->Value = val.reserved1;
-        PTE::MainForm::GetInstance()->dgvPTProperties->Rows[1]->Cells[5]->Value = pageFrameNumber;
-        PTE::MainForm::GetInstance()->dgvPTProperties->Rows[1]->Cells[6]->Value = val.ignored_1;
-        PTE::MainForm::GetInstance()->dgvPTProperties->Rows[1]->Cells[7]->Value = val.global;
-        PTE::MainForm::GetInstance()->dgvPTProperties->Rows[1]->Cells[8]->Value = val.pat;
-        PTE::MainForm::GetInstance()->dgvPTProperties->Rows[1]->Cells[9]->Value = val.dirty;
-        PTE::MainForm::GetInstance()->dgvPTProperties->Rows[1]->Cells[10]->Value = val.accessed;
-        PTE::MainForm::GetInstance()->dgvPTProperties->Rows[1]->Cells[11]->Value = val.page_level_cache_disable;
-        PTE::MainForm::GetInstance()->dgvPTProperties->Rows[1]->Cells[12]->Value = val.page_level_write_through;
-        PTE::MainForm::GetInstance()->dgvPTProperties->Rows[1]->Cells[13]->Value = val.supervisor;
-        PTE::MainForm::GetInstance()->dgvPTProperties->Rows[1]->Cells[14]->Value = val.write;
-        PTE::MainForm::GetInstance()->dgvPTProperties->Rows[1]->Cells[15]->Value = val.present;
-
-        PTE::MainForm::GetInstance()->dgvPTProperties->CurrentCell = nullptr;
+        SetGridFields<T>(PTE::MainForm::GetInstance()->dgvPTProperties, 1, value);
     }
     else
     {
         //
         // Property table row index.
-        uint8_t i = 0;
-        if (std::is_same<T, pml4e_64>::value)
-        {
-            i = 1;
-        }
-        else if (std::is_same<T, pdpte_64>::value)
+        int i = 1;
+        if constexpr (std::is_same_v<T, pdpte_64>)
         {
             i = 2;
         }
-        else if (std::is_same<T, pde_64>::value)
+        else if constexpr (std::is_same_v<T, pde_64>)
         {
             i = 3;
-        }       
+        }
 
-        PTE::MainForm::GetInstance()->dgvProperties->Rows[i]->Cells[1]->Value = val.execute_disable;
-        PTE::MainForm::GetInstance()->dgvProperties->Rows[i]->Cells[2]->Value = val.ignored_2;
-        PTE::MainForm::GetInstance()->dgvProperties->Rows[i]->Cells[3]->Value = val.reserved2;
-        PTE::MainForm::GetInstance()->dgvProperties->Rows[i]->Cells[4]->Value = pageFrameNumber;
-        PTE::MainForm::GetInstance()->dgvProperties->Rows[i]->Cells[5]->Value = val.ignored_1;
-        //
-        // "large_page" for pdpte_64 or pde_64. "must_be_zero" for pml4e_64
-        PTE::MainForm::GetInstance()->dgvProperties->Rows[i]->Cells[6]->Value = ((value) >> 7) & 0x01;
-        PTE::MainForm::GetInstance()->dgvProperties->Rows[i]->Cells[7]->Value = val.reserved1;
-        PTE::MainForm::GetInstance()->dgvProperties->Rows[i]->Cells[8]->Value = val.accessed;
-        PTE::MainForm::GetInstance()->dgvProperties->Rows[i]->Cells[9]->Value = val.page_level_cache_disable;
-        PTE::MainForm::GetInstance()->dgvProperties->Rows[i]->Cells[10]->Value = val.page_level_write_through;
-        PTE::MainForm::GetInstance()->dgvProperties->Rows[i]->Cells[11]->Value = val.supervisor;
-        PTE::MainForm::GetInstance()->dgvProperties->Rows[i]->Cells[12]->Value = val.write;
-        PTE::MainForm::GetInstance()->dgvProperties->Rows[i]->Cells[13]->Value = val.present;
+        SetGridFields<T>(PTE::MainForm::GetInstance()->dgvProperties, i, value);
+    }
+}
 
-        PTE::MainForm::GetInstance()->dgvProperties->CurrentCell = nullptr;
+/// <summary>
+/// Resolve the effective memory type of the leaf entry translating the address.
+/// </summary>
+/// <param name="response">The data returned by driver.</param>
+/// <returns>Text for the address list</returns>
+static std::string GetMemoryTypeText(const IOCTL_RESPONSE& response)
+{
+    ULONG level{ 0 };
+    uint64_t entry{ 0 };
+    if (!PTE::MemoryTypes::LeafEntry(response, level, entry))
+    {
+        return "Memory Type: not mapped";
     }
+
+    return std::format("Memory Type: {} (PAT entry {}, IA32_PAT 0x{:016x})",
+        PTE::MemoryTypes::Name(PTE::MemoryTypes::Resolve(response.regPAT, level, entry)),
+        PTE::MemoryTypes::PatIndex(level, entry),
+        response.regPAT);
 }
 
 /// <summary>
@@ -252,43 +267,15 @@ static void SetRegistersProperties(const IOCTL_RESPONSE& response)
     //
     // https://wiki.osdev.org/CPU_Registers_x86
     //
-    cr0 cr_0{ .flags = response.regCR0 };
-    PTE::MainForm::GetInstance()->dataGridCR0->Rows[1]->Cells[1]->Value = cr_0.reserved4;
-    PTE::MainForm::GetInstance()->dataGridCR0->Rows[1]->Cells[2]->Value = cr_0.paging_enable;
-    PTE::MainForm::GetInstance()->dataGridCR0->Rows[1]->Cells[3]->Value = cr_0.cache_disable;
-    PTE::MainForm::GetInstance()->dataGridCR0->Rows[1]->Cells[4]->Value = cr_0.not_write_through;
-    PTE::MainForm::GetInstance()->dataGridCR0->Rows[1]->Cells[5]->Value = cr_0.reserved3;
-    PTE::MainForm::GetInstance()->dataGridCR0->Rows[1]->Cells[6]->Value = cr_0.alignment_mask;
-    PTE::MainForm::GetInstance()->dataGridCR0->Rows[1]->Cells[7]->Value = cr_0.reserved2;
-    PTE::MainForm::GetInstance()->dataGridCR0->Rows[1]->Cells[8]->Value = cr_0.write_protect;
-    PTE::MainForm::GetInstance()->dataGridCR0->Rows[1]->Cells[9]->Value = cr_0.reserved1;
-    PTE::MainForm::GetInstance()->dataGridCR0->Rows[1]->Cells[10]->Value = cr_0.numeric_error;
-    PTE::MainForm::GetInstance()->dataGridCR0->Rows[1]->Cells[11]->Value = cr_0.extension_type;
-    PTE::MainForm::GetInstance()->dataGridCR0->Rows[1]->Cells[12]->Value = cr_0.task_switched;
-    PTE::MainForm::GetInstance()->dataGridCR0->Rows[1]->Cells[13]->Value = cr_0.emulate_fpu;
-    PTE::MainForm::GetInstance()->dataGridCR0->Rows[1]->Cells[14]->Value = cr_0.monitor_coprocessor;
-    PTE::MainForm::GetInstance()->dataGridCR0->Rows[1]->Cells[15]->Value = cr_0.protection_enable;
-    PTE::MainForm::GetInstance()->dataGridCR0->CurrentCell = nullptr;
+    SetGridFields<cr0>(PTE::MainForm::GetInstance()->dataGridCR0, 1, response.regCR0);
 
     PTE::MainForm::GetInstance()->labelCR2->Text = "CR2: " + gcnew String(std::format("0x{:x}", response.regCR2).data());
 
-    cr3 cr_3{ .flags = response.regCR3 };
-    auto address_of_page_directory = cr_3.address_of_page_directory;
-
-    PTE::MainForm::GetInstance()->dataGridCR3->Rows[1]->Cells[1]->Value = cr_3.reserved3;
-    PTE::MainForm::GetInstance()->dataGridCR3->Rows[1]->Cells[2]->Value = gcnew String(std::format("0x{:x}", address_of_page_directory).data());
-    PTE::MainForm::GetInstance()->dataGridCR3->Rows[1]->Cells[3]->Value = cr_3.reserved2;
-    PTE::MainForm::GetInstance()->dataGridCR3->Rows[1]->Cells[4]->Value = cr_3.page_level_cache_disable;
-    PTE::MainForm::GetInstance()->dataGridCR3->Rows[1]->Cells[5]->Value = cr_3.page_level_write_through;
-    PTE::MainForm::GetInstance()->dataGridCR3->Rows[1]->Cells[6]->Value = cr_3.reserved1;
-    PTE::MainForm::GetInstance()->dataGridCR3->CurrentCell = nullptr;
+    SetGridFields<cr3>(PTE::MainForm::GetInstance()->dataGridCR3, 1, response.regCR3);
 
     //
     // TODO: Add CR4
     //
-
-    PTE::MainForm::GetInstance()->dataGridCR0->CurrentCell = nullptr;
-    PTE::MainForm::GetInstance()->dataGridCR3->CurrentCell = nullptr;
 }
 
 /// <summary>
@@ -344,19 +331,34 @@ System::Void PTE::MainForm::UpdateUIBasedOnAddress(unsigned long long address, v
 
     //
     // Fill the tables
-    DrawPT(TableType::PML4, b47_39, &response->pa47_39);
-    DrawPT(TableType::PDP, b38_30, &response->pa38_30);
-    DrawPT(TableType::PD, b29_21, &response->pa29_21);
-    DrawPT(TableType::PT, b20_12, &response->pa20_12);
+    {
+        StageTimer bindTimer(response->times, TIMING_STAGE_BIND);
+        DrawPT(TableType::PML4, b47_39, &response->pa47_39);
+        DrawPT(TableType::PDP, b38_30, &response->pa38_30);
+        DrawPT(TableType::PD, b29_21, &response->pa29_21);
+        DrawPT(TableType::PT, b20_12, &response->pa20_12);
+    }
 
     //
     // Print bytes.
     if (!bPageFault)
     {
-        this->richTextBoxMemory->Text = gcnew String(PTE::Utils::GetPageData(address,
+        StageTimer formatTimer(response->times, TIMING_STAGE_FORMAT);
+        std::string pageData = PTE::Utils::GetPageData(address,
             response->physAddress.QuadPart,
             response->Buffer.data(),
-            response->Buffer.size()).data());
+            response->Buffer.size());
+        formatTimer.Stop();
+
+        this->richTextBoxMemory->Text = gcnew String(pageData.data());
+
+        PTE::PageClass content = PTE::PageClassifier::Classify(response->Buffer.data());
+        const uint16_t node = PTE::NumaMap::System().NodeOf(response->physAddress.QuadPart / PAGE_SIZE);
+        stripStatusLabel->Text = gcnew String(std::format("Page content: {}entropy {:.2f} bits/byte, ~{} bytes compressed, {}",
+            content.Zero ? "zero, " : content.Pattern ? "repeated pattern, " : "",
+            content.Entropy,
+            content.CompressedBytes,
+            node == PTE::NumaMap::UnknownNode ? std::string("node unknown") : std::format("node {}", node)).data());
     }
     else
     {
@@ -418,6 +420,10 @@ System::Void PTE::MainForm::UpdateUIBasedOnAddress(unsigned long long address, v
     SetPTProperties<pdpte_64>(response->flagsPDP);
     SetPTProperties<pde_64>(response->flagsPD);
     SetPTProperties<pte_64>(response->flagsPT);
+
+    //
+    // The raw PAT, PCD and PWT bits select the memory type through IA32_PAT.
+    addressListBox->Items->Add(gcnew String(GetMemoryTypeText(*response).data()));
 }
 
 /// <summary>
@@ -455,15 +461,16 @@ System::Void PTE::MainForm::DgvMemory_CellContentClick(System::Object^ sender, S
 
     //
     // Send request to the driver.
-    // The buffer allocated here will be used for both request and response.
+    // The buffer taken here will be used for both request and response,
+    // it comes back to the pool after the click, so the next one does not allocate.
     // This memory will be locked by driver while ioctl is processed.
-    IOCTL_DATA* ioctlData = static_cast<IOCTL_DATA*>(malloc(sizeof(IOCTL_DATA)));
-    if (ioctlData == nullptr)
+    PTE::BufferPool<IOCTL_DATA>::Lease ioctlData = PTE::BufferPool<IOCTL_DATA>::Acquire();
+    if (!ioctlData)
     {
         return;
     }
 
-    memset(ioctlData, 0, sizeof(IOCTL_DATA));
+    memset(ioctlData.Get(), 0, sizeof(IOCTL_DATA));
     
     //
     // Ask driver to give us the info about the address checkBoxAlwaysUnpage->Checked
@@ -473,16 +480,19 @@ System::Void PTE::MainForm::DgvMemory_CellContentClick(System::Object^ sender, S
         probe = true;
         s_UnpageButtonPressed = false;
     }
-    PTE::Utils::SendIOCTL(static_cast<ULONG>(pid), address, ioctlData, probe);
+    unsigned long err = PTE::Utils::SendIOCTL(static_cast<ULONG>(pid), address, ioctlData.Get(), probe);
+    if (err != ERROR_SUCCESS)
+    {
+        stripStatusLabel->Text = gcnew String(std::format("IOCTL failed: [{}]", err).data());
+    }
 
     //
     // Update the UI based on the response from driver
-    UpdateUIBasedOnAddress(address, &ioctlData->response);
-
-    if (ioctlData)
     {
-        free(ioctlData);
+        PTE::TimelineScope scope(PTE::TimelineCategory::Export, "update views", pid);
+        UpdateUIBasedOnAddress(address, &ioctlData->response);
     }
+    PTE::Latency::Record(ioctlData->response.times);
 }
 
 /// <summary>
@@ -584,57 +594,125 @@ System::Void PTE::MainForm::ButtonUnpage_Click(System::Object^ sender, System::E
     DgvMemory_CellContentClick(sender, newEvent);
 }
 
+/// <summary>
+/// Turn the timing of the translation stages on or off.
+/// </summary>
+/// <param name="sender">Sender info.</param>
+System::Void PTE::MainForm::TimingToolStripMenuItem_Click(System::Object^ /*sender*/, System::EventArgs^ /*e*/)
+{
+    PTE::Latency::Enable(TimingStripMenuItem->Checked);
+    stripStatusLabel->Text = TimingStripMenuItem->Checked ? "Stage timing on" : "Stage timing off";
+}
+
+/// <summary>
+/// Save the histograms of the stage times collected so far.
+/// </summary>
+/// <param name="sender">Sender info.</param>
+System::Void PTE::MainForm::SaveTimingToolStripMenuItem_Click(System::Object^ /*sender*/, System::EventArgs^ /*e*/)
+{
+    SaveFileDialog^ dialog = gcnew SaveFileDialog();
+    dialog->Filter = "Text files (*.txt)|*.txt|All files (*.*)|*.*";
+    dialog->FileName = "timing.txt";
+    if (dialog->ShowDialog() != System::Windows::Forms::DialogResult::OK)
+    {
+        return;
+    }
+
+    std::wstring path = msclr::interop::marshal_as<std::wstring>(dialog->FileName);
+    stripStatusLabel->Text = PTE::Latency::WriteReport(path) ? "Timing saved to " + dialog->FileName : "Failed to save the timing";
+}
+
+/// <summary>
+/// Turn the recording of the timeline on or off.
+/// </summary>
+/// <param name="sender">Sender info.</param>
+System::Void PTE::MainForm::TimelineToolStripMenuItem_Click(System::Object^ /*sender*/, System::EventArgs^ /*e*/)
+{
+    PTE::Timeline::Enable(TimelineStripMenuItem->Checked);
+    if (TimelineStripMenuItem->Checked)
+    {
+        PTE::Timeline::NameThread("ui");
+    }
+    stripStatusLabel->Text = TimelineStripMenuItem->Checked ? "Timeline recording on" : "Timeline recording off";
+}
+
+/// <summary>
+/// Save the timeline recorded so far as a Perfetto or a Chrome trace.
+/// </summary>
+/// <param name="sender">Sender info.</param>
+System::Void PTE::MainForm::SaveTimelineToolStripMenuItem_Click(System::Object^ /*sender*/, System::EventArgs^ /*e*/)
+{
+    SaveFileDialog^ dialog = gcnew SaveFileDialog();
+    dialog->Filter = "Perfetto trace (*.perfetto-trace)|*.perfetto-trace|Chrome trace (*.json)|*.json";
+    dialog->FileName = "timeline.perfetto-trace";
+    if (dialog->ShowDialog() != System::Windows::Forms::DialogResult::OK)
+    {
+        return;
+    }
+
+    std::wstring path = msclr::interop::marshal_as<std::wstring>(dialog->FileName);
+    stripStatusLabel->Text = PTE::Timeline::Write(path) ? "Timeline saved to " + dialog->FileName : "Failed to save the timeline";
+}
+
 /// <summary>
 /// Create a memory table entry and get the memory properties.
 /// </summary>
-/// <param name="mbi">Memory information</param>
-/// <param name="strAddress">The Memory address as a string.</param>
+/// <param name="region">Memory information</param>
 /// <returns>Memory table entry</returns>
-static PTE::AddressTable^ GetAddressEntry(const MEMORY_BASIC_INFORMATION& mbi, const std::string& strAddress)
+static PTE::AddressTable^ GetAddressEntry(const PTE::Region& region)
 {
     std::wstring result;
 
-    if (mbi.Protect & PAGE_EXECUTE)
+    //
+    // Indent if not a base address.
+    std::string strAddress{ };
+    if (region.AllocationBase != region.BaseAddress)
+    {
+        strAddress += std::format("   ");
+    }
+    strAddress += std::format("0x{:x}", region.BaseAddress);
+
+    if (region.Protect & PAGE_EXECUTE)
     {
         result = L"X";
     }
-    else if (mbi.Protect & PAGE_EXECUTE_READ)
+    else if (region.Protect & PAGE_EXECUTE_READ)
     {
         result = L"RX";
     }
-    else if (mbi.Protect & PAGE_EXECUTE_READWRITE)
+    else if (region.Protect & PAGE_EXECUTE_READWRITE)
     {
         result = L"RWX";
     }
-    else if (mbi.Protect & PAGE_EXECUTE_WRITECOPY)
+    else if (region.Protect & PAGE_EXECUTE_WRITECOPY)
     {
         result = L"WCX";
     }
-    else if (mbi.Protect & PAGE_NOACCESS)
+    else if (region.Protect & PAGE_NOACCESS)
     {
         result = L"NA";
     }
-    else if (mbi.Protect & PAGE_READONLY)
+    else if (region.Protect & PAGE_READONLY)
     {
         result = L"R";
     }
-    else if (mbi.Protect & PAGE_READWRITE)
+    else if (region.Protect & PAGE_READWRITE)
     {
         result = L"RW";
     }
-    else if (mbi.Protect & PAGE_WRITECOPY)
+    else if (region.Protect & PAGE_WRITECOPY)
     {
         result = L"WC";
     }
-    else if (mbi.Protect & PAGE_TARGETS_INVALID)
+    else if (region.Protect & PAGE_TARGETS_INVALID)
     {
         result = L"INV";
     }
-    else if (mbi.Protect & PAGE_TARGETS_NO_UPDATE)
+    else if (region.Protect & PAGE_TARGETS_NO_UPDATE)
     {
         result = L"NU";
     }
-    else if (mbi.State & MEM_RESERVE)
+    else if (region.State & MEM_RESERVE)
     {
         result = L"RESERVE";
     }
@@ -643,16 +721,16 @@ static PTE::AddressTable^ GetAddressEntry(const MEMORY_BASIC_INFORMATION& mbi, c
         result = L"";
     }
 
-    if (mbi.Protect & PAGE_GUARD)
+    if (region.Protect & PAGE_GUARD)
     {
         result += L",PG";
     }
-    if (mbi.Protect & PAGE_NOCACHE)
+    if (region.Protect & PAGE_NOCACHE)
     {
         result += L",NC";
 
     }
-    if (mbi.Protect & PAGE_WRITECOMBINE)
+    if (region.Protect & PAGE_WRITECOMBINE)
     {
         result+= L",WCM";
     }
@@ -661,17 +739,17 @@ static PTE::AddressTable^ GetAddressEntry(const MEMORY_BASIC_INFORMATION& mbi, c
     // Create the memory table entry
     auto tableEntry = gcnew PTE::AddressTable(gcnew String(strAddress.data()), gcnew String(result.data()));
 
-    if ((mbi.State & MEM_RESERVE))
+    if ((region.State & MEM_RESERVE))
     {
         tableEntry->CellColor = System::Drawing::SystemColors::ControlLight;
     }
-    else if (mbi.Protect & PAGE_GUARD)
+    else if (region.Protect & PAGE_GUARD)
     {
         tableEntry->CellColor = System::Drawing::Color::Plum;
     }
     else
     {
-        switch (mbi.Type)
+        switch (region.Type)
         {
         case MEM_IMAGE:
             tableEntry->CellColor = System::Drawing::SystemColors::GradientActiveCaption;
@@ -690,8 +768,137 @@ static PTE::AddressTable^ GetAddressEntry(const MEMORY_BASIC_INFORMATION& mbi, c
     return tableEntry;
 }
 
+/// <summary>
+/// Check if the region is shown in the memory table.
+/// Base addresses are included to show the hierarchy.
+/// </summary>
+/// <param name="region">Memory information</param>
+/// <returns>True if shown</returns>
+static bool IsRegionDisplayed(const PTE::Region& region)
+{
+    return !((!(region.State & MEM_COMMIT) && region.AllocationBase != region.BaseAddress) ||
+        region.Protect == PAGE_NOACCESS);
+}
+
+/// <summary>
+/// Set the map of addresses.
+/// It is used to get the memory properties when user clicks of an address.
+/// </summary>
+/// <param name="hProcess">Process handle</param>
+/// <param name="region">Memory information</param>
+static void SetRegionInfo(HANDLE hProcess, const PTE::Region& region)
+{
+    auto& info = PTE::s_CurrentProcMemory[region.BaseAddress];
+    info =
+    {
+        .Type = region.Type,
+        .Protection = region.Protect,
+        .State = region.State,
+        .RegionSize = region.RegionSize
+    };
+
+    //
+    // If backed by file, get its name.
+    if (region.Type == MEM_IMAGE || region.Type == MEM_MAPPED)
+    {
+        info.Use = PTE::ModuleCache::GetName(hProcess, reinterpret_cast<PVOID>(static_cast<ULONG_PTR>(region.AllocationBase)));
+    }
+}
+
+/// <summary>
+/// Set the memory table row color based on the data.
+/// </summary>
+/// <param name="grid">The memory table</param>
+/// <param name="row">Row index</param>
+/// <param name="color">Row color</param>
+static void SetRowColor(DataGridView^ grid, int row, System::Drawing::Color color)
+{
+    grid->Rows[row]->DefaultCellStyle->BackColor =
+        color != System::Drawing::Color::Transparent ? color : System::Drawing::Color::Empty;
+}
+
+/// <summary>
+/// Apply the region changes to the memory table and the address map
+/// instead of rebuilding them.
+/// </summary>
+/// <param name="hProcess">Process handle</param>
+/// <param name="grid">The memory table</param>
+/// <param name="memoryList">Data source of the memory table, in the s_CurrentProcRegions order</param>
+/// <param name="diff">Changes of the displayed regions</param>
+static void PatchAddressTable(HANDLE hProcess,
+    DataGridView^ grid,
+    BindingList<PTE::AddressTable>^ memoryList,
+    const PTE::RegionDiff& diff)
+{
+    //
+    // Base addresses of the current rows, kept in sync with the list.
+    std::vector<uint64_t> rows;
+    rows.reserve(PTE::s_CurrentProcRegions.size() + diff.Added.size());
+    for (const auto& region : PTE::s_CurrentProcRegions)
+    {
+        rows.push_back(region.BaseAddress);
+    }
+
+    //
+    // Base addresses are unique across the three lists, merge them in the table order.
+    size_t removed = 0;
+    size_t added = 0;
+    size_t changed = 0;
+    int row = 0;
+
+    while (removed < diff.Removed.size() || added < diff.Added.size() || changed < diff.Changed.size())
+    {
+        uint64_t next = UINT64_MAX;
+        if (removed < diff.Removed.size())
+        {
+            next = std::min(next, diff.Removed[removed].BaseAddress);
+        }
+        if (added < diff.Added.size())
+        {
+            next = std::min(next, diff.Added[added].BaseAddress);
+        }
+        if (changed < diff.Changed.size())
+        {
+            next = std::min(next, diff.Changed[changed].BaseAddress);
+        }
+
+        while (row < static_cast<int>(rows.size()) && rows[row] < next)
+        {
+            ++row;
+        }
+
+        if (removed < diff.Removed.size() && diff.Removed[removed].BaseAddress == next)
+        {
+            PTE::s_CurrentProcMemory.erase(next);
+            memoryList->RemoveAt(row);
+            rows.erase(rows.begin() + row);
+            ++removed;
+        }
+        else if (added < diff.Added.size() && diff.Added[added].BaseAddress == next)
+        {
+            auto entry = GetAddressEntry(diff.Added[added]);
+            SetRegionInfo(hProcess, diff.Added[added]);
+            memoryList->Insert(row, *entry);
+            rows.insert(rows.begin() + row, next);
+            SetRowColor(grid, row, entry->CellColor);
+            ++row;
+            ++added;
+        }
+        else
+        {
+            auto entry = GetAddressEntry(diff.Changed[changed]);
+            SetRegionInfo(hProcess, diff.Changed[changed]);
+            memoryList[row] = *entry;
+            SetRowColor(grid, row, entry->CellColor);
+            ++row;
+            ++changed;
+        }
+    }
+}
+
 /// <summary>
 /// Fill the address table for the selected process.
+/// Clicking the same process again only applies the changes since the previous time.
 /// </summary>
 /// <param name="e">The event</param>
 System::Void PTE::MainForm::DrawAddressTable(System::Object^ /*sender*/, System::Windows::Forms::DataGridViewCellEventArgs^ e)
@@ -701,76 +908,90 @@ System::Void PTE::MainForm::DrawAddressTable(System::Object^ /*sender*/, System:
         return;
     }
 
-    //
-    // s_CurrentProcMemory hash table is used to store the memory and its properties,
-    // so it could be retrieved when user clicks on an address without requesting the properties.
     dgvMemory->DefaultCellStyle->SelectionBackColor = System::Drawing::SystemColors::Highlight;
-    s_CurrentProcMemory.clear();
     stripStatusLabel->Text = "";
 
+    ULONG selectedPid = static_cast<ULONG>(dgvProcesses->CurrentRow->Cells["PID"]->Value);
+    HANDLE hProcess = nullptr;
+
     //
-    // Data source for the table
-    auto memoryList = gcnew BindingList <AddressTable>();
- 
-    HANDLE hProcess = PTE::Utils::OpenSelectedProcessPrivileged();
-    if (!hProcess)
+    // System process cannot be handled.
+    if (selectedPid <= 4)
     {
-        return;
+        dgvMemory->Rows->Clear();
     }
-
-    MEMORY_BASIC_INFORMATION mbi;
-    uint8_t* address = 0;
-
-    while (VirtualQueryEx(hProcess, address, &mbi, sizeof(mbi)))
+    else
     {
-        address += mbi.RegionSize;
-
-        //
-        // Include base addresses to show the hierarchy
-        if ((!(mbi.State & MEM_COMMIT) && mbi.AllocationBase != mbi.BaseAddress) ||
-            mbi.Protect == PAGE_NOACCESS)
+        bool debugPrivileged = IsDebugPrivileged();
+        if (PTE::Utils::OpenProcessPrivileged(selectedPid, debugPrivileged, hProcess) != ERROR_SUCCESS)
         {
-            continue;
+            stripStatusLabel->Text = "Cannot get the handle to the process. Try running tool as Administrator.";
         }
-
-        //
-        // Indent if not a base address.
-        std::string strAddress{ };
-        if (mbi.AllocationBase != mbi.BaseAddress)
+        if (debugPrivileged)
         {
-            strAddress += std::format("   ");
+            SetDebugPrivileged();
         }
-        strAddress += std::format("0x{:x}", std::bit_cast<ULONGLONG>(mbi.BaseAddress));
+    }
 
-        //
-        // Set the map of addresses.
-        // It is used to get the memory properties when user clicks of an address.
-        s_CurrentProcMemory[std::bit_cast<ULONG_PTR>(mbi.BaseAddress)] =
-        {
-            .Type = mbi.Type,
-            .Protection = mbi.Protect,
-            .State = mbi.State,
-            .RegionSize = mbi.RegionSize
-        };
+    if (!hProcess)
+    {
+        s_CurrentProcMemory.clear();
+        s_CurrentProcRegions.clear();
+        s_CurrentProcPid = 0;
+        return;
+    }
 
-        //
-        // If backed by file, get its name.
-        if (mbi.Type == MEM_IMAGE)
-        {
-            wchar_t wzModuleName[MAX_PATH]{ };
+    ULONG pid = GetProcessId(hProcess);
 
-            GetModuleFileNameW(std::bit_cast<HMODULE>(mbi.AllocationBase), wzModuleName, MAX_PATH);
-            s_CurrentProcMemory[std::bit_cast<ULONG_PTR>(mbi.BaseAddress)].Use = wzModuleName;
-        }
+    //
+    // Names are resolved against the target, the module list is only reloaded when it changes.
+    PTE::ModuleCache::Load(hProcess);
+
+    std::vector<Region> regions;
+    PTE::Regions::Enumerate(hProcess, regions);
+    std::erase_if(regions, [](const Region& region) { return !IsRegionDisplayed(region); });
 
-        memoryList->Add(*GetAddressEntry(mbi, strAddress));
+    //
+    // Same process: patch the table if the changes are small enough.
+    auto memoryList = dynamic_cast<BindingList<AddressTable>^>(dgvMemory->DataSource);
+    if (pid == s_CurrentProcPid && memoryList != nullptr)
+    {
+        RegionDiff diff = PTE::Regions::Diff(s_CurrentProcRegions, regions);
+
+        if (diff.Size() <= regions.size() / 4)
+        {
+            PatchAddressTable(hProcess, dgvMemory, memoryList, diff);
+            s_CurrentProcRegions = std::move(regions);
+            CloseHandle(hProcess);
+
+            stripStatusLabel->Text = gcnew String(std::format("Regions refreshed: +{} -{} ~{}",
+                diff.Added.size(),
+                diff.Removed.size(),
+                diff.Changed.size()).data());
+            return;
+        }
     }
 
-    if (hProcess)
+    //
+    // s_CurrentProcMemory hash table is used to store the memory and its properties,
+    // so it could be retrieved when user clicks on an address without requesting the properties.
+    s_CurrentProcMemory.clear();
+
+    //
+    // Data source for the table
+    memoryList = gcnew BindingList <AddressTable>();
+
+    for (const auto& region : regions)
     {
-        CloseHandle(hProcess);
+        SetRegionInfo(hProcess, region);
+        memoryList->Add(*GetAddressEntry(region));
     }
 
+    CloseHandle(hProcess);
+
+    s_CurrentProcRegions = std::move(regions);
+    s_CurrentProcPid = pid;
+
     dgvMemory->DataSource = memoryList;
 
     //
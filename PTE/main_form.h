@@ -11,7 +11,8 @@
 	2025
 */
 #pragma once
-#include "Utils.h"
+#include "utils.h"
+#include "regions.h"
 #include <unordered_map>
 
 typedef struct _MEMORY_INFORMATION
@@ -40,6 +41,13 @@ using namespace System::Drawing;
 /// </summary>
 static std::unordered_map<ULONG_PTR, MEMORY_INFORMATION> s_CurrentProcMemory{};
 
+/// <summary>
+/// The regions shown in the memory table, in the table order,
+/// and the process they belong to. Used to refresh the table incrementally.
+/// </summary>
+static std::vector<PTE::Region> s_CurrentProcRegions{};
+static ULONG s_CurrentProcPid{ 0 };
+
 //
 // Properties names should match column names.
 // Used for data binding.
@@ -169,6 +177,10 @@ private: System::Windows::Forms::ToolStripMenuItem^ menu1ToolStripMenuItem;
 private: System::Windows::Forms::ToolStripMenuItem^ aboutToolStripMenuItem;
 private: System::Windows::Forms::ToolStripMenuItem^ aboutToolStripMenuItem1;
 private: System::Windows::Forms::ToolStripMenuItem^ RefreshStripMenuItem;
+private: System::Windows::Forms::ToolStripMenuItem^ TimingStripMenuItem;
+private: System::Windows::Forms::ToolStripMenuItem^ SaveTimingStripMenuItem;
+private: System::Windows::Forms::ToolStripMenuItem^ TimelineStripMenuItem;
+private: System::Windows::Forms::ToolStripMenuItem^ SaveTimelineStripMenuItem;
 private: System::Windows::Forms::ToolStripMenuItem^ exitToolStripMenuItem;
 private: System::Windows::Forms::Panel^ panel1;
 public: System::Windows::Forms::DataGridView^ dataGridViewPT;
@@ -426,6 +438,10 @@ private:
 		this->menuStrip1 = (gcnew System::Windows::Forms::MenuStrip());
 		this->menu1ToolStripMenuItem = (gcnew System::Windows::Forms::ToolStripMenuItem());
 		this->RefreshStripMenuItem = (gcnew System::Windows::Forms::ToolStripMenuItem());
+		this->TimingStripMenuItem = (gcnew System::Windows::Forms::ToolStripMenuItem());
+		this->SaveTimingStripMenuItem = (gcnew System::Windows::Forms::ToolStripMenuItem());
+		this->TimelineStripMenuItem = (gcnew System::Windows::Forms::ToolStripMenuItem());
+		this->SaveTimelineStripMenuItem = (gcnew System::Windows::Forms::ToolStripMenuItem());
 		this->exitToolStripMenuItem = (gcnew System::Windows::Forms::ToolStripMenuItem());
 		this->aboutToolStripMenuItem = (gcnew System::Windows::Forms::ToolStripMenuItem());
 		this->aboutToolStripMenuItem1 = (gcnew System::Windows::Forms::ToolStripMenuItem());
@@ -1130,8 +1146,9 @@ private:
 		// 
 		// menu1ToolStripMenuItem
 		// 
-		this->menu1ToolStripMenuItem->DropDownItems->AddRange(gcnew cli::array< System::Windows::Forms::ToolStripItem^  >(2) {
+		this->menu1ToolStripMenuItem->DropDownItems->AddRange(gcnew cli::array< System::Windows::Forms::ToolStripItem^  >(6) {
 			this->RefreshStripMenuItem,
+				this->TimingStripMenuItem, this->SaveTimingStripMenuItem, this->TimelineStripMenuItem, this->SaveTimelineStripMenuItem,
 				this->exitToolStripMenuItem
 		});
 		this->menu1ToolStripMenuItem->Name = L"menu1ToolStripMenuItem";
@@ -1145,6 +1162,36 @@ private:
 		this->RefreshStripMenuItem->Text = L"Refresh";
 		this->RefreshStripMenuItem->Click += gcnew System::EventHandler(this, &MainForm::RefreshToolStripMenuItem_Click);
 		// 
+		// TimingStripMenuItem
+		// 
+		this->TimingStripMenuItem->CheckOnClick = true;
+		this->TimingStripMenuItem->Name = L"TimingStripMenuItem";
+		this->TimingStripMenuItem->Size = System::Drawing::Size(180, 22);
+		this->TimingStripMenuItem->Text = L"Stage timing";
+		this->TimingStripMenuItem->Click += gcnew System::EventHandler(this, &MainForm::TimingToolStripMenuItem_Click);
+		// 
+		// SaveTimingStripMenuItem
+		// 
+		this->SaveTimingStripMenuItem->Name = L"SaveTimingStripMenuItem";
+		this->SaveTimingStripMenuItem->Size = System::Drawing::Size(180, 22);
+		this->SaveTimingStripMenuItem->Text = L"Save timing...";
+		this->SaveTimingStripMenuItem->Click += gcnew System::EventHandler(this, &MainForm::SaveTimingToolStripMenuItem_Click);
+		// 
+		// TimelineStripMenuItem
+		// 
+		this->TimelineStripMenuItem->CheckOnClick = true;
+		this->TimelineStripMenuItem->Name = L"TimelineStripMenuItem";
+		this->TimelineStripMenuItem->Size = System::Drawing::Size(180, 22);
+		this->TimelineStripMenuItem->Text = L"Record timeline";
+		this->TimelineStripMenuItem->Click += gcnew System::EventHandler(this, &MainForm::TimelineToolStripMenuItem_Click);
+		// 
+		// SaveTimelineStripMenuItem
+		// 
+		this->SaveTimelineStripMenuItem->Name = L"SaveTimelineStripMenuItem";
+		this->SaveTimelineStripMenuItem->Size = System::Drawing::Size(180, 22);
+		this->SaveTimelineStripMenuItem->Text = L"Save timeline...";
+		this->SaveTimelineStripMenuItem->Click += gcnew System::EventHandler(this, &MainForm::SaveTimelineToolStripMenuItem_Click);
+		// 
 		// exitToolStripMenuItem
 		// 
 		this->exitToolStripMenuItem->Name = L"exitToolStripMenuItem";
@@ -2133,6 +2180,10 @@ private: System::Void RefreshToolStripMenuItem_Click(System::Object^ sender, Sys
 {
 	EnumProcesses();
 }
+private: System::Void TimingToolStripMenuItem_Click(System::Object^ sender, System::EventArgs^ e);
+private: System::Void SaveTimingToolStripMenuItem_Click(System::Object^ sender, System::EventArgs^ e);
+private: System::Void TimelineToolStripMenuItem_Click(System::Object^ sender, System::EventArgs^ e);
+private: System::Void SaveTimelineToolStripMenuItem_Click(System::Object^ sender, System::EventArgs^ e);
 private: System::Void exitToolStripMenuItem_Click(System::Object^ sender, System::EventArgs^ e)
 {
 	this->Close();
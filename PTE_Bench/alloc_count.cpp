@@ -0,0 +1,110 @@
+/*
+    alloc_count.cpp
+
+    Replacement of the global operator new counting the heap allocations.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "bench.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+namespace
+{
+
+std::atomic<uint64_t> s_count{ 0 };
+std::atomic<uint64_t> s_bytes{ 0 };
+
+} //namespace
+
+/// <summary>
+/// Allocations made since the start of the process.
+/// </summary>
+PTE::Bench::Allocations PTE::Bench::CountAllocations()
+{
+    Allocations result;
+    result.Count = s_count.load(std::memory_order_relaxed);
+    result.Bytes = s_bytes.load(std::memory_order_relaxed);
+
+    return result;
+}
+
+//
+// The array and the nothrow forms end up here as well.
+void* operator new(size_t size)
+{
+    s_count.fetch_add(1, std::memory_order_relaxed);
+    s_bytes.fetch_add(size, std::memory_order_relaxed);
+
+    void* p = malloc(size != 0 ? size : 1);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+//
+// The page aligned buffers of the pools.
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    s_count.fetch_add(1, std::memory_order_relaxed);
+    s_bytes.fetch_add(size, std::memory_order_relaxed);
+
+    const size_t align = static_cast<size_t>(alignment);
+    const size_t rounded = (size + align - 1) & ~(align - 1);
+#if defined(_MSC_VER)
+    void* p = _aligned_malloc(rounded != 0 ? rounded : align, align);
+#else
+    void* p = aligned_alloc(align, rounded != 0 ? rounded : align);
+#endif
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+
+    return p;
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    try
+    {
+        return operator new(size, alignment);
+    }
+    catch (const std::bad_alloc&)
+    {
+        return nullptr;
+    }
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+#if defined(_MSC_VER)
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+void operator delete(void* p, size_t, std::align_val_t alignment) noexcept
+{
+    operator delete(p, alignment);
+}
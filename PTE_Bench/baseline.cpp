@@ -0,0 +1,152 @@
+/*
+    baseline.cpp
+
+    Results of the run, saved as a baseline and compared against one.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "bench.h"
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+struct Result
+{
+    std::string Key;
+    PTE::Bench::OpCost Cost;
+};
+
+/// <summary>
+/// The results in the order they were reported.
+/// </summary>
+std::vector<Result>& Results()
+{
+    static std::vector<Result> s_results;
+    return s_results;
+}
+
+/// <summary>
+/// Print a heap column pair, "-" for the values not measured.
+/// </summary>
+void PrintHeap(double value, bool measured, double base, bool baseMeasured, const char* format)
+{
+    char text[32] = "-";
+    char baseText[32] = "-";
+    if (measured)
+    {
+        snprintf(text, sizeof(text), format, value);
+    }
+    if (baseMeasured)
+    {
+        snprintf(baseText, sizeof(baseText), format, base);
+    }
+
+    printf(" %10s %10s", text, baseText);
+}
+
+} //namespace
+
+/// <summary>
+/// Keep a result of the run.
+/// </summary>
+/// <param name="name">Benchmark name</param>
+/// <param name="impl">Implementation or variant</param>
+/// <param name="cost">Nanoseconds per iteration or per operation, the heap use per operation if measured</param>
+void PTE::Bench::Record(const char* name, const char* impl, const OpCost& cost)
+{
+    Results().push_back({ std::string(name) + ' ' + impl, cost });
+}
+
+/// <summary>
+/// Write the results as "name impl ns bytes allocs" lines, "-" for the heap use not measured.
+/// </summary>
+/// <param name="path">Output file</param>
+/// <returns>False if the file could not be written</returns>
+bool PTE::Bench::SaveBaseline(const char* path)
+{
+    std::ofstream file(path);
+    for (const auto& result : Results())
+    {
+        file << result.Key << ' ' << result.Cost.Ns;
+        if (result.Cost.HeapMeasured)
+        {
+            file << ' ' << result.Cost.Bytes << ' ' << result.Cost.Allocs << '\n';
+        }
+        else
+        {
+            file << " - -\n";
+        }
+    }
+
+    return static_cast<bool>(file);
+}
+
+/// <summary>
+/// Print the change of every result against the baseline.
+/// The baselines saved with the time only are read too.
+/// </summary>
+/// <param name="path">Baseline written by SaveBaseline</param>
+/// <returns>False if the baseline could not be read</returns>
+bool PTE::Bench::CompareBaseline(const char* path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        return false;
+    }
+
+    std::map<std::string, OpCost> baseline;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream fields(line);
+        std::string name;
+        std::string impl;
+        OpCost cost;
+        if (!(fields >> name >> impl >> cost.Ns))
+        {
+            continue;
+        }
+
+        std::string bytes;
+        std::string allocs;
+        if (fields >> bytes >> allocs && bytes != "-" && allocs != "-")
+        {
+            cost.Bytes = std::stod(bytes);
+            cost.Allocs = std::stod(allocs);
+            cost.HeapMeasured = true;
+        }
+        baseline[name + ' ' + impl] = cost;
+    }
+
+    printf("\n%-33s %12s %12s %8s %10s %10s %10s %10s\n", "vs baseline", "ns", "base ns", "change",
+        "B/op", "base B/op", "allocs/op", "base");
+    for (const auto& result : Results())
+    {
+        const OpCost& cost = result.Cost;
+        auto it = baseline.find(result.Key);
+        if (it == baseline.end() || it->second.Ns <= 0)
+        {
+            printf("%-33s %12.1f %12s %8s", result.Key.c_str(), cost.Ns, "-", "new");
+            PrintHeap(cost.Bytes, cost.HeapMeasured, 0, false, "%.0f");
+            PrintHeap(cost.Allocs, cost.HeapMeasured, 0, false, "%.2f");
+            printf("\n");
+            continue;
+        }
+
+        const OpCost& base = it->second;
+        printf("%-33s %12.1f %12.1f %+7.1f%%", result.Key.c_str(), cost.Ns, base.Ns, (cost.Ns / base.Ns - 1) * 100);
+        PrintHeap(cost.Bytes, cost.HeapMeasured, base.Bytes, base.HeapMeasured, "%.0f");
+        PrintHeap(cost.Allocs, cost.HeapMeasured, base.Allocs, base.HeapMeasured, "%.2f");
+        printf("\n");
+    }
+
+    return true;
+}
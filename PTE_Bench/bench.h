@@ -0,0 +1,151 @@
+/*
+	bench.h
+
+	Microbenchmarks of the hot paths.
+	Every result is kept by name so the run can be saved as a baseline
+	and compared against one.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include "image_builder.h"
+
+namespace PTE
+{
+namespace Bench
+{
+
+/// <summary>
+/// Run the function until at least the minimal time passes.
+/// </summary>
+/// <param name="func">Function doing a single iteration</param>
+/// <returns>Seconds per iteration</returns>
+template <typename F>
+double Measure(F&& func)
+{
+	using Clock = std::chrono::steady_clock;
+	constexpr double minSeconds = 0.5;
+
+	//
+	// Warm up the caches and the branch predictor.
+	func();
+
+	uint64_t iterations{ 0 };
+	double elapsed{ 0 };
+	const auto start = Clock::now();
+	do
+	{
+		func();
+		++iterations;
+		elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+	} while (elapsed < minSeconds);
+
+	return elapsed / iterations;
+}
+
+/// <summary>
+/// Heap allocations made by the whole process, counted by the replaced operator new.
+/// </summary>
+struct Allocations
+{
+	uint64_t Count{ 0 };
+	uint64_t Bytes{ 0 };
+};
+
+Allocations CountAllocations();
+
+/// <summary>
+/// Cost of a single operation.
+/// </summary>
+struct OpCost
+{
+	double Ns{ 0 };
+
+	//
+	// Heap bytes and allocations, both per operation
+	double Bytes{ 0 };
+	double Allocs{ 0 };
+
+	//
+	// False if only the time was measured
+	bool HeapMeasured{ false };
+};
+
+/// <summary>
+/// Measure the time and the heap use of a function doing a number of operations.
+/// </summary>
+/// <param name="ops">Number of the operations done by a single call</param>
+/// <param name="func">Function doing a single iteration</param>
+template <typename F>
+OpCost MeasureOps(uint64_t ops, F&& func)
+{
+	//
+	// The allocations are counted over a single warm call, the heap use
+	// of these paths does not depend on the iteration.
+	func();
+	const Allocations before = CountAllocations();
+	func();
+	const Allocations after = CountAllocations();
+
+	OpCost cost;
+	cost.Ns = Measure(func) * 1e9 / ops;
+	cost.Bytes = static_cast<double>(after.Bytes - before.Bytes) / ops;
+	cost.Allocs = static_cast<double>(after.Count - before.Count) / ops;
+	cost.HeapMeasured = true;
+
+	return cost;
+}
+
+//
+// The synthetic address space walked by the walk and the transport benchmarks:
+// 32MB of 4KB pages over scattered frames of the image and 1GB of 2MB pages above the image.
+constexpr uint64_t SmallBase = 0x7FF600000000ull;
+constexpr uint64_t SmallPages = 8192;
+constexpr uint64_t LargeBase = 0x7FF700000000ull;
+constexpr uint64_t LargePages = 512;
+constexpr uint64_t LargeFrames = 0x100000000ull;
+constexpr uint64_t SpaceImageSize = 40ull << 20;
+
+uint64_t BuildSpace(ImageBuilder& image);
+uint64_t ExpectedPA(uint64_t va);
+
+void Record(const char* name, const char* impl, const OpCost& cost);
+bool SaveBaseline(const char* path);
+bool CompareBaseline(const char* path);
+
+/// <summary>
+/// Print the throughput line.
+/// </summary>
+inline void Report(const char* name, const char* impl, uint64_t bytes, double seconds)
+{
+	printf("%-24s %-8s %10.3f GB/s %12.1f us\n", name, impl, bytes / seconds / 1e9, seconds * 1e6);
+	Record(name, impl, { .Ns = seconds * 1e9 });
+}
+
+/// <summary>
+/// Print the per-operation line.
+/// </summary>
+inline void Report(const char* name, const char* impl, const OpCost& cost)
+{
+	printf("%-24s %-8s %10.1f ns/op %9.0f B/op %8.2f allocs/op\n", name, impl, cost.Ns, cost.Bytes, cost.Allocs);
+	Record(name, impl, cost);
+}
+
+int RunHexDump();
+int RunLeafIndex();
+int RunPageClassify();
+int RunPageHash();
+int RunRegions();
+int RunTableDecode();
+int RunTimeline();
+int RunTlbSim();
+int RunTransport();
+int RunWalk();
+
+} //namespace Bench
+} //namespace PTE
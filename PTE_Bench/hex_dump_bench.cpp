@@ -0,0 +1,161 @@
+/*
+    hex_dump_bench.cpp
+
+    Hex dump formatter throughput against the per-byte implementation it replaced.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "bench.h"
+#include "cpu_features.h"
+#include "hex_dump.h"
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+/// <summary>
+/// The former GetPageData: the string grows by a few characters per byte.
+/// </summary>
+std::string FormatLegacy(uint64_t virt, uint64_t phys, const uint8_t* data, size_t len)
+{
+    const short sAllignBy = 16;
+    std::string strResult;
+    std::string strAscii;
+    char buf[32];
+
+    for (size_t i = 0; i < len; ++i)
+    {
+        if (i % sAllignBy == 0)
+        {
+            snprintf(buf, sizeof(buf), "0x%012llx", static_cast<unsigned long long>(virt + i));
+            strResult += buf;
+            strResult += " -> ";
+            snprintf(buf, sizeof(buf), "0x%012llx : ", static_cast<unsigned long long>(phys + i));
+            strResult += buf;
+        }
+
+        snprintf(buf, sizeof(buf), "%02X ", data[i]);
+        strResult += buf;
+        if (data[i] < 0x20)
+        {
+            strAscii += '.';
+        }
+        else
+        {
+            strAscii += data[i];
+        }
+
+        if ((i + 1) % sAllignBy == 0)
+        {
+            strResult += " ";
+            strResult += strAscii;
+            strResult += '\n';
+            strAscii.clear();
+        }
+    }
+
+    return strResult;
+}
+
+struct ImplInfo
+{
+    PTE::HexDump::Impl impl;
+    const char* name;
+    bool supported;
+};
+
+} //namespace
+
+/// <summary>
+/// Check every implementation against the legacy output and measure it
+/// on a single page and on a multi-megabyte region.
+/// </summary>
+/// <returns>0 if all the outputs match</returns>
+int PTE::Bench::RunHexDump()
+{
+    const ImplInfo impls[] = {
+        { PTE::HexDump::Impl::Scalar, "scalar", true },
+        { PTE::HexDump::Impl::Ssse3, "ssse3", CpuFeatures::HasSsse3() },
+        { PTE::HexDump::Impl::Avx2, "avx2", CpuFeatures::HasAvx2() },
+    };
+    const size_t sizes[] = { 4096, 8 << 20 };
+
+    //
+    // Every byte value, including the control characters, appears in the data.
+    std::vector<uint8_t> data(sizes[1] + 7);
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+        data[i] = static_cast<uint8_t>(i * 131 + (i >> 8));
+    }
+    std::vector<char> out(PTE::HexDump::MaxFormattedSize(data.size()));
+
+    int result = 0;
+    const uint64_t virt = 0x7FF612340000;
+    const uint64_t phys = 0x1234567000;
+    const uint64_t bases[] = { virt, 0xFFFFF80000000000 };
+
+    //
+    // Correctness, including the partial last line and the addresses over 48 bits.
+    for (size_t len : { size_t{ 0 }, size_t{ 5 }, size_t{ 16 }, size_t{ 47 }, size_t{ 4096 }, size_t{ 4103 } })
+    {
+        for (uint64_t base : bases)
+        {
+            const std::string expected = FormatLegacy(base, phys, data.data(), len);
+            for (const auto& info : impls)
+            {
+                if (!info.supported)
+                {
+                    continue;
+                }
+
+                size_t written = PTE::HexDump::Format(base, phys, data.data(), len, out.data(), info.impl);
+                if (written != expected.size() || memcmp(out.data(), expected.data(), written) != 0)
+                {
+                    printf("hex_dump: %s output differs for %zu bytes at 0x%llx\n", info.name, len, static_cast<unsigned long long>(base));
+                    result = 1;
+                }
+            }
+        }
+    }
+
+    for (size_t len : sizes)
+    {
+        const char* name = len == sizes[0] ? "hex_dump/page" : "hex_dump/region";
+
+        double seconds = Measure([&]()
+            {
+                std::string text = FormatLegacy(virt, phys, data.data(), len);
+                out[0] = text[0];
+            });
+        Report(name, "legacy", len, seconds);
+
+        for (const auto& info : impls)
+        {
+            if (!info.supported)
+            {
+                continue;
+            }
+
+            seconds = Measure([&]()
+                {
+                    PTE::HexDump::Format(virt, phys, data.data(), len, out.data(), info.impl);
+                });
+            Report(name, info.name, len, seconds);
+        }
+    }
+
+    //
+    // A page formatted into a new string, as GetPageData does for every click.
+    const OpCost cost = MeasureOps(1, [&]()
+        {
+            std::string text = PTE::HexDump::Format(virt, phys, data.data(), sizes[0]);
+            out[0] = text[0];
+        });
+    Report("hex_dump/GetPageData", "auto", cost);
+
+    return result;
+}
@@ -0,0 +1,100 @@
+/*
+    leaf_index_bench.cpp
+
+    Bulk translation rate of the leaf index.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "bench.h"
+#include "leaf_index.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+/// <summary>
+/// Translate sorted random addresses over 256MB of 4KB pages and a 1GB of 2MB pages.
+/// </summary>
+/// <returns>0 if the translations are right</returns>
+int PTE::Bench::RunLeafIndex()
+{
+    constexpr uint64_t SmallBase = 0x10000000ull;
+    constexpr uint64_t LargeBase = 0x40000000ull;
+    constexpr uint64_t FrameBase = 0x100000000ull;
+    constexpr size_t SmallTables = 128;
+
+    //
+    // PML4, PDP, a PD with 128 page tables and a PD of 2MB pages.
+    PageTables tables;
+    auto addTable = [&](ULONG level, uint64_t baseVA) -> TABLE_PAGE&
+        {
+            TABLE_PAGE& table = tables.Tables.emplace_back();
+            table = { };
+            table.baseVA = baseVA;
+            table.level = level;
+            return table;
+        };
+
+    addTable(TABLE_LEVEL_PML4, 0).entries[0] = 1;
+    TABLE_PAGE& pdp = addTable(TABLE_LEVEL_PDP, 0);
+    pdp.entries[0] = 1;
+    pdp.entries[1] = 1;
+
+    TABLE_PAGE& pd = addTable(TABLE_LEVEL_PD, 0);
+    for (size_t i = 0; i < SmallTables; ++i)
+    {
+        pd.entries[SmallBase / (1ull << 21) + i] = 1;
+    }
+    for (size_t i = 0; i < SmallTables; ++i)
+    {
+        TABLE_PAGE& pt = addTable(TABLE_LEVEL_PT, SmallBase + (i << 21));
+        for (size_t j = 0; j < TABLE_SIZE; ++j)
+        {
+            pt.entries[j] = 1 | (FrameBase + (i << 21) + (j << 12));
+        }
+    }
+
+    TABLE_PAGE& largePd = addTable(TABLE_LEVEL_PD, LargeBase);
+    for (size_t i = 0; i < TABLE_SIZE; ++i)
+    {
+        largePd.entries[i] = 1 | 0x80 | (FrameBase + (1ull << 30) + (i << 21));
+    }
+
+    LeafIndex index;
+    index.Build(tables);
+
+    const size_t count = 4 << 20;
+    std::vector<uint64_t> addresses(count);
+    std::mt19937_64 random(1);
+    for (auto& address : addresses)
+    {
+        address = random() % 2 ? SmallBase + random() % (SmallTables << 21) : LargeBase + random() % (1ull << 30);
+    }
+    std::sort(addresses.begin(), addresses.end());
+
+    std::vector<uint64_t> pa(count);
+    std::vector<uint32_t> pageSize(count);
+
+    int result = 0;
+    index.Translate(addresses.data(), count, pa.data(), pageSize.data());
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint64_t expected = addresses[i] < LargeBase ? FrameBase + (addresses[i] - SmallBase) : FrameBase + addresses[i];
+        if (pa[i] != expected)
+        {
+            printf("leaf_index: wrong translation of 0x%llx\n", static_cast<unsigned long long>(addresses[i]));
+            result = 1;
+            break;
+        }
+    }
+
+    const double seconds = Measure([&]()
+        {
+            index.Translate(addresses.data(), count, pa.data(), pageSize.data());
+        });
+    printf("%-24s %-8s %10.1f M/s\n", "leaf_index/4M", "sorted", count / seconds / 1e6);
+    Record("leaf_index/4M", "sorted", { .Ns = seconds * 1e9 });
+
+    return result;
+}
@@ -0,0 +1,59 @@
+/*
+    main.cpp
+
+    Microbenchmarks of the hot paths.
+
+    pte_bench [--save <baseline>] [--baseline <baseline>]
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "bench.h"
+#include <cstring>
+
+int main(int argc, char* argv[])
+{
+    const char* savePath = nullptr;
+    const char* baselinePath = nullptr;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--save") == 0)
+        {
+            savePath = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--baseline") == 0)
+        {
+            baselinePath = argv[i + 1];
+        }
+    }
+
+    int result = 0;
+
+    result |= PTE::Bench::RunHexDump();
+    result |= PTE::Bench::RunTableDecode();
+    result |= PTE::Bench::RunPageHash();
+    result |= PTE::Bench::RunPageClassify();
+#ifndef PTE_NO_STD_FORMAT
+    result |= PTE::Bench::RunTlbSim();
+#endif
+    result |= PTE::Bench::RunLeafIndex();
+    result |= PTE::Bench::RunWalk();
+    result |= PTE::Bench::RunRegions();
+    result |= PTE::Bench::RunTransport();
+    result |= PTE::Bench::RunTimeline();
+
+    if (baselinePath != nullptr && !PTE::Bench::CompareBaseline(baselinePath))
+    {
+        printf("Failed to read the baseline %s\n", baselinePath);
+        result = 1;
+    }
+
+    if (savePath != nullptr && !PTE::Bench::SaveBaseline(savePath))
+    {
+        printf("Failed to write the baseline %s\n", savePath);
+        result = 1;
+    }
+
+    return result;
+}
@@ -0,0 +1,109 @@
+/*
+    page_classify_bench.cpp
+
+    Page content classifier throughput.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "bench.h"
+#include "cpu_features.h"
+#include "page_classify.h"
+#include <random>
+#include <vector>
+
+/// <summary>
+/// Check the implementations against the scalar one and measure them on a mix
+/// of zero, pattern, low and high entropy pages bigger than the cache.
+/// </summary>
+/// <returns>0 if all the results match</returns>
+int PTE::Bench::RunPageClassify()
+{
+    struct ImplInfo
+    {
+        PageClassifier::Impl impl;
+        const char* name;
+        bool supported;
+    };
+
+    const ImplInfo impls[] = {
+        { PageClassifier::Impl::Scalar, "scalar", true },
+        { PageClassifier::Impl::Avx2, "avx2", CpuFeatures::HasAvx2() },
+    };
+
+    //
+    // 64MB, every fourth page zero, then a pattern, a few values and random bytes.
+    const size_t pageCount = 16384;
+    std::vector<uint8_t> pages(pageCount * PAGE_SIZE);
+    std::mt19937_64 random(1);
+    for (size_t page = 0; page < pageCount; ++page)
+    {
+        uint8_t* data = pages.data() + page * PAGE_SIZE;
+        for (size_t i = 0; i < PAGE_SIZE; ++i)
+        {
+            switch (page % 4)
+            {
+            case 0:
+                data[i] = 0;
+                break;
+            case 1:
+                data[i] = static_cast<uint8_t>(i % 8 == 0 ? page : 0);
+                break;
+            case 2:
+                data[i] = static_cast<uint8_t>(random() % 16);
+                break;
+            default:
+                data[i] = static_cast<uint8_t>(random());
+                break;
+            }
+        }
+    }
+
+    int result = 0;
+
+    for (size_t page = 0; page < 64; ++page)
+    {
+        const uint8_t* data = pages.data() + page * PAGE_SIZE;
+        const PageClass expected = PageClassifier::Classify(data, PageClassifier::Impl::Scalar);
+
+        for (const auto& info : impls)
+        {
+            if (!info.supported)
+            {
+                continue;
+            }
+
+            const PageClass actual = PageClassifier::Classify(data, info.impl);
+            if (actual.Zero != expected.Zero ||
+                actual.Pattern != expected.Pattern ||
+                actual.RepeatWords != expected.RepeatWords ||
+                actual.Entropy != expected.Entropy ||
+                actual.CompressedBytes != expected.CompressedBytes)
+            {
+                printf("page_classify: %s result differs for page %zu\n", info.name, page);
+                result = 1;
+            }
+        }
+    }
+
+    for (const auto& info : impls)
+    {
+        if (!info.supported)
+        {
+            continue;
+        }
+
+        uint64_t compressed = 0;
+        const double seconds = Measure([&]()
+            {
+                for (size_t page = 0; page < pageCount; ++page)
+                {
+                    compressed += PageClassifier::Classify(pages.data() + page * PAGE_SIZE, info.impl).CompressedBytes;
+                }
+            });
+        Report("page_classify/64MB", info.name, pageCount * PAGE_SIZE, seconds);
+    }
+
+    return result;
+}
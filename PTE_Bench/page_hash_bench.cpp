@@ -0,0 +1,73 @@
+/*
+    page_hash_bench.cpp
+
+    Page content hash throughput.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "bench.h"
+#include "cpu_features.h"
+#include "page_hash.h"
+#include <cstring>
+#include <random>
+#include <vector>
+
+/// <summary>
+/// Check the implementations against the scalar one and measure them on
+/// a set of pages bigger than the cache, as the dedupe scan hashes them.
+/// </summary>
+/// <returns>0 if all the hashes match</returns>
+int PTE::Bench::RunPageHash()
+{
+    struct ImplInfo
+    {
+        PageHash::Impl impl;
+        const char* name;
+        bool supported;
+    };
+
+    const ImplInfo impls[] = {
+        { PageHash::Impl::Scalar, "scalar", true },
+        { PageHash::Impl::Avx2, "avx2", CpuFeatures::HasAvx2() },
+    };
+
+    //
+    // 64MB of random pages
+    const size_t pageCount = 16384;
+    std::vector<uint8_t> pages(pageCount * PAGE_SIZE);
+    std::mt19937_64 random(1);
+    for (size_t i = 0; i < pages.size(); i += sizeof(uint64_t))
+    {
+        const uint64_t value = random();
+        memcpy(pages.data() + i, &value, sizeof(value));
+    }
+
+    int result = 0;
+    std::vector<uint64_t> expected(pageCount), hashes(pageCount);
+    PageHash::HashPages(pages.data(), pageCount, expected.data(), PageHash::Impl::Scalar);
+
+    for (const auto& info : impls)
+    {
+        if (!info.supported)
+        {
+            continue;
+        }
+
+        PageHash::HashPages(pages.data(), pageCount, hashes.data(), info.impl);
+        if (hashes != expected)
+        {
+            printf("page_hash: %s hashes differ\n", info.name);
+            result = 1;
+        }
+
+        const double seconds = Measure([&]()
+            {
+                PageHash::HashPages(pages.data(), pageCount, hashes.data(), info.impl);
+            });
+        Report("page_hash/64MB", info.name, pageCount * PAGE_SIZE, seconds);
+    }
+
+    return result;
+}
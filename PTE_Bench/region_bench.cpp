@@ -0,0 +1,70 @@
+/*
+    region_bench.cpp
+
+    Region lookup by address, as done for every leaf by the census and the memory type views.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "bench.h"
+#include "regions.h"
+#include <random>
+#include <vector>
+
+/// <summary>
+/// Look up random addresses in a region list of a large process.
+/// </summary>
+/// <returns>0 if the lookups are right</returns>
+int PTE::Bench::RunRegions()
+{
+    //
+    // Regions of 1 to 64 pages with a free gap after every fourth.
+    const size_t count = 64 << 10;
+    std::vector<Region> regions;
+    regions.reserve(count);
+
+    std::mt19937_64 random(1);
+    uint64_t base = 0x10000;
+    for (size_t i = 0; i < count; ++i)
+    {
+        Region region{ };
+        region.BaseAddress = base;
+        region.RegionSize = (1 + random() % 64) * PAGE_SIZE;
+        region.Type = MEM_PRIVATE;
+        regions.push_back(region);
+
+        base += region.RegionSize + (i % 4 == 3 ? 16 * PAGE_SIZE : 0);
+    }
+
+    const size_t lookups = 1 << 20;
+    std::vector<uint64_t> addresses(lookups);
+    for (auto& address : addresses)
+    {
+        address = 0x10000 + random() % (base - 0x10000);
+    }
+
+    int result = 0;
+    for (uint64_t address : addresses)
+    {
+        const Region* region = Regions::Find(regions, address);
+        if (region != nullptr && (address < region->BaseAddress || address >= region->BaseAddress + region->RegionSize))
+        {
+            printf("regions: wrong region for 0x%llx\n", static_cast<unsigned long long>(address));
+            result = 1;
+            break;
+        }
+    }
+
+    size_t found{ 0 };
+    const OpCost cost = MeasureOps(lookups, [&]()
+        {
+            for (uint64_t address : addresses)
+            {
+                found += Regions::Find(regions, address) != nullptr;
+            }
+        });
+    Report("regions/find", "64K", cost);
+
+    return result | (found == 0);
+}
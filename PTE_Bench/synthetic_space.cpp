@@ -0,0 +1,81 @@
+/*
+    synthetic_space.cpp
+
+    The deterministic address space shared by the walk and the transport benchmarks.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "bench.h"
+
+namespace
+{
+
+//
+// Odd, so the small pages are a permutation of the data frames.
+constexpr uint64_t s_scatter = 4099;
+
+//
+// The data frames follow the root and the tables allocated before them.
+uint64_t s_dataBase{ 0 };
+
+} //namespace
+
+/// <summary>
+/// Build the address space in the image.
+/// </summary>
+/// <param name="image">Empty image of at least SpaceImageSize</param>
+/// <returns>CR3 of the space or 0 if the image is too small</returns>
+uint64_t PTE::Bench::BuildSpace(ImageBuilder& image)
+{
+    const uint64_t cr3 = image.CreateRoot();
+    s_dataBase = image.AllocateFrames(SmallPages * PAGE_SIZE);
+    if (cr3 == 0 || s_dataBase == 0)
+    {
+        return 0;
+    }
+
+    for (uint64_t i = 0; i < SmallPages; ++i)
+    {
+        const uint64_t pa = s_dataBase + (i * s_scatter % SmallPages) * PAGE_SIZE;
+        if (!image.Map(cr3, SmallBase + i * PAGE_SIZE, pa, PAGE_SIZE))
+        {
+            return 0;
+        }
+
+        //
+        // Tag every page with its virtual address.
+        *reinterpret_cast<uint64_t*>(image.Data() + pa) = SmallBase + i * PAGE_SIZE;
+    }
+
+    for (uint64_t i = 0; i < LargePages; ++i)
+    {
+        if (!image.Map(cr3, LargeBase + (i << 21), LargeFrames + (i << 21), 1ull << 21))
+        {
+            return 0;
+        }
+    }
+
+    return cr3;
+}
+
+/// <summary>
+/// The physical address the space maps the virtual address to.
+/// </summary>
+/// <returns>The physical address or 0 if the address is not mapped</returns>
+uint64_t PTE::Bench::ExpectedPA(uint64_t va)
+{
+    if (va - SmallBase < SmallPages * PAGE_SIZE)
+    {
+        const uint64_t page = (va - SmallBase) / PAGE_SIZE;
+        return s_dataBase + (page * s_scatter % SmallPages) * PAGE_SIZE + va % PAGE_SIZE;
+    }
+
+    if (va - LargeBase < (LargePages << 21))
+    {
+        return LargeFrames + (va - LargeBase);
+    }
+
+    return 0;
+}
@@ -0,0 +1,93 @@
+/*
+    table_decode_bench.cpp
+
+    Bulk table decoding throughput.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "bench.h"
+#include "cpu_features.h"
+#include "table_decode.h"
+#include <cstring>
+#include <random>
+#include <vector>
+
+/// <summary>
+/// Check every implementation against the scalar one and measure them on a set of tables
+/// bigger than the cache, so the result shows how close the decoding is to the memory bandwidth.
+/// </summary>
+/// <returns>0 if all the outputs match</returns>
+int PTE::Bench::RunTableDecode()
+{
+    struct ImplInfo
+    {
+        TableDecoder::Impl impl;
+        const char* name;
+        bool supported;
+    };
+
+    const ImplInfo impls[] = {
+        { TableDecoder::Impl::Scalar, "scalar", true },
+        { TableDecoder::Impl::Avx2, "avx2", CpuFeatures::HasAvx2() },
+        { TableDecoder::Impl::Avx512, "avx512", CpuFeatures::HasAvx512() },
+    };
+
+    //
+    // 64MB of tables, half of the entries present, the rest random.
+    const size_t tableCount = 16384;
+    std::vector<TABLE_PAGE> tables(tableCount);
+    std::mt19937_64 random(1);
+    for (auto& table : tables)
+    {
+        for (auto& entry : table.entries)
+        {
+            entry = random();
+            entry = (entry & 1) ? entry : 0;
+        }
+    }
+
+    int result = 0;
+    TableBits expected, bits;
+
+    for (size_t t = 0; t < 64; ++t)
+    {
+        TableDecoder::Decode(tables[t].entries, expected, TableDecoder::Impl::Scalar);
+        for (const auto& info : impls)
+        {
+            if (!info.supported)
+            {
+                continue;
+            }
+
+            TableDecoder::Decode(tables[t].entries, bits, info.impl);
+            if (memcmp(&bits, &expected, sizeof(bits)) != 0)
+            {
+                printf("table_decode: %s output differs for table %zu\n", info.name, t);
+                result = 1;
+            }
+        }
+    }
+
+    for (const auto& info : impls)
+    {
+        if (!info.supported)
+        {
+            continue;
+        }
+
+        size_t present = 0;
+        const double seconds = Measure([&]()
+            {
+                for (const auto& table : tables)
+                {
+                    TableDecoder::Decode(table.entries, bits, info.impl);
+                    present += TableDecoder::Count(bits.present);
+                }
+            });
+        Report("table_decode/64MB", info.name, tableCount * PAGE_SIZE, seconds);
+    }
+
+    return result;
+}
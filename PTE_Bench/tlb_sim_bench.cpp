@@ -0,0 +1,93 @@
+/*
+    tlb_sim_bench.cpp
+
+    TLB simulator replay rate.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "bench.h"
+#include "tlb_sim.h"
+#include <random>
+#include <vector>
+
+namespace
+{
+
+/// <summary>
+/// Replay the trace with the default TLB configuration and print the rate.
+/// </summary>
+void ReplayTrace(const char* impl, const std::vector<uint64_t>& trace, const PTE::PageSizeMap& map)
+{
+    PTE::TlbSimulator simulator(PTE::TlbConfig::Default());
+    const double seconds = PTE::Bench::Measure([&]()
+        {
+            simulator.Reset();
+            simulator.Replay(trace.data(), trace.size(), map);
+        });
+
+    const PTE::TlbStats stats = simulator.Stats();
+    printf("%-24s %-8s %10.1f M/s   %8.4f walks/access\n",
+        "tlb_sim/8M",
+        impl,
+        trace.size() / seconds / 1e6,
+        stats.Accesses != 0 ? static_cast<double>(stats.Walks) / stats.Accesses : 0.0);
+    PTE::Bench::Record("tlb_sim/8M", impl, { .Ns = seconds * 1e9 });
+}
+
+} //namespace
+
+/// <summary>
+/// Replay a trace of short sequential bursts over 4KB, 2MB and 1GB pages
+/// with the default TLB configuration, then the uniform random accesses
+/// over 1GB of 4KB pages and over 4MB, which stays in the second level.
+/// </summary>
+/// <returns>0</returns>
+int PTE::Bench::RunTlbSim()
+{
+    //
+    // 64 2MB pages and a 1GB page, the rest of the trace goes to 4KB pages.
+    PageSizeMap map;
+    for (uint64_t i = 0; i < 64; ++i)
+    {
+        map.Add(0x40000000ull + (i << 21), 1ull << 21);
+    }
+    map.Add(0x100000000ull, 1ull << 30);
+    map.Finish();
+
+    std::vector<uint64_t> trace;
+    std::mt19937_64 random(1);
+    while (trace.size() < (8u << 20))
+    {
+        const uint64_t kind = random() % 10;
+        const uint64_t base = kind < 6 ? 0x7FF000000000ull + random() % (256ull << 20) :
+            kind < 8 ? 0x40000000ull + random() % (128ull << 20) :
+            kind < 9 ? 0x100000000ull + random() % (1ull << 30) :
+            0x10000ull + random() % (64ull << 20);
+
+        const uint64_t burst = random() % 64 + 1;
+        for (uint64_t i = 0; i < burst; ++i)
+        {
+            trace.push_back(base + i * 64);
+        }
+    }
+
+    ReplayTrace("default", trace, map);
+
+    //
+    // Every access to another page, the probes and the fills are all that is measured.
+    for (auto& address : trace)
+    {
+        address = 0x7FF000000000ull + random() % (1ull << 30);
+    }
+    ReplayTrace("rand1g", trace, map);
+
+    for (auto& address : trace)
+    {
+        address = 0x7FF000000000ull + random() % (4ull << 20);
+    }
+    ReplayTrace("rand4m", trace, map);
+
+    return 0;
+}
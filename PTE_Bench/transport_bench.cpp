@@ -0,0 +1,150 @@
+/*
+    transport_bench.cpp
+
+    Encoding of the driver responses by the walker and their decoding by the application.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "bench.h"
+#include "buffer_pool.h"
+#include "latency.h"
+#include "page_tables.h"
+#include "phys_walk.h"
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+/// <summary>
+/// Fill the IOCTL_CODE response for random addresses, into a reused buffer, into
+/// a buffer allocated per request, into a pooled one as the memory view does and with the stage timing on,
+/// then enumerate the tables
+/// and decode the leaves the way the hierarchy views do.
+/// </summary>
+/// <returns>0 if the decoded leaves are right</returns>
+int PTE::Bench::RunTransport()
+{
+    ImageBuilder image(SpaceImageSize);
+    const uint64_t cr3 = BuildSpace(image);
+    if (cr3 == 0)
+    {
+        printf("transport: failed to build the image\n");
+        return 1;
+    }
+
+    const PhysicalWalker walker(image.View(), cr3);
+
+    const size_t count = 4096;
+    std::vector<uint64_t> addresses(count);
+    std::mt19937_64 random(1);
+    for (auto& address : addresses)
+    {
+        address = SmallBase + random() % (SmallPages * PAGE_SIZE);
+    }
+
+    int result = 0;
+    auto data = std::make_unique<IOCTL_DATA>();
+    walker.Analyze(addresses[0], data->response);
+    if (static_cast<uint64_t>(data->response.physAddress.QuadPart) != ExpectedPA(addresses[0]) ||
+        *reinterpret_cast<const uint64_t*>(data->response.Buffer.data()) != (addresses[0] & ~static_cast<uint64_t>(PAGE_SIZE - 1)))
+    {
+        printf("transport: wrong response for 0x%llx\n", static_cast<unsigned long long>(addresses[0]));
+        result = 1;
+    }
+
+    OpCost cost = MeasureOps(count, [&]()
+        {
+            for (uint64_t address : addresses)
+            {
+                memset(data.get(), 0, sizeof(IOCTL_DATA));
+                walker.Analyze(address, data->response);
+            }
+        });
+    Report("transport/analyze", "reused", cost);
+
+    cost = MeasureOps(count, [&]()
+        {
+            for (uint64_t address : addresses)
+            {
+                auto perRequest = std::make_unique<IOCTL_DATA>();
+                walker.Analyze(address, perRequest->response);
+            }
+        });
+    Report("transport/analyze", "alloc", cost);
+
+    cost = MeasureOps(count, [&]()
+        {
+            for (uint64_t address : addresses)
+            {
+                BufferPool<IOCTL_DATA>::Lease pooled = BufferPool<IOCTL_DATA>::Acquire();
+                memset(pooled.Get(), 0, sizeof(IOCTL_DATA));
+                walker.Analyze(address, pooled->response);
+            }
+        });
+    Report("transport/analyze", "pooled", cost);
+
+    //
+    // Once the pool is warm a request must not touch the heap.
+    if (cost.Allocs != 0)
+    {
+        printf("transport: %.4f allocations per pooled request\n", cost.Allocs);
+        result = 1;
+    }
+
+    //
+    // With the stage timers on and the times recorded, as with the timing turned on in the UI.
+    Latency::Enable(true);
+    cost = MeasureOps(count, [&]()
+        {
+            for (uint64_t address : addresses)
+            {
+                memset(data.get(), 0, sizeof(IOCTL_DATA));
+                data->response.times.enabled = true;
+                walker.Analyze(address, data->response);
+                Latency::Record(data->response.times);
+            }
+        });
+    Report("transport/analyze", "timed", cost);
+    Latency::Enable(false);
+    Latency::Reset();
+
+    auto enumData = std::make_unique<IOCTL_ENUM_DATA>();
+    PageTables tables;
+    walker.ReadPageTables(enumData.get(), tables);
+
+    size_t leaves{ 0 };
+    tables.ForEachLeaf([&](const LeafMapping& leaf)
+        {
+            if (leaf.pa != ExpectedPA(leaf.va))
+            {
+                result = 1;
+            }
+            ++leaves;
+        });
+    if (leaves != SmallPages + LargePages)
+    {
+        printf("transport: %zu leaves decoded, %llu expected\n", leaves, static_cast<unsigned long long>(SmallPages + LargePages));
+        result = 1;
+    }
+
+    cost = MeasureOps(tables.Tables.size(), [&]()
+        {
+            walker.ReadPageTables(enumData.get(), tables);
+        });
+    Report("transport/enum", "table", cost);
+
+    cost = MeasureOps(leaves, [&]()
+        {
+            tables.Clear();
+            tables.Append(enumData->response);
+            tables.ForEachLeaf([&](const LeafMapping& leaf)
+                {
+                    leaves += leaf.size != 0;
+                });
+        });
+    Report("transport/decode", "leaf", cost);
+
+    return result;
+}
@@ -0,0 +1,259 @@
+/*
+    walk_bench.cpp
+
+    Single and batched page walks over the synthetic image.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "bench.h"
+#include "buffer_pool.h"
+#include "image_generator.h"
+#include "memory_type.h"
+#include "phys_walk.h"
+#include "ia32.hpp"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+/// <summary>
+/// Generate a multi-process image, check every recorded translation against
+/// the walker and measure the batched walks over all the leaves.
+/// </summary>
+/// <returns>0 if the translations are right</returns>
+int WalkGenerated()
+{
+    PTE::ImageSpec spec;
+    spec.ImageSize = 2ull << 30;
+    spec.Processes = 4;
+    spec.MappedPerProcess = 128ull << 20;
+    spec.Density = 0.6;
+    spec.Large2MB = 0.25;
+    spec.Shared = 0.2;
+    spec.KernelMapped = 32ull << 20;
+    spec.Fragmentation = 0.5;
+    spec.SelfMapIndex = 0x1ED;
+
+    const auto start = std::chrono::steady_clock::now();
+    PTE::ImageBuilder builder(spec.ImageSize);
+    PTE::GeneratedImage image;
+    if (PTE::ImageGenerator::Generate(spec, builder, image) != ERROR_SUCCESS)
+    {
+        printf("walk: failed to generate the image\n");
+        return 1;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%-24s %-8s %10.1f ms %10zu leaves %8llu frames\n", "walk/generate", "2GB", seconds * 1e3,
+        image.Translations.size(), static_cast<unsigned long long>(builder.UsedFrames()));
+
+    //
+    // A random offset into every leaf, the leaves are sorted by the process and the address.
+    std::vector<std::vector<uint64_t>> addresses(spec.Processes);
+    std::vector<std::vector<uint64_t>> expected(spec.Processes);
+    std::mt19937_64 random(1);
+    for (const auto& truth : image.Translations)
+    {
+        const uint64_t offset = random() % truth.PageSize;
+        addresses[truth.Process].push_back(truth.VA + offset);
+        expected[truth.Process].push_back(truth.PA + offset);
+    }
+
+    int result = 0;
+    std::vector<uint64_t> pa;
+    std::vector<uint64_t> pageSize;
+    for (ULONG process = 0; process < spec.Processes && result == 0; ++process)
+    {
+        const PTE::PhysicalWalker walker(builder.View(), image.CR3[process]);
+        pa.resize(addresses[process].size());
+        pageSize.resize(addresses[process].size());
+        walker.TranslateBatch(addresses[process].data(), addresses[process].size(), pa.data(), pageSize.data());
+        if (pa != expected[process])
+        {
+            printf("walk: generated translations of process %lu differ\n", static_cast<unsigned long>(process));
+            result = 1;
+        }
+    }
+
+    const PTE::PhysicalWalker walker(builder.View(), image.CR3[0]);
+    const PTE::Bench::OpCost cost = PTE::Bench::MeasureOps(addresses[0].size(), [&]()
+        {
+            walker.TranslateBatch(addresses[0].data(), addresses[0].size(), pa.data(), pageSize.data());
+        });
+    PTE::Bench::Report("walk/generated", "sorted", cost);
+
+    return result;
+}
+
+/// <summary>
+/// Resolve the memory types of the pages from the entries returned by Analyze.
+/// The pages are not at the index 0 of their tables, whose entries are write-back.
+/// </summary>
+/// <returns>0 if the types are right</returns>
+int AnalyzeMemoryTypes()
+{
+    //
+    // A different type for every PAT bit: WB, WT, UC-, UC, then WP, WT, WC, UC.
+    constexpr uint64_t pat = 0x0001040500070406ull;
+    constexpr uint64_t patBit = 0x80;
+    constexpr uint64_t largePatBit = 0x1000;
+    constexpr uint64_t cacheDisable = 0x10;
+    constexpr uint64_t base = 0x7FF600000000ull;
+
+    struct Page
+    {
+        uint64_t VA;
+        uint64_t Size;
+        uint64_t Flags;
+        uint32_t Type;
+    };
+    const Page pages[] =
+    {
+        { base, PAGE_SIZE, 0, MEMORY_TYPE_WRITE_BACK },
+        { base + 5 * PAGE_SIZE, PAGE_SIZE, patBit, MEMORY_TYPE_WRITE_PROTECTED },
+        { base + 6 * PAGE_SIZE, PAGE_SIZE, patBit | cacheDisable, MEMORY_TYPE_WRITE_COMBINING },
+        { base + 7 * PAGE_SIZE, PAGE_SIZE, cacheDisable, MEMORY_TYPE_UNCACHEABLE_MINUS },
+        { base + (3ull << 21), 1ull << 21, largePatBit | cacheDisable, MEMORY_TYPE_WRITE_COMBINING },
+    };
+
+    PTE::ImageBuilder image(16ull << 20);
+    const uint64_t cr3 = image.CreateRoot();
+    for (const auto& page : pages)
+    {
+        const uint64_t pa = image.AllocateFrames(page.Size, page.Size);
+        if (cr3 == 0 || pa == 0 || !image.Map(cr3, page.VA, pa, page.Size, PTE::ImageBuilder::Writable | PTE::ImageBuilder::User | page.Flags))
+        {
+            printf("walk: failed to build the memory type image\n");
+            return 1;
+        }
+    }
+
+    const PTE::PhysicalWalker walker(image.View(), cr3);
+    auto response = std::make_unique<IOCTL_RESPONSE>();
+    for (const auto& page : pages)
+    {
+        *response = { };
+        walker.Analyze(page.VA, *response);
+
+        ULONG level{ 0 };
+        uint64_t entry{ 0 };
+        if (!PTE::MemoryTypes::LeafEntry(*response, level, entry) || PTE::MemoryTypes::Resolve(pat, level, entry) != page.Type)
+        {
+            printf("walk: wrong memory type of 0x%llx\n", static_cast<unsigned long long>(page.VA));
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+} //namespace
+
+/// <summary>
+/// Walk random addresses one by one and sorted in a batch, also into pooled result vectors,
+/// with a tenth of the addresses in the holes.
+/// </summary>
+/// <returns>0 if the translations are right</returns>
+int PTE::Bench::RunWalk()
+{
+    ImageBuilder image(SpaceImageSize);
+    const uint64_t cr3 = BuildSpace(image);
+    if (cr3 == 0)
+    {
+        printf("walk: failed to build the image\n");
+        return 1;
+    }
+
+    const PhysicalWalker walker(image.View(), cr3);
+
+    const size_t count = 1 << 20;
+    std::vector<uint64_t> addresses(count);
+    std::mt19937_64 random(1);
+    for (auto& address : addresses)
+    {
+        switch (random() % 10)
+        {
+        case 0:
+            address = SmallBase - (1ull << 30) + random() % (1ull << 30);
+            break;
+        case 1:
+        case 2:
+        case 3:
+        case 4:
+            address = SmallBase + random() % (SmallPages * PAGE_SIZE);
+            break;
+        default:
+            address = LargeBase + random() % (LargePages << 21);
+            break;
+        }
+    }
+    std::vector<uint64_t> sorted = addresses;
+    std::sort(sorted.begin(), sorted.end());
+
+    std::vector<uint64_t> pa(count);
+    std::vector<uint64_t> pageSize(count);
+
+    int result = 0;
+    walker.TranslateBatch(sorted.data(), count, pa.data(), pageSize.data());
+    for (size_t i = 0; i < count; ++i)
+    {
+        Translation translation;
+        walker.Translate(sorted[i], translation);
+
+        const uint64_t expected = ExpectedPA(sorted[i]);
+        if (pa[i] != expected || translation.PA != expected)
+        {
+            printf("walk: wrong translation of 0x%llx\n", static_cast<unsigned long long>(sorted[i]));
+            result = 1;
+            break;
+        }
+    }
+
+    uint64_t sink{ 0 };
+    OpCost cost = MeasureOps(count, [&]()
+        {
+            Translation translation;
+            for (uint64_t address : addresses)
+            {
+                walker.Translate(address, translation);
+                sink += translation.PA;
+            }
+        });
+    Report("walk/single", "random", cost);
+
+    cost = MeasureOps(count, [&]()
+        {
+            walker.TranslateBatch(addresses.data(), count, pa.data(), pageSize.data());
+        });
+    Report("walk/batch", "random", cost);
+
+    cost = MeasureOps(count, [&]()
+        {
+            walker.TranslateBatch(sorted.data(), count, pa.data(), pageSize.data());
+        });
+    Report("walk/batch", "sorted", cost);
+
+    //
+    // The result vectors taken from the pool per batch, the capacity is kept between the batches.
+    cost = MeasureOps(count, [&]()
+        {
+            VectorPool<uint64_t>::Lease pooledPa = VectorPool<uint64_t>::Acquire(count);
+            VectorPool<uint64_t>::Lease pooledSize = VectorPool<uint64_t>::Acquire(count);
+            walker.TranslateBatch(sorted.data(), count, pooledPa.data(), pooledSize.data());
+            sink += pooledPa[0];
+        });
+    Report("walk/batch", "pooled", cost);
+
+    if (cost.Allocs != 0)
+    {
+        printf("walk: %.4f allocations per pooled batch\n", cost.Allocs);
+        result = 1;
+    }
+
+    return result | (sink == 1) | WalkGenerated() | AnalyzeMemoryTypes();
+}
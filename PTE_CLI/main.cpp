@@ -0,0 +1,898 @@
+/*
+    main.cpp
+
+    Command line front end of the core, runs the analyses without the UI.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "buffer_pool.h"
+#include "census.h"
+#include "content_census.h"
+#include "contiguity.h"
+#include "huge_pages.h"
+#include "image_generator.h"
+#include "latency.h"
+#include "memory_type.h"
+#include "numa.h"
+#include "page_dedupe.h"
+#include "page_tables.h"
+#include "region_dump.h"
+#include "timeline.h"
+#include "tlb_sim.h"
+#include "trace_translate.h"
+#include "utils.h"
+#include "walk_model.h"
+#include <io.h>
+#include <fcntl.h>
+#include <share.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+/// <summary>
+/// Print the usage.
+/// </summary>
+/// <returns>ERROR_INVALID_PARAMETER</returns>
+int Usage()
+{
+    fprintf(stderr,
+        "usage:\n"
+        "  pte-cli [--timeline <timeline.json|timeline.perfetto-trace>] <command> ...\n"
+        "  pte-cli translate <pid> <va> [va ...] [--probe] [--timing]\n"
+        "  pte-cli trace <trace> [translated.csv|translated.bin] [snapshot|live]\n"
+        "  pte-cli enumerate <pid> [leaves.csv]\n"
+        "  pte-cli dump <pid> <start> <end> [hex|raw|annotated] [dump.txt]\n"
+        "  pte-cli census [census.csv]\n"
+        "  pte-cli classify <pid> [classify.csv]\n"
+        "  pte-cli promote <pid> [promote.csv] [min present]\n"
+        "  pte-cli tlb <pid> <trace.bin> [tlb.csv] [L1:4k=64x4,2m=32x4,1g=4x4;L2:4k+2m=1536x12,1g=16x4]\n"
+        "  pte-cli dedupe [dedupe.csv] [pid ...]\n"
+        "  pte-cli contiguity [contiguity.csv] [pid ...]\n"
+        "  pte-cli numa [numa.csv] [pid ...]\n"
+        "  pte-cli memtype [memtype.csv] [pid ...]\n"
+        "  pte-cli generate <image.bin> [truth.csv] [processes] [MB per process] [image MB]\n"
+        "Addresses are hex, process ids and sizes are decimal.\n");
+
+    return ERROR_INVALID_PARAMETER;
+}
+
+/// <summary>
+/// Parse a number of the command line.
+/// </summary>
+/// <param name="text">The argument</param>
+/// <param name="base">10 or 16, a "0x" prefix is accepted with 16</param>
+/// <param name="value">The number</param>
+/// <returns>True if the whole argument is a number</returns>
+bool Parse(const wchar_t* text, int base, uint64_t& value)
+{
+    wchar_t* end = nullptr;
+    errno = 0;
+    value = wcstoull(text, &end, base);
+
+    return *text != L'\0' && *end == L'\0' && errno == 0;
+}
+
+/// <summary>
+/// Parse a process id.
+/// </summary>
+/// <param name="text">The argument</param>
+/// <param name="pid">Process id</param>
+/// <returns>True if the argument is a decimal process id</returns>
+bool ParsePid(const wchar_t* text, ULONG& pid)
+{
+    uint64_t value{ 0 };
+    if (!Parse(text, 10, value) || value > ULONG_MAX)
+    {
+        return false;
+    }
+
+    pid = static_cast<ULONG>(value);
+    return true;
+}
+
+/// <summary>
+/// Parse the process ids at the end of the command line.
+/// </summary>
+/// <param name="argc">Number of the arguments</param>
+/// <param name="argv">The arguments</param>
+/// <param name="first">Index of the first process id</param>
+/// <param name="pids">Process ids, empty for all the processes</param>
+/// <returns>True if all the arguments from the first are process ids</returns>
+bool ParsePids(int argc, wchar_t** argv, int first, std::vector<ULONG>& pids)
+{
+    for (int i = first; i < argc; ++i)
+    {
+        ULONG pid{ 0 };
+        if (!ParsePid(argv[i], pid))
+        {
+            return false;
+        }
+        pids.push_back(pid);
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Print the entries the driver walked through for the address.
+/// </summary>
+/// <param name="address">Virtual address</param>
+/// <param name="response">The driver response</param>
+void PrintTranslation(uint64_t address, const IOCTL_RESPONSE& response)
+{
+    const ULONG index[TABLE_LEVEL_COUNT]{ response.b47_39, response.b38_30, response.b29_21, response.b20_12 };
+    const PHYSICAL_ADDRESS* tables[TABLE_LEVEL_COUNT]{ response.pa47_39, response.pa38_30, response.pa29_21, response.pa20_12 };
+    const char* names[TABLE_LEVEL_COUNT]{ "pml4e", "pdpte", "pde", "pte" };
+
+    if (response.physAddress.QuadPart == 0)
+    {
+        printf("0x%llx -> page fault, cr3 0x%llx\n", address, response.regCR3);
+    }
+    else
+    {
+        printf("0x%llx -> 0x%llx, cr3 0x%llx\n", address, response.physAddress.QuadPart, response.regCR3);
+    }
+
+    for (ULONG level = TABLE_LEVEL_PML4; level < TABLE_LEVEL_COUNT; ++level)
+    {
+        printf("  %-6s [%3lu] 0x%016llx\n", names[level], index[level], tables[level][index[level] % TABLE_SIZE].QuadPart);
+    }
+}
+
+/// <summary>
+/// Translate single addresses through the driver.
+/// </summary>
+/// <param name="pid">Process id</param>
+/// <param name="addresses">Virtual addresses</param>
+/// <param name="probe">Ask the driver to page in the data</param>
+/// <param name="timing">Print the latencies of the stages</param>
+/// <returns>Exit code</returns>
+int RunTranslate(ULONG pid, const std::vector<uint64_t>& addresses, bool probe, bool timing)
+{
+    PTE::BufferPool<IOCTL_DATA>::Lease data = PTE::BufferPool<IOCTL_DATA>::Acquire();
+    if (!data)
+    {
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    PTE::Latency::Enable(timing);
+
+    unsigned long err = PTE::Utils::InitHeadless();
+    for (size_t i = 0; err == ERROR_SUCCESS && i < addresses.size(); ++i)
+    {
+        memset(data.Get(), 0, sizeof(IOCTL_DATA));
+
+        err = PTE::Utils::SendIOCTL(pid, addresses[i], data.Get(), probe);
+        if (err == ERROR_SUCCESS)
+        {
+            PrintTranslation(addresses[i], data->response);
+            PTE::Latency::Record(data->response.times);
+        }
+    }
+
+    PTE::Utils::StopAndDeleteDriver();
+    data.Release();
+
+    if (timing)
+    {
+        printf("%s", PTE::Latency::Report().c_str());
+    }
+
+    return static_cast<int>(err);
+}
+
+/// <summary>
+/// Translate a (pid, va) trace in bulk.
+/// </summary>
+/// <param name="tracePath">Binary or text trace</param>
+/// <param name="outputPath">CSV output path, binary if it ends with ".bin"</param>
+/// <param name="backend">Where the page tables come from</param>
+/// <returns>Exit code</returns>
+int RunTrace(const std::wstring& tracePath, const std::wstring& outputPath, PTE::TraceTranslator::Backend backend)
+{
+    unsigned long err = PTE::Utils::InitHeadless();
+    if (err != ERROR_SUCCESS)
+    {
+        return static_cast<int>(err);
+    }
+
+    PTE::TraceStats stats;
+    {
+        PTE::TraceTranslator translator(backend, PTE::NumaMap::System());
+        err = translator.Run(tracePath, outputPath, stats);
+    }
+
+    PTE::Utils::StopAndDeleteDriver();
+
+    if (err == ERROR_SUCCESS)
+    {
+        printf("%llu records, %llu translated, %llu skipped, %llu processes, %.2f s\n",
+            stats.Records,
+            stats.Translated,
+            stats.Skipped,
+            stats.Processes,
+            stats.Seconds);
+    }
+
+    return static_cast<int>(err);
+}
+
+/// <summary>
+/// Copy the page tables of a process and write its leaf mappings.
+/// </summary>
+/// <param name="pid">Process id</param>
+/// <param name="reportPath">CSV report path</param>
+/// <returns>Exit code</returns>
+int RunEnumerate(ULONG pid, const std::wstring& reportPath)
+{
+    unsigned long err = PTE::Utils::InitHeadless();
+    if (err != ERROR_SUCCESS)
+    {
+        return static_cast<int>(err);
+    }
+
+    PTE::PageTables tables;
+    HANDLE device = PTE::Utils::OpenDevice();
+    PTE::BufferPool<IOCTL_ENUM_DATA>::Lease buffer = PTE::BufferPool<IOCTL_ENUM_DATA>::Acquire();
+
+    if (device == INVALID_HANDLE_VALUE)
+    {
+        err = GetLastError();
+    }
+    else if (!buffer)
+    {
+        err = ERROR_NOT_ENOUGH_MEMORY;
+    }
+    else
+    {
+        err = PTE::Utils::ReadPageTables(device, pid, buffer.Get(), tables);
+    }
+
+    buffer.Release();
+    if (device != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(device);
+    }
+
+    PTE::Utils::StopAndDeleteDriver();
+
+    if (err != ERROR_SUCCESS)
+    {
+        return static_cast<int>(err);
+    }
+
+    std::ofstream file(reportPath);
+    if (!file)
+    {
+        return ERROR_OPEN_FAILED;
+    }
+
+    uint64_t leaves{ 0 };
+    uint64_t bytes{ 0 };
+
+    file << "va,pa,size,level,entry\n";
+    tables.ForEachLeaf([&](const PTE::LeafMapping& leaf)
+        {
+            file << std::format("0x{:x},0x{:x},{},{},0x{:016x}\n", leaf.va, leaf.pa, leaf.size, leaf.level, leaf.entry);
+            ++leaves;
+            bytes += leaf.size;
+        });
+
+    file << std::format("# pid {}, cr3 0x{:x}, tables pml4/pdpt/pd/pt {}/{}/{}/{}, {} leaves, {} KB mapped\n",
+        pid,
+        tables.CR3,
+        tables.TableCount(TABLE_LEVEL_PML4),
+        tables.TableCount(TABLE_LEVEL_PDP),
+        tables.TableCount(TABLE_LEVEL_PD),
+        tables.TableCount(TABLE_LEVEL_PT),
+        leaves,
+        bytes / 1024);
+
+    printf("%llu leaves, %llu KB mapped\n", leaves, bytes / 1024);
+
+    return file ? 0 : ERROR_WRITE_FAULT;
+}
+
+/// <summary>
+/// Dump the address range of a process.
+/// </summary>
+/// <param name="pid">Process id</param>
+/// <param name="start">Start of the range</param>
+/// <param name="end">End of the range</param>
+/// <param name="format">Output format</param>
+/// <param name="path">Output file path</param>
+/// <returns>Exit code</returns>
+int RunDump(ULONG pid, uint64_t start, uint64_t end, PTE::DumpFormat format, const std::wstring& path)
+{
+    int fd = -1;
+    if (_wsopen_s(&fd, path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _SH_DENYWR, _S_IREAD | _S_IWRITE) != 0)
+    {
+        return ERROR_OPEN_FAILED;
+    }
+
+    unsigned long err = PTE::Utils::InitHeadless();
+    if (err == ERROR_SUCCESS)
+    {
+        err = PTE::RegionDump::Write(pid, start, end, format, fd);
+        PTE::Utils::StopAndDeleteDriver();
+    }
+
+    _close(fd);
+
+    return static_cast<int>(err);
+}
+
+/// <summary>
+/// Run the census of all the processes.
+/// </summary>
+/// <param name="reportPath">CSV report path</param>
+/// <returns>Exit code</returns>
+int RunCensus(const std::wstring& reportPath)
+{
+    unsigned long err = PTE::Utils::InitHeadless();
+    if (err != ERROR_SUCCESS)
+    {
+        return static_cast<int>(err);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto entries = PTE::Census::Run(0);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+    bool written = PTE::Census::WriteReport(reportPath, entries, elapsed.count());
+
+    PTE::Utils::StopAndDeleteDriver();
+
+    printf("%zu processes, %lld ms\n", entries.size(), static_cast<long long>(elapsed.count()));
+
+    return written ? 0 : ERROR_WRITE_FAULT;
+}
+
+/// <summary>
+/// Classify the content of the resident pages of a process.
+/// </summary>
+/// <param name="pid">Process id</param>
+/// <param name="reportPath">CSV report path</param>
+/// <returns>Exit code</returns>
+int RunClassify(ULONG pid, const std::wstring& reportPath)
+{
+    unsigned long err = PTE::Utils::InitHeadless();
+    if (err != ERROR_SUCCESS)
+    {
+        return static_cast<int>(err);
+    }
+
+    std::vector<PTE::RegionClass> regions;
+    err = PTE::ContentCensus::Run(pid, regions);
+
+    PTE::Utils::StopAndDeleteDriver();
+
+    if (err != ERROR_SUCCESS)
+    {
+        return static_cast<int>(err);
+    }
+
+    printf("%zu regions\n", regions.size());
+
+    return PTE::ContentCensus::WriteReport(reportPath, pid, regions) ? 0 : ERROR_WRITE_FAULT;
+}
+
+/// <summary>
+/// Find the page tables of a process which could be replaced by 2MB pages.
+/// </summary>
+/// <param name="pid">Process id</param>
+/// <param name="reportPath">CSV report path</param>
+/// <param name="minPresent">Present entries a table needs</param>
+/// <returns>Exit code</returns>
+int RunPromote(ULONG pid, const std::wstring& reportPath, uint32_t minPresent)
+{
+    unsigned long err = PTE::Utils::InitHeadless();
+    if (err != ERROR_SUCCESS)
+    {
+        return static_cast<int>(err);
+    }
+
+    std::vector<PTE::PromotionCandidate> candidates;
+    err = PTE::HugePages::Run(pid, candidates, minPresent);
+
+    PTE::Utils::StopAndDeleteDriver();
+
+    if (err != ERROR_SUCCESS)
+    {
+        return static_cast<int>(err);
+    }
+
+    printf("%zu candidates\n", candidates.size());
+
+    return PTE::HugePages::WriteReport(reportPath, pid, candidates) ? 0 : ERROR_WRITE_FAULT;
+}
+
+/// <summary>
+/// Replay an address trace through the simulated TLB with the page sizes of a process.
+/// </summary>
+/// <param name="pid">Process the page sizes come from</param>
+/// <param name="tracePath">File of 64-bit virtual addresses</param>
+/// <param name="reportPath">CSV report path</param>
+/// <param name="config">TLB levels</param>
+/// <returns>Exit code</returns>
+int RunTlb(ULONG pid, const std::wstring& tracePath, const std::wstring& reportPath, const PTE::TlbConfig& config)
+{
+    unsigned long err = PTE::Utils::InitHeadless();
+    if (err != ERROR_SUCCESS)
+    {
+        return static_cast<int>(err);
+    }
+
+    PTE::PageSizeMap map;
+    PTE::PageTables tables;
+    HANDLE device = PTE::Utils::OpenDevice();
+    PTE::BufferPool<IOCTL_ENUM_DATA>::Lease buffer = PTE::BufferPool<IOCTL_ENUM_DATA>::Acquire();
+
+    if (device == INVALID_HANDLE_VALUE)
+    {
+        err = GetLastError();
+    }
+    else if (!buffer)
+    {
+        err = ERROR_NOT_ENOUGH_MEMORY;
+    }
+    else
+    {
+        err = PTE::Utils::ReadPageTables(device, pid, buffer.Get(), tables);
+        map.Build(tables);
+    }
+
+    buffer.Release();
+    if (device != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(device);
+    }
+
+    PTE::Utils::StopAndDeleteDriver();
+
+    //
+    // The mapping is captured, the replay does not need the driver.
+    PTE::TlbSimulator::Report report;
+    if (err == ERROR_SUCCESS)
+    {
+        PTE::WalkModel walkModel(tables);
+        err = PTE::TlbSimulator::ReplayFile(tracePath, map, config, report, &walkModel);
+    }
+    if (err != ERROR_SUCCESS)
+    {
+        return static_cast<int>(err);
+    }
+
+    return PTE::TlbSimulator::WriteReport(reportPath, pid, config, report) ? 0 : ERROR_WRITE_FAULT;
+}
+
+/// <summary>
+/// Find the pages with the same content.
+/// </summary>
+/// <param name="reportPath">CSV report path</param>
+/// <param name="pids">Processes to scan, all if empty</param>
+/// <returns>Exit code</returns>
+int RunDedupe(const std::wstring& reportPath, const std::vector<ULONG>& pids)
+{
+    unsigned long err = PTE::Utils::InitHeadless();
+    if (err != ERROR_SUCCESS)
+    {
+        return static_cast<int>(err);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto report = PTE::PageDedupe::Run(pids, 0);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+    bool written = PTE::PageDedupe::WriteReport(reportPath, report, elapsed.count());
+
+    PTE::Utils::StopAndDeleteDriver();
+
+    printf("%lld ms\n", static_cast<long long>(elapsed.count()));
+
+    return written ? 0 : ERROR_WRITE_FAULT;
+}
+
+/// <summary>
+/// Build the physical contiguity histograms.
+/// </summary>
+/// <param name="reportPath">CSV report path</param>
+/// <param name="pids">Processes to walk, all if empty</param>
+/// <returns>Exit code</returns>
+int RunContiguity(const std::wstring& reportPath, const std::vector<ULONG>& pids)
+{
+    unsigned long err = PTE::Utils::InitHeadless();
+    if (err != ERROR_SUCCESS)
+    {
+        return static_cast<int>(err);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto report = PTE::Contiguity::Run(pids, 0);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+    bool written = PTE::Contiguity::WriteReport(reportPath, report, elapsed.count());
+
+    PTE::Utils::StopAndDeleteDriver();
+
+    printf("%lld ms\n", static_cast<long long>(elapsed.count()));
+
+    return written ? 0 : ERROR_WRITE_FAULT;
+}
+
+/// <summary>
+/// Attribute the resident memory to the NUMA nodes.
+/// </summary>
+/// <param name="reportPath">CSV report path</param>
+/// <param name="pids">Processes to walk, all if empty</param>
+/// <returns>Exit code</returns>
+int RunNuma(const std::wstring& reportPath, const std::vector<ULONG>& pids)
+{
+    unsigned long err = PTE::Utils::InitHeadless();
+    if (err != ERROR_SUCCESS)
+    {
+        return static_cast<int>(err);
+    }
+
+    const PTE::NumaMap& map = PTE::NumaMap::System();
+
+    auto start = std::chrono::steady_clock::now();
+    auto usages = PTE::NumaCensus::Run(map, pids, 0);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+    bool written = PTE::NumaCensus::WriteReport(reportPath, map, usages, elapsed.count());
+
+    PTE::Utils::StopAndDeleteDriver();
+
+    printf("%zu processes, %lld ms\n", usages.size(), static_cast<long long>(elapsed.count()));
+
+    return written ? 0 : ERROR_WRITE_FAULT;
+}
+
+/// <summary>
+/// Find the user mappings with the memory type other than write-back.
+/// </summary>
+/// <param name="reportPath">CSV report path</param>
+/// <param name="pids">Processes to walk, all if empty</param>
+/// <returns>Exit code</returns>
+int RunMemoryTypes(const std::wstring& reportPath, const std::vector<ULONG>& pids)
+{
+    unsigned long err = PTE::Utils::InitHeadless();
+    if (err != ERROR_SUCCESS)
+    {
+        return static_cast<int>(err);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto usages = PTE::MemoryTypes::Run(pids, 0);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+    bool written = PTE::MemoryTypes::WriteReport(reportPath, usages, elapsed.count());
+
+    PTE::Utils::StopAndDeleteDriver();
+
+    printf("%zu processes, %lld ms\n", usages.size(), static_cast<long long>(elapsed.count()));
+
+    return written ? 0 : ERROR_WRITE_FAULT;
+}
+
+/// <summary>
+/// Generate a synthetic image of the page tables into a sparse file,
+/// with a mix of the page sizes, sharing and fragmentation.
+/// </summary>
+/// <param name="imagePath">Image file path</param>
+/// <param name="truthPath">CSV path of the translations</param>
+/// <param name="spec">Shape of the image</param>
+/// <returns>Exit code</returns>
+int RunGenerate(const std::wstring& imagePath, const std::wstring& truthPath, const PTE::ImageSpec& spec)
+{
+    PTE::ImageMemory memory;
+    unsigned long err = memory.MapFile(imagePath, spec.ImageSize);
+    if (err != ERROR_SUCCESS)
+    {
+        return static_cast<int>(err);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    PTE::ImageBuilder builder(std::move(memory));
+    PTE::GeneratedImage image;
+    err = PTE::ImageGenerator::Generate(spec, builder, image);
+    if (err != ERROR_SUCCESS)
+    {
+        return static_cast<int>(err);
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+    for (size_t i = 0; i < image.CR3.size(); ++i)
+    {
+        printf("process %zu cr3 0x%llx\n", i, image.CR3[i]);
+    }
+    printf("%zu leaves, %llu frames used, %lld ms\n", image.Translations.size(), builder.UsedFrames(), static_cast<long long>(elapsed.count()));
+
+    return PTE::ImageGenerator::WriteTruth(truthPath, image) ? 0 : ERROR_WRITE_FAULT;
+}
+
+/// <summary>
+/// Run the command of the command line.
+/// </summary>
+/// <returns>Exit code</returns>
+int RunCommand(int argc, wchar_t** argv)
+{
+    if (argc < 2)
+    {
+        return Usage();
+    }
+
+    const std::wstring command = argv[1];
+
+    //
+    //   pte-cli translate <pid> <va> [va ...] [--probe] [--timing]
+    if (command == L"translate" && argc > 3)
+    {
+        ULONG pid{ 0 };
+        if (!ParsePid(argv[2], pid))
+        {
+            return Usage();
+        }
+
+        bool probe{ false };
+        bool timing{ false };
+        std::vector<uint64_t> addresses;
+        for (int i = 3; i < argc; ++i)
+        {
+            uint64_t address{ 0 };
+            if (std::wstring(argv[i]) == L"--probe")
+            {
+                probe = true;
+            }
+            else if (std::wstring(argv[i]) == L"--timing")
+            {
+                timing = true;
+            }
+            else if (Parse(argv[i], 16, address))
+            {
+                addresses.push_back(address);
+            }
+            else
+            {
+                return Usage();
+            }
+        }
+
+        return RunTranslate(pid, addresses, probe, timing);
+    }
+
+    //
+    //   pte-cli trace <trace> [translated.csv|translated.bin] [snapshot|live]
+    if (command == L"trace" && argc > 2)
+    {
+        PTE::TraceTranslator::Backend backend = PTE::TraceTranslator::Backend::Snapshot;
+        if (argc > 4 && std::wstring(argv[4]) == L"live")
+        {
+            backend = PTE::TraceTranslator::Backend::Live;
+        }
+        else if (argc > 4 && std::wstring(argv[4]) != L"snapshot")
+        {
+            return Usage();
+        }
+
+        return RunTrace(argv[2], argc > 3 ? argv[3] : L"translated.csv", backend);
+    }
+
+    //
+    //   pte-cli enumerate <pid> [leaves.csv]
+    if (command == L"enumerate" && argc > 2)
+    {
+        ULONG pid{ 0 };
+        if (!ParsePid(argv[2], pid))
+        {
+            return Usage();
+        }
+
+        return RunEnumerate(pid, argc > 3 ? argv[3] : L"leaves.csv");
+    }
+
+    //
+    //   pte-cli dump <pid> <start> <end> [hex|raw|annotated] [dump.txt]
+    if (command == L"dump" && argc > 4)
+    {
+        ULONG pid{ 0 };
+        uint64_t start{ 0 };
+        uint64_t end{ 0 };
+        if (!ParsePid(argv[2], pid) || !Parse(argv[3], 16, start) || !Parse(argv[4], 16, end))
+        {
+            return Usage();
+        }
+
+        PTE::DumpFormat format = PTE::DumpFormat::Hex;
+        if (argc > 5 && std::wstring(argv[5]) == L"raw")
+        {
+            format = PTE::DumpFormat::Raw;
+        }
+        else if (argc > 5 && std::wstring(argv[5]) == L"annotated")
+        {
+            format = PTE::DumpFormat::Annotated;
+        }
+        else if (argc > 5 && std::wstring(argv[5]) != L"hex")
+        {
+            return Usage();
+        }
+
+        return RunDump(pid, start, end, format, argc > 6 ? argv[6] : L"dump.txt");
+    }
+
+    //
+    //   pte-cli census [census.csv]
+    if (command == L"census")
+    {
+        return RunCensus(argc > 2 ? argv[2] : L"census.csv");
+    }
+
+    //
+    //   pte-cli classify <pid> [classify.csv]
+    if (command == L"classify" && argc > 2)
+    {
+        ULONG pid{ 0 };
+        if (!ParsePid(argv[2], pid))
+        {
+            return Usage();
+        }
+
+        return RunClassify(pid, argc > 3 ? argv[3] : L"classify.csv");
+    }
+
+    //
+    //   pte-cli promote <pid> [promote.csv] [min present]
+    if (command == L"promote" && argc > 2)
+    {
+        ULONG pid{ 0 };
+        uint64_t minPresent = PTE::HugePages::DefaultMinPresent;
+        if (!ParsePid(argv[2], pid) || (argc > 4 && (!Parse(argv[4], 10, minPresent) || minPresent > TABLE_SIZE)))
+        {
+            return Usage();
+        }
+
+        return RunPromote(pid, argc > 3 ? argv[3] : L"promote.csv", static_cast<uint32_t>(minPresent));
+    }
+
+    //
+    //   pte-cli tlb <pid> <trace.bin> [tlb.csv] [config]
+    if (command == L"tlb" && argc > 3)
+    {
+        ULONG pid{ 0 };
+        if (!ParsePid(argv[2], pid))
+        {
+            return Usage();
+        }
+
+        PTE::TlbConfig config = PTE::TlbConfig::Default();
+        if (argc > 5)
+        {
+            const std::wstring text = argv[5];
+            if (!PTE::TlbConfig::Parse(std::string(text.begin(), text.end()), config))
+            {
+                return Usage();
+            }
+        }
+
+        return RunTlb(pid, argv[3], argc > 4 ? argv[4] : L"tlb.csv", config);
+    }
+
+    //
+    //   pte-cli dedupe|contiguity|numa|memtype [report.csv] [pid ...]
+    if (command == L"dedupe" || command == L"contiguity" || command == L"numa" || command == L"memtype")
+    {
+        std::vector<ULONG> pids;
+        if (!ParsePids(argc, argv, 3, pids))
+        {
+            return Usage();
+        }
+
+        const std::wstring reportPath = argc > 2 ? argv[2] : command + L".csv";
+        if (command == L"dedupe")
+        {
+            return RunDedupe(reportPath, pids);
+        }
+        if (command == L"contiguity")
+        {
+            return RunContiguity(reportPath, pids);
+        }
+        if (command == L"numa")
+        {
+            return RunNuma(reportPath, pids);
+        }
+
+        return RunMemoryTypes(reportPath, pids);
+    }
+
+    //
+    //   pte-cli generate <image.bin> [truth.csv] [processes] [MB per process] [image MB]
+    if (command == L"generate" && argc > 2)
+    {
+        //
+        // A mix resembling a desktop: mostly 4KB pages with holes, some large pages,
+        // shared module images, the kernel half and fragmented physical memory.
+        PTE::ImageSpec spec;
+        spec.ImageSize = 4ull << 30;
+        spec.Processes = 4;
+        spec.MappedPerProcess = 256ull << 20;
+        spec.Density = 0.6;
+        spec.Large2MB = 0.25;
+        spec.Shared = 0.2;
+        spec.KernelMapped = 64ull << 20;
+        spec.Fragmentation = 0.5;
+        spec.SelfMapIndex = 0x1ED;
+
+        uint64_t value{ 0 };
+        if (argc > 4)
+        {
+            if (!Parse(argv[4], 10, value) || value == 0 || value > ULONG_MAX)
+            {
+                return Usage();
+            }
+            spec.Processes = static_cast<ULONG>(value);
+        }
+        if (argc > 5)
+        {
+            if (!Parse(argv[5], 10, value) || value == 0)
+            {
+                return Usage();
+            }
+            spec.MappedPerProcess = value << 20;
+        }
+        if (argc > 6)
+        {
+            if (!Parse(argv[6], 10, value) || value == 0)
+            {
+                return Usage();
+            }
+            spec.ImageSize = value << 20;
+        }
+
+        return RunGenerate(argv[2], argc > 3 ? argv[3] : L"truth.csv", spec);
+    }
+
+    return Usage();
+}
+
+} //namespace
+
+int wmain(int argc, wchar_t** argv)
+{
+    //
+    //   pte-cli --timeline <timeline.json|timeline.perfetto-trace> <command> ...
+    const wchar_t* timelinePath = nullptr;
+    if (argc > 3 && std::wstring(argv[1]) == L"--timeline")
+    {
+        timelinePath = argv[2];
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+        PTE::Timeline::Enable(true);
+        PTE::Timeline::NameThread("main");
+    }
+
+    const int result = RunCommand(argc, argv);
+
+    if (timelinePath != nullptr && !PTE::Timeline::Write(timelinePath))
+    {
+        fwprintf(stderr, L"Failed to write the timeline %ls\n", timelinePath);
+    }
+
+    return result;
+}
@@ -0,0 +1,43 @@
+/*
+    buffer_pool.cpp
+
+    Per-thread pools of the request buffers and of the result vectors,
+    reused instead of allocating them for every request.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "buffer_pool.h"
+
+/// <summary>
+/// Free list of the calling thread.
+/// </summary>
+template <typename T>
+typename PTE::BufferPool<T>::FreeList& PTE::BufferPool<T>::Local()
+{
+    static thread_local FreeList s_list;
+    return s_list;
+}
+
+/// <summary>
+/// Free vectors of the calling thread.
+/// </summary>
+template <typename T>
+std::vector<std::vector<T>>& PTE::VectorPool<T>::Local()
+{
+    static thread_local std::vector<std::vector<T>> s_list = []()
+        {
+            std::vector<std::vector<T>> list;
+            list.reserve(MaxFree);
+            return list;
+        }();
+    return s_list;
+}
+
+//
+// The pooled types.
+template PTE::BufferPool<IOCTL_DATA>::FreeList& PTE::BufferPool<IOCTL_DATA>::Local();
+template PTE::BufferPool<IOCTL_ENUM_DATA>::FreeList& PTE::BufferPool<IOCTL_ENUM_DATA>::Local();
+template std::vector<std::vector<uint64_t>>& PTE::VectorPool<uint64_t>::Local();
+template std::vector<std::vector<uint32_t>>& PTE::VectorPool<uint32_t>::Local();
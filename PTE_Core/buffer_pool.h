@@ -0,0 +1,259 @@
+/*
+	buffer_pool.h
+
+	Per-thread pools of the request buffers and of the result vectors,
+	reused instead of allocating them for every request.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "include.h"
+
+namespace PTE
+{
+
+/// <summary>
+/// Page aligned buffers of a driver structure, IOCTL_DATA or IOCTL_ENUM_DATA.
+/// A released buffer goes to the free list of the releasing thread and is handed out again
+/// by the next Acquire there, so a thread repeating requests allocates only the first time.
+/// The buffers are not cleared, as the malloc-ed ones they replace.
+/// The free lists are thread_local, which the /clr code of the UI cannot have,
+/// so they are instantiated in buffer_pool.cpp for the pooled types only.
+/// </summary>
+template <typename T>
+class BufferPool
+{
+	static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>,
+		"The buffers hold the plain structures shared with the driver");
+
+public:
+	static constexpr size_t Alignment = PAGE_SIZE;
+
+	//
+	// Buffers a thread keeps, the rest is freed
+	static constexpr size_t MaxFree = 2;
+
+	/// <summary>
+	/// Owns a buffer and returns it to the pool.
+	/// </summary>
+	class Lease
+	{
+	public:
+		Lease() = default;
+
+		~Lease()
+		{
+			Release();
+		}
+
+		Lease(Lease&& other) noexcept :
+			m_buffer(std::exchange(other.m_buffer, nullptr))
+		{
+		}
+
+		Lease& operator=(Lease&& other) noexcept
+		{
+			if (this != &other)
+			{
+				Release();
+				m_buffer = std::exchange(other.m_buffer, nullptr);
+			}
+			return *this;
+		}
+
+		Lease(const Lease&) = delete;
+		Lease& operator=(const Lease&) = delete;
+
+		T* Get() const { return m_buffer; }
+		T* operator->() const { return m_buffer; }
+		explicit operator bool() const { return m_buffer != nullptr; }
+
+		/// <summary>
+		/// Return the buffer to the pool before the end of the lease.
+		/// </summary>
+		void Release()
+		{
+			if (m_buffer != nullptr)
+			{
+				BufferPool::Return(m_buffer);
+				m_buffer = nullptr;
+			}
+		}
+
+	private:
+		friend class BufferPool;
+
+		explicit Lease(T* buffer) :
+			m_buffer(buffer)
+		{
+		}
+
+		T* m_buffer{ nullptr };
+	};
+
+	/// <summary>
+	/// Take a buffer of the thread's free list, allocate one if the list is empty.
+	/// </summary>
+	/// <returns>The lease, empty if the allocation failed</returns>
+	static Lease Acquire()
+	{
+		FreeList& list = Local();
+		if (list.head != nullptr)
+		{
+			Node* node = list.head;
+			list.head = node->next;
+			list.count--;
+			return Lease(reinterpret_cast<T*>(node));
+		}
+
+		return Lease(static_cast<T*>(::operator new(sizeof(T), std::align_val_t(Alignment), std::nothrow)));
+	}
+
+	/// <summary>
+	/// Free the buffers kept by the calling thread.
+	/// </summary>
+	static void Trim()
+	{
+		Local().Trim();
+	}
+
+private:
+	//
+	// A free buffer holds the link to the next one.
+	struct Node
+	{
+		Node* next;
+	};
+
+	struct FreeList
+	{
+		Node* head{ nullptr };
+		size_t count{ 0 };
+
+		~FreeList()
+		{
+			Trim();
+		}
+
+		void Trim()
+		{
+			while (head != nullptr)
+			{
+				Node* next = head->next;
+				::operator delete(static_cast<void*>(head), std::align_val_t(Alignment));
+				head = next;
+			}
+			count = 0;
+		}
+	};
+
+	static FreeList& Local();
+
+	static void Return(T* buffer)
+	{
+		FreeList& list = Local();
+		if (list.count == MaxFree)
+		{
+			::operator delete(static_cast<void*>(buffer), std::align_val_t(Alignment));
+			return;
+		}
+
+		Node* node = reinterpret_cast<Node*>(buffer);
+		node->next = list.head;
+		list.head = node;
+		list.count++;
+	}
+};
+
+/// <summary>
+/// Result vectors of the batch translations. A vector returned to the pool keeps its capacity,
+/// so resizing it for the next batch of the same size does not allocate.
+/// The capacity is kept until the thread ends or calls Trim.
+/// </summary>
+template <typename T>
+class VectorPool
+{
+public:
+	//
+	// Vectors a thread keeps, the rest is freed
+	static constexpr size_t MaxFree = 4;
+
+	/// <summary>
+	/// Owns a vector and returns it to the pool.
+	/// </summary>
+	class Lease
+	{
+	public:
+		explicit Lease(std::vector<T>&& vector) :
+			m_vector(std::move(vector))
+		{
+		}
+
+		~Lease()
+		{
+			VectorPool::Return(std::move(m_vector));
+		}
+
+		Lease(const Lease&) = delete;
+		Lease& operator=(const Lease&) = delete;
+
+		std::vector<T>& operator*() { return m_vector; }
+		std::vector<T>* operator->() { return &m_vector; }
+		T* data() { return m_vector.data(); }
+		size_t size() const { return m_vector.size(); }
+		T& operator[](size_t i) { return m_vector[i]; }
+
+	private:
+		std::vector<T> m_vector;
+	};
+
+	/// <summary>
+	/// Take a vector of the thread's free list and resize it.
+	/// </summary>
+	/// <param name="size">Number of the elements</param>
+	/// <returns>The lease</returns>
+	static Lease Acquire(size_t size)
+	{
+		std::vector<std::vector<T>>& list = Local();
+
+		std::vector<T> vector;
+		if (!list.empty())
+		{
+			vector = std::move(list.back());
+			list.pop_back();
+		}
+		vector.resize(size);
+
+		return Lease(std::move(vector));
+	}
+
+	/// <summary>
+	/// Free the vectors kept by the calling thread.
+	/// </summary>
+	static void Trim()
+	{
+		Local().clear();
+	}
+
+private:
+	static std::vector<std::vector<T>>& Local();
+
+	static void Return(std::vector<T>&& vector)
+	{
+		std::vector<std::vector<T>>& list = Local();
+		if (list.size() < MaxFree && vector.capacity() != 0)
+		{
+			vector.clear();
+			list.push_back(std::move(vector));
+		}
+	}
+};
+
+} //namespace PTE
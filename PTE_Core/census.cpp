@@ -0,0 +1,501 @@
+/*
+    census.cpp
+
+    Headless system-wide census of the process memory.
+    Every accessible process is analyzed on a pool of worker threads:
+    the virtual regions are walked with VirtualQueryEx and
+    the paging structures are copied by the driver.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "census.h"
+#include "buffer_pool.h"
+#include "table_decode.h"
+#include "timeline.h"
+#include "utils.h"
+#include <tlhelp32.h>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <format>
+#include <fstream>
+#include <thread>
+
+/// <summary>
+/// Bytes mapped by the present leaf entries.
+/// </summary>
+uint64_t PTE::CensusEntry::ResidentBytes() const
+{
+    return ResidentPages * PAGE_SIZE + LargeBytes();
+}
+
+/// <summary>
+/// Bytes mapped by the 2MB and 1GB pages.
+/// </summary>
+uint64_t PTE::CensusEntry::LargeBytes() const
+{
+    return (LargePages << 21) + (HugePages << 30);
+}
+
+/// <summary>
+/// Bytes spent on the paging structures.
+/// </summary>
+uint64_t PTE::CensusEntry::TableBytes() const
+{
+    uint64_t result{ 0 };
+
+    for (auto count : TablePages)
+    {
+        result += count * PAGE_SIZE;
+    }
+
+    return result;
+}
+
+/// <summary>
+/// Average number of the present entries per table of the level.
+/// </summary>
+/// <param name="level">TABLE_LEVEL</param>
+/// <returns>0..TABLE_SIZE</returns>
+double PTE::CensusEntry::Occupancy(ULONG level) const
+{
+    return TablePages[level] ? static_cast<double>(TableEntries[level]) / TablePages[level] : 0.0;
+}
+
+/// <summary>
+/// Bytes spent on the paging structures per GB of the mapped memory.
+/// Densely used 4KB page tables cost 2MB per GB.
+/// </summary>
+uint64_t PTE::CensusEntry::TableBytesPerGB() const
+{
+    const uint64_t resident = ResidentBytes();
+
+    return resident ? static_cast<uint64_t>(static_cast<double>(TableBytes()) * (1ull << 30) / resident) : 0;
+}
+
+/// <summary>
+/// Check if the address space layout is so sparse the tables cost much more than they map.
+/// </summary>
+bool PTE::CensusEntry::IsSparse() const
+{
+    //
+    // Eight times the dense cost, ignoring the small processes.
+    constexpr uint64_t SparseBytesPerGB = 8 * (2ull << 20);
+    constexpr uint64_t MinTableBytes = 1ull << 20;
+
+    return TableBytes() >= MinTableBytes && TableBytesPerGB() >= SparseBytesPerGB;
+}
+
+/// <summary>
+/// Get the list of running processes.
+/// </summary>
+/// <returns>Census entries with pid and name set</returns>
+std::vector<PTE::CensusEntry> PTE::Census::ListProcesses()
+{
+    std::vector<CensusEntry> result;
+    PROCESSENTRY32W proc{ .dwSize = sizeof(PROCESSENTRY32W) };
+
+    HANDLE hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+    if (hSnapshot == INVALID_HANDLE_VALUE)
+    {
+        return result;
+    }
+
+    if (Process32FirstW(hSnapshot, &proc))
+    {
+        do
+        {
+            //
+            // System processes are ignored by the driver.
+            if (proc.th32ProcessID <= 4)
+            {
+                continue;
+            }
+
+            CensusEntry entry;
+            entry.Pid = proc.th32ProcessID;
+            entry.Name = proc.szExeFile;
+            result.push_back(std::move(entry));
+        } while (Process32NextW(hSnapshot, &proc));
+    }
+
+    CloseHandle(hSnapshot);
+
+    return result;
+}
+
+/// <summary>
+/// Get the processes to walk.
+/// </summary>
+/// <param name="pids">Requested processes</param>
+/// <returns>The requested processes, all the running ones if none is requested</returns>
+std::vector<ULONG> PTE::Census::Targets(const std::vector<ULONG>& pids)
+{
+    if (!pids.empty())
+    {
+        return pids;
+    }
+
+    std::vector<ULONG> targets;
+    for (const auto& entry : ListProcesses())
+    {
+        targets.push_back(entry.Pid);
+    }
+
+    return targets;
+}
+
+/// <summary>
+/// Get the number of the worker threads for the processes.
+/// </summary>
+/// <param name="threads">Requested number, 0 to use all the cores</param>
+/// <param name="processes">Number of the processes</param>
+/// <returns>From 1 to the number of the processes</returns>
+unsigned int PTE::Census::ThreadCount(unsigned int threads, size_t processes)
+{
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    return std::min(threads, static_cast<unsigned int>(std::max<size_t>(1, processes)));
+}
+
+/// <summary>
+/// Call the callback for every process on a pool of worker threads.
+/// Every worker has its own device handle, IOCTL buffer, snapshot and region list,
+/// the processes are taken one by one until none is left.
+/// </summary>
+/// <param name="count">Number of the processes</param>
+/// <param name="threads">Number of worker threads, 0 to use all the cores</param>
+/// <param name="name">Name of the worker threads in the timeline</param>
+/// <param name="callback">Called concurrently with the worker and the index of the process</param>
+void PTE::Census::ForEachProcess(size_t count, unsigned int threads, const char* name, const ProcessCallback& callback)
+{
+    threads = ThreadCount(threads, count);
+
+    std::atomic<size_t> next{ 0 };
+    std::vector<std::thread> workers;
+
+    for (unsigned int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t]()
+            {
+                Timeline::NameThread(name);
+
+                ProcessWorker worker;
+                worker.Index = t;
+                worker.Device = Utils::OpenDevice();
+                worker.Error = worker.Device == INVALID_HANDLE_VALUE ? GetLastError() : ERROR_SUCCESS;
+
+                BufferPool<IOCTL_ENUM_DATA>::Lease lease = BufferPool<IOCTL_ENUM_DATA>::Acquire();
+                worker.Buffer = lease.Get();
+                if (worker.Buffer == nullptr)
+                {
+                    worker.Error = ERROR_NOT_ENOUGH_MEMORY;
+                }
+
+                for (size_t i = next++; i < count; i = next++)
+                {
+                    callback(worker, i);
+                }
+
+                if (worker.Device != INVALID_HANDLE_VALUE)
+                {
+                    CloseHandle(worker.Device);
+                }
+            });
+    }
+
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+/// <summary>
+/// Get the virtual regions of the process into the region list of the worker.
+/// </summary>
+/// <param name="pid">Process id</param>
+/// <returns>Win32 error code, the list is empty on failure</returns>
+unsigned long PTE::ProcessWorker::ReadRegions(ULONG pid)
+{
+    Regions.clear();
+
+    HANDLE hProcess = OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, pid);
+    if (!hProcess)
+    {
+        return GetLastError();
+    }
+
+    PTE::Regions::Enumerate(hProcess, Regions);
+    CloseHandle(hProcess);
+
+    return ERROR_SUCCESS;
+}
+
+/// <summary>
+/// Copy the page tables of the user space of the process into the snapshot of the worker.
+/// </summary>
+/// <param name="pid">Process id</param>
+/// <returns>Win32 error code, the error of the worker if it has no device or buffer</returns>
+unsigned long PTE::ProcessWorker::ReadPageTables(ULONG pid)
+{
+    if (Error != ERROR_SUCCESS)
+    {
+        return Error;
+    }
+
+    return Utils::ReadPageTables(Device, pid, Buffer, Tables);
+}
+
+/// <summary>
+/// Sum up the virtual regions of the process.
+/// </summary>
+/// <param name="worker">The worker, its region list is filled</param>
+/// <param name="entry">The process entry to fill</param>
+void PTE::Census::WalkRegions(ProcessWorker& worker, CensusEntry& entry)
+{
+    unsigned long err = worker.ReadRegions(entry.Pid);
+    if (err != ERROR_SUCCESS)
+    {
+        entry.Error = err;
+        return;
+    }
+
+    for (const auto& region : worker.Regions)
+    {
+        if (region.State != MEM_COMMIT)
+        {
+            continue;
+        }
+
+        ++entry.Regions;
+        entry.CommittedBytes += region.RegionSize;
+
+        switch (region.Type)
+        {
+        case MEM_IMAGE:
+            entry.ImageBytes += region.RegionSize;
+            break;
+        case MEM_MAPPED:
+            entry.MappedBytes += region.RegionSize;
+            break;
+        case MEM_PRIVATE:
+            entry.PrivateBytes += region.RegionSize;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/// <summary>
+/// Get the type of the region holding the address.
+/// </summary>
+/// <param name="regions">The regions, sorted by the base address</param>
+/// <param name="va">Virtual address</param>
+/// <returns>MEMORY_KIND</returns>
+uint32_t PTE::Census::GetMemoryKind(const std::vector<Region>& regions, uint64_t va)
+{
+    //
+    // Memory mapped by the page tables but not reported by VirtualQueryEx is counted as private.
+    const Region* region = Regions::Find(regions, va);
+    if (region == nullptr)
+    {
+        return MEMORY_KIND_PRIVATE;
+    }
+
+    return SharedFrames::KindOf(region->Type);
+}
+
+/// <summary>
+/// Sum up the paging structures of the process and collect its frames.
+/// </summary>
+/// <param name="worker">The worker, its regions are used to tag the frames</param>
+/// <param name="entry">The process entry to fill</param>
+/// <param name="index">Index of the entry, used to tag the frames</param>
+/// <param name="frames">Frames collected by the worker</param>
+void PTE::Census::WalkPageTables(ProcessWorker& worker,
+    CensusEntry& entry,
+    uint32_t index,
+    std::vector<FrameRef>& frames)
+{
+    unsigned long err = worker.ReadPageTables(entry.Pid);
+    if (err != ERROR_SUCCESS)
+    {
+        entry.Error = err;
+        return;
+    }
+
+    const PageTables& tables = worker.Tables;
+    const std::vector<Region>& regions = worker.Regions;
+
+    //
+    // Leaf entries are counted and collected per table from the decoded bitmaps,
+    // which skips the holes of the sparse tables a word at a time.
+    // The same bitmaps give the occupancy of every table.
+    TableBits bits;
+    for (const auto& table : tables.Tables)
+    {
+        TableDecoder::Decode(table.entries, bits);
+
+        ++entry.TablePages[table.level];
+        entry.TableEntries[table.level] += TableDecoder::Count(bits.present);
+
+        if (table.level == TABLE_LEVEL_PML4)
+        {
+            continue;
+        }
+
+        //
+        // Frame numbers of the large pages have PAT in their low bits.
+        uint64_t pfnMask = ~0ull;
+        uint32_t frames4K = 1;
+        uint64_t* counter = &entry.ResidentPages;
+        if (table.level == TABLE_LEVEL_PD)
+        {
+            pfnMask = ~0x1FFull;
+            frames4K = 512;
+            counter = &entry.LargePages;
+        }
+        else if (table.level == TABLE_LEVEL_PDP)
+        {
+            pfnMask = ~0x3FFFFull;
+            frames4K = 512 * 512;
+            counter = &entry.HugePages;
+        }
+
+        const uint64_t entrySize = static_cast<uint64_t>(frames4K) * PAGE_SIZE;
+
+        for (size_t word = 0; word < TableBits::Words; ++word)
+        {
+            uint64_t leaves = bits.present[word];
+            if (table.level != TABLE_LEVEL_PT)
+            {
+                leaves &= bits.large[word];
+            }
+
+            *counter += std::popcount(leaves);
+
+            for (; leaves != 0; leaves &= leaves - 1)
+            {
+                const size_t i = word * 64 + std::countr_zero(leaves);
+                frames.push_back({ .pfn = bits.pfn[i] & pfnMask,
+                    .process = index,
+                    .frames = frames4K,
+                    .kind = GetMemoryKind(regions, table.baseVA + i * entrySize) });
+            }
+        }
+    }
+}
+
+/// <summary>
+/// Analyze all the accessible processes.
+/// </summary>
+/// <param name="threads">Number of worker threads, 0 to use all the cores</param>
+/// <returns>Entry per process</returns>
+std::vector<PTE::CensusEntry> PTE::Census::Run(unsigned int threads)
+{
+    std::vector<CensusEntry> entries = ListProcesses();
+
+    //
+    // Region totals are counted even without the driver.
+    std::vector<std::vector<FrameRef>> frames(ThreadCount(threads, entries.size()));
+    ForEachProcess(entries.size(), threads, "census worker", [&](ProcessWorker& worker, size_t i)
+        {
+            WalkRegions(worker, entries[i]);
+            WalkPageTables(worker, entries[i], static_cast<uint32_t>(i), frames[worker.Index]);
+        });
+
+    std::vector<FrameRef> allFrames;
+    for (auto& workerFrames : frames)
+    {
+        allFrames.insert(allFrames.end(), workerFrames.begin(), workerFrames.end());
+        workerFrames = {};
+    }
+
+    auto shares = SharedFrames::Analyze(allFrames, entries.size());
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        entries[i].SharedFrames = shares[i].SharedFrames;
+        entries[i].PrivateFrames = shares[i].PrivateFrames;
+        entries[i].PssFrames = shares[i].PssFrames;
+        std::copy(std::begin(shares[i].SharedKindFrames), std::end(shares[i].SharedKindFrames), entries[i].SharedKindFrames);
+    }
+
+    return entries;
+}
+
+/// <summary>
+/// Write the census as CSV.
+/// </summary>
+/// <param name="path">Report file path</param>
+/// <param name="entries">The census</param>
+/// <param name="elapsedMs">Time spent on the census</param>
+/// <returns>True on success</returns>
+bool PTE::Census::WriteReport(const std::wstring& path, const std::vector<CensusEntry>& entries, uint64_t elapsedMs)
+{
+    TimelineScope scope(TimelineCategory::Export, "write report");
+
+    std::ofstream report(path, std::ios::out | std::ios::trunc);
+    if (!report)
+    {
+        return false;
+    }
+
+    report << "pid,name,error,regions,committed_kb,image_kb,mapped_kb,private_kb,"
+        "resident_4k,resident_2m,resident_1g,resident_kb,huge_page_share,"
+        "pml4_tables,pdp_tables,pd_tables,pt_tables,table_kb,"
+        "private_frames_kb,shared_frames_kb,pss_kb,shared_image_kb,shared_mapped_kb,shared_private_kb,"
+        "pml4_occupancy,pdp_occupancy,pd_occupancy,pt_occupancy,table_kb_per_gb,sparse\n";
+
+    for (const auto& entry : entries)
+    {
+        //
+        // Process names are written as UTF-8.
+        std::string name(WideCharToMultiByte(CP_UTF8, 0, entry.Name.data(), static_cast<int>(entry.Name.size()), nullptr, 0, nullptr, nullptr), '\0');
+        WideCharToMultiByte(CP_UTF8, 0, entry.Name.data(), static_cast<int>(entry.Name.size()), name.data(), static_cast<int>(name.size()), nullptr, nullptr);
+
+        const uint64_t resident = entry.ResidentBytes();
+        const double hugeShare = resident ? static_cast<double>(entry.LargeBytes()) / resident : 0.0;
+
+        report << std::format("{},\"{}\",{},{},{},{},{},{},{},{},{},{},{:.4f},{},{},{},{},{},{},{},{:.0f},{},{},{},{:.1f},{:.1f},{:.1f},{:.1f},{},{}\n",
+            entry.Pid,
+            name,
+            entry.Error,
+            entry.Regions,
+            entry.CommittedBytes / 1024,
+            entry.ImageBytes / 1024,
+            entry.MappedBytes / 1024,
+            entry.PrivateBytes / 1024,
+            entry.ResidentPages,
+            entry.LargePages,
+            entry.HugePages,
+            resident / 1024,
+            hugeShare,
+            entry.TablePages[TABLE_LEVEL_PML4],
+            entry.TablePages[TABLE_LEVEL_PDP],
+            entry.TablePages[TABLE_LEVEL_PD],
+            entry.TablePages[TABLE_LEVEL_PT],
+            entry.TableBytes() / 1024,
+            entry.PrivateFrames * PAGE_SIZE / 1024,
+            entry.SharedFrames * PAGE_SIZE / 1024,
+            entry.PssFrames * PAGE_SIZE / 1024,
+            entry.SharedKindFrames[MEMORY_KIND_IMAGE] * PAGE_SIZE / 1024,
+            entry.SharedKindFrames[MEMORY_KIND_MAPPED] * PAGE_SIZE / 1024,
+            entry.SharedKindFrames[MEMORY_KIND_PRIVATE] * PAGE_SIZE / 1024,
+            entry.Occupancy(TABLE_LEVEL_PML4),
+            entry.Occupancy(TABLE_LEVEL_PDP),
+            entry.Occupancy(TABLE_LEVEL_PD),
+            entry.Occupancy(TABLE_LEVEL_PT),
+            entry.TableBytesPerGB() / 1024,
+            entry.IsSparse() ? 1 : 0);
+    }
+
+    report << std::format("# {} processes in {} ms\n", entries.size(), elapsedMs);
+
+    return static_cast<bool>(report);
+}
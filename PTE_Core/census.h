@@ -0,0 +1,124 @@
+/*
+	census.h
+
+	Headless system-wide census of the process memory.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "include.h"
+#include "page_tables.h"
+#include "regions.h"
+#include "shared_frames.h"
+
+namespace PTE
+{
+
+/// <summary>
+/// Memory totals of a single process.
+/// </summary>
+struct CensusEntry
+{
+	ULONG Pid{ 0 };
+	std::wstring Name;
+
+	//
+	// Win32 error if the process could not be fully analyzed
+	unsigned long Error{ 0 };
+
+	//
+	// Virtual regions totals
+	uint64_t Regions{ 0 };
+	uint64_t CommittedBytes{ 0 };
+	uint64_t ImageBytes{ 0 };
+	uint64_t MappedBytes{ 0 };
+	uint64_t PrivateBytes{ 0 };
+
+	//
+	// Page tables totals.
+	// Number of present leaf entries for 4KB, 2MB and 1GB pages.
+	uint64_t ResidentPages{ 0 };
+	uint64_t LargePages{ 0 };
+	uint64_t HugePages{ 0 };
+	uint64_t TablePages[TABLE_LEVEL_COUNT]{ };
+
+	//
+	// Present entries of the tables of every level, the occupancy of the tables.
+	uint64_t TableEntries[TABLE_LEVEL_COUNT]{ };
+
+	//
+	// Resident 4KB frames which are also mapped by another process,
+	// by the type of the region they are mapped in
+	uint64_t SharedFrames{ 0 };
+	uint64_t SharedKindFrames[MEMORY_KIND_COUNT]{ };
+
+	//
+	// Resident 4KB frames mapped by this process only
+	uint64_t PrivateFrames{ 0 };
+
+	//
+	// Proportional set size in 4KB frames
+	double PssFrames{ 0 };
+
+	uint64_t ResidentBytes() const;
+	uint64_t LargeBytes() const;
+	uint64_t TableBytes() const;
+	double Occupancy(ULONG level) const;
+	uint64_t TableBytesPerGB() const;
+	bool IsSparse() const;
+};
+
+/// <summary>
+/// State of a worker of Census::ForEachProcess, reused from a process to the next.
+/// </summary>
+struct ProcessWorker
+{
+	//
+	// Worker number, from 0 to the thread count
+	unsigned int Index{ 0 };
+
+	HANDLE Device{ INVALID_HANDLE_VALUE };
+	IOCTL_ENUM_DATA* Buffer{ nullptr };
+
+	//
+	// Win32 error if the device or the buffer is missing
+	unsigned long Error{ 0 };
+
+	PageTables Tables;
+	std::vector<Region> Regions;
+
+	unsigned long ReadRegions(ULONG pid);
+	unsigned long ReadPageTables(ULONG pid);
+};
+
+/// <summary>
+/// Walks the regions and the page tables of all accessible processes in parallel.
+/// </summary>
+class Census
+{
+public:
+	using ProcessCallback = std::function<void(ProcessWorker& worker, size_t index)>;
+
+	static std::vector<CensusEntry> Run(unsigned int threads);
+	static bool WriteReport(const std::wstring& path, const std::vector<CensusEntry>& entries, uint64_t elapsedMs);
+	static std::vector<CensusEntry> ListProcesses();
+	static std::vector<ULONG> Targets(const std::vector<ULONG>& pids);
+	static unsigned int ThreadCount(unsigned int threads, size_t processes);
+	static void ForEachProcess(size_t count, unsigned int threads, const char* name, const ProcessCallback& callback);
+
+private:
+	static void WalkRegions(ProcessWorker& worker, CensusEntry& entry);
+	static void WalkPageTables(ProcessWorker& worker,
+		CensusEntry& entry,
+		uint32_t index,
+		std::vector<FrameRef>& frames);
+	static uint32_t GetMemoryKind(const std::vector<Region>& regions, uint64_t va);
+};
+
+} //namespace PTE
@@ -0,0 +1,117 @@
+/*
+    content_census.cpp
+
+    Content classes of the resident memory of a process, per region.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "content_census.h"
+#include "page_scan.h"
+#include <format>
+#include <fstream>
+
+/// <summary>
+/// Count a page of the region.
+/// </summary>
+/// <param name="page">Content class of the page</param>
+void PTE::RegionClass::Add(const PageClass& page)
+{
+    ++Pages;
+    ZeroPages += page.Zero;
+    PatternPages += page.Pattern;
+    EntropySum += page.Entropy;
+    CompressedBytes += page.CompressedBytes;
+}
+
+/// <summary>
+/// Classify the resident pages of the process and sum them up per region.
+/// </summary>
+/// <param name="pid">Process id</param>
+/// <param name="regions">The committed regions, in the address order</param>
+/// <returns>Win32 error code, 0 on success</returns>
+unsigned long PTE::ContentCensus::Run(ULONG pid, std::vector<RegionClass>& regions)
+{
+    PageScanner scanner;
+    std::vector<RegionClass> totals;
+
+    unsigned long err = scanner.Scan(pid, [&](ULONG, const ScannedPage* pages, const uint8_t* data, size_t count)
+        {
+            //
+            // The region list is known by the first batch.
+            if (totals.empty())
+            {
+                totals.resize(scanner.GetRegions().size());
+            }
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                totals[pages[i].region].Add(PageClassifier::Classify(data + i * PAGE_SIZE));
+            }
+        });
+
+    regions.clear();
+    const auto& all = scanner.GetRegions();
+    totals.resize(all.size());
+
+    for (size_t i = 0; i < all.size(); ++i)
+    {
+        if (all[i].State == MEM_COMMIT)
+        {
+            totals[i].Info = all[i];
+            regions.push_back(totals[i]);
+        }
+    }
+
+    return err;
+}
+
+/// <summary>
+/// Write the report as CSV, a line per region.
+/// </summary>
+/// <param name="path">Report path</param>
+/// <param name="pid">Process id</param>
+/// <param name="regions">The regions</param>
+/// <returns>True on success</returns>
+bool PTE::ContentCensus::WriteReport(const std::wstring& path, ULONG pid, const std::vector<RegionClass>& regions)
+{
+    std::ofstream report(path, std::ios::out | std::ios::trunc);
+    if (!report)
+    {
+        return false;
+    }
+
+    report << "base,size_kb,type,protect,resident_kb,zero_kb,pattern_kb,avg_entropy,compressed_kb\n";
+
+    RegionClass total;
+    for (const auto& region : regions)
+    {
+        report << std::format("0x{:x},{},0x{:x},0x{:x},{},{},{},{:.3f},{}\n",
+            region.Info.BaseAddress,
+            region.Info.RegionSize / 1024,
+            region.Info.Type,
+            region.Info.Protect,
+            region.Pages * PAGE_SIZE / 1024,
+            region.ZeroPages * PAGE_SIZE / 1024,
+            region.PatternPages * PAGE_SIZE / 1024,
+            region.Pages ? region.EntropySum / region.Pages : 0.0,
+            region.CompressedBytes / 1024);
+
+        total.Pages += region.Pages;
+        total.ZeroPages += region.ZeroPages;
+        total.PatternPages += region.PatternPages;
+        total.EntropySum += region.EntropySum;
+        total.CompressedBytes += region.CompressedBytes;
+    }
+
+    report << std::format("# pid {}: resident_kb={} zero_kb={} pattern_kb={} avg_entropy={:.3f} compressed_kb={}\n",
+        pid,
+        total.Pages * PAGE_SIZE / 1024,
+        total.ZeroPages * PAGE_SIZE / 1024,
+        total.PatternPages * PAGE_SIZE / 1024,
+        total.Pages ? total.EntropySum / total.Pages : 0.0,
+        total.CompressedBytes / 1024);
+
+    return static_cast<bool>(report);
+}
@@ -0,0 +1,48 @@
+/*
+	content_census.h
+
+	Content classes of the resident memory of a process, per region.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "include.h"
+#include "page_classify.h"
+#include "regions.h"
+
+namespace PTE
+{
+
+/// <summary>
+/// Content totals of a region.
+/// </summary>
+struct RegionClass
+{
+	Region Info{ };
+
+	uint64_t Pages{ 0 };
+	uint64_t ZeroPages{ 0 };
+	uint64_t PatternPages{ 0 };
+	double EntropySum{ 0 };
+	uint64_t CompressedBytes{ 0 };
+
+	void Add(const PageClass& page);
+};
+
+/// <summary>
+/// Classifies the resident pages of a process and sums them up
+/// over the same regions the address table shows.
+/// </summary>
+class ContentCensus
+{
+public:
+	static unsigned long Run(ULONG pid, std::vector<RegionClass>& regions);
+	static bool WriteReport(const std::wstring& path, ULONG pid, const std::vector<RegionClass>& regions);
+};
+
+} //namespace PTE
@@ -0,0 +1,268 @@
+/*
+    contiguity.cpp
+
+    Physical contiguity of the process memory and fragmentation of the physical memory.
+    The leaf entries of every process are walked in the address order and
+    merged into runs while both the virtual and the physical addresses follow
+    each other. All the frames seen are set in a bitmap of the RAM shared by
+    the workers, which gives the use of the aligned 2MB and 1GB blocks at the end.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "contiguity.h"
+#include "census.h"
+#include "page_tables.h"
+#include "timeline.h"
+#include <algorithm>
+#include <bit>
+#include <format>
+#include <fstream>
+
+namespace
+{
+
+constexpr size_t NoRegion = PTE::RegionCursor::NoRegion;
+
+/// <summary>
+/// Run being extended by the walk.
+/// </summary>
+struct OpenRun
+{
+    uint64_t vaEnd{ 0 };
+    uint64_t paEnd{ 0 };
+    uint64_t frames{ 0 };
+    size_t region{ NoRegion };
+};
+
+/// <summary>
+/// Walk the leaf entries of the process once.
+/// </summary>
+/// <param name="worker">Device, buffer, snapshot and region list of the worker</param>
+/// <param name="result">The process to fill</param>
+/// <param name="bitmap">Frames seen by all the workers</param>
+void WalkProcess(PTE::ProcessWorker& worker, PTE::ProcessContiguity& result, PTE::FrameBitmap& bitmap)
+{
+    //
+    // Without the region list only the process totals are counted.
+    worker.ReadRegions(result.Pid);
+
+    result.Error = worker.ReadPageTables(result.Pid);
+    if (result.Error != ERROR_SUCCESS)
+    {
+        return;
+    }
+
+    const std::vector<PTE::Region>& regions = worker.Regions;
+    std::vector<PTE::ContiguityHistogram> histograms(regions.size());
+    OpenRun run;
+    PTE::RegionCursor cursor(regions);
+
+    auto closeRun = [&]()
+        {
+            if (run.frames != 0)
+            {
+                result.Total.AddRun(run.frames);
+                if (run.region != NoRegion)
+                {
+                    histograms[run.region].AddRun(run.frames);
+                }
+            }
+        };
+
+    worker.Tables.ForEachLeaf([&](const PTE::LeafMapping& leaf)
+        {
+            bitmap.SetRange(leaf.pa / PAGE_SIZE, leaf.size / PAGE_SIZE);
+
+            //
+            // A large page may span several regions, it is cut at their boundaries.
+            const uint64_t leafEnd = leaf.va + leaf.size;
+            for (uint64_t va = leaf.va; va < leafEnd; )
+            {
+                uint64_t end{ 0 };
+                const size_t region = cursor.Next(va, leafEnd, end);
+
+                const uint64_t pa = leaf.pa + (va - leaf.va);
+                if (run.frames == 0 || va != run.vaEnd || pa != run.paEnd || region != run.region)
+                {
+                    closeRun();
+                    run = { .frames = 0, .region = region };
+                }
+
+                run.frames += (end - va) / PAGE_SIZE;
+                run.vaEnd = end;
+                run.paEnd = pa + (end - va);
+                va = end;
+            }
+        });
+
+    closeRun();
+
+    for (size_t i = 0; i < regions.size(); ++i)
+    {
+        if (histograms[i].Runs != 0)
+        {
+            result.Regions.emplace_back(regions[i], histograms[i]);
+        }
+    }
+}
+
+} //namespace
+
+/// <summary>
+/// Count a run.
+/// </summary>
+/// <param name="frames">Length of the run in 4KB frames</param>
+void PTE::ContiguityHistogram::AddRun(uint64_t frames)
+{
+    const size_t bucket = std::min<size_t>(std::bit_width(frames) - 1, Buckets - 1);
+
+    ++Runs;
+    Frames[bucket] += frames;
+}
+
+/// <summary>
+/// Add the runs of another histogram.
+/// </summary>
+void PTE::ContiguityHistogram::Add(const ContiguityHistogram& other)
+{
+    Runs += other.Runs;
+    for (size_t bucket = 0; bucket < Buckets; ++bucket)
+    {
+        Frames[bucket] += other.Frames[bucket];
+    }
+}
+
+/// <summary>
+/// Share of the partially used blocks among the ones not fully used.
+/// </summary>
+double PTE::BlockUsage::FragmentationIndex() const
+{
+    const uint64_t notFull = Blocks - Full;
+
+    return notFull ? static_cast<double>(notFull - Clean) / notFull : 0.0;
+}
+
+/// <summary>
+/// Count the aligned blocks of the RAM by their use.
+/// The blocks crossing a hole of the RAM, the device memory below 4GB for example, are not counted.
+/// </summary>
+/// <param name="bitmap">Bit per 4KB frame of the RAM</param>
+/// <param name="blockFrames">Block size in frames</param>
+/// <returns>The block counts</returns>
+PTE::BlockUsage PTE::Contiguity::CountBlocks(const FrameBitmap& bitmap, uint64_t blockFrames)
+{
+    BlockUsage usage;
+
+    for (const auto& range : bitmap.Ranges())
+    {
+        for (uint64_t block = (range.Start + blockFrames - 1) / blockFrames; (block + 1) * blockFrames <= range.End; ++block)
+        {
+            const uint64_t used = bitmap.Count(block * blockFrames, blockFrames);
+
+            ++usage.Blocks;
+            usage.Clean += used == 0;
+            usage.Full += used == blockFrames;
+        }
+    }
+
+    return usage;
+}
+
+/// <summary>
+/// Walk the processes on a pool of worker threads.
+/// </summary>
+/// <param name="pids">Processes to walk, all the accessible ones if empty</param>
+/// <param name="threads">Number of worker threads, 0 to use all the cores</param>
+/// <returns>The report</returns>
+PTE::ContiguityReport PTE::Contiguity::Run(const std::vector<ULONG>& pids, unsigned int threads)
+{
+    ContiguityReport report;
+
+    const std::vector<ULONG> targets = Census::Targets(pids);
+
+    report.Processes.resize(targets.size());
+    for (size_t i = 0; i < targets.size(); ++i)
+    {
+        report.Processes[i].Pid = targets[i];
+    }
+
+    FrameBitmap bitmap(RamMap::System());
+    Census::ForEachProcess(targets.size(), threads, "contiguity worker", [&](ProcessWorker& worker, size_t i)
+        {
+            WalkProcess(worker, report.Processes[i], bitmap);
+        });
+
+    report.ObservedFrames = bitmap.Count();
+    report.MaxPfn = bitmap.HighestFrame();
+
+    if (report.ObservedFrames != 0)
+    {
+        report.Large = CountBlocks(bitmap, TABLE_SIZE);
+        report.Huge = CountBlocks(bitmap, TABLE_SIZE * TABLE_SIZE);
+    }
+
+    return report;
+}
+
+/// <summary>
+/// Write the report as CSV: a line per process and per region, the fragmentation in the comments.
+/// </summary>
+/// <param name="path">Report path</param>
+/// <param name="report">The report</param>
+/// <param name="elapsedMs">Duration of the walk</param>
+/// <returns>True on success</returns>
+bool PTE::Contiguity::WriteReport(const std::wstring& path, const ContiguityReport& report, uint64_t elapsedMs)
+{
+    TimelineScope scope(TimelineCategory::Export, "write report");
+
+    std::ofstream out(path, std::ios::out | std::ios::trunc);
+    if (!out)
+    {
+        return false;
+    }
+
+    //
+    // Bucket columns hold the KB in the runs of the bucket.
+    out << "pid,region,error,runs";
+    for (size_t bucket = 0; bucket < ContiguityHistogram::Buckets; ++bucket)
+    {
+        const uint64_t size = PAGE_SIZE << bucket;
+        out << (size >= (1ull << 30) ? std::format(",{}g_kb", size >> 30) :
+            size >= (1ull << 20) ? std::format(",{}m_kb", size >> 20) :
+            std::format(",{}k_kb", size >> 10));
+    }
+    out << "\n";
+
+    auto writeLine = [&](ULONG pid, const std::string& region, unsigned long error, const ContiguityHistogram& histogram)
+        {
+            out << std::format("{},{},{},{}", pid, region, error, histogram.Runs);
+            for (uint64_t frames : histogram.Frames)
+            {
+                out << std::format(",{}", frames * PAGE_SIZE / 1024);
+            }
+            out << "\n";
+        };
+
+    ContiguityHistogram total;
+    for (const auto& process : report.Processes)
+    {
+        writeLine(process.Pid, "", process.Error, process.Total);
+        for (const auto& [region, histogram] : process.Regions)
+        {
+            writeLine(process.Pid, std::format("0x{:x}", region.BaseAddress), 0, histogram);
+        }
+        total.Add(process.Total);
+    }
+    writeLine(0, "all", 0, total);
+
+    out << std::format("# observed_kb={} max_pfn=0x{:x}\n", report.ObservedFrames * PAGE_SIZE / 1024, report.MaxPfn);
+    out << std::format("# 2mb_blocks={} clean={} full={} fragmentation={:.4f}\n",
+        report.Large.Blocks, report.Large.Clean, report.Large.Full, report.Large.FragmentationIndex());
+    out << std::format("# 1gb_blocks={} clean={} full={} fragmentation={:.4f}\n",
+        report.Huge.Blocks, report.Huge.Clean, report.Huge.Full, report.Huge.FragmentationIndex());
+    out << std::format("# {} processes in {} ms\n", report.Processes.size(), elapsedMs);
+
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,103 @@
+/*
+	contiguity.h
+
+	Physical contiguity of the process memory and fragmentation of the physical memory.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "include.h"
+#include "ram_map.h"
+#include "regions.h"
+
+namespace PTE
+{
+
+/// <summary>
+/// Lengths of the runs of the virtual pages mapped to consecutive frames,
+/// in power of two buckets from 4KB to 1GB.
+/// </summary>
+struct ContiguityHistogram
+{
+	static constexpr size_t Buckets = 19;
+
+	uint64_t Runs{ 0 };
+
+	//
+	// 4KB frames in the runs of [4KB << i, 4KB << (i + 1)), the last bucket holds the longer runs too
+	uint64_t Frames[Buckets]{ };
+
+	void AddRun(uint64_t frames);
+	void Add(const ContiguityHistogram& other);
+};
+
+/// <summary>
+/// Contiguity of a single process.
+/// </summary>
+struct ProcessContiguity
+{
+	ULONG Pid{ 0 };
+	unsigned long Error{ 0 };
+	ContiguityHistogram Total;
+
+	//
+	// Committed regions with resident pages, runs are split at the region boundaries
+	std::vector<std::pair<Region, ContiguityHistogram>> Regions;
+};
+
+/// <summary>
+/// Use of the aligned physical blocks of a size by the frames seen in the page tables.
+/// Only the blocks inside the RAM are counted.
+/// </summary>
+struct BlockUsage
+{
+	uint64_t Blocks{ 0 };
+
+	//
+	// No frame of the block is mapped by a process
+	uint64_t Clean{ 0 };
+
+	//
+	// All the frames of the block are mapped
+	uint64_t Full{ 0 };
+
+	//
+	// Share of the partially used blocks among the ones not fully used:
+	// 0 when the user memory is packed, 1 when every block holds a few frames
+	double FragmentationIndex() const;
+};
+
+/// <summary>
+/// System-wide result.
+/// </summary>
+struct ContiguityReport
+{
+	std::vector<ProcessContiguity> Processes;
+
+	//
+	// Union of the frames of all the processes in the RAM
+	uint64_t ObservedFrames{ 0 };
+	uint64_t MaxPfn{ 0 };
+	BlockUsage Large;
+	BlockUsage Huge;
+};
+
+/// <summary>
+/// Streams the leaf entries of the processes once, building the run histograms
+/// and a bitmap of the RAM frames seen shared by the workers, no per page lists are kept.
+/// </summary>
+class Contiguity
+{
+public:
+	static ContiguityReport Run(const std::vector<ULONG>& pids, unsigned int threads);
+	static bool WriteReport(const std::wstring& path, const ContiguityReport& report, uint64_t elapsedMs);
+
+	static BlockUsage CountBlocks(const FrameBitmap& bitmap, uint64_t blockFrames);
+};
+
+} //namespace PTE
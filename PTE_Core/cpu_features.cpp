@@ -0,0 +1,127 @@
+/*
+    cpu_features.cpp
+
+    Detection of the instruction set extensions used by the vectorized code.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "cpu_features.h"
+#include <cstdint>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+namespace
+{
+
+/// <summary>
+/// Execute CPUID.
+/// </summary>
+/// <param name="leaf">EAX input</param>
+/// <param name="subleaf">ECX input</param>
+/// <param name="regs">EAX, EBX, ECX, EDX output</param>
+void CpuId(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuidex(info, static_cast<int>(leaf), static_cast<int>(subleaf));
+    for (int i = 0; i < 4; ++i)
+    {
+        regs[i] = static_cast<uint32_t>(info[i]);
+    }
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+/// <summary>
+/// Read XCR0, the register state enabled by the OS.
+/// </summary>
+/// <returns>XCR0 value</returns>
+uint64_t ReadXcr0()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+}
+
+} //namespace
+
+/// <summary>
+/// Query the CPU once.
+/// </summary>
+/// <returns>Supported extensions</returns>
+PTE::CpuFeatures::Flags PTE::CpuFeatures::Detect()
+{
+    Flags flags{ };
+    uint32_t regs[4]{ };
+
+    CpuId(0, 0, regs);
+    const uint32_t maxLeaf = regs[0];
+
+    CpuId(1, 0, regs);
+    flags.ssse3 = (regs[2] >> 9) & 1;
+
+    //
+    // AVX state must be enabled by the OS, XSAVE support tells if XCR0 can be read.
+    const bool osxsave = (regs[2] >> 27) & 1;
+    if (!osxsave || maxLeaf < 7)
+    {
+        return flags;
+    }
+
+    const uint64_t xcr0 = ReadXcr0();
+    const bool ymmEnabled = (xcr0 & 0x06) == 0x06;
+    const bool zmmEnabled = (xcr0 & 0xE6) == 0xE6;
+
+    CpuId(7, 0, regs);
+    flags.avx2 = ymmEnabled && ((regs[1] >> 5) & 1);
+    flags.avx512 = zmmEnabled && ((regs[1] >> 16) & 1) && ((regs[1] >> 30) & 1);
+
+    return flags;
+}
+
+/// <summary>
+/// Get the cached detection result.
+/// </summary>
+/// <returns>Supported extensions</returns>
+const PTE::CpuFeatures::Flags& PTE::CpuFeatures::Get()
+{
+    static const Flags s_flags = Detect();
+    return s_flags;
+}
+
+/// <summary>
+/// Check for SSSE3.
+/// </summary>
+/// <returns>True if supported</returns>
+bool PTE::CpuFeatures::HasSsse3()
+{
+    return Get().ssse3;
+}
+
+/// <summary>
+/// Check for AVX2.
+/// </summary>
+/// <returns>True if supported</returns>
+bool PTE::CpuFeatures::HasAvx2()
+{
+    return Get().avx2;
+}
+
+/// <summary>
+/// Check for AVX-512 F and BW.
+/// </summary>
+/// <returns>True if supported</returns>
+bool PTE::CpuFeatures::HasAvx512()
+{
+    return Get().avx512;
+}
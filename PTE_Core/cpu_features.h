@@ -0,0 +1,50 @@
+/*
+	cpu_features.h
+
+	Detection of the instruction set extensions used by the vectorized code.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+
+//
+// MSVC allows the intrinsics of any extension in any function,
+// GCC and Clang need the function to be compiled for the extension.
+#if defined(_MSC_VER)
+#define PTE_TARGET_SSSE3
+#define PTE_TARGET_AVX2
+#define PTE_TARGET_AVX512
+#else
+#define PTE_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define PTE_TARGET_AVX2 __attribute__((target("avx2")))
+#define PTE_TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#endif
+
+namespace PTE
+{
+
+/// <summary>
+/// Instruction set extensions supported by the CPU and enabled by the OS.
+/// </summary>
+class CpuFeatures
+{
+public:
+	static bool HasSsse3();
+	static bool HasAvx2();
+	static bool HasAvx512();
+
+private:
+	struct Flags
+	{
+		bool ssse3;
+		bool avx2;
+		bool avx512;
+	};
+
+	static const Flags& Get();
+	static Flags Detect();
+};
+
+} //namespace PTE
@@ -0,0 +1,228 @@
+/*
+	entry_fields.h
+
+	Compile-time descriptions of the paging entries and the control registers fields.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include "include.h"
+#include "ia32.hpp"
+
+namespace PTE
+{
+
+/// <summary>
+/// A bitfield of a 64-bit entry.
+/// </summary>
+struct EntryField
+{
+	const char* name;
+	uint8_t bit;
+	uint8_t width;
+
+	//
+	// Addresses and frame numbers are shown in hex
+	bool hex;
+
+	constexpr uint64_t Mask() const
+	{
+		return width == 64 ? ~0ull : (1ull << width) - 1;
+	}
+
+	constexpr uint64_t Get(uint64_t value) const
+	{
+		return (value >> bit) & Mask();
+	}
+};
+
+//
+// Field declared by ia32.hpp: the position and the width come from its _BIT and _MASK macros.
+#define PTE_ENTRY_FIELD(prefix, field, name) \
+	EntryField{ name, prefix##_##field##_BIT, static_cast<uint8_t>(std::bit_width(static_cast<uint64_t>(prefix##_##field##_MASK))), false }
+#define PTE_ENTRY_FIELD_HEX(prefix, field, name) \
+	EntryField{ name, prefix##_##field##_BIT, static_cast<uint8_t>(std::bit_width(static_cast<uint64_t>(prefix##_##field##_MASK))), true }
+
+//
+// Reserved bits have no macros, their position is checked by the layout check.
+#define PTE_RESERVED_FIELD(name, bit, width) EntryField{ name, bit, width, false }
+
+/// <summary>
+/// Check that the fields go from the highest bit down, without gaps and overlaps,
+/// and cover all the 64 bits.
+/// </summary>
+/// <param name="fields">The fields</param>
+/// <returns>True if the layout is valid</returns>
+template <size_t N>
+constexpr bool IsLayoutValid(const std::array<EntryField, N>& fields)
+{
+	unsigned int next = 64;
+
+	for (const auto& field : fields)
+	{
+		if (field.width == 0 || field.bit + field.width != next)
+		{
+			return false;
+		}
+		next = field.bit;
+	}
+
+	return next == 0;
+}
+
+/// <summary>
+/// Fields of the type, from the highest bit down, the order of the property grid columns.
+/// </summary>
+template <typename T>
+struct EntryFields;
+
+template <>
+struct EntryFields<pml4e_64>
+{
+	static constexpr std::array<EntryField, 13> Fields{
+		PTE_ENTRY_FIELD(PML4E_64, EXECUTE_DISABLE, "execute_disable"),
+		PTE_ENTRY_FIELD(PML4E_64, IGNORED_2, "ignored_2"),
+		PTE_RESERVED_FIELD("reserved2", 48, 4),
+		PTE_ENTRY_FIELD_HEX(PML4E_64, PAGE_FRAME_NUMBER, "page_frame_number"),
+		PTE_ENTRY_FIELD(PML4E_64, IGNORED_1, "ignored_1"),
+		PTE_ENTRY_FIELD(PML4E_64, MUST_BE_ZERO, "must_be_zero"),
+		PTE_RESERVED_FIELD("reserved1", 6, 1),
+		PTE_ENTRY_FIELD(PML4E_64, ACCESSED, "accessed"),
+		PTE_ENTRY_FIELD(PML4E_64, PAGE_LEVEL_CACHE_DISABLE, "page_level_cache_disable"),
+		PTE_ENTRY_FIELD(PML4E_64, PAGE_LEVEL_WRITE_THROUGH, "page_level_write_through"),
+		PTE_ENTRY_FIELD(PML4E_64, SUPERVISOR, "supervisor"),
+		PTE_ENTRY_FIELD(PML4E_64, WRITE, "write"),
+		PTE_ENTRY_FIELD(PML4E_64, PRESENT, "present"),
+	};
+};
+
+template <>
+struct EntryFields<pdpte_64>
+{
+	static constexpr std::array<EntryField, 13> Fields{
+		PTE_ENTRY_FIELD(PDPTE_64, EXECUTE_DISABLE, "execute_disable"),
+		PTE_ENTRY_FIELD(PDPTE_64, IGNORED_2, "ignored_2"),
+		PTE_RESERVED_FIELD("reserved2", 48, 4),
+		PTE_ENTRY_FIELD_HEX(PDPTE_64, PAGE_FRAME_NUMBER, "page_frame_number"),
+		PTE_ENTRY_FIELD(PDPTE_64, IGNORED_1, "ignored_1"),
+		PTE_ENTRY_FIELD(PDPTE_64, LARGE_PAGE, "large_page"),
+		PTE_RESERVED_FIELD("reserved1", 6, 1),
+		PTE_ENTRY_FIELD(PDPTE_64, ACCESSED, "accessed"),
+		PTE_ENTRY_FIELD(PDPTE_64, PAGE_LEVEL_CACHE_DISABLE, "page_level_cache_disable"),
+		PTE_ENTRY_FIELD(PDPTE_64, PAGE_LEVEL_WRITE_THROUGH, "page_level_write_through"),
+		PTE_ENTRY_FIELD(PDPTE_64, SUPERVISOR, "supervisor"),
+		PTE_ENTRY_FIELD(PDPTE_64, WRITE, "write"),
+		PTE_ENTRY_FIELD(PDPTE_64, PRESENT, "present"),
+	};
+};
+
+template <>
+struct EntryFields<pde_64>
+{
+	static constexpr std::array<EntryField, 13> Fields{
+		PTE_ENTRY_FIELD(PDE_64, EXECUTE_DISABLE, "execute_disable"),
+		PTE_ENTRY_FIELD(PDE_64, IGNORED_2, "ignored_2"),
+		PTE_RESERVED_FIELD("reserved2", 48, 4),
+		PTE_ENTRY_FIELD_HEX(PDE_64, PAGE_FRAME_NUMBER, "page_frame_number"),
+		PTE_ENTRY_FIELD(PDE_64, IGNORED_1, "ignored_1"),
+		PTE_ENTRY_FIELD(PDE_64, LARGE_PAGE, "large_page"),
+		PTE_RESERVED_FIELD("reserved1", 6, 1),
+		PTE_ENTRY_FIELD(PDE_64, ACCESSED, "accessed"),
+		PTE_ENTRY_FIELD(PDE_64, PAGE_LEVEL_CACHE_DISABLE, "page_level_cache_disable"),
+		PTE_ENTRY_FIELD(PDE_64, PAGE_LEVEL_WRITE_THROUGH, "page_level_write_through"),
+		PTE_ENTRY_FIELD(PDE_64, SUPERVISOR, "supervisor"),
+		PTE_ENTRY_FIELD(PDE_64, WRITE, "write"),
+		PTE_ENTRY_FIELD(PDE_64, PRESENT, "present"),
+	};
+};
+
+template <>
+struct EntryFields<pte_64>
+{
+	static constexpr std::array<EntryField, 15> Fields{
+		PTE_ENTRY_FIELD(PTE_64, EXECUTE_DISABLE, "execute_disable"),
+		PTE_ENTRY_FIELD(PTE_64, PROTECTION_KEY, "protection_key"),
+		PTE_ENTRY_FIELD(PTE_64, IGNORED_2, "ignored_2"),
+		PTE_RESERVED_FIELD("reserved1", 48, 4),
+		PTE_ENTRY_FIELD_HEX(PTE_64, PAGE_FRAME_NUMBER, "page_frame_number"),
+		PTE_ENTRY_FIELD(PTE_64, IGNORED_1, "ignored_1"),
+		PTE_ENTRY_FIELD(PTE_64, GLOBAL, "global"),
+		PTE_ENTRY_FIELD(PTE_64, PAT, "pat"),
+		PTE_ENTRY_FIELD(PTE_64, DIRTY, "dirty"),
+		PTE_ENTRY_FIELD(PTE_64, ACCESSED, "accessed"),
+		PTE_ENTRY_FIELD(PTE_64, PAGE_LEVEL_CACHE_DISABLE, "page_level_cache_disable"),
+		PTE_ENTRY_FIELD(PTE_64, PAGE_LEVEL_WRITE_THROUGH, "page_level_write_through"),
+		PTE_ENTRY_FIELD(PTE_64, SUPERVISOR, "supervisor"),
+		PTE_ENTRY_FIELD(PTE_64, WRITE, "write"),
+		PTE_ENTRY_FIELD(PTE_64, PRESENT, "present"),
+	};
+};
+
+template <>
+struct EntryFields<cr0>
+{
+	static constexpr std::array<EntryField, 15> Fields{
+		PTE_RESERVED_FIELD("reserved4", 32, 32),
+		PTE_ENTRY_FIELD(CR0, PAGING_ENABLE, "paging_enable"),
+		PTE_ENTRY_FIELD(CR0, CACHE_DISABLE, "cache_disable"),
+		PTE_ENTRY_FIELD(CR0, NOT_WRITE_THROUGH, "not_write_through"),
+		PTE_RESERVED_FIELD("reserved3", 19, 10),
+		PTE_ENTRY_FIELD(CR0, ALIGNMENT_MASK, "alignment_mask"),
+		PTE_RESERVED_FIELD("reserved2", 17, 1),
+		PTE_ENTRY_FIELD(CR0, WRITE_PROTECT, "write_protect"),
+		PTE_RESERVED_FIELD("reserved1", 6, 10),
+		PTE_ENTRY_FIELD(CR0, NUMERIC_ERROR, "numeric_error"),
+		PTE_ENTRY_FIELD(CR0, EXTENSION_TYPE, "extension_type"),
+		PTE_ENTRY_FIELD(CR0, TASK_SWITCHED, "task_switched"),
+		PTE_ENTRY_FIELD(CR0, EMULATE_FPU, "emulate_fpu"),
+		PTE_ENTRY_FIELD(CR0, MONITOR_COPROCESSOR, "monitor_coprocessor"),
+		PTE_ENTRY_FIELD(CR0, PROTECTION_ENABLE, "protection_enable"),
+	};
+};
+
+template <>
+struct EntryFields<cr3>
+{
+	static constexpr std::array<EntryField, 6> Fields{
+		PTE_RESERVED_FIELD("reserved3", 48, 16),
+		PTE_ENTRY_FIELD_HEX(CR3, ADDRESS_OF_PAGE_DIRECTORY, "address_of_page_directory"),
+		PTE_RESERVED_FIELD("reserved2", 5, 7),
+		PTE_ENTRY_FIELD(CR3, PAGE_LEVEL_CACHE_DISABLE, "page_level_cache_disable"),
+		PTE_ENTRY_FIELD(CR3, PAGE_LEVEL_WRITE_THROUGH, "page_level_write_through"),
+		PTE_RESERVED_FIELD("reserved1", 0, 3),
+	};
+};
+
+#undef PTE_ENTRY_FIELD
+#undef PTE_ENTRY_FIELD_HEX
+#undef PTE_RESERVED_FIELD
+
+static_assert(sizeof(pml4e_64) == sizeof(uint64_t) && IsLayoutValid(EntryFields<pml4e_64>::Fields));
+static_assert(sizeof(pdpte_64) == sizeof(uint64_t) && IsLayoutValid(EntryFields<pdpte_64>::Fields));
+static_assert(sizeof(pde_64) == sizeof(uint64_t) && IsLayoutValid(EntryFields<pde_64>::Fields));
+static_assert(sizeof(pte_64) == sizeof(uint64_t) && IsLayoutValid(EntryFields<pte_64>::Fields));
+static_assert(sizeof(cr0) == sizeof(uint64_t) && IsLayoutValid(EntryFields<cr0>::Fields));
+static_assert(sizeof(cr3) == sizeof(uint64_t) && IsLayoutValid(EntryFields<cr3>::Fields));
+
+/// <summary>
+/// Call the function for every field of the entry, from the highest bit down.
+/// </summary>
+/// <typeparam name="T">ia32.hpp entry type</typeparam>
+/// <param name="value">Raw entry</param>
+/// <param name="func">Callable taking const EntryField& and the field value</param>
+template <typename T, typename F>
+constexpr void ForEachField(uint64_t value, F&& func)
+{
+	for (const auto& field : EntryFields<T>::Fields)
+	{
+		func(field, field.Get(value));
+	}
+}
+
+} //namespace PTE
@@ -0,0 +1,368 @@
+/*
+    hex_dump.cpp
+
+    Formatting of the memory content as a hex dump.
+    The bytes are converted to hex digits 16 (SSSE3) or 32 (AVX2) at a time
+    with a nibble lookup done by the byte shuffle instruction.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "hex_dump.h"
+#include "cpu_features.h"
+#include <cstring>
+#include <immintrin.h>
+
+namespace
+{
+
+const char s_hexLower[] = "0123456789abcdef";
+const char s_hexUpper[] = "0123456789ABCDEF";
+
+//
+// Address columns are at least 12 digits wide, the SIMD path handles exactly 12.
+constexpr size_t AddressDigits = 12;
+constexpr uint64_t AddressLimit = 1ull << (AddressDigits * 4);
+
+//
+// "0x" + 16 digits + " -> " + "0x" + 16 digits + " : " + 16 * "XX " + " " + 16 ASCII + "\n"
+constexpr size_t MaxLineSize = 2 + 16 + 4 + 2 + 16 + 3 + 3 * PTE::HexDump::BytesPerLine + 1 + PTE::HexDump::BytesPerLine + 1;
+
+//
+// Byte shuffle masks which spread 16 "HL" digit pairs into 48 "HL " characters.
+// -128 produces zero, the spaces are added afterwards.
+alignas(16) const int8_t s_spreadLo0[16] = { 0, 1, -128, 2, 3, -128, 4, 5, -128, 6, 7, -128, 8, 9, -128, 10 };
+alignas(16) const int8_t s_spreadLo1[16] = { 11, -128, 12, 13, -128, 14, 15, -128, -128, -128, -128, -128, -128, -128, -128, -128 };
+alignas(16) const int8_t s_spreadHi1[16] = { -128, -128, -128, -128, -128, -128, -128, -128, 0, 1, -128, 2, 3, -128, 4, 5 };
+alignas(16) const int8_t s_spreadHi2[16] = { -128, 6, 7, -128, 8, 9, -128, 10, 11, -128, 12, 13, -128, 14, 15, -128 };
+alignas(16) const int8_t s_spaces0[16] = { 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0 };
+alignas(16) const int8_t s_spaces1[16] = { 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0 };
+alignas(16) const int8_t s_spaces2[16] = { ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ' };
+
+//
+// Reorders the digit pairs of a little endian 64-bit value into "0x" + the low 12 digits.
+alignas(16) const int8_t s_addressOrder[16] = { -128, -128, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1, -128, -128 };
+alignas(16) const int8_t s_addressPrefix[16] = { '0', 'x', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+/// <summary>
+/// Write the address as "0x" and at least 12 lowercase hex digits.
+/// </summary>
+/// <param name="out">Output position</param>
+/// <param name="value">The address</param>
+/// <returns>Position after the address</returns>
+char* WriteAddress(char* out, uint64_t value)
+{
+    size_t digits = AddressDigits;
+    while (digits < 16 && (value >> (digits * 4)) != 0)
+    {
+        ++digits;
+    }
+
+    *out++ = '0';
+    *out++ = 'x';
+    for (size_t i = digits; i > 0; --i)
+    {
+        out[i - 1] = s_hexLower[value & 0x0F];
+        value >>= 4;
+    }
+
+    return out + digits;
+}
+
+/// <summary>
+/// Write the line prefix with both addresses.
+/// </summary>
+/// <param name="out">Output position</param>
+/// <param name="virt">Virtual address</param>
+/// <param name="phys">Physical address</param>
+/// <returns>Position after the prefix</returns>
+char* WritePrefix(char* out, uint64_t virt, uint64_t phys)
+{
+    out = WriteAddress(out, virt);
+    memcpy(out, " -> ", 4);
+    out = WriteAddress(out + 4, phys);
+    memcpy(out, " : ", 3);
+
+    return out + 3;
+}
+
+/// <summary>
+/// Format the line byte by byte.
+/// </summary>
+/// <param name="out">Output position</param>
+/// <param name="data">The bytes</param>
+/// <param name="len">Number of bytes, the ASCII column is only added for the full line</param>
+/// <returns>Position after the line</returns>
+char* WriteBytesScalar(char* out, const uint8_t* data, size_t len)
+{
+    for (size_t i = 0; i < len; ++i)
+    {
+        out[0] = s_hexUpper[data[i] >> 4];
+        out[1] = s_hexUpper[data[i] & 0x0F];
+        out[2] = ' ';
+        out += 3;
+    }
+
+    if (len != PTE::HexDump::BytesPerLine)
+    {
+        return out;
+    }
+
+    *out++ = ' ';
+    for (size_t i = 0; i < len; ++i)
+    {
+        *out++ = data[i] < 0x20 ? '.' : static_cast<char>(data[i]);
+    }
+    *out++ = '\n';
+
+    return out;
+}
+
+/// <summary>
+/// Reference implementation.
+/// </summary>
+size_t FormatScalar(uint64_t virt, uint64_t phys, const uint8_t* data, size_t len, char* out)
+{
+    char* pos = out;
+
+    for (size_t i = 0; i < len; i += PTE::HexDump::BytesPerLine)
+    {
+        size_t count = len - i < PTE::HexDump::BytesPerLine ? len - i : PTE::HexDump::BytesPerLine;
+
+        pos = WritePrefix(pos, virt + i, phys + i);
+        pos = WriteBytesScalar(pos, data + i, count);
+    }
+
+    return pos - out;
+}
+
+/// <summary>
+/// Convert every byte into two hex digits.
+/// </summary>
+/// <param name="v">16 bytes</param>
+/// <param name="table">16 digit characters</param>
+/// <param name="pairsLo">Digits of the bytes 0..7, high nibble first</param>
+/// <param name="pairsHi">Digits of the bytes 8..15, high nibble first</param>
+PTE_TARGET_SSSE3 inline void ToHexPairs(__m128i v, __m128i table, __m128i& pairsLo, __m128i& pairsHi)
+{
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i hi = _mm_shuffle_epi8(table, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+    const __m128i lo = _mm_shuffle_epi8(table, _mm_and_si128(v, nibble));
+
+    pairsLo = _mm_unpacklo_epi8(hi, lo);
+    pairsHi = _mm_unpackhi_epi8(hi, lo);
+}
+
+/// <summary>
+/// Write the address as "0x" and 12 lowercase hex digits.
+/// Stores 16 bytes, the last 2 of them are overwritten by the caller.
+/// </summary>
+PTE_TARGET_SSSE3 inline char* WriteAddressSsse3(char* out, uint64_t value)
+{
+    const __m128i table = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s_hexLower));
+    __m128i pairsLo, pairsHi;
+
+    ToHexPairs(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&value)), table, pairsLo, pairsHi);
+
+    const __m128i digits = _mm_or_si128(
+        _mm_shuffle_epi8(pairsLo, _mm_load_si128(reinterpret_cast<const __m128i*>(s_addressOrder))),
+        _mm_load_si128(reinterpret_cast<const __m128i*>(s_addressPrefix)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), digits);
+
+    return out + 2 + AddressDigits;
+}
+
+/// <summary>
+/// Write the line prefix, using the shuffle when both addresses are 12 digits long.
+/// </summary>
+PTE_TARGET_SSSE3 inline char* WritePrefixSsse3(char* out, uint64_t virt, uint64_t phys)
+{
+    if (virt >= AddressLimit || phys >= AddressLimit)
+    {
+        return WritePrefix(out, virt, phys);
+    }
+
+    out = WriteAddressSsse3(out, virt);
+    memcpy(out, " -> ", 4);
+    out = WriteAddressSsse3(out + 4, phys);
+    memcpy(out, " : ", 3);
+
+    return out + 3;
+}
+
+/// <summary>
+/// Spread the digit pairs into 48 "HL " characters.
+/// </summary>
+PTE_TARGET_SSSE3 inline void SpreadPairs(__m128i pairsLo, __m128i pairsHi, __m128i& c0, __m128i& c1, __m128i& c2)
+{
+    c0 = _mm_or_si128(_mm_shuffle_epi8(pairsLo, _mm_load_si128(reinterpret_cast<const __m128i*>(s_spreadLo0))),
+        _mm_load_si128(reinterpret_cast<const __m128i*>(s_spaces0)));
+    c1 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(pairsLo, _mm_load_si128(reinterpret_cast<const __m128i*>(s_spreadLo1))),
+        _mm_shuffle_epi8(pairsHi, _mm_load_si128(reinterpret_cast<const __m128i*>(s_spreadHi1)))),
+        _mm_load_si128(reinterpret_cast<const __m128i*>(s_spaces1)));
+    c2 = _mm_or_si128(_mm_shuffle_epi8(pairsHi, _mm_load_si128(reinterpret_cast<const __m128i*>(s_spreadHi2))),
+        _mm_load_si128(reinterpret_cast<const __m128i*>(s_spaces2)));
+}
+
+/// <summary>
+/// Replace the control characters with dots.
+/// </summary>
+PTE_TARGET_SSSE3 inline __m128i ToAscii(__m128i v)
+{
+    const __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1F)), v);
+
+    return _mm_or_si128(_mm_and_si128(control, _mm_set1_epi8('.')), _mm_andnot_si128(control, v));
+}
+
+/// <summary>
+/// Write the hex and the ASCII columns of a full line.
+/// </summary>
+PTE_TARGET_SSSE3 inline char* WriteColumnsSsse3(char* out, __m128i c0, __m128i c1, __m128i c2, __m128i ascii)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), c0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16), c1);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 32), c2);
+    out[48] = ' ';
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 49), ascii);
+    out[65] = '\n';
+
+    return out + 66;
+}
+
+/// <summary>
+/// SSSE3 implementation, a line per iteration.
+/// </summary>
+PTE_TARGET_SSSE3 size_t FormatSsse3(uint64_t virt, uint64_t phys, const uint8_t* data, size_t len, char* out)
+{
+    const __m128i table = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s_hexUpper));
+    const size_t full = len - len % PTE::HexDump::BytesPerLine;
+    char* pos = out;
+
+    for (size_t i = 0; i < full; i += PTE::HexDump::BytesPerLine)
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i pairsLo, pairsHi, c0, c1, c2;
+
+        ToHexPairs(v, table, pairsLo, pairsHi);
+        SpreadPairs(pairsLo, pairsHi, c0, c1, c2);
+
+        pos = WritePrefixSsse3(pos, virt + i, phys + i);
+        pos = WriteColumnsSsse3(pos, c0, c1, c2, ToAscii(v));
+    }
+
+    return (pos - out) + FormatScalar(virt + full, phys + full, data + full, len - full, pos);
+}
+
+/// <summary>
+/// AVX2 implementation, two lines per iteration, one in each 128-bit lane.
+/// </summary>
+PTE_TARGET_AVX2 size_t FormatAvx2(uint64_t virt, uint64_t phys, const uint8_t* data, size_t len, char* out)
+{
+    const size_t step = 2 * PTE::HexDump::BytesPerLine;
+    const size_t full = len - len % step;
+
+    const __m256i table = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s_hexUpper)));
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const __m256i spreadLo0 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(s_spreadLo0)));
+    const __m256i spreadLo1 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(s_spreadLo1)));
+    const __m256i spreadHi1 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(s_spreadHi1)));
+    const __m256i spreadHi2 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(s_spreadHi2)));
+    const __m256i spaces0 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(s_spaces0)));
+    const __m256i spaces1 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(s_spaces1)));
+    const __m256i spaces2 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(s_spaces2)));
+    const __m256i controlMax = _mm256_set1_epi8(0x1F);
+    const __m256i dots = _mm256_set1_epi8('.');
+
+    char* pos = out;
+
+    for (size_t i = 0; i < full; i += step)
+    {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        const __m256i hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+        const __m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(v, nibble));
+        const __m256i pairsLo = _mm256_unpacklo_epi8(hi, lo);
+        const __m256i pairsHi = _mm256_unpackhi_epi8(hi, lo);
+
+        const __m256i c0 = _mm256_or_si256(_mm256_shuffle_epi8(pairsLo, spreadLo0), spaces0);
+        const __m256i c1 = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(pairsLo, spreadLo1),
+            _mm256_shuffle_epi8(pairsHi, spreadHi1)), spaces1);
+        const __m256i c2 = _mm256_or_si256(_mm256_shuffle_epi8(pairsHi, spreadHi2), spaces2);
+
+        const __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(v, controlMax), v);
+        const __m256i ascii = _mm256_or_si256(_mm256_and_si256(control, dots), _mm256_andnot_si256(control, v));
+
+        pos = WritePrefixSsse3(pos, virt + i, phys + i);
+        pos = WriteColumnsSsse3(pos,
+            _mm256_castsi256_si128(c0),
+            _mm256_castsi256_si128(c1),
+            _mm256_castsi256_si128(c2),
+            _mm256_castsi256_si128(ascii));
+
+        pos = WritePrefixSsse3(pos, virt + i + PTE::HexDump::BytesPerLine, phys + i + PTE::HexDump::BytesPerLine);
+        pos = WriteColumnsSsse3(pos,
+            _mm256_extracti128_si256(c0, 1),
+            _mm256_extracti128_si256(c1, 1),
+            _mm256_extracti128_si256(c2, 1),
+            _mm256_extracti128_si256(ascii, 1));
+    }
+
+    return (pos - out) + FormatSsse3(virt + full, phys + full, data + full, len - full, pos);
+}
+
+} //namespace
+
+/// <summary>
+/// Get the buffer size enough to format the data.
+/// </summary>
+/// <param name="len">Data size</param>
+/// <returns>Buffer size</returns>
+size_t PTE::HexDump::MaxFormattedSize(size_t len)
+{
+    return (len + BytesPerLine - 1) / BytesPerLine * MaxLineSize;
+}
+
+/// <summary>
+/// Format the data into the buffer.
+/// </summary>
+/// <param name="virt">Virtual address of the first byte</param>
+/// <param name="phys">Physical address of the first byte</param>
+/// <param name="data">Data blob</param>
+/// <param name="len">The blob size</param>
+/// <param name="out">Buffer of at least MaxFormattedSize(len) bytes</param>
+/// <param name="impl">The implementation to use</param>
+/// <returns>Number of characters written</returns>
+size_t PTE::HexDump::Format(uint64_t virt, uint64_t phys, const uint8_t* data, size_t len, char* out, Impl impl)
+{
+    if (impl == Impl::Auto)
+    {
+        impl = CpuFeatures::HasAvx2() ? Impl::Avx2 : CpuFeatures::HasSsse3() ? Impl::Ssse3 : Impl::Scalar;
+    }
+
+    switch (impl)
+    {
+    case Impl::Avx2:
+        return FormatAvx2(virt, phys, data, len, out);
+    case Impl::Ssse3:
+        return FormatSsse3(virt, phys, data, len, out);
+    default:
+        return FormatScalar(virt, phys, data, len, out);
+    }
+}
+
+/// <summary>
+/// Format the data into a string.
+/// </summary>
+/// <param name="virt">Virtual address of the first byte</param>
+/// <param name="phys">Physical address of the first byte</param>
+/// <param name="data">Data blob</param>
+/// <param name="len">The blob size</param>
+/// <returns>The formatted data</returns>
+std::string PTE::HexDump::Format(uint64_t virt, uint64_t phys, const uint8_t* data, size_t len)
+{
+    std::string result(MaxFormattedSize(len), '\0');
+
+    result.resize(Format(virt, phys, data, len, result.data()));
+
+    return result;
+}
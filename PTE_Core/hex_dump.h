@@ -0,0 +1,43 @@
+/*
+	hex_dump.h
+
+	Formatting of the memory content as a hex dump.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace PTE
+{
+
+/// <summary>
+/// Hex dump formatter.
+/// Every line is "0x<virt> -> 0x<phys> : XX XX ... XX  <ascii>\n" for 16 bytes.
+/// The last partial line has no ASCII column.
+/// </summary>
+class HexDump
+{
+public:
+	//
+	// Formatter implementation, Auto picks the best one supported by the CPU.
+	enum class Impl
+	{
+		Auto,
+		Scalar,
+		Ssse3,
+		Avx2
+	};
+
+	static constexpr size_t BytesPerLine = 16;
+
+	static size_t MaxFormattedSize(size_t len);
+	static size_t Format(uint64_t virt, uint64_t phys, const uint8_t* data, size_t len, char* out, Impl impl = Impl::Auto);
+	static std::string Format(uint64_t virt, uint64_t phys, const uint8_t* data, size_t len);
+};
+
+} //namespace PTE
@@ -0,0 +1,279 @@
+/*
+    huge_pages.cpp
+
+    Search of the page tables which could be replaced by a 2MB page.
+    The first present entry of a table gives the expected 2MB frame and
+    the attributes, then every entry is compared against its expected
+    frame in one pass, four entries at a time with AVX2.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "huge_pages.h"
+#include "buffer_pool.h"
+#include "cpu_features.h"
+#include "utils.h"
+#include "ia32.hpp"
+#include <algorithm>
+#include <bit>
+#include <format>
+#include <fstream>
+#include <immintrin.h>
+
+namespace
+{
+
+constexpr uint64_t FrameMask = PTE_64_PAGE_FRAME_NUMBER_FLAG;
+constexpr uint64_t LargePageSize = PAGE_SIZE * TABLE_SIZE;
+
+static_assert(PTE::HugePages::AttributeMask == (PTE_64_WRITE_FLAG | PTE_64_SUPERVISOR_FLAG |
+    PTE_64_PAGE_LEVEL_WRITE_THROUGH_FLAG | PTE_64_PAGE_LEVEL_CACHE_DISABLE_FLAG | PTE_64_PAT_FLAG |
+    PTE_64_GLOBAL_FLAG | PTE_64_PROTECTION_KEY_FLAG | PTE_64_EXECUTE_DISABLE_FLAG));
+
+/// <summary>
+/// Present entries of a table compared with the large page they could form.
+/// </summary>
+struct TableCounts
+{
+    uint32_t matching{ 0 };
+    uint32_t mismatching{ 0 };
+    uint32_t accessed{ 0 };
+};
+
+/// <summary>
+/// Reference implementation.
+/// </summary>
+TableCounts CountScalar(const uint64_t* entries, uint64_t base, uint64_t attributes)
+{
+    TableCounts counts;
+
+    for (size_t i = 0; i < TABLE_SIZE; ++i)
+    {
+        const uint64_t entry = entries[i];
+        if ((entry & PTE_64_PRESENT_FLAG) == 0)
+        {
+            continue;
+        }
+
+        if ((entry & FrameMask) == base + i * PAGE_SIZE &&
+            (entry & PTE::HugePages::AttributeMask) == attributes)
+        {
+            ++counts.matching;
+            counts.accessed += (entry & PTE_64_ACCESSED_FLAG) != 0;
+        }
+        else
+        {
+            ++counts.mismatching;
+        }
+    }
+
+    return counts;
+}
+
+/// <summary>
+/// AVX2 implementation, the expected frames of four entries are advanced together.
+/// </summary>
+PTE_TARGET_AVX2 TableCounts CountAvx2(const uint64_t* entries, uint64_t base, uint64_t attributes)
+{
+    const __m256i presentFlag = _mm256_set1_epi64x(PTE_64_PRESENT_FLAG);
+    const __m256i accessedFlag = _mm256_set1_epi64x(PTE_64_ACCESSED_FLAG);
+    const __m256i frameMask = _mm256_set1_epi64x(FrameMask);
+    const __m256i attributeMask = _mm256_set1_epi64x(PTE::HugePages::AttributeMask);
+    const __m256i expectedAttributes = _mm256_set1_epi64x(attributes);
+    const __m256i step = _mm256_set1_epi64x(4 * PAGE_SIZE);
+    __m256i expected = _mm256_add_epi64(_mm256_set1_epi64x(base), _mm256_setr_epi64x(0, PAGE_SIZE, 2 * PAGE_SIZE, 3 * PAGE_SIZE));
+
+    TableCounts counts;
+
+    for (size_t i = 0; i < TABLE_SIZE; i += 4)
+    {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(entries + i));
+
+        const __m256i present = _mm256_cmpeq_epi64(_mm256_and_si256(v, presentFlag), presentFlag);
+        const __m256i match = _mm256_and_si256(
+            _mm256_cmpeq_epi64(_mm256_and_si256(v, frameMask), expected),
+            _mm256_cmpeq_epi64(_mm256_and_si256(v, attributeMask), expectedAttributes));
+        const __m256i accessed = _mm256_cmpeq_epi64(_mm256_and_si256(v, accessedFlag), accessedFlag);
+
+        const unsigned int presentBits = _mm256_movemask_pd(_mm256_castsi256_pd(present));
+        const unsigned int matchBits = _mm256_movemask_pd(_mm256_castsi256_pd(match)) & presentBits;
+        const unsigned int accessedBits = _mm256_movemask_pd(_mm256_castsi256_pd(accessed)) & matchBits;
+
+        counts.matching += std::popcount(matchBits);
+        counts.mismatching += std::popcount(presentBits & ~matchBits);
+        counts.accessed += std::popcount(accessedBits);
+
+        expected = _mm256_add_epi64(expected, step);
+    }
+
+    return counts;
+}
+
+} //namespace
+
+/// <summary>
+/// Estimate the TLB entries saved by the promotion:
+/// the accessed 4KB pages are replaced by a single 2MB entry.
+/// </summary>
+uint32_t PTE::PromotionCandidate::TlbSavings() const
+{
+    return Accessed > 1 ? Accessed - 1 : 0;
+}
+
+/// <summary>
+/// Check if a page table maps its range to a single 2MB frame.
+/// </summary>
+/// <param name="table">A table of the PT level</param>
+/// <param name="candidate">Filled if the table is a candidate</param>
+/// <param name="minPresent">Present entries needed</param>
+/// <param name="impl">The implementation to use</param>
+/// <returns>True if at least minPresent entries are present and all of them map the frames of a 2MB aligned frame in order</returns>
+bool PTE::HugePages::CheckTable(const TABLE_PAGE& table, PromotionCandidate& candidate, uint32_t minPresent, Impl impl)
+{
+    //
+    // The first present entry tells where the 2MB frame should be.
+    size_t first = 0;
+    while (first < TABLE_SIZE && (table.entries[first] & PTE_64_PRESENT_FLAG) == 0)
+    {
+        ++first;
+    }
+    if (first == TABLE_SIZE)
+    {
+        return false;
+    }
+
+    const uint64_t frame = table.entries[first] & FrameMask;
+    if (frame < first * PAGE_SIZE || ((frame - first * PAGE_SIZE) & (LargePageSize - 1)) != 0)
+    {
+        return false;
+    }
+
+    const uint64_t base = frame - first * PAGE_SIZE;
+    const uint64_t attributes = table.entries[first] & AttributeMask;
+
+    if (impl == Impl::Auto)
+    {
+        impl = CpuFeatures::HasAvx2() ? Impl::Avx2 : Impl::Scalar;
+    }
+
+    const TableCounts counts = impl == Impl::Avx2 ?
+        CountAvx2(table.entries, base, attributes) :
+        CountScalar(table.entries, base, attributes);
+    if (counts.mismatching != 0 || counts.matching < minPresent)
+    {
+        return false;
+    }
+
+    candidate = { .VA = table.baseVA,
+        .PA = base,
+        .Present = counts.matching,
+        .Missing = static_cast<uint32_t>(TABLE_SIZE - counts.matching),
+        .Accessed = counts.accessed,
+        .Attributes = attributes };
+
+    return true;
+}
+
+/// <summary>
+/// Find the promotable page tables of the snapshot.
+/// </summary>
+/// <param name="tables">Page tables of a process</param>
+/// <param name="minPresent">Present entries a table needs</param>
+/// <param name="impl">The implementation to use</param>
+/// <returns>The candidates, the biggest TLB savings first</returns>
+std::vector<PTE::PromotionCandidate> PTE::HugePages::Find(const PageTables& tables, uint32_t minPresent, Impl impl)
+{
+    std::vector<PromotionCandidate> candidates;
+    PromotionCandidate candidate;
+
+    for (const auto& table : tables.Tables)
+    {
+        if (table.level == TABLE_LEVEL_PT && CheckTable(table, candidate, minPresent, impl))
+        {
+            candidates.push_back(candidate);
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](const PromotionCandidate& left, const PromotionCandidate& right)
+        {
+            if (left.TlbSavings() != right.TlbSavings())
+            {
+                return left.TlbSavings() > right.TlbSavings();
+            }
+            return left.Missing < right.Missing;
+        });
+
+    return candidates;
+}
+
+/// <summary>
+/// Find the promotable page tables of the process.
+/// </summary>
+/// <param name="pid">Process id</param>
+/// <param name="candidates">The candidates, the biggest TLB savings first</param>
+/// <param name="minPresent">Present entries a table needs</param>
+/// <returns>Win32 error code, 0 on success</returns>
+unsigned long PTE::HugePages::Run(ULONG pid, std::vector<PromotionCandidate>& candidates, uint32_t minPresent)
+{
+    candidates.clear();
+
+    HANDLE device = Utils::OpenDevice();
+    if (device == INVALID_HANDLE_VALUE)
+    {
+        return GetLastError();
+    }
+
+    unsigned long err = ERROR_NOT_ENOUGH_MEMORY;
+    BufferPool<IOCTL_ENUM_DATA>::Lease buffer = BufferPool<IOCTL_ENUM_DATA>::Acquire();
+    if (buffer)
+    {
+        PageTables tables;
+        err = Utils::ReadPageTables(device, pid, buffer.Get(), tables);
+        if (err == ERROR_SUCCESS)
+        {
+            candidates = Find(tables, minPresent);
+        }
+    }
+
+    CloseHandle(device);
+
+    return err;
+}
+
+/// <summary>
+/// Write the report as CSV, a line per candidate.
+/// </summary>
+/// <param name="path">Report path</param>
+/// <param name="pid">Process id</param>
+/// <param name="candidates">The candidates</param>
+/// <returns>True on success</returns>
+bool PTE::HugePages::WriteReport(const std::wstring& path, ULONG pid, const std::vector<PromotionCandidate>& candidates)
+{
+    std::ofstream report(path, std::ios::out | std::ios::trunc);
+    if (!report)
+    {
+        return false;
+    }
+
+    report << "va,pa,present,missing,accessed,tlb_savings,attributes\n";
+
+    size_t ready{ 0 };
+    for (const auto& candidate : candidates)
+    {
+        report << std::format("0x{:x},0x{:x},{},{},{},{},0x{:x}\n",
+            candidate.VA,
+            candidate.PA,
+            candidate.Present,
+            candidate.Missing,
+            candidate.Accessed,
+            candidate.TlbSavings(),
+            candidate.Attributes);
+
+        ready += candidate.Missing == 0;
+    }
+
+    report << std::format("# pid {}: {} candidates, {} promotable without faulting in\n", pid, candidates.size(), ready);
+
+    return static_cast<bool>(report);
+}
@@ -0,0 +1,83 @@
+/*
+	huge_pages.h
+
+	Search of the page tables which could be replaced by a 2MB page.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "include.h"
+#include "page_tables.h"
+
+namespace PTE
+{
+
+/// <summary>
+/// A page table mapping a 2MB aligned range to 2MB aligned contiguous frames.
+/// </summary>
+struct PromotionCandidate
+{
+	uint64_t VA{ 0 };
+
+	//
+	// The 2MB frame the present entries point into
+	uint64_t PA{ 0 };
+
+	//
+	// Present entries, all of them at their place in the 2MB frame
+	uint32_t Present{ 0 };
+
+	//
+	// Entries to fault in before the table can be promoted
+	uint32_t Missing{ 0 };
+
+	//
+	// Present entries with the accessed flag
+	uint32_t Accessed{ 0 };
+
+	//
+	// Permission and cache bits shared by all the present entries
+	uint64_t Attributes{ 0 };
+
+	uint32_t TlbSavings() const;
+};
+
+/// <summary>
+/// Checks the page tables in a single vector pass per table.
+/// </summary>
+class HugePages
+{
+public:
+	//
+	// Implementation, Auto picks the best one supported by the CPU.
+	enum class Impl
+	{
+		Auto,
+		Scalar,
+		Avx2
+	};
+
+	//
+	// Entry bits which must match to map the range with a single entry:
+	// RW, US, PWT, PCD, PAT, G, protection key and XD.
+	static constexpr uint64_t AttributeMask = 0xF80000000000019Eull;
+
+	//
+	// Present entries a table needs to be a candidate. A nearly empty table
+	// would be promoted by faulting in most of the 2MB, so half of it must be there.
+	static constexpr uint32_t DefaultMinPresent = TABLE_SIZE / 2;
+
+	static bool CheckTable(const TABLE_PAGE& table, PromotionCandidate& candidate,
+		uint32_t minPresent = DefaultMinPresent, Impl impl = Impl::Auto);
+	static std::vector<PromotionCandidate> Find(const PageTables& tables,
+		uint32_t minPresent = DefaultMinPresent, Impl impl = Impl::Auto);
+	static unsigned long Run(ULONG pid, std::vector<PromotionCandidate>& candidates, uint32_t minPresent = DefaultMinPresent);
+	static bool WriteReport(const std::wstring& path, ULONG pid, const std::vector<PromotionCandidate>& candidates);
+};
+
+} //namespace PTE
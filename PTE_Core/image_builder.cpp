@@ -0,0 +1,301 @@
+/*
+    image_builder.cpp
+
+    Construction of synthetic physical memory images holding page tables.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "image_builder.h"
+#include "ia32.hpp"
+
+namespace
+{
+
+//
+// Size of the memory covered by a single entry for each level.
+constexpr ULONG s_levelShift[TABLE_LEVEL_COUNT] = { 39, 30, 21, 12 };
+
+} //namespace
+
+/// <summary>
+/// Create the image in zeroed memory, the pages take memory as the tables are written.
+/// </summary>
+/// <param name="size">Size of the physical memory, rounded down to the pages</param>
+PTE::ImageBuilder::ImageBuilder(uint64_t size)
+{
+    ImageMemory memory;
+    if (memory.Allocate(size & ~static_cast<uint64_t>(PAGE_SIZE - 1)) == ERROR_SUCCESS)
+    {
+        *this = ImageBuilder(std::move(memory));
+    }
+}
+
+/// <summary>
+/// Create the image in zeroed memory, e.g. a mapped sparse file.
+/// An empty memory makes every allocation fail.
+/// </summary>
+/// <param name="memory">The memory of the image</param>
+PTE::ImageBuilder::ImageBuilder(ImageMemory&& memory) :
+    m_memory(std::move(memory)),
+    m_used((m_memory.Size() / PAGE_SIZE + 63) / 64)
+{
+    if (!m_used.empty())
+    {
+        MarkUsed(0, 1);
+        m_usedFrames = 0;
+    }
+}
+
+/// <summary>
+/// Take a free frame.
+/// </summary>
+/// <param name="hint">Physical address to look from, 0 for the next frame in order</param>
+/// <returns>Physical address of the zeroed frame or 0 if the image is full</returns>
+uint64_t PTE::ImageBuilder::AllocateFrame(uint64_t hint)
+{
+    return AllocateFrames(PAGE_SIZE, PAGE_SIZE, hint);
+}
+
+/// <summary>
+/// Take contiguous free frames, e.g. for a large page.
+/// </summary>
+/// <param name="size">Size of the memory, rounded up to the pages</param>
+/// <param name="alignment">Alignment, a power of two, 2MB or 1GB for the large pages</param>
+/// <param name="hint">Physical address to look from, 0 for the next frames in order.
+/// The search wraps around, so the hinted allocations scatter the frames over the image.</param>
+/// <returns>Physical address of the zeroed memory or 0 if the image is full</returns>
+uint64_t PTE::ImageBuilder::AllocateFrames(uint64_t size, uint64_t alignment, uint64_t hint)
+{
+    const uint64_t count = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    const uint64_t step = alignment > PAGE_SIZE ? alignment / PAGE_SIZE : 1;
+    const uint64_t frames = m_memory.Size() / PAGE_SIZE;
+    if (count == 0 || count > frames)
+    {
+        return 0;
+    }
+
+    const uint64_t start = ((hint != 0 ? hint / PAGE_SIZE : m_next) + step - 1) / step * step;
+
+    uint64_t frame = FindFree(start, frames, count, step);
+    if (frame == 0)
+    {
+        frame = FindFree(step, start + count - 1, count, step);
+    }
+    if (frame == 0)
+    {
+        return 0;
+    }
+
+    MarkUsed(frame, count);
+    if (hint == 0)
+    {
+        m_next = frame + count;
+    }
+
+    return frame * PAGE_SIZE;
+}
+
+/// <summary>
+/// Create an empty PML4.
+/// </summary>
+/// <param name="hint">Physical address to look for the frame from, 0 for the next frame</param>
+/// <returns>CR3 of the new address space or 0 if the image is full</returns>
+uint64_t PTE::ImageBuilder::CreateRoot(uint64_t hint)
+{
+    cr3 cr3{ };
+    cr3.address_of_page_directory = AllocateFrame(hint) >> 12;
+
+    return cr3.flags;
+}
+
+/// <summary>
+/// Map a page, creating the missing tables on the way.
+/// </summary>
+/// <param name="cr3">CR3 of the address space</param>
+/// <param name="va">Virtual address, aligned to the page size</param>
+/// <param name="pa">Physical address, aligned to the page size</param>
+/// <param name="pageSize">4KB, 2MB or 1GB</param>
+/// <param name="flags">Flags of the leaf entry</param>
+/// <param name="tableHint">Physical address to look for the new tables from, 0 for the next frames</param>
+/// <returns>False if the image is full or a large page is in the way</returns>
+bool PTE::ImageBuilder::Map(uint64_t cr3, uint64_t va, uint64_t pa, uint64_t pageSize, uint64_t flags, uint64_t tableHint)
+{
+    const ULONG leafLevel = pageSize == (1ull << 30) ? TABLE_LEVEL_PDP : pageSize == (1ull << 21) ? TABLE_LEVEL_PD : TABLE_LEVEL_PT;
+
+    uint64_t* table = Table(CR3_ADDRESS_OF_PAGE_DIRECTORY(cr3) << 12);
+    for (ULONG level = TABLE_LEVEL_PML4; level < leafLevel; ++level)
+    {
+        if (table == nullptr)
+        {
+            return false;
+        }
+
+        uint64_t& entry = table[(va >> s_levelShift[level]) % TABLE_SIZE];
+        if (!PDE_64_PRESENT(entry))
+        {
+            //
+            // The upper levels allow everything, the leaf decides.
+            pde_64 next{ };
+            next.present = 1;
+            next.write = 1;
+            next.supervisor = 1;
+            next.page_frame_number = AllocateFrame(tableHint) >> 12;
+            if (next.page_frame_number == 0)
+            {
+                return false;
+            }
+
+            entry = next.flags;
+        }
+        else if (level != TABLE_LEVEL_PML4 && PDE_64_LARGE_PAGE(entry))
+        {
+            return false;
+        }
+
+        table = Table(PDE_64_PAGE_FRAME_NUMBER(entry) << 12);
+    }
+
+    if (table == nullptr)
+    {
+        return false;
+    }
+
+    uint64_t& entry = table[(va >> s_levelShift[leafLevel]) % TABLE_SIZE];
+    switch (leafLevel)
+    {
+    case TABLE_LEVEL_PDP:
+    {
+        pdpte_1gb_64 leaf{ };
+        leaf.flags = flags;
+        leaf.present = 1;
+        leaf.large_page = 1;
+        leaf.page_frame_number = pa >> 30;
+        entry = leaf.flags;
+        break;
+    }
+    case TABLE_LEVEL_PD:
+    {
+        pde_2mb_64 leaf{ };
+        leaf.flags = flags;
+        leaf.present = 1;
+        leaf.large_page = 1;
+        leaf.page_frame_number = pa >> 21;
+        entry = leaf.flags;
+        break;
+    }
+    default:
+    {
+        pte_64 leaf{ };
+        leaf.flags = flags;
+        leaf.present = 1;
+        leaf.page_frame_number = pa >> 12;
+        entry = leaf.flags;
+        break;
+    }
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Write a raw entry, e.g. a self-map entry or a table shared with another address space.
+/// </summary>
+/// <param name="tablePA">Physical address of the table</param>
+/// <param name="index">Index of the entry</param>
+/// <param name="entry">Value of the entry</param>
+/// <returns>False if the table is outside the image</returns>
+bool PTE::ImageBuilder::SetEntry(uint64_t tablePA, size_t index, uint64_t entry)
+{
+    uint64_t* table = Table(tablePA);
+    if (table == nullptr || index >= TABLE_SIZE)
+    {
+        return false;
+    }
+
+    table[index] = entry;
+
+    return true;
+}
+
+/// <summary>
+/// The table at the physical address.
+/// </summary>
+/// <returns>The entries or nullptr if the table is outside the image</returns>
+uint64_t* PTE::ImageBuilder::Table(uint64_t pa)
+{
+    pa &= ~static_cast<uint64_t>(PAGE_SIZE - 1);
+    return m_memory.Size() >= PAGE_SIZE && pa <= m_memory.Size() - PAGE_SIZE ? reinterpret_cast<uint64_t*>(m_memory.Data() + pa) : nullptr;
+}
+
+/// <summary>
+/// Check if all the frames of a run are free.
+/// </summary>
+bool PTE::ImageBuilder::IsFree(uint64_t frame, uint64_t count) const
+{
+    for (uint64_t i = frame; i < frame + count; ++i)
+    {
+        //
+        // Whole words at once for the large pages.
+        if (i % 64 == 0 && i + 64 <= frame + count)
+        {
+            if (m_used[i / 64] != 0)
+            {
+                return false;
+            }
+            i += 63;
+            continue;
+        }
+
+        if (m_used[i / 64] & (1ull << (i % 64)))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Mark the frames of a run as used.
+/// </summary>
+void PTE::ImageBuilder::MarkUsed(uint64_t frame, uint64_t count)
+{
+    for (uint64_t i = frame; i < frame + count; ++i)
+    {
+        m_used[i / 64] |= 1ull << (i % 64);
+    }
+
+    m_usedFrames += count;
+}
+
+/// <summary>
+/// Find the first free run of frames starting at a multiple of the step.
+/// </summary>
+/// <param name="first">The first frame to check, a multiple of the step</param>
+/// <param name="end">The runs start before this frame</param>
+/// <param name="count">Number of the frames</param>
+/// <param name="step">Alignment of the run in frames</param>
+/// <returns>The first frame of the run or 0 if there is none</returns>
+uint64_t PTE::ImageBuilder::FindFree(uint64_t first, uint64_t end, uint64_t count, uint64_t step) const
+{
+    const uint64_t frames = m_memory.Size() / PAGE_SIZE;
+    for (uint64_t frame = first; frame < end && frame + count <= frames; frame += step)
+    {
+        //
+        // Skip the fully used words in a single step when looking for single frames.
+        if (step == 1 && frame % 64 == 0 && m_used[frame / 64] == ~0ull)
+        {
+            frame += 63;
+            continue;
+        }
+
+        if (IsFree(frame, count))
+        {
+            return frame;
+        }
+    }
+
+    return 0;
+}
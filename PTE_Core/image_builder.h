@@ -0,0 +1,76 @@
+/*
+	image_builder.h
+
+	Construction of synthetic physical memory images holding page tables,
+	for the benchmarks and for checking the walkers against known translations.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "image_memory.h"
+#include "phys_walk.h"
+
+namespace PTE
+{
+
+/// <summary>
+/// Builds the paging structures of one or more address spaces in a zeroed image.
+/// The frames are handed out in order unless a hint says otherwise,
+/// so the same calls build the same image.
+/// </summary>
+class ImageBuilder
+{
+public:
+	//
+	// Flags of the leaf entries, the present and page size bits are set by Map.
+	static constexpr uint64_t Writable = 0x2;
+	static constexpr uint64_t User = 0x4;
+	static constexpr uint64_t NoExecute = 0x8000000000000000ull;
+
+	explicit ImageBuilder(uint64_t size);
+	explicit ImageBuilder(ImageMemory&& memory);
+
+	uint64_t AllocateFrame(uint64_t hint = 0);
+	uint64_t AllocateFrames(uint64_t size, uint64_t alignment = PAGE_SIZE, uint64_t hint = 0);
+	uint64_t CreateRoot(uint64_t hint = 0);
+	bool Map(uint64_t cr3, uint64_t va, uint64_t pa, uint64_t pageSize, uint64_t flags = Writable | User, uint64_t tableHint = 0);
+	bool SetEntry(uint64_t tablePA, size_t index, uint64_t entry);
+
+	uint64_t UsedFrames() const
+	{
+		return m_usedFrames;
+	}
+
+	uint8_t* Data()
+	{
+		return m_memory.Data();
+	}
+
+	PhysicalView View() const
+	{
+		return { m_memory.Data(), m_memory.Size() };
+	}
+
+private:
+	uint64_t* Table(uint64_t pa);
+	bool IsFree(uint64_t frame, uint64_t count) const;
+	void MarkUsed(uint64_t frame, uint64_t count);
+	uint64_t FindFree(uint64_t first, uint64_t end, uint64_t count, uint64_t step) const;
+
+	ImageMemory m_memory;
+
+	//
+	// One bit per frame, the frame 0 is never handed out so 0 means failure
+	std::vector<uint64_t> m_used;
+	uint64_t m_usedFrames{ 0 };
+
+	//
+	// The frame the next allocation without a hint starts looking from
+	uint64_t m_next{ 1 };
+};
+
+} //namespace PTE
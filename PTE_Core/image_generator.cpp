@@ -0,0 +1,323 @@
+/*
+    image_generator.cpp
+
+    Generation of synthetic physical memory images with the address spaces of several processes.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "image_generator.h"
+#include "ia32.hpp"
+#include "timeline.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
+#include <random>
+
+namespace
+{
+
+constexpr uint64_t s_size2MB = 1ull << 21;
+constexpr uint64_t s_size1GB = 1ull << 30;
+
+//
+// Where the generated mappings live in every address space.
+constexpr uint64_t s_userBase = 0x10000000000ull;
+constexpr uint64_t s_hugeBase = 0x400000000000ull;
+constexpr uint64_t s_sharedBase = 0x7FF800000000ull;
+constexpr uint64_t s_kernelBase = 0xFFFF800000000000ull;
+
+//
+// The first PML4 entry of the kernel half.
+constexpr size_t s_kernelFirstEntry = TABLE_SIZE / 2;
+
+//
+// The spread is sampled with a permutation of its 2MB slots.
+constexpr uint64_t s_maxSlots = 1ull << 24;
+
+/// <summary>
+/// The random choices of the generation.
+/// </summary>
+class Randomizer
+{
+public:
+    Randomizer(uint64_t seed, double fragmentation, uint64_t imageSize) :
+        m_random(seed),
+        m_fragmentation(fragmentation),
+        m_imageSize(imageSize)
+    {
+    }
+
+    /// <summary>
+    /// True with the probability.
+    /// </summary>
+    bool Chance(double probability)
+    {
+        return probability >= 1.0 || (probability > 0.0 && m_uniform(m_random) < probability);
+    }
+
+    /// <summary>
+    /// Where the next frame is looked for: in order or at a random place of the image.
+    /// </summary>
+    uint64_t FrameHint()
+    {
+        return Chance(m_fragmentation) ? PAGE_SIZE + m_random() % (m_imageSize - PAGE_SIZE) : 0;
+    }
+
+    std::mt19937_64& Engine()
+    {
+        return m_random;
+    }
+
+private:
+    std::mt19937_64 m_random;
+    std::uniform_real_distribution<double> m_uniform{ 0.0, 1.0 };
+    double m_fragmentation;
+    uint64_t m_imageSize;
+};
+
+/// <summary>
+/// Map a page and record it.
+/// </summary>
+bool MapLeaf(PTE::ImageBuilder& builder,
+    Randomizer& randomizer,
+    PTE::GeneratedImage& image,
+    ULONG process,
+    uint64_t va,
+    uint64_t pa,
+    uint64_t pageSize,
+    uint64_t flags)
+{
+    if (pa == 0 || !builder.Map(image.CR3[process], va, pa, pageSize, flags, randomizer.FrameHint()))
+    {
+        return false;
+    }
+
+    image.Translations.push_back({ process, va, pa, pageSize });
+
+    return true;
+}
+
+} //namespace
+
+/// <summary>
+/// Build the address spaces in the image.
+/// Every process gets the 1GB pages one after another, the 2MB ranges of the 2MB and
+/// the 4KB pages scattered over the spread, the shared pages and the kernel half.
+/// </summary>
+/// <param name="spec">Shape of the image</param>
+/// <param name="builder">Empty builder of at least spec.ImageSize</param>
+/// <param name="image">The address spaces and their translations</param>
+/// <returns>Win32 error code</returns>
+unsigned long PTE::ImageGenerator::Generate(const ImageSpec& spec, ImageBuilder& builder, GeneratedImage& image)
+{
+    image = { };
+
+    const uint64_t imageSize = std::min(spec.ImageSize, builder.View().Size);
+    const uint64_t slotCount = spec.VirtualSpread / s_size2MB;
+    if (spec.Processes == 0 || imageSize < 2 * PAGE_SIZE || slotCount == 0 || slotCount > s_maxSlots ||
+        spec.SelfMapIndex >= static_cast<int>(TABLE_SIZE) ||
+        s_userBase + spec.VirtualSpread > s_hugeBase)
+    {
+        return ERROR_INVALID_PARAMETER;
+    }
+
+    Randomizer randomizer(spec.Seed, spec.Fragmentation, imageSize);
+
+    //
+    // Split the memory of a process between the page sizes.
+    const uint64_t hugePages = static_cast<uint64_t>(spec.MappedPerProcess * spec.Huge1GB) / s_size1GB;
+    const uint64_t largePages = static_cast<uint64_t>(spec.MappedPerProcess * spec.Large2MB) / s_size2MB;
+    const uint64_t rest = spec.MappedPerProcess - std::min(spec.MappedPerProcess, hugePages * s_size1GB + largePages * s_size2MB);
+    const uint64_t sharedPages = static_cast<uint64_t>(rest / PAGE_SIZE * spec.Shared);
+    const uint64_t privatePages = rest / PAGE_SIZE - sharedPages;
+
+    const double density = std::clamp(spec.Density, 1.0 / TABLE_SIZE, 1.0);
+
+    //
+    // With the holes being random, a quarter more ranges than the average need.
+    const uint64_t smallSlots = static_cast<uint64_t>(privatePages / (TABLE_SIZE * density) * (density < 1.0 ? 1.25 : 1.0)) + 2;
+    if (largePages + smallSlots > slotCount)
+    {
+        return ERROR_INVALID_PARAMETER;
+    }
+
+    //
+    // The large frames are taken first, the scattered 4KB frames leave no aligned runs.
+    std::vector<uint64_t> hugeFrames(spec.Processes * hugePages);
+    for (auto& frame : hugeFrames)
+    {
+        frame = builder.AllocateFrames(s_size1GB, s_size1GB, randomizer.FrameHint());
+    }
+
+    std::vector<uint64_t> largeFrames(spec.Processes * largePages + (spec.KernelMapped + s_size2MB - 1) / s_size2MB);
+    for (auto& frame : largeFrames)
+    {
+        frame = builder.AllocateFrames(s_size2MB, s_size2MB, randomizer.FrameHint());
+    }
+
+    //
+    // The frames of the shared pages are taken once.
+    std::vector<uint64_t> sharedFrames(sharedPages);
+    for (auto& frame : sharedFrames)
+    {
+        frame = builder.AllocateFrame(randomizer.FrameHint());
+    }
+
+    std::vector<uint32_t> slots(slotCount);
+    for (ULONG process = 0; process < spec.Processes; ++process)
+    {
+        image.CR3.push_back(builder.CreateRoot(randomizer.FrameHint()));
+        if (image.CR3.back() == 0)
+        {
+            return ERROR_NOT_ENOUGH_MEMORY;
+        }
+
+        for (uint64_t i = 0; i < hugePages; ++i)
+        {
+            const uint64_t pa = hugeFrames[process * hugePages + i];
+            if (!MapLeaf(builder, randomizer, image, process, s_hugeBase + i * s_size1GB, pa, s_size1GB, ImageBuilder::Writable | ImageBuilder::User))
+            {
+                return ERROR_NOT_ENOUGH_MEMORY;
+            }
+        }
+
+        //
+        // The first slots of a partial shuffle are the random 2MB ranges of the process.
+        std::iota(slots.begin(), slots.end(), 0);
+        for (uint64_t i = 0; i < largePages + smallSlots; ++i)
+        {
+            std::swap(slots[i], slots[i + randomizer.Engine()() % (slotCount - i)]);
+        }
+
+        for (uint64_t i = 0; i < largePages; ++i)
+        {
+            const uint64_t pa = largeFrames[process * largePages + i];
+            if (!MapLeaf(builder, randomizer, image, process, s_userBase + slots[i] * s_size2MB, pa, s_size2MB, ImageBuilder::Writable | ImageBuilder::User))
+            {
+                return ERROR_NOT_ENOUGH_MEMORY;
+            }
+        }
+
+        uint64_t remaining = privatePages;
+        for (uint64_t i = largePages; i < largePages + smallSlots && remaining != 0; ++i)
+        {
+            const uint64_t base = s_userBase + slots[i] * s_size2MB;
+            for (uint64_t j = 0; j < TABLE_SIZE && remaining != 0; ++j)
+            {
+                if (!randomizer.Chance(density))
+                {
+                    continue;
+                }
+
+                const uint64_t pa = builder.AllocateFrame(randomizer.FrameHint());
+                if (!MapLeaf(builder, randomizer, image, process, base + j * PAGE_SIZE, pa, PAGE_SIZE,
+                    ImageBuilder::Writable | ImageBuilder::User | ImageBuilder::NoExecute))
+                {
+                    return ERROR_NOT_ENOUGH_MEMORY;
+                }
+                --remaining;
+            }
+        }
+
+        for (uint64_t i = 0; i < sharedPages; ++i)
+        {
+            if (!MapLeaf(builder, randomizer, image, process, s_sharedBase + i * PAGE_SIZE, sharedFrames[i], PAGE_SIZE, ImageBuilder::User))
+            {
+                return ERROR_NOT_ENOUGH_MEMORY;
+            }
+        }
+    }
+
+    //
+    // The kernel half is built in the first process, the others point to the same tables.
+    const uint64_t firstKernel = image.Translations.size();
+    for (uint64_t offset = 0; offset < spec.KernelMapped; offset += s_size2MB)
+    {
+        const uint64_t pa = largeFrames[spec.Processes * largePages + offset / s_size2MB];
+        if (!MapLeaf(builder, randomizer, image, 0, s_kernelBase + offset, pa, s_size2MB, ImageBuilder::Writable))
+        {
+            return ERROR_NOT_ENOUGH_MEMORY;
+        }
+    }
+
+    const uint64_t kernelEnd = image.Translations.size();
+    const PhysicalView view = builder.View();
+    const uint64_t* kernelRoot = view.Table(CR3_ADDRESS_OF_PAGE_DIRECTORY(image.CR3[0]) << 12);
+    for (ULONG process = 1; process < spec.Processes; ++process)
+    {
+        for (size_t i = s_kernelFirstEntry; i < TABLE_SIZE; ++i)
+        {
+            if (kernelRoot[i] != 0)
+            {
+                builder.SetEntry(CR3_ADDRESS_OF_PAGE_DIRECTORY(image.CR3[process]) << 12, i, kernelRoot[i]);
+            }
+        }
+
+        for (uint64_t i = firstKernel; i < kernelEnd; ++i)
+        {
+            GroundTruth truth = image.Translations[i];
+            truth.Process = process;
+            image.Translations.push_back(truth);
+        }
+    }
+
+    if (spec.SelfMapIndex >= 0)
+    {
+        if (kernelRoot[spec.SelfMapIndex] != 0)
+        {
+            return ERROR_INVALID_PARAMETER;
+        }
+
+        for (uint64_t cr3 : image.CR3)
+        {
+            pml4e_64 self{ };
+            self.present = 1;
+            self.write = 1;
+            self.execute_disable = 1;
+            self.page_frame_number = CR3_ADDRESS_OF_PAGE_DIRECTORY(cr3);
+            builder.SetEntry(self.page_frame_number << 12, static_cast<size_t>(spec.SelfMapIndex), self.flags);
+        }
+    }
+
+    std::sort(image.Translations.begin(), image.Translations.end(), [](const GroundTruth& left, const GroundTruth& right)
+        {
+            return left.Process != right.Process ? left.Process < right.Process : left.VA < right.VA;
+        });
+
+    return ERROR_SUCCESS;
+}
+
+/// <summary>
+/// Write the translations as CSV, a line per leaf.
+/// </summary>
+/// <param name="path">Output file</param>
+/// <param name="image">The generated image</param>
+/// <returns>False if the file could not be written</returns>
+bool PTE::ImageGenerator::WriteTruth(const std::filesystem::path& path, const GeneratedImage& image)
+{
+    TimelineScope scope(TimelineCategory::Export, "write truth", image.Translations.size());
+
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file)
+    {
+        return false;
+    }
+
+    char line[128];
+    file << "process,cr3,va,pa,size\n";
+    for (const auto& truth : image.Translations)
+    {
+        snprintf(line, sizeof(line), "%u,0x%llx,0x%llx,0x%llx,%llu\n",
+            static_cast<unsigned>(truth.Process),
+            static_cast<unsigned long long>(image.CR3[truth.Process]),
+            static_cast<unsigned long long>(truth.VA),
+            static_cast<unsigned long long>(truth.PA),
+            static_cast<unsigned long long>(truth.PageSize));
+        file << line;
+    }
+
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,105 @@
+/*
+	image_generator.h
+
+	Generation of synthetic physical memory images with the address spaces
+	of several processes, together with the translations they hold.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+#include "image_builder.h"
+
+namespace PTE
+{
+
+/// <summary>
+/// Shape of the generated image.
+/// </summary>
+struct ImageSpec
+{
+	//
+	// Size of the physical memory
+	uint64_t ImageSize{ 1ull << 30 };
+
+	//
+	// Number of the address spaces
+	ULONG Processes{ 1 };
+
+	//
+	// Memory mapped in the user half of every process
+	uint64_t MappedPerProcess{ 64ull << 20 };
+
+	//
+	// Fraction of the present entries in the page tables of the 4KB pages
+	double Density{ 1.0 };
+
+	//
+	// Fractions of the mapped memory mapped by the 2MB and the 1GB pages
+	double Large2MB{ 0.0 };
+	double Huge1GB{ 0.0 };
+
+	//
+	// Fraction of the 4KB pages mapping the frames every process maps at the same address,
+	// as the images of the shared modules
+	double Shared{ 0.0 };
+
+	//
+	// Memory mapped in the kernel half, the kernel tables are shared by all the processes
+	uint64_t KernelMapped{ 0 };
+
+	//
+	// Fraction of the frames taken from random places of the image rather than in order
+	double Fragmentation{ 0.0 };
+
+	//
+	// Spread of the 2MB ranges of the 4KB and 2MB pages over the user half
+	uint64_t VirtualSpread{ 64ull << 30 };
+
+	//
+	// PML4 index of the entry pointing to the PML4 itself, 0x1ED as on Windows 10, -1 for none
+	int SelfMapIndex{ -1 };
+
+	uint64_t Seed{ 1 };
+};
+
+/// <summary>
+/// A leaf the generator mapped, the ground truth for the walkers.
+/// </summary>
+struct GroundTruth
+{
+	ULONG Process;
+	uint64_t VA;
+	uint64_t PA;
+	uint64_t PageSize;
+};
+
+/// <summary>
+/// The address spaces of the generated image.
+/// </summary>
+struct GeneratedImage
+{
+	//
+	// CR3 of every process
+	std::vector<uint64_t> CR3;
+
+	//
+	// Every leaf, ordered by the process and the virtual address
+	std::vector<GroundTruth> Translations;
+};
+
+/// <summary>
+/// Wrapper class for the image generation.
+/// </summary>
+class ImageGenerator
+{
+public:
+	static unsigned long Generate(const ImageSpec& spec, ImageBuilder& builder, GeneratedImage& image);
+	static bool WriteTruth(const std::filesystem::path& path, const GeneratedImage& image);
+};
+
+} //namespace PTE
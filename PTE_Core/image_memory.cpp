@@ -0,0 +1,220 @@
+/*
+    image_memory.cpp
+
+    Zero-filled memory backing the synthetic physical memory images.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "image_memory.h"
+#include <utility>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/// <summary>
+/// Unmap the memory.
+/// </summary>
+PTE::ImageMemory::~ImageMemory()
+{
+    Release();
+}
+
+PTE::ImageMemory::ImageMemory(ImageMemory&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+PTE::ImageMemory& PTE::ImageMemory::operator=(ImageMemory&& other) noexcept
+{
+    if (this != &other)
+    {
+        Release();
+
+        std::swap(m_data, other.m_data);
+        std::swap(m_size, other.m_size);
+#ifdef _WIN32
+        std::swap(m_file, other.m_file);
+        std::swap(m_mapping, other.m_mapping);
+#endif
+    }
+
+    return *this;
+}
+
+/// <summary>
+/// Reserve anonymous memory, the pages are zero until written.
+/// On Windows it is a sparse file deleted on the release, the file sections
+/// are not charged against the commit limit. Without the temporary directory
+/// the whole size is committed.
+/// </summary>
+/// <param name="size">Size of the memory</param>
+/// <returns>Win32 error code</returns>
+unsigned long PTE::ImageMemory::Allocate(uint64_t size)
+{
+    Release();
+
+#ifdef _WIN32
+    wchar_t wzDirectory[MAX_PATH]{ };
+    wchar_t wzPath[MAX_PATH]{ };
+    if (GetTempPathW(MAX_PATH, wzDirectory) != 0 && GetTempFileNameW(wzDirectory, L"pte", 0, wzPath) != 0)
+    {
+        m_file = CreateFileW(wzPath, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+            FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+        if (m_file != INVALID_HANDLE_VALUE && MapSparse(size) == ERROR_SUCCESS)
+        {
+            return ERROR_SUCCESS;
+        }
+
+        Release();
+        DeleteFileW(wzPath);
+    }
+
+    m_data = static_cast<uint8_t*>(VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+    if (m_data == nullptr)
+    {
+        return GetLastError();
+    }
+#else
+    //
+    // Not reserving the swap, the image is mostly never touched.
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (data == MAP_FAILED)
+    {
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    m_data = static_cast<uint8_t*>(data);
+#endif
+
+    m_size = size;
+
+    return ERROR_SUCCESS;
+}
+
+/// <summary>
+/// Create a sparse file of the size and map it, the image stays in the file after the release.
+/// </summary>
+/// <param name="path">Image file, replaced if it exists</param>
+/// <param name="size">Size of the memory</param>
+/// <returns>Win32 error code</returns>
+unsigned long PTE::ImageMemory::MapFile(const std::filesystem::path& path, uint64_t size)
+{
+    Release();
+
+#ifdef _WIN32
+    m_file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE)
+    {
+        return GetLastError();
+    }
+
+    return MapSparse(size);
+#else
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        return ERROR_OPEN_FAILED;
+    }
+
+    //
+    // Extending the file leaves a hole, the blocks are allocated when written.
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0)
+    {
+        close(fd);
+        return ERROR_WRITE_FAULT;
+    }
+
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    m_data = static_cast<uint8_t*>(data);
+#endif
+
+    m_size = size;
+
+    return ERROR_SUCCESS;
+}
+
+#ifdef _WIN32
+/// <summary>
+/// Make the open file sparse, extend it to the size and map it.
+/// </summary>
+/// <param name="size">Size of the memory</param>
+/// <returns>Win32 error code</returns>
+unsigned long PTE::ImageMemory::MapSparse(uint64_t size)
+{
+    //
+    // Without the sparse attribute NTFS writes the zeroes of the whole size.
+    DWORD returned{ 0 };
+    DeviceIoControl(m_file, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, &returned, nullptr);
+
+    LARGE_INTEGER fileSize{ };
+    fileSize.QuadPart = static_cast<LONGLONG>(size);
+    m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READWRITE, fileSize.HighPart, fileSize.LowPart, nullptr);
+    if (m_mapping == nullptr)
+    {
+        unsigned long err = GetLastError();
+        Release();
+        return err;
+    }
+
+    m_data = static_cast<uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+    if (m_data == nullptr)
+    {
+        unsigned long err = GetLastError();
+        Release();
+        return err;
+    }
+
+    m_size = size;
+
+    return ERROR_SUCCESS;
+}
+#endif
+
+/// <summary>
+/// Unmap the memory, the file backed images are flushed to the file.
+/// </summary>
+void PTE::ImageMemory::Release()
+{
+#ifdef _WIN32
+    if (m_data != nullptr)
+    {
+        if (m_mapping != nullptr)
+        {
+            UnmapViewOfFile(m_data);
+        }
+        else
+        {
+            VirtualFree(m_data, 0, MEM_RELEASE);
+        }
+    }
+    if (m_mapping != nullptr)
+    {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+    if (m_file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (m_data != nullptr)
+    {
+        munmap(m_data, m_size);
+    }
+#endif
+
+    m_data = nullptr;
+    m_size = 0;
+}
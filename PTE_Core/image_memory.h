@@ -0,0 +1,64 @@
+/*
+	image_memory.h
+
+	Zero-filled memory backing the synthetic physical memory images.
+	The pages only take memory or disk space when written, so a multi-GB
+	image holding a few MB of tables costs a few MB. On Windows the anonymous
+	memory is a sparse temporary file too: the reserved pages could not be
+	read, and the committed ones are charged against the commit limit up front.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include "include.h"
+
+namespace PTE
+{
+
+/// <summary>
+/// Owner of a zero-filled mapping, anonymous or backed by a sparse file.
+/// </summary>
+class ImageMemory
+{
+public:
+	ImageMemory() = default;
+	~ImageMemory();
+
+	ImageMemory(const ImageMemory&) = delete;
+	ImageMemory& operator=(const ImageMemory&) = delete;
+	ImageMemory(ImageMemory&& other) noexcept;
+	ImageMemory& operator=(ImageMemory&& other) noexcept;
+
+	unsigned long Allocate(uint64_t size);
+	unsigned long MapFile(const std::filesystem::path& path, uint64_t size);
+	void Release();
+
+	uint8_t* Data() const
+	{
+		return m_data;
+	}
+
+	uint64_t Size() const
+	{
+		return m_size;
+	}
+
+private:
+#ifdef _WIN32
+	unsigned long MapSparse(uint64_t size);
+#endif
+
+	uint8_t* m_data{ nullptr };
+	uint64_t m_size{ 0 };
+
+#ifdef _WIN32
+	HANDLE m_file{ INVALID_HANDLE_VALUE };
+	HANDLE m_mapping{ nullptr };
+#endif
+};
+
+} //namespace PTE
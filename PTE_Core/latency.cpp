@@ -0,0 +1,256 @@
+/*
+    latency.cpp
+
+    Latency histograms of the translation stages timed by the driver and the application.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "latency.h"
+#include "tsc_clock.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+
+namespace
+{
+
+const char* s_stageNames[TIMING_STAGE_COUNT] =
+{
+    "lookup",
+    "attach",
+    "walk",
+    "copy",
+    "open",
+    "ioctl",
+    "format",
+    "bind"
+};
+
+//
+// A histogram per stage and the last one for the whole translation.
+std::array<PTE::LatencyHistogram, TIMING_STAGE_COUNT + 1> s_histograms;
+std::mutex s_histogramsLock;
+std::atomic<bool> s_enabled{ false };
+
+//
+// Started when the timing is enabled, to convert the ticks to nanoseconds.
+TscClock s_clock;
+
+} //namespace
+
+/// <summary>
+/// Bucket of a value: the values under SubBuckets have their own buckets,
+/// above that the bits under the highest one select the bucket in its power of two.
+/// </summary>
+/// <param name="value">The value</param>
+/// <returns>Index of the bucket</returns>
+size_t PTE::LatencyHistogram::Index(uint64_t value)
+{
+    if (value < SubBuckets)
+    {
+        return static_cast<size_t>(value);
+    }
+
+    const unsigned msb = 63 - static_cast<unsigned>(std::countl_zero(value));
+    const unsigned shift = msb - SubBucketBits;
+
+    return (static_cast<size_t>(shift) + 1) * SubBuckets + static_cast<size_t>((value >> shift) & (SubBuckets - 1));
+}
+
+/// <summary>
+/// The highest value kept in a bucket.
+/// </summary>
+/// <param name="index">Index of the bucket</param>
+/// <returns>The value</returns>
+uint64_t PTE::LatencyHistogram::HighestInBucket(size_t index)
+{
+    if (index < SubBuckets)
+    {
+        return index;
+    }
+
+    const unsigned shift = static_cast<unsigned>(index / SubBuckets) - 1;
+    const uint64_t lowest = (SubBuckets | (index % SubBuckets)) << shift;
+
+    return lowest + ((1ull << shift) - 1);
+}
+
+/// <summary>
+/// Add a value.
+/// </summary>
+/// <param name="value">The value</param>
+void PTE::LatencyHistogram::Record(uint64_t value)
+{
+    m_buckets[Index(value)]++;
+    m_count++;
+    m_sum += value;
+    m_min = std::min(m_min, value);
+    m_max = std::max(m_max, value);
+}
+
+/// <summary>
+/// Remove all the values.
+/// </summary>
+void PTE::LatencyHistogram::Reset()
+{
+    m_buckets.fill(0);
+    m_count = 0;
+    m_sum = 0;
+    m_min = ~0ull;
+    m_max = 0;
+}
+
+/// <summary>
+/// The value under which the percentile of the values falls.
+/// </summary>
+/// <param name="percentile">0 to 100</param>
+/// <returns>The highest value of the bucket the percentile is in, Max at most</returns>
+uint64_t PTE::LatencyHistogram::ValueAtPercentile(double percentile) const
+{
+    if (m_count == 0)
+    {
+        return 0;
+    }
+
+    const double clamped = std::clamp(percentile, 0.0, 100.0);
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(clamped / 100.0 * static_cast<double>(m_count))));
+
+    uint64_t seen{ 0 };
+    for (size_t i = 0; i < BucketCount; ++i)
+    {
+        seen += m_buckets[i];
+        if (seen >= rank)
+        {
+            return std::clamp(HighestInBucket(i), Min(), m_max);
+        }
+    }
+
+    return m_max;
+}
+
+/// <summary>
+/// Turn the stage timing on or off.
+/// Turning it on starts the calibration of the TSC, the histograms are kept.
+/// </summary>
+/// <param name="enable">On or off</param>
+void PTE::Latency::Enable(bool enable)
+{
+    std::lock_guard<std::mutex> lock(s_histogramsLock);
+
+    if (enable && !s_enabled.load(std::memory_order_relaxed))
+    {
+        s_clock.Start();
+    }
+
+    s_enabled.store(enable, std::memory_order_relaxed);
+}
+
+/// <summary>
+/// Whether the translations should be timed.
+/// </summary>
+/// <returns>True if the timing is on</returns>
+bool PTE::Latency::Enabled()
+{
+    return s_enabled.load(std::memory_order_relaxed);
+}
+
+/// <summary>
+/// Add the stage times of a translation.
+/// The stages that were not timed, the UI stages in the command line for example, are skipped.
+/// </summary>
+/// <param name="times">The times filled by the timers</param>
+void PTE::Latency::Record(const STAGE_TIMES& times)
+{
+    if (!times.enabled || !Enabled())
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(s_histogramsLock);
+
+    uint64_t total{ 0 };
+    for (size_t stage = 0; stage < TIMING_STAGE_COUNT; ++stage)
+    {
+        if (times.ticks[stage] != 0)
+        {
+            s_histograms[stage].Record(times.ticks[stage]);
+            total += times.ticks[stage];
+        }
+    }
+
+    s_histograms[TIMING_STAGE_COUNT].Record(total);
+}
+
+/// <summary>
+/// Remove all the recorded times.
+/// </summary>
+void PTE::Latency::Reset()
+{
+    std::lock_guard<std::mutex> lock(s_histogramsLock);
+
+    for (auto& histogram : s_histograms)
+    {
+        histogram.Reset();
+    }
+}
+
+/// <summary>
+/// Format the histograms as a table of percentiles in nanoseconds.
+/// </summary>
+/// <returns>The table, a line per stage</returns>
+std::string PTE::Latency::Report()
+{
+    std::lock_guard<std::mutex> lock(s_histogramsLock);
+
+    const double ticksPerNs = s_clock.TicksPerNanosecond();
+    auto ns = [ticksPerNs](double ticks) { return ticks / ticksPerNs; };
+
+    char line[160];
+    snprintf(line, sizeof(line), "%-8s %10s %10s %10s %10s %10s %10s\n", "stage", "count", "mean ns", "p50 ns", "p90 ns", "p99 ns", "max ns");
+    std::string report = line;
+
+    for (size_t stage = 0; stage <= TIMING_STAGE_COUNT; ++stage)
+    {
+        const LatencyHistogram& histogram = s_histograms[stage];
+        if (histogram.Count() == 0)
+        {
+            continue;
+        }
+
+        snprintf(line, sizeof(line), "%-8s %10llu %10.0f %10.0f %10.0f %10.0f %10.0f\n",
+            stage < TIMING_STAGE_COUNT ? s_stageNames[stage] : "total",
+            static_cast<unsigned long long>(histogram.Count()),
+            ns(histogram.Mean()),
+            ns(static_cast<double>(histogram.ValueAtPercentile(50.0))),
+            ns(static_cast<double>(histogram.ValueAtPercentile(90.0))),
+            ns(static_cast<double>(histogram.ValueAtPercentile(99.0))),
+            ns(static_cast<double>(histogram.Max())));
+        report += line;
+    }
+
+    return report;
+}
+
+/// <summary>
+/// Write the report to a file.
+/// </summary>
+/// <param name="path">Path of the report</param>
+/// <returns>True if the report was written</returns>
+bool PTE::Latency::WriteReport(const std::filesystem::path& path)
+{
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file)
+    {
+        return false;
+    }
+
+    file << Report();
+
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,74 @@
+/*
+	latency.h
+
+	Latency histograms of the translation stages timed by the driver and the application.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include "include.h"
+
+namespace PTE
+{
+
+/// <summary>
+/// Log-linear histogram of the latencies, as in HdrHistogram.
+/// Every power of two is split into SubBuckets buckets, so a value is kept
+/// with a relative error under 1/SubBuckets and recording does not allocate.
+/// </summary>
+class LatencyHistogram
+{
+public:
+	static constexpr unsigned SubBucketBits = 5;
+	static constexpr size_t SubBuckets = 1ull << SubBucketBits;
+
+	//
+	// The values under SubBuckets are exact, every power of two above adds SubBuckets buckets
+	static constexpr size_t BucketCount = (64 - SubBucketBits + 1) * SubBuckets;
+
+	void Record(uint64_t value);
+	void Reset();
+
+	uint64_t Count() const { return m_count; }
+	uint64_t Min() const { return m_count == 0 ? 0 : m_min; }
+	uint64_t Max() const { return m_max; }
+	double Mean() const { return m_count == 0 ? 0.0 : static_cast<double>(m_sum) / static_cast<double>(m_count); }
+	uint64_t ValueAtPercentile(double percentile) const;
+
+private:
+	static size_t Index(uint64_t value);
+	static uint64_t HighestInBucket(size_t index);
+
+	std::array<uint64_t, BucketCount> m_buckets{ };
+	uint64_t m_count{ 0 };
+	uint64_t m_min{ ~0ull };
+	uint64_t m_max{ 0 };
+	uint64_t m_sum{ 0 };
+};
+
+/// <summary>
+/// Collects the stage times of the translations into a histogram per stage.
+/// The timers check Enabled before reading the TSC, so with the timing off
+/// a translation costs a test of a flag.
+/// </summary>
+class Latency
+{
+public:
+	static void Enable(bool enable);
+	static bool Enabled();
+
+	static void Record(const STAGE_TIMES& times);
+	static void Reset();
+
+	static std::string Report();
+	static bool WriteReport(const std::filesystem::path& path);
+};
+
+} //namespace PTE
@@ -0,0 +1,87 @@
+/*
+    leaf_index.cpp
+
+    Sorted index of the leaf entries of a snapshot for bulk translation.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "leaf_index.h"
+#include <algorithm>
+#include <bit>
+
+/// <summary>
+/// Index the leaf entries of the snapshot, the walk order is the address order.
+/// </summary>
+/// <param name="tables">Page tables of the process</param>
+void PTE::LeafIndex::Build(const PageTables& tables)
+{
+    Clear();
+
+    tables.ForEachLeaf([&](const LeafMapping& leaf)
+        {
+            m_va.push_back(leaf.va);
+            m_pa.push_back(leaf.pa);
+            m_shift.push_back(static_cast<uint8_t>(std::countr_zero(leaf.size)));
+        });
+}
+
+/// <summary>
+/// Drop the index.
+/// </summary>
+void PTE::LeafIndex::Clear()
+{
+    m_va.clear();
+    m_pa.clear();
+    m_shift.clear();
+}
+
+/// <summary>
+/// Number of the leaf entries.
+/// </summary>
+size_t PTE::LeafIndex::Size() const
+{
+    return m_va.size();
+}
+
+/// <summary>
+/// Translate the addresses sorted in the ascending order.
+/// The cursor moves forward with the addresses and jumps with a binary search over the gaps.
+/// </summary>
+/// <param name="addresses">Sorted virtual addresses</param>
+/// <param name="count">Number of the addresses</param>
+/// <param name="pa">Physical addresses, 0 for the addresses not mapped</param>
+/// <param name="pageSize">Page sizes, 0 for the addresses not mapped</param>
+void PTE::LeafIndex::Translate(const uint64_t* addresses, size_t count, uint64_t* pa, uint32_t* pageSize) const
+{
+    const size_t leaves = m_va.size();
+    size_t cursor = 0;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint64_t va = addresses[i];
+
+        //
+        // The next leaf is usually the next page, step to it before searching.
+        if (cursor + 1 < leaves && m_va[cursor + 1] <= va)
+        {
+            ++cursor;
+            if (cursor + 1 < leaves && m_va[cursor + 1] <= va)
+            {
+                cursor = (std::upper_bound(m_va.begin() + cursor + 1, m_va.end(), va) - m_va.begin()) - 1;
+            }
+        }
+
+        if (leaves != 0 && m_va[cursor] <= va && va - m_va[cursor] < (1ull << m_shift[cursor]))
+        {
+            pa[i] = m_pa[cursor] + (va - m_va[cursor]);
+            pageSize[i] = 1u << m_shift[cursor];
+        }
+        else
+        {
+            pa[i] = 0;
+            pageSize[i] = 0;
+        }
+    }
+}
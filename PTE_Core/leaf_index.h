@@ -0,0 +1,41 @@
+/*
+	leaf_index.h
+
+	Sorted index of the leaf entries of a snapshot for bulk translation.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "include.h"
+#include "page_tables.h"
+
+namespace PTE
+{
+
+/// <summary>
+/// The leaf mappings of a snapshot in flat arrays ordered by the virtual address.
+/// Sorted addresses are translated by a single merge pass over the index.
+/// </summary>
+class LeafIndex
+{
+public:
+	void Build(const PageTables& tables);
+	void Clear();
+	size_t Size() const;
+
+	void Translate(const uint64_t* addresses, size_t count, uint64_t* pa, uint32_t* pageSize) const;
+
+private:
+	std::vector<uint64_t> m_va;
+	std::vector<uint64_t> m_pa;
+
+	//
+	// log2 of the page size
+	std::vector<uint8_t> m_shift;
+};
+
+} //namespace PTE
@@ -0,0 +1,254 @@
+/*
+    memory_type.cpp
+
+    Effective memory type of the mappings from the PAT, PCD and PWT bits.
+    The three bits of the leaf entry select one of the eight IA32_PAT entries.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "memory_type.h"
+#include "ia32.hpp"
+
+#ifdef _WIN32
+#include "census.h"
+#include "page_tables.h"
+#include "timeline.h"
+#include <format>
+#include <fstream>
+
+namespace
+{
+
+/// <summary>
+/// Walk the leaf entries of the process, count the bytes per type and collect the non write-back runs.
+/// </summary>
+/// <param name="worker">Device, buffer, snapshot and region list of the worker</param>
+/// <param name="usage">The process to fill</param>
+void WalkProcess(PTE::ProcessWorker& worker, PTE::MemoryTypeUsage& usage)
+{
+    worker.ReadRegions(usage.Pid);
+
+    usage.Error = worker.ReadPageTables(usage.Pid);
+    if (usage.Error != ERROR_SUCCESS)
+    {
+        return;
+    }
+    usage.PAT = worker.Tables.PAT;
+
+    const std::vector<PTE::Region>& regions = worker.Regions;
+    PTE::RegionCursor cursor(regions);
+    size_t runRegion = PTE::RegionCursor::NoRegion;
+
+    worker.Tables.ForEachLeaf([&](const PTE::LeafMapping& leaf)
+        {
+            const uint32_t patIndex = PTE::MemoryTypes::PatIndex(leaf.level, leaf.entry);
+            const uint32_t type = PTE::MemoryTypes::Resolve(usage.PAT, leaf.level, leaf.entry);
+            if (type < PTE::MemoryTypeUsage::TypeCount)
+            {
+                usage.Bytes[type] += leaf.size;
+            }
+            if (type == MEMORY_TYPE_WRITE_BACK)
+            {
+                return;
+            }
+
+            //
+            // Extend the previous run if the leaf continues it within the same region.
+            const size_t region = cursor.Seek(leaf.va);
+            if (!usage.Runs.empty())
+            {
+                PTE::MemoryTypeRun& last = usage.Runs.back();
+                if (last.VA + last.Size == leaf.va && last.PatIndex == patIndex && runRegion == region)
+                {
+                    last.Size += leaf.size;
+                    return;
+                }
+            }
+
+            PTE::MemoryTypeRun run{ .VA = leaf.va, .Size = leaf.size, .Type = type, .PatIndex = patIndex };
+            if (region != PTE::RegionCursor::NoRegion)
+            {
+                run.RegionType = regions[region].Type;
+                run.Protect = regions[region].Protect;
+            }
+            usage.Runs.push_back(run);
+            runRegion = region;
+        });
+}
+
+} //namespace
+#endif
+
+/// <summary>
+/// Get the IA32_PAT entry selected by a leaf entry: PAT * 4 + PCD * 2 + PWT.
+/// </summary>
+/// <param name="level">TABLE_LEVEL of the table holding the entry</param>
+/// <param name="entry">Raw leaf entry</param>
+/// <returns>Index from 0 to 7</returns>
+uint32_t PTE::MemoryTypes::PatIndex(ULONG level, uint64_t entry)
+{
+    //
+    // Large pages keep PAT in the bit 12, the bit 7 is the page size there.
+    const uint64_t pat = level == TABLE_LEVEL_PT ? PTE_64_PAT(entry) :
+        level == TABLE_LEVEL_PD ? PDE_2MB_64_PAT(entry) : PDPTE_1GB_64_PAT(entry);
+
+    return static_cast<uint32_t>((pat << 2) |
+        (PTE_64_PAGE_LEVEL_CACHE_DISABLE(entry) << 1) |
+        PTE_64_PAGE_LEVEL_WRITE_THROUGH(entry));
+}
+
+/// <summary>
+/// Get the memory type of a leaf entry.
+/// </summary>
+/// <param name="pat">IA32_PAT value</param>
+/// <param name="level">TABLE_LEVEL of the table holding the entry</param>
+/// <param name="entry">Raw leaf entry</param>
+/// <returns>MEMORY_TYPE_*</returns>
+uint32_t PTE::MemoryTypes::Resolve(uint64_t pat, ULONG level, uint64_t entry)
+{
+    //
+    // Every entry of ia32_pat_register is 3 bits wide, at the start of its byte.
+    return static_cast<uint32_t>((pat >> (PatIndex(level, entry) * 8)) & IA32_PAT_PA0_MASK);
+}
+
+/// <summary>
+/// Get the short name of the memory type.
+/// </summary>
+/// <param name="type">MEMORY_TYPE_*</param>
+/// <returns>Name, "??" for the reserved encodings</returns>
+const char* PTE::MemoryTypes::Name(uint32_t type)
+{
+    switch (type)
+    {
+    case MEMORY_TYPE_UNCACHEABLE:
+        return "UC";
+    case MEMORY_TYPE_WRITE_COMBINING:
+        return "WC";
+    case MEMORY_TYPE_WRITE_THROUGH:
+        return "WT";
+    case MEMORY_TYPE_WRITE_PROTECTED:
+        return "WP";
+    case MEMORY_TYPE_WRITE_BACK:
+        return "WB";
+    case MEMORY_TYPE_UNCACHEABLE_MINUS:
+        return "UC-";
+    default:
+        return "??";
+    }
+}
+
+/// <summary>
+/// Get the leaf entry translating the address from the entries of the walk.
+/// </summary>
+/// <param name="response">Response of IOCTL_CODE or PhysicalWalker::Analyze</param>
+/// <param name="level">TABLE_LEVEL of the leaf</param>
+/// <param name="entry">Raw leaf entry</param>
+/// <returns>False if the address is not mapped</returns>
+bool PTE::MemoryTypes::LeafEntry(const IOCTL_RESPONSE& response, ULONG& level, uint64_t& entry)
+{
+    level = TABLE_LEVEL_PT;
+    entry = response.flagsPT;
+
+    //
+    // 1GB and 2MB pages end the walk early.
+    if (PDPTE_64_PRESENT(response.flagsPDP) && PDPTE_64_LARGE_PAGE(response.flagsPDP))
+    {
+        level = TABLE_LEVEL_PDP;
+        entry = response.flagsPDP;
+    }
+    else if (PDE_64_PRESENT(response.flagsPD) && PDE_64_LARGE_PAGE(response.flagsPD))
+    {
+        level = TABLE_LEVEL_PD;
+        entry = response.flagsPD;
+    }
+
+    return PML4E_64_PRESENT(response.flagsPML4) && PTE_64_PRESENT(entry);
+}
+
+#ifdef _WIN32
+/// <summary>
+/// Resolve the memory types of the user mappings of the processes on a pool of worker threads.
+/// </summary>
+/// <param name="pids">Processes to walk, all the accessible ones if empty</param>
+/// <param name="threads">Number of worker threads, 0 to use all the cores</param>
+/// <returns>Usage per process</returns>
+std::vector<PTE::MemoryTypeUsage> PTE::MemoryTypes::Run(const std::vector<ULONG>& pids, unsigned int threads)
+{
+    const std::vector<ULONG> targets = Census::Targets(pids);
+
+    std::vector<MemoryTypeUsage> usages(targets.size());
+    for (size_t i = 0; i < targets.size(); ++i)
+    {
+        usages[i].Pid = targets[i];
+    }
+
+    Census::ForEachProcess(targets.size(), threads, "memory type worker", [&](ProcessWorker& worker, size_t i)
+        {
+            WalkProcess(worker, usages[i]);
+        });
+
+    return usages;
+}
+
+/// <summary>
+/// Write the report as CSV: the totals per process, then the non write-back runs.
+/// </summary>
+/// <param name="path">Report path</param>
+/// <param name="usages">Usage per process</param>
+/// <param name="elapsedMs">Duration of the walk</param>
+/// <returns>True on success</returns>
+bool PTE::MemoryTypes::WriteReport(const std::wstring& path, const std::vector<MemoryTypeUsage>& usages, uint64_t elapsedMs)
+{
+    TimelineScope scope(TimelineCategory::Export, "write report");
+
+    std::ofstream report(path, std::ios::out | std::ios::trunc);
+    if (!report)
+    {
+        return false;
+    }
+
+    report << "pid,error,pat,uc_kb,wc_kb,wt_kb,wp_kb,wb_kb,uc_minus_kb\n";
+
+    size_t runs{ 0 };
+    uint64_t uncachedBytes{ 0 };
+    for (const auto& usage : usages)
+    {
+        report << std::format("{},{},0x{:016x},{},{},{},{},{},{}\n",
+            usage.Pid,
+            usage.Error,
+            usage.PAT,
+            usage.Bytes[MEMORY_TYPE_UNCACHEABLE] / 1024,
+            usage.Bytes[MEMORY_TYPE_WRITE_COMBINING] / 1024,
+            usage.Bytes[MEMORY_TYPE_WRITE_THROUGH] / 1024,
+            usage.Bytes[MEMORY_TYPE_WRITE_PROTECTED] / 1024,
+            usage.Bytes[MEMORY_TYPE_WRITE_BACK] / 1024,
+            usage.Bytes[MEMORY_TYPE_UNCACHEABLE_MINUS] / 1024);
+
+        runs += usage.Runs.size();
+        uncachedBytes += usage.Bytes[MEMORY_TYPE_UNCACHEABLE] + usage.Bytes[MEMORY_TYPE_UNCACHEABLE_MINUS];
+    }
+
+    report << "\npid,va,size_kb,type,pat_index,region_type,protect\n";
+    for (const auto& usage : usages)
+    {
+        for (const auto& run : usage.Runs)
+        {
+            report << std::format("{},0x{:x},{},{},{},0x{:x},0x{:x}\n",
+                usage.Pid,
+                run.VA,
+                run.Size / 1024,
+                Name(run.Type),
+                run.PatIndex,
+                run.RegionType,
+                run.Protect);
+        }
+    }
+
+    report << std::format("# {} processes, {} non write-back runs, {} KB uncached in {} ms\n",
+        usages.size(), runs, uncachedBytes / 1024, elapsedMs);
+
+    return static_cast<bool>(report);
+}
+#endif
@@ -0,0 +1,73 @@
+/*
+	memory_type.h
+
+	Effective memory type of the mappings from the PAT, PCD and PWT bits.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "include.h"
+
+namespace PTE
+{
+
+/// <summary>
+/// A run of the virtual pages with the same memory type other than write-back.
+/// </summary>
+struct MemoryTypeRun
+{
+	uint64_t VA{ 0 };
+	uint64_t Size{ 0 };
+
+	//
+	// MEMORY_TYPE_* and the IA32_PAT entry which selected it
+	uint32_t Type{ 0 };
+	uint32_t PatIndex{ 0 };
+
+	//
+	// The region holding the run, zero if the region list is not available
+	uint32_t RegionType{ 0 };
+	uint32_t Protect{ 0 };
+};
+
+/// <summary>
+/// Resident memory of a process by the memory type.
+/// </summary>
+struct MemoryTypeUsage
+{
+	static constexpr size_t TypeCount = 8;
+
+	ULONG Pid{ 0 };
+	unsigned long Error{ 0 };
+	uint64_t PAT{ 0 };
+
+	//
+	// Bytes mapped with each MEMORY_TYPE_*, the reserved encodings stay zero
+	uint64_t Bytes[TypeCount]{ };
+
+	std::vector<MemoryTypeRun> Runs;
+};
+
+/// <summary>
+/// Resolves the memory type of the leaf entries and finds the non write-back user mappings.
+/// The type selected by PAT is reported, the MTRRs are not taken into account:
+/// they keep the RAM write-back and only matter for the device memory.
+/// </summary>
+class MemoryTypes
+{
+public:
+	static uint32_t PatIndex(ULONG level, uint64_t entry);
+	static uint32_t Resolve(uint64_t pat, ULONG level, uint64_t entry);
+	static const char* Name(uint32_t type);
+	static bool LeafEntry(const IOCTL_RESPONSE& response, ULONG& level, uint64_t& entry);
+
+	static std::vector<MemoryTypeUsage> Run(const std::vector<ULONG>& pids, unsigned int threads);
+	static bool WriteReport(const std::wstring& path, const std::vector<MemoryTypeUsage>& usages, uint64_t elapsedMs);
+};
+
+} //namespace PTE
@@ -0,0 +1,228 @@
+/*
+    module_cache.cpp
+
+    Cache of the module names of the target processes.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "module_cache.h"
+#include "timeline.h"
+#include <psapi.h>
+#include <algorithm>
+#include <bit>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#pragma comment(lib, "psapi.lib")
+
+namespace
+{
+
+struct ProcessModules
+{
+    //
+    // Creation time tells a restarted process from the one with the same PID.
+    ULONGLONG createTime{ 0 };
+
+    //
+    // Module list at the moment of the last load
+    std::vector<HMODULE> modules;
+
+    //
+    // Names of the modules, kept while the module list does not change.
+    std::unordered_map<ULONG_PTR, std::wstring> names;
+
+    //
+    // Names of the mapped files, the files can be mapped and unmapped at any moment,
+    // so these are dropped on every load. Empty names are not cached.
+    std::unordered_map<ULONG_PTR, std::wstring> mappedFiles;
+};
+
+//
+// The cache is checked for the exited processes when it grows past this size.
+constexpr size_t MinPruneSize = 64;
+
+std::mutex s_lock;
+std::unordered_map<DWORD, ProcessModules> s_processes;
+size_t s_pruneSize = MinPruneSize;
+
+/// <summary>
+/// Get the process creation time.
+/// </summary>
+/// <param name="hProcess">Process handle</param>
+/// <returns>Creation time or 0</returns>
+ULONGLONG GetCreateTime(HANDLE hProcess)
+{
+    FILETIME createTime{ }, exitTime{ }, kernelTime{ }, userTime{ };
+
+    if (!GetProcessTimes(hProcess, &createTime, &exitTime, &kernelTime, &userTime))
+    {
+        return 0;
+    }
+
+    return (static_cast<ULONGLONG>(createTime.dwHighDateTime) << 32) | createTime.dwLowDateTime;
+}
+
+/// <summary>
+/// Check if the process cached under the PID is still running.
+/// </summary>
+/// <param name="pid">Process ID</param>
+/// <param name="createTime">Creation time of the cached process</param>
+/// <returns>True if the process is running</returns>
+bool IsRunning(DWORD pid, ULONGLONG createTime)
+{
+    HANDLE hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (hProcess == nullptr)
+    {
+        return false;
+    }
+
+    DWORD exitCode{ 0 };
+    const bool running = GetExitCodeProcess(hProcess, &exitCode) && exitCode == STILL_ACTIVE &&
+        GetCreateTime(hProcess) == createTime;
+    CloseHandle(hProcess);
+
+    return running;
+}
+
+/// <summary>
+/// Drop the processes which exited, called under the lock.
+/// The check runs when the cache doubles, so its cost spreads over the loads.
+/// </summary>
+void PruneExited()
+{
+    if (s_processes.size() < s_pruneSize)
+    {
+        return;
+    }
+
+    std::erase_if(s_processes, [](const auto& entry)
+        {
+            return !IsRunning(entry.first, entry.second.createTime);
+        });
+    s_pruneSize = std::max(MinPruneSize, s_processes.size() * 2);
+}
+
+} //namespace
+
+/// <summary>
+/// Load the module list of the target process and drop the cached mapped file names.
+/// The module names are kept if the list did not change since the previous call.
+/// </summary>
+/// <param name="hProcess">Process handle with PROCESS_QUERY_INFORMATION and PROCESS_VM_READ access</param>
+void PTE::ModuleCache::Load(HANDLE hProcess)
+{
+    std::vector<HMODULE> modules(1024);
+    DWORD needed{ 0 };
+
+    //
+    // The list may grow between the calls, retry with the bigger buffer.
+    // Without the list the cached names are dropped, the mapped files are still resolved.
+    while (true)
+    {
+        DWORD size = static_cast<DWORD>(modules.size() * sizeof(HMODULE));
+        if (!EnumProcessModulesEx(hProcess, modules.data(), size, &needed, LIST_MODULES_ALL))
+        {
+            needed = 0;
+            break;
+        }
+        if (needed <= size)
+        {
+            break;
+        }
+        modules.resize(needed / sizeof(HMODULE));
+    }
+    modules.resize(needed / sizeof(HMODULE));
+
+    ULONGLONG createTime = GetCreateTime(hProcess);
+
+    std::lock_guard<std::mutex> guard(s_lock);
+
+    PruneExited();
+
+    //
+    // Drop the cache if the PID was reused by another process.
+    ProcessModules& cache = s_processes[GetProcessId(hProcess)];
+    if (cache.createTime != createTime)
+    {
+        cache = {};
+        cache.createTime = createTime;
+    }
+
+    cache.mappedFiles.clear();
+    if (cache.modules == modules)
+    {
+        return;
+    }
+
+    //
+    // Modules were loaded or unloaded, start over.
+    PTE::Timeline::Instant(PTE::TimelineCategory::Cache, "module cache miss", GetProcessId(hProcess));
+    cache.names.clear();
+    cache.modules = std::move(modules);
+
+    wchar_t wzModuleName[MAX_PATH]{ };
+    for (HMODULE hModule : cache.modules)
+    {
+        DWORD len = GetModuleFileNameExW(hProcess, hModule, wzModuleName, MAX_PATH);
+        if (len != 0)
+        {
+            cache.names[std::bit_cast<ULONG_PTR>(hModule)].assign(wzModuleName, len);
+        }
+    }
+}
+
+/// <summary>
+/// Get the name of the image or the file mapped at the allocation base.
+/// Falls back to the mapped file name for the regions missing in the module list,
+/// the mapped file names are cached until the next Load.
+/// </summary>
+/// <param name="hProcess">Process handle</param>
+/// <param name="allocationBase">Allocation base of the region</param>
+/// <returns>The name or an empty string</returns>
+std::wstring PTE::ModuleCache::GetName(HANDLE hProcess, PVOID allocationBase)
+{
+    const ULONG_PTR base = std::bit_cast<ULONG_PTR>(allocationBase);
+
+    {
+        std::lock_guard<std::mutex> guard(s_lock);
+
+        auto process = s_processes.find(GetProcessId(hProcess));
+        if (process != s_processes.end())
+        {
+            auto it = process->second.names.find(base);
+            if (it != process->second.names.end())
+            {
+                return it->second;
+            }
+
+            it = process->second.mappedFiles.find(base);
+            if (it != process->second.mappedFiles.end())
+            {
+                return it->second;
+            }
+        }
+    }
+
+    //
+    // Not a loaded module: mapped file or the image mapped without the loader.
+    // The name is in the NT device form.
+    wchar_t wzFileName[MAX_PATH]{ };
+    DWORD len = GetMappedFileNameW(hProcess, allocationBase, wzFileName, MAX_PATH);
+    std::wstring name(wzFileName, len);
+
+    //
+    // Only for a loaded process, the entry is dropped with the others on its next load.
+    std::lock_guard<std::mutex> guard(s_lock);
+
+    auto process = s_processes.find(GetProcessId(hProcess));
+    if (len != 0 && process != s_processes.end())
+    {
+        process->second.mappedFiles[base] = name;
+    }
+
+    return name;
+}
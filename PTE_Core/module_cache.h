@@ -0,0 +1,29 @@
+/*
+	module_cache.h
+
+	Cache of the module names of the target processes.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <string>
+#include "include.h"
+
+namespace PTE
+{
+
+/// <summary>
+/// Names of the images and the mapped files keyed by allocation base.
+/// The module names are kept while the module list of the process does not change,
+/// the mapped file names only until the next load. Exited processes are dropped.
+/// </summary>
+class ModuleCache
+{
+public:
+	static void Load(HANDLE hProcess);
+	static std::wstring GetName(HANDLE hProcess, PVOID allocationBase);
+};
+
+} //namespace PTE
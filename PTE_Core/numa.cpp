@@ -0,0 +1,378 @@
+/*
+    numa.cpp
+
+    NUMA node attribution of the physical frames.
+    The node ranges come from the memory affinity structures of the ACPI
+    SRAT table, the proximity domains are mapped to the node numbers by
+    the OS. Without SRAT the system has a single node.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "numa.h"
+#include "census.h"
+#include "page_tables.h"
+#include "timeline.h"
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <fstream>
+
+namespace
+{
+
+//
+// GetSystemFirmwareTable identifiers: the provider and the table signature as stored in the memory.
+constexpr DWORD AcpiProvider = ('A' << 24) | ('C' << 16) | ('P' << 8) | 'I';
+constexpr DWORD SratSignature = 'S' | ('R' << 8) | ('A' << 16) | ('T' << 24);
+
+//
+// SRAT layout: the ACPI header and 12 reserved bytes, then the affinity structures.
+constexpr size_t SratHeaderSize = 48;
+constexpr uint8_t SratMemoryAffinity = 1;
+constexpr size_t SratMemoryAffinitySize = 40;
+constexpr uint32_t SratMemoryEnabled = 1;
+
+/// <summary>
+/// Read a little endian value of the table.
+/// </summary>
+template <typename T>
+T ReadField(const uint8_t* data)
+{
+    T value;
+    memcpy(&value, data, sizeof(value));
+
+    return value;
+}
+
+/// <summary>
+/// Walk the leaf entries of the process and count the frames per node.
+/// </summary>
+/// <param name="map">Node ranges</param>
+/// <param name="worker">Device, buffer, snapshot and region list of the worker</param>
+/// <param name="usage">The process to fill</param>
+void WalkProcess(const PTE::NumaMap& map, PTE::ProcessWorker& worker, PTE::NumaUsage& usage)
+{
+    const size_t buckets = map.NodeCount() + 1;
+    usage.Total.assign(buckets, 0);
+
+    //
+    // Without the region list only the process totals are counted.
+    worker.ReadRegions(usage.Pid);
+
+    usage.Error = worker.ReadPageTables(usage.Pid);
+    if (usage.Error != ERROR_SUCCESS)
+    {
+        return;
+    }
+
+    const std::vector<PTE::Region>& regions = worker.Regions;
+    std::vector<std::vector<uint64_t>> histograms(regions.size());
+    PTE::RegionCursor cursor(regions);
+
+    worker.Tables.ForEachLeaf([&](const PTE::LeafMapping& leaf)
+        {
+            map.Count(leaf.pa / PAGE_SIZE, leaf.size / PAGE_SIZE, usage.Total);
+
+            //
+            // A large page may span several regions, it is cut at their boundaries.
+            const uint64_t leafEnd = leaf.va + leaf.size;
+            for (uint64_t va = leaf.va; va < leafEnd; )
+            {
+                uint64_t end{ 0 };
+                const size_t region = cursor.Next(va, leafEnd, end);
+                if (region != PTE::RegionCursor::NoRegion)
+                {
+                    if (histograms[region].empty())
+                    {
+                        histograms[region].assign(buckets, 0);
+                    }
+                    map.Count((leaf.pa + (va - leaf.va)) / PAGE_SIZE, (end - va) / PAGE_SIZE, histograms[region]);
+                }
+                va = end;
+            }
+        });
+
+    for (size_t i = 0; i < regions.size(); ++i)
+    {
+        if (!histograms[i].empty())
+        {
+            usage.Regions.emplace_back(regions[i], std::move(histograms[i]));
+        }
+    }
+}
+
+} //namespace
+
+/// <summary>
+/// Load the node ranges of the system from SRAT.
+/// </summary>
+/// <returns>Win32 error code, 0 on success</returns>
+unsigned long PTE::NumaMap::LoadSystem()
+{
+    m_starts.clear();
+    m_ends.clear();
+    m_nodes.clear();
+    m_nodeCount = 0;
+
+    ULONG highestNode{ 0 };
+    if (!GetNumaHighestNodeNumber(&highestNode))
+    {
+        return GetLastError();
+    }
+
+    //
+    // The single node systems often have no SRAT, all the memory is on the node 0.
+    if (highestNode == 0)
+    {
+        AddRange(0, ~0ull / PAGE_SIZE, 0);
+        Finish();
+        return ERROR_SUCCESS;
+    }
+
+    const UINT size = GetSystemFirmwareTable(AcpiProvider, SratSignature, nullptr, 0);
+    if (size < SratHeaderSize)
+    {
+        return size == 0 ? GetLastError() : ERROR_INVALID_DATA;
+    }
+
+    std::vector<uint8_t> srat(size);
+    if (GetSystemFirmwareTable(AcpiProvider, SratSignature, srat.data(), size) != size)
+    {
+        return GetLastError();
+    }
+
+    for (size_t offset = SratHeaderSize; offset + 2 <= srat.size(); )
+    {
+        const uint8_t type = srat[offset];
+        const uint8_t length = srat[offset + 1];
+        if (length < 2 || offset + length > srat.size())
+        {
+            break;
+        }
+
+        if (type == SratMemoryAffinity && length >= SratMemoryAffinitySize)
+        {
+            const uint8_t* entry = srat.data() + offset;
+            const uint32_t domain = ReadField<uint32_t>(entry + 2);
+            const uint64_t base = ReadField<uint64_t>(entry + 8);
+            const uint64_t rangeSize = ReadField<uint64_t>(entry + 16);
+            const uint32_t flags = ReadField<uint32_t>(entry + 28);
+
+            USHORT node{ 0 };
+            if ((flags & SratMemoryEnabled) != 0 && rangeSize != 0 && GetNumaProximityNodeEx(domain, &node))
+            {
+                AddRange(base / PAGE_SIZE, rangeSize / PAGE_SIZE, node);
+            }
+        }
+
+        offset += length;
+    }
+
+    Finish();
+
+    return m_starts.empty() ? ERROR_NOT_FOUND : ERROR_SUCCESS;
+}
+
+/// <summary>
+/// Add a range of the frames, Finish must be called after the last one.
+/// </summary>
+/// <param name="firstPfn">The first frame</param>
+/// <param name="frames">Number of the frames</param>
+/// <param name="node">Node number</param>
+void PTE::NumaMap::AddRange(uint64_t firstPfn, uint64_t frames, uint16_t node)
+{
+    m_starts.push_back(firstPfn);
+    m_ends.push_back(firstPfn + frames);
+    m_nodes.push_back(node);
+    m_nodeCount = std::max<size_t>(m_nodeCount, static_cast<size_t>(node) + 1);
+}
+
+/// <summary>
+/// Sort the ranges and merge the adjacent ones of the same node.
+/// </summary>
+void PTE::NumaMap::Finish()
+{
+    std::vector<size_t> order(m_starts.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](size_t left, size_t right) { return m_starts[left] < m_starts[right]; });
+
+    std::vector<uint64_t> starts, ends;
+    std::vector<uint16_t> nodes;
+    for (size_t i : order)
+    {
+        if (!starts.empty() && nodes.back() == m_nodes[i] && ends.back() >= m_starts[i])
+        {
+            ends.back() = std::max(ends.back(), m_ends[i]);
+            continue;
+        }
+
+        //
+        // Overlapping ranges of different nodes: the earlier one wins.
+        const uint64_t start = starts.empty() ? m_starts[i] : std::max(m_starts[i], ends.back());
+        if (start < m_ends[i])
+        {
+            starts.push_back(start);
+            ends.push_back(m_ends[i]);
+            nodes.push_back(m_nodes[i]);
+        }
+    }
+
+    m_starts = std::move(starts);
+    m_ends = std::move(ends);
+    m_nodes = std::move(nodes);
+}
+
+/// <summary>
+/// Get the node of a frame.
+/// </summary>
+/// <param name="pfn">Frame number</param>
+/// <returns>Node number or UnknownNode</returns>
+uint16_t PTE::NumaMap::NodeOf(uint64_t pfn) const
+{
+    auto it = std::upper_bound(m_starts.begin(), m_starts.end(), pfn);
+    if (it == m_starts.begin())
+    {
+        return UnknownNode;
+    }
+
+    const size_t index = (it - m_starts.begin()) - 1;
+
+    return pfn < m_ends[index] ? m_nodes[index] : UnknownNode;
+}
+
+/// <summary>
+/// Add the frames of a range to the node histogram, the range may span several nodes.
+/// </summary>
+/// <param name="firstPfn">The first frame</param>
+/// <param name="frames">Number of the frames</param>
+/// <param name="histogram">NodeCount() + 1 counters, the last one for the unknown node</param>
+void PTE::NumaMap::Count(uint64_t firstPfn, uint64_t frames, std::vector<uint64_t>& histogram) const
+{
+    const uint64_t end = firstPfn + frames;
+    size_t index = std::upper_bound(m_starts.begin(), m_starts.end(), firstPfn) - m_starts.begin();
+
+    for (uint64_t pfn = firstPfn; pfn < end; )
+    {
+        //
+        // Inside the range before the index, or in the gap before the range at the index.
+        if (index > 0 && pfn < m_ends[index - 1])
+        {
+            const uint64_t next = std::min(end, m_ends[index - 1]);
+            histogram[m_nodes[index - 1]] += next - pfn;
+            pfn = next;
+        }
+        else
+        {
+            const uint64_t next = index < m_starts.size() ? std::min(end, m_starts[index]) : end;
+            histogram[m_nodeCount] += next - pfn;
+            pfn = next;
+        }
+
+        if (index < m_starts.size() && pfn >= m_starts[index])
+        {
+            ++index;
+        }
+    }
+}
+
+/// <summary>
+/// Number of the nodes, the highest node number + 1.
+/// </summary>
+size_t PTE::NumaMap::NodeCount() const
+{
+    return m_nodeCount;
+}
+
+/// <summary>
+/// Get the map of the system, loaded on the first call.
+/// </summary>
+const PTE::NumaMap& PTE::NumaMap::System()
+{
+    static const NumaMap s_map = []()
+        {
+            NumaMap map;
+            map.LoadSystem();
+            return map;
+        }();
+
+    return s_map;
+}
+
+/// <summary>
+/// Count the resident frames of the processes per node on a pool of worker threads.
+/// </summary>
+/// <param name="map">Node ranges</param>
+/// <param name="pids">Processes to walk, all the accessible ones if empty</param>
+/// <param name="threads">Number of worker threads, 0 to use all the cores</param>
+/// <returns>Usage per process</returns>
+std::vector<PTE::NumaUsage> PTE::NumaCensus::Run(const NumaMap& map, const std::vector<ULONG>& pids, unsigned int threads)
+{
+    const std::vector<ULONG> targets = Census::Targets(pids);
+
+    std::vector<NumaUsage> usages(targets.size());
+    for (size_t i = 0; i < targets.size(); ++i)
+    {
+        usages[i].Pid = targets[i];
+    }
+
+    Census::ForEachProcess(targets.size(), threads, "numa worker", [&](ProcessWorker& worker, size_t i)
+        {
+            WalkProcess(map, worker, usages[i]);
+        });
+
+    return usages;
+}
+
+/// <summary>
+/// Write the report as CSV: a line per process and per region, KB per node.
+/// </summary>
+/// <param name="path">Report path</param>
+/// <param name="map">Node ranges</param>
+/// <param name="usages">Usage per process</param>
+/// <param name="elapsedMs">Duration of the walk</param>
+/// <returns>True on success</returns>
+bool PTE::NumaCensus::WriteReport(const std::wstring& path, const NumaMap& map, const std::vector<NumaUsage>& usages, uint64_t elapsedMs)
+{
+    TimelineScope scope(TimelineCategory::Export, "write report");
+
+    std::ofstream report(path, std::ios::out | std::ios::trunc);
+    if (!report)
+    {
+        return false;
+    }
+
+    report << "pid,region,error";
+    for (size_t node = 0; node < map.NodeCount(); ++node)
+    {
+        report << std::format(",node{}_kb", node);
+    }
+    report << ",unknown_kb\n";
+
+    auto writeLine = [&](ULONG pid, const std::string& region, unsigned long error, const std::vector<uint64_t>& histogram)
+        {
+            report << std::format("{},{},{}", pid, region, error);
+            for (size_t node = 0; node <= map.NodeCount(); ++node)
+            {
+                report << std::format(",{}", node < histogram.size() ? histogram[node] * PAGE_SIZE / 1024 : 0);
+            }
+            report << "\n";
+        };
+
+    for (const auto& usage : usages)
+    {
+        writeLine(usage.Pid, "", usage.Error, usage.Total);
+        for (const auto& [region, histogram] : usage.Regions)
+        {
+            writeLine(usage.Pid, std::format("0x{:x}", region.BaseAddress), 0, histogram);
+        }
+    }
+
+    report << std::format("# {} nodes, {} processes in {} ms\n", map.NodeCount(), usages.size(), elapsedMs);
+
+    return static_cast<bool>(report);
+}
@@ -0,0 +1,72 @@
+/*
+	numa.h
+
+	NUMA node attribution of the physical frames.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "include.h"
+#include "regions.h"
+
+namespace PTE
+{
+
+/// <summary>
+/// Map of the physical frame ranges to the NUMA nodes.
+/// The ranges are kept in flat sorted arrays searched by binary search.
+/// </summary>
+class NumaMap
+{
+public:
+	static constexpr uint16_t UnknownNode = 0xFFFF;
+
+	unsigned long LoadSystem();
+	void AddRange(uint64_t firstPfn, uint64_t frames, uint16_t node);
+	void Finish();
+
+	uint16_t NodeOf(uint64_t pfn) const;
+	void Count(uint64_t firstPfn, uint64_t frames, std::vector<uint64_t>& histogram) const;
+	size_t NodeCount() const;
+
+	static const NumaMap& System();
+
+private:
+	//
+	// [start, end) frame ranges sorted by start, not overlapping
+	std::vector<uint64_t> m_starts;
+	std::vector<uint64_t> m_ends;
+	std::vector<uint16_t> m_nodes;
+	size_t m_nodeCount{ 0 };
+};
+
+/// <summary>
+/// Frames of a process per NUMA node, the last entry counts the frames of no known node.
+/// </summary>
+struct NumaUsage
+{
+	ULONG Pid{ 0 };
+	unsigned long Error{ 0 };
+	std::vector<uint64_t> Total;
+
+	//
+	// Committed regions with resident pages
+	std::vector<std::pair<Region, std::vector<uint64_t>>> Regions;
+};
+
+/// <summary>
+/// Attributes the resident memory of the processes to the NUMA nodes.
+/// </summary>
+class NumaCensus
+{
+public:
+	static std::vector<NumaUsage> Run(const NumaMap& map, const std::vector<ULONG>& pids, unsigned int threads);
+	static bool WriteReport(const std::wstring& path, const NumaMap& map, const std::vector<NumaUsage>& usages, uint64_t elapsedMs);
+};
+
+} //namespace PTE
@@ -0,0 +1,253 @@
+/*
+    page_classify.cpp
+
+    Classification of the page content: zero, repeated pattern, entropy.
+    A single vector pass over the page finds the zero pages, the pages
+    repeating their first 32 bytes and the words repeating the previous one.
+    The byte histogram is counted into four tables to avoid the store to
+    load stalls on the runs of equal bytes, the entropy is summed from
+    a fixed point c * log2(c) table, so all the implementations agree.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "page_classify.h"
+#include "cpu_features.h"
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <immintrin.h>
+
+namespace
+{
+
+constexpr size_t Words = PAGE_SIZE / sizeof(uint64_t);
+constexpr size_t PatternSize = 32;
+
+//
+// Fixed point scale of the entropy table
+constexpr unsigned int EntropyShift = 16;
+
+//
+// log2(PAGE_SIZE), the entropy of a page with all the byte values equally frequent
+constexpr uint64_t PageBits = 12;
+
+using EntropyTable = std::array<uint32_t, PAGE_SIZE + 1>;
+
+/// <summary>
+/// Get the c * log2(c) table in the fixed point, c is the number of occurrences of a byte value.
+/// PAGE_SIZE * 12 * 2^16 fits into 32 bits.
+/// </summary>
+const EntropyTable& GetEntropyTable()
+{
+    static const EntropyTable s_table = []()
+        {
+            EntropyTable table{ };
+            for (size_t count = 1; count <= PAGE_SIZE; ++count)
+            {
+                table[count] = static_cast<uint32_t>(std::lround(count * std::log2(static_cast<double>(count)) * (1 << EntropyShift)));
+            }
+            return table;
+        }();
+
+    return s_table;
+}
+
+/// <summary>
+/// Count the byte values of the data.
+/// </summary>
+/// <param name="data">The bytes, the size is a multiple of 4</param>
+/// <param name="size">Number of the bytes</param>
+/// <param name="repeat">Every byte counts this many times</param>
+/// <param name="histogram">The counts</param>
+void CountBytes(const uint8_t* data, size_t size, uint32_t repeat, uint32_t (&histogram)[256])
+{
+    uint32_t partial[4][256]{ };
+
+    for (size_t i = 0; i < size; i += 4)
+    {
+        ++partial[0][data[i]];
+        ++partial[1][data[i + 1]];
+        ++partial[2][data[i + 2]];
+        ++partial[3][data[i + 3]];
+    }
+
+    for (size_t value = 0; value < 256; ++value)
+    {
+        histogram[value] = (partial[0][value] + partial[1][value] + partial[2][value] + partial[3][value]) * repeat;
+    }
+}
+
+/// <summary>
+/// Sum c * log2(c) over the histogram.
+/// </summary>
+uint64_t SumEntropyScalar(const uint32_t (&histogram)[256])
+{
+    const EntropyTable& table = GetEntropyTable();
+    uint64_t sum{ 0 };
+
+    for (uint32_t count : histogram)
+    {
+        sum += table[count];
+    }
+
+    return sum;
+}
+
+/// <summary>
+/// Sum c * log2(c) over the histogram, 8 table lookups per gather.
+/// </summary>
+PTE_TARGET_AVX2 uint64_t SumEntropyAvx2(const uint32_t (&histogram)[256])
+{
+    const int* table = reinterpret_cast<const int*>(GetEntropyTable().data());
+    __m256i sum = _mm256_setzero_si256();
+
+    for (size_t value = 0; value < 256; value += 8)
+    {
+        const __m256i counts = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(histogram + value));
+        const __m256i terms = _mm256_i32gather_epi32(table, counts, 4);
+
+        sum = _mm256_add_epi64(sum, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(terms)));
+        sum = _mm256_add_epi64(sum, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(terms, 1)));
+    }
+
+    alignas(32) uint64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), sum);
+
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+/// <summary>
+/// Reference implementation.
+/// </summary>
+void ScanScalar(const uint8_t* page, PTE::PageClass& result)
+{
+    uint64_t words[Words];
+    memcpy(words, page, PAGE_SIZE);
+
+    uint64_t any{ 0 };
+    for (size_t i = 0; i < Words; ++i)
+    {
+        any |= words[i];
+        if (words[i] == 0 || (i > 0 && words[i] == words[i - 1]))
+        {
+            ++result.RepeatWords;
+        }
+    }
+
+    result.Zero = any == 0;
+    result.Pattern = true;
+    for (size_t offset = PatternSize; offset < PAGE_SIZE && result.Pattern; offset += PatternSize)
+    {
+        result.Pattern = memcmp(page, page + offset, PatternSize) == 0;
+    }
+}
+
+/// <summary>
+/// AVX2 implementation of the same pass, 32 bytes per iteration.
+/// </summary>
+PTE_TARGET_AVX2 void ScanAvx2(const uint8_t* page, PTE::PageClass& result)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(page));
+    __m256i any = first;
+    __m256i diff = zero;
+
+    //
+    // The first word has no previous one, the lane compared with itself is masked out.
+    const __m256i firstPrevious = _mm256_permute4x64_epi64(first, _MM_SHUFFLE(2, 1, 0, 0));
+    unsigned int repeats = std::popcount(static_cast<unsigned int>(_mm256_movemask_pd(_mm256_castsi256_pd(
+        _mm256_or_si256(_mm256_cmpeq_epi64(first, zero), _mm256_cmpeq_epi64(first, firstPrevious))))) & 0xE) +
+        (_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(first, zero))) & 1);
+
+    for (size_t offset = PatternSize; offset < PAGE_SIZE; offset += PatternSize)
+    {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(page + offset));
+        const __m256i previous = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(page + offset - sizeof(uint64_t)));
+
+        any = _mm256_or_si256(any, v);
+        diff = _mm256_or_si256(diff, _mm256_xor_si256(v, first));
+        repeats += std::popcount(static_cast<unsigned int>(_mm256_movemask_pd(_mm256_castsi256_pd(
+            _mm256_or_si256(_mm256_cmpeq_epi64(v, zero), _mm256_cmpeq_epi64(v, previous))))));
+    }
+
+    result.Zero = _mm256_testz_si256(any, any) != 0;
+    result.Pattern = _mm256_testz_si256(diff, diff) != 0;
+    result.RepeatWords = static_cast<uint16_t>(repeats);
+}
+
+} //namespace
+
+/// <summary>
+/// Estimate the compressed size of the page: the repeated words cost a bit each,
+/// the rest is coded with the order-0 entropy.
+/// </summary>
+/// <param name="repeatWords">Words which are zero or repeat the previous one</param>
+/// <param name="entropySum">Sum of c * log2(c) over the byte histogram in the fixed point</param>
+/// <returns>Size in bytes</returns>
+uint32_t PTE::PageClassifier::EstimateCompressed(uint32_t repeatWords, uint64_t entropySum)
+{
+    //
+    // Bits per byte in the fixed point: log2(N) - sum(c * log2(c)) / N
+    const uint64_t bitsPerByte = (PageBits << EntropyShift) - entropySum / PAGE_SIZE;
+    const uint64_t literalBytes = (Words - repeatWords) * sizeof(uint64_t);
+    const uint64_t size = ((literalBytes * bitsPerByte) >> (EntropyShift + 3)) + (repeatWords + 7) / 8;
+
+    return static_cast<uint32_t>(std::min<uint64_t>(size, PAGE_SIZE));
+}
+
+/// <summary>
+/// Classify the content of a page.
+/// </summary>
+/// <param name="page">PAGE_SIZE bytes</param>
+/// <param name="impl">The implementation to use</param>
+/// <returns>The estimates</returns>
+PTE::PageClass PTE::PageClassifier::Classify(const uint8_t* page, Impl impl)
+{
+    if (impl == Impl::Auto)
+    {
+        impl = CpuFeatures::HasAvx2() ? Impl::Avx2 : Impl::Scalar;
+    }
+
+    PageClass result;
+    if (impl == Impl::Avx2)
+    {
+        ScanAvx2(page, result);
+    }
+    else
+    {
+        ScanScalar(page, result);
+    }
+
+    result.Pattern = result.Pattern && !result.Zero;
+
+    //
+    // Zero page: no need for the histogram.
+    // Pattern page: the histogram of the pattern is the same, up to the scale.
+    uint64_t entropySum{ 0 };
+    if (result.Zero)
+    {
+        entropySum = GetEntropyTable()[PAGE_SIZE];
+    }
+    else
+    {
+        uint32_t histogram[256];
+        if (result.Pattern)
+        {
+            CountBytes(page, PatternSize, PAGE_SIZE / PatternSize, histogram);
+        }
+        else
+        {
+            CountBytes(page, PAGE_SIZE, 1, histogram);
+        }
+
+        entropySum = impl == Impl::Avx2 ? SumEntropyAvx2(histogram) : SumEntropyScalar(histogram);
+    }
+
+    result.Entropy = static_cast<float>(PageBits - static_cast<double>(entropySum) / PAGE_SIZE / (1 << EntropyShift));
+    result.CompressedBytes = EstimateCompressed(result.RepeatWords, entropySum);
+
+    return result;
+}
@@ -0,0 +1,65 @@
+/*
+	page_classify.h
+
+	Classification of the page content: zero, repeated pattern, entropy.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "include.h"
+
+namespace PTE
+{
+
+/// <summary>
+/// Content estimates of a single page.
+/// </summary>
+struct PageClass
+{
+	//
+	// All the bytes are zero
+	bool Zero{ false };
+
+	//
+	// Not zero, but repeats its first 32 bytes, which covers all the periods dividing 32
+	bool Pattern{ false };
+
+	//
+	// 8-byte words which are zero or equal to the previous word
+	uint16_t RepeatWords{ 0 };
+
+	//
+	// Order-0 byte entropy, 0..8 bits per byte
+	float Entropy{ 0 };
+
+	//
+	// Estimated size after compression
+	uint32_t CompressedBytes{ 0 };
+};
+
+/// <summary>
+/// Classifies the page content with vector kernels.
+/// </summary>
+class PageClassifier
+{
+public:
+	//
+	// Classifier implementation, Auto picks the best one supported by the CPU.
+	enum class Impl
+	{
+		Auto,
+		Scalar,
+		Avx2
+	};
+
+	static PageClass Classify(const uint8_t* page, Impl impl = Impl::Auto);
+
+private:
+	static uint32_t EstimateCompressed(uint32_t repeatWords, uint64_t entropySum);
+};
+
+} //namespace PTE
@@ -0,0 +1,290 @@
+/*
+    page_dedupe.cpp
+
+    Search of the pages with the same content.
+    The resident pages of the processes are hashed as they are read and
+    the hashes are counted in an index of a fixed size, so any amount of
+    memory is scanned in a bounded space. Frames mapped by several processes
+    are counted once, they are already shared. The counted frames are kept
+    in a bitmap of the RAM ranges, so its size does not depend on the frames
+    of the device memory the processes map.
+    Pages with equal hashes are assumed to be equal, with 64-bit hashes
+    a false match is unlikely below billions of pages.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "page_dedupe.h"
+#include "census.h"
+#include "page_hash.h"
+#include "page_scan.h"
+#include "ram_map.h"
+#include <algorithm>
+#include <bit>
+#include <format>
+#include <fstream>
+#include <mutex>
+
+/// <summary>
+/// Number of the frames in the cluster.
+/// </summary>
+uint64_t PTE::DedupeCluster::Frames() const
+{
+    uint64_t frames{ 0 };
+    for (uint32_t count : KindFrames)
+    {
+        frames += count;
+    }
+
+    return frames;
+}
+
+/// <summary>
+/// Create the index.
+/// </summary>
+/// <param name="capacity">Number of the slots, rounded up to a power of two</param>
+PTE::DedupeIndex::DedupeIndex(size_t capacity)
+{
+    m_slots.resize(std::bit_ceil(std::max<size_t>(capacity, 1024)));
+}
+
+/// <summary>
+/// Check if the hash is in the sampled part of the hash space.
+/// </summary>
+bool PTE::DedupeIndex::IsSampled(uint64_t hash) const
+{
+    return m_shift == 0 || (hash >> (64 - m_shift)) == 0;
+}
+
+/// <summary>
+/// Put the cluster into a free slot, the slot is found by linear probing.
+/// </summary>
+void PTE::DedupeIndex::Insert(const DedupeCluster& cluster)
+{
+    const size_t mask = m_slots.size() - 1;
+
+    for (size_t slot = cluster.Hash & mask; ; slot = (slot + 1) & mask)
+    {
+        if (m_slots[slot].Frames() == 0)
+        {
+            m_slots[slot] = cluster;
+            ++m_used;
+            return;
+        }
+    }
+}
+
+/// <summary>
+/// Halve the sampled part of the hash space and drop the clusters outside of it.
+/// The table is rebuilt into a new array, which doubles the memory for a moment.
+/// </summary>
+void PTE::DedupeIndex::RaiseSampleShift()
+{
+    do
+    {
+        ++m_shift;
+
+        std::vector<DedupeCluster> previous(m_slots.size());
+        previous.swap(m_slots);
+        m_used = 0;
+
+        for (const auto& cluster : previous)
+        {
+            if (cluster.Frames() != 0 && IsSampled(cluster.Hash))
+            {
+                Insert(cluster);
+            }
+        }
+    } while (m_used > m_slots.size() / 2 && m_shift < 63);
+}
+
+/// <summary>
+/// Count a frame.
+/// </summary>
+/// <param name="hash">Hash of the content</param>
+/// <param name="kind">MEMORY_KIND of the region</param>
+/// <param name="pid">Process id</param>
+/// <param name="va">Virtual address of the page</param>
+void PTE::DedupeIndex::Add(uint64_t hash, uint32_t kind, ULONG pid, uint64_t va)
+{
+    if (!IsSampled(hash))
+    {
+        return;
+    }
+
+    const size_t mask = m_slots.size() - 1;
+
+    for (size_t slot = hash & mask; ; slot = (slot + 1) & mask)
+    {
+        DedupeCluster& cluster = m_slots[slot];
+
+        if (cluster.Frames() == 0)
+        {
+            cluster.Hash = hash;
+            cluster.KindFrames[kind] = 1;
+            cluster.Pid = pid;
+            cluster.VA = va;
+            cluster.Kind = kind;
+            break;
+        }
+        if (cluster.Hash == hash)
+        {
+            ++cluster.KindFrames[kind];
+            return;
+        }
+    }
+
+    //
+    // Linear probing slows down quickly above 3/4 of the slots used.
+    if (++m_used > m_slots.size() / 4 * 3)
+    {
+        RaiseSampleShift();
+    }
+}
+
+/// <summary>
+/// Fill the totals and the biggest clusters.
+/// </summary>
+/// <param name="report">The report to fill</param>
+/// <param name="topCount">Number of the clusters to keep</param>
+void PTE::DedupeIndex::Finish(DedupeReport& report, size_t topCount) const
+{
+    //
+    // Every sampled cluster stands for 2^shift clusters of the whole hash space.
+    const double scale = static_cast<double>(1ull << m_shift);
+    std::vector<DedupeCluster> duplicates;
+
+    report.SampleShift = m_shift;
+    report.DistinctSampled = m_used;
+
+    for (const auto& cluster : m_slots)
+    {
+        if (cluster.Frames() < 2)
+        {
+            continue;
+        }
+
+        //
+        // One copy is kept, in the region it was found first.
+        for (uint32_t kind = 0; kind < MEMORY_KIND_COUNT; ++kind)
+        {
+            report.SavedFrames[kind] += (cluster.KindFrames[kind] - (kind == cluster.Kind ? 1 : 0)) * scale;
+        }
+        duplicates.push_back(cluster);
+    }
+
+    topCount = std::min(topCount, duplicates.size());
+    std::partial_sort(duplicates.begin(), duplicates.begin() + topCount, duplicates.end(),
+        [](const DedupeCluster& left, const DedupeCluster& right)
+        {
+            return left.Frames() > right.Frames();
+        });
+    duplicates.resize(topCount);
+
+    report.TopClusters = std::move(duplicates);
+}
+
+/// <summary>
+/// Scan the resident memory of the processes.
+/// </summary>
+/// <param name="pids">Processes to scan, all the accessible ones if empty</param>
+/// <param name="threads">Number of worker threads, 0 to use all the cores</param>
+/// <param name="capacity">Number of the index slots</param>
+/// <returns>The report</returns>
+PTE::DedupeReport PTE::PageDedupe::Run(const std::vector<ULONG>& pids, unsigned int threads, size_t capacity)
+{
+    const std::vector<ULONG> targets = Census::Targets(pids);
+
+    DedupeReport report;
+    DedupeIndex index(capacity);
+    std::mutex lock;
+
+    //
+    // Bit per frame of the RAM already counted, the frames outside of the RAM are not counted.
+    FrameBitmap seen(RamMap::System());
+
+    auto errors = PageScanner::Run(targets, threads, [&](ULONG pid, const ScannedPage* pages, const uint8_t* data, size_t count)
+        {
+            //
+            // Hashing is done by the workers in parallel, only the index update is serialized.
+            uint64_t hashes[PageScanner::ChunkPages];
+            PageHash::HashPages(data, count, hashes);
+
+            std::lock_guard<std::mutex> guard(lock);
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (!seen.TestAndSet(pages[i].pfn))
+                {
+                    continue;
+                }
+
+                ++report.ScannedFrames;
+                index.Add(hashes[i], pages[i].kind, pid, pages[i].va);
+            }
+        });
+
+    for (size_t i = 0; i < targets.size(); ++i)
+    {
+        if (errors[i] != ERROR_SUCCESS)
+        {
+            report.Errors.emplace_back(targets[i], errors[i]);
+        }
+    }
+
+    index.Finish(report, 100);
+
+    return report;
+}
+
+/// <summary>
+/// Write the report as CSV: the totals in the comments and a line per cluster.
+/// </summary>
+/// <param name="path">Report path</param>
+/// <param name="report">The report</param>
+/// <param name="elapsedMs">Duration of the scan</param>
+/// <returns>True on success</returns>
+bool PTE::PageDedupe::WriteReport(const std::wstring& path, const DedupeReport& report, uint64_t elapsedMs)
+{
+    std::ofstream out(path, std::ios::out | std::ios::trunc);
+    if (!out)
+    {
+        return false;
+    }
+
+    const double saved = report.SavedFrames[MEMORY_KIND_IMAGE] +
+        report.SavedFrames[MEMORY_KIND_MAPPED] +
+        report.SavedFrames[MEMORY_KIND_PRIVATE];
+
+    out << std::format("# scanned_kb={} saved_kb={:.0f} saved_image_kb={:.0f} saved_mapped_kb={:.0f} saved_private_kb={:.0f} sample=1/{}\n",
+        report.ScannedFrames * PAGE_SIZE / 1024,
+        saved * PAGE_SIZE / 1024,
+        report.SavedFrames[MEMORY_KIND_IMAGE] * PAGE_SIZE / 1024,
+        report.SavedFrames[MEMORY_KIND_MAPPED] * PAGE_SIZE / 1024,
+        report.SavedFrames[MEMORY_KIND_PRIVATE] * PAGE_SIZE / 1024,
+        1ull << report.SampleShift);
+
+    out << "hash,frames,image_frames,mapped_frames,private_frames,pid,va\n";
+
+    for (const auto& cluster : report.TopClusters)
+    {
+        out << std::format("{:016x},{},{},{},{},{},0x{:x}\n",
+            cluster.Hash,
+            cluster.Frames(),
+            cluster.KindFrames[MEMORY_KIND_IMAGE],
+            cluster.KindFrames[MEMORY_KIND_MAPPED],
+            cluster.KindFrames[MEMORY_KIND_PRIVATE],
+            cluster.Pid,
+            cluster.VA);
+    }
+
+    for (const auto& [pid, err] : report.Errors)
+    {
+        out << std::format("# pid {} error {}\n", pid, err);
+    }
+
+    out << std::format("# {} distinct pages sampled in {} ms\n", report.DistinctSampled, elapsedMs);
+
+    return static_cast<bool>(out);
+}
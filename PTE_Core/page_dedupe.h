@@ -0,0 +1,105 @@
+/*
+	page_dedupe.h
+
+	Search of the pages with the same content.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "include.h"
+#include "shared_frames.h"
+
+namespace PTE
+{
+
+/// <summary>
+/// Frames with the same content.
+/// </summary>
+struct DedupeCluster
+{
+	uint64_t Hash{ 0 };
+
+	//
+	// Number of the frames by the kind of the region they were found in
+	uint32_t KindFrames[MEMORY_KIND_COUNT]{ };
+
+	//
+	// The first frame seen, to find the content in the memory view
+	ULONG Pid{ 0 };
+	uint64_t VA{ 0 };
+	uint32_t Kind{ 0 };
+
+	uint64_t Frames() const;
+};
+
+/// <summary>
+/// Result of the scan.
+/// The frames are counted once however many processes map them.
+/// </summary>
+struct DedupeReport
+{
+	uint64_t ScannedFrames{ 0 };
+
+	//
+	// Frames which would be freed if the copies were merged, by the kind of the region.
+	// Estimated from the sampled clusters when the index was full.
+	double SavedFrames[MEMORY_KIND_COUNT]{ };
+
+	//
+	// The hashes below 2^(64 - SampleShift) were indexed
+	uint32_t SampleShift{ 0 };
+	uint64_t DistinctSampled{ 0 };
+
+	//
+	// Biggest clusters, the largest first
+	std::vector<DedupeCluster> TopClusters;
+
+	//
+	// Processes which could not be scanned
+	std::vector<std::pair<ULONG, unsigned long>> Errors;
+};
+
+/// <summary>
+/// Hash index of a fixed size.
+/// When it fills up, only the hashes with the next top bit clear are kept,
+/// so a sampled cluster always has all its frames and the totals can be scaled.
+/// </summary>
+class DedupeIndex
+{
+public:
+	explicit DedupeIndex(size_t capacity);
+
+	void Add(uint64_t hash, uint32_t kind, ULONG pid, uint64_t va);
+	void Finish(DedupeReport& report, size_t topCount) const;
+
+private:
+	bool IsSampled(uint64_t hash) const;
+	void Insert(const DedupeCluster& cluster);
+	void RaiseSampleShift();
+
+	std::vector<DedupeCluster> m_slots;
+	size_t m_used{ 0 };
+	uint32_t m_shift{ 0 };
+};
+
+/// <summary>
+/// Finds the resident pages of the processes with the same content and
+/// estimates how much memory the same-page merging could save.
+/// </summary>
+class PageDedupe
+{
+public:
+	//
+	// Default number of the index slots, 40MB
+	static constexpr size_t DefaultCapacity = 1 << 20;
+
+	static DedupeReport Run(const std::vector<ULONG>& pids, unsigned int threads, size_t capacity = DefaultCapacity);
+	static bool WriteReport(const std::wstring& path, const DedupeReport& report, uint64_t elapsedMs);
+};
+
+} //namespace PTE
@@ -0,0 +1,205 @@
+/*
+    page_hash.cpp
+
+    Content hash of the memory pages.
+    The page is consumed in 64-byte stripes by eight 64-bit accumulators,
+    the same scheme as XXH3: every lane multiplies the low and the high half
+    of the data mixed with a key and adds the raw data to the neighbour lane.
+    The key changes with every stripe and the accumulators are scrambled
+    every 1KB, so moving the content within the page changes the hash.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "page_hash.h"
+#include "cpu_features.h"
+#include <cstring>
+#include <immintrin.h>
+
+namespace
+{
+
+constexpr size_t Lanes = 8;
+constexpr size_t StripeSize = Lanes * sizeof(uint64_t);
+constexpr size_t StripesPerBlock = 16;
+constexpr size_t Blocks = PAGE_SIZE / (StripeSize * StripesPerBlock);
+
+constexpr uint64_t Prime32_1 = 0x9E3779B1ull;
+constexpr uint64_t Prime64_1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t Prime64_2 = 0xC2B2AE3D27D4EB4Full;
+
+alignas(32) const uint64_t s_init[Lanes] = {
+    0x00000000C2B2AE3Dull, 0x9E3779B185EBCA87ull, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull,
+    0x85EBCA77C2B2AE63ull, 0x0000000085EBCA77ull, 0x27D4EB2F165667C5ull, 0x000000009E3779B1ull };
+
+//
+// Key of the first stripe and its increment per stripe, both from the XXH3 default secret.
+alignas(32) const uint64_t s_key[Lanes] = {
+    0xbe4ba423396cfeb8ull, 0x1cad21f72c81017cull, 0xdb979083e96dd4deull, 0x1f67b3b7a4a44072ull,
+    0x78e5c0cc4ee679cbull, 0x2172ffcc7dd05a82ull, 0x8e2443f7744608b8ull, 0x4c263a81e69035e0ull };
+alignas(32) const uint64_t s_step[Lanes] = {
+    0xcb00c391bb52283dull, 0xa32e531b8b65d088ull, 0x4ef90da297486471ull, 0xd8acdea946ef1938ull,
+    0x3f349ce33f76faa8ull, 0x1d4f0bc7c7bbdcf9ull, 0x3159b4cd4be0518aull, 0x647378d9c97e9fc8ull };
+alignas(32) const uint64_t s_scramble[Lanes] = {
+    0xc3ebd33483acc5eaull, 0xeb6313faffa081c5ull, 0x49daf0b751dd0d17ull, 0x9e68d429265516d3ull,
+    0xfca1477d58be162bull, 0xce31d07ad1b8f88full, 0x280416958f3acb45ull, 0x7e404bbbcafbd7afull };
+
+/// <summary>
+/// Final mix of a 64-bit value (MurmurHash3 fmix64).
+/// </summary>
+uint64_t Mix(uint64_t value)
+{
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdull;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ull;
+    value ^= value >> 33;
+
+    return value;
+}
+
+/// <summary>
+/// Fold the accumulators into the hash.
+/// </summary>
+uint64_t Merge(const uint64_t* acc)
+{
+    uint64_t hash = PAGE_SIZE * Prime64_1;
+
+    for (size_t lane = 0; lane < Lanes; ++lane)
+    {
+        hash = (hash ^ Mix(acc[lane] ^ s_key[lane])) * Prime64_2;
+    }
+
+    return Mix(hash);
+}
+
+/// <summary>
+/// Reference implementation.
+/// </summary>
+uint64_t HashScalar(const uint8_t* page)
+{
+    uint64_t acc[Lanes];
+    uint64_t key[Lanes];
+    memcpy(acc, s_init, sizeof(acc));
+    memcpy(key, s_key, sizeof(key));
+
+    for (size_t block = 0; block < Blocks; ++block)
+    {
+        for (size_t stripe = 0; stripe < StripesPerBlock; ++stripe, page += StripeSize)
+        {
+            for (size_t lane = 0; lane < Lanes; ++lane)
+            {
+                uint64_t data;
+                memcpy(&data, page + lane * sizeof(uint64_t), sizeof(data));
+
+                const uint64_t mixed = data ^ key[lane];
+                acc[lane ^ 1] += data;
+                acc[lane] += (mixed & 0xFFFFFFFF) * (mixed >> 32);
+                key[lane] += s_step[lane];
+            }
+        }
+
+        for (size_t lane = 0; lane < Lanes; ++lane)
+        {
+            acc[lane] = ((acc[lane] ^ (acc[lane] >> 47)) ^ s_scramble[lane]) * Prime32_1;
+        }
+    }
+
+    return Merge(acc);
+}
+
+/// <summary>
+/// Scramble four accumulators. AVX2 has no 64-bit multiply,
+/// the 32-bit constant multiplies both halves separately.
+/// </summary>
+PTE_TARGET_AVX2 inline __m256i ScrambleAvx2(__m256i acc, __m256i key)
+{
+    const __m256i prime = _mm256_set1_epi64x(Prime32_1);
+    const __m256i mixed = _mm256_xor_si256(_mm256_xor_si256(acc, _mm256_srli_epi64(acc, 47)), key);
+    const __m256i lo = _mm256_mul_epu32(mixed, prime);
+    const __m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(mixed, 32), prime);
+
+    return _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32));
+}
+
+/// <summary>
+/// AVX2 implementation, a stripe is two registers.
+/// The neighbour lanes are the 64-bit halves of a 128-bit lane, swapped by a single shuffle.
+/// </summary>
+PTE_TARGET_AVX2 uint64_t HashAvx2(const uint8_t* page)
+{
+    __m256i acc0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(s_init));
+    __m256i acc1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(s_init + 4));
+    __m256i key0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(s_key));
+    __m256i key1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(s_key + 4));
+    const __m256i step0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(s_step));
+    const __m256i step1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(s_step + 4));
+    const __m256i scramble0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(s_scramble));
+    const __m256i scramble1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(s_scramble + 4));
+
+    for (size_t block = 0; block < Blocks; ++block)
+    {
+        for (size_t stripe = 0; stripe < StripesPerBlock; ++stripe, page += StripeSize)
+        {
+            const __m256i data0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(page));
+            const __m256i data1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(page + 32));
+            const __m256i mixed0 = _mm256_xor_si256(data0, key0);
+            const __m256i mixed1 = _mm256_xor_si256(data1, key1);
+
+            acc0 = _mm256_add_epi64(acc0, _mm256_shuffle_epi32(data0, _MM_SHUFFLE(1, 0, 3, 2)));
+            acc1 = _mm256_add_epi64(acc1, _mm256_shuffle_epi32(data1, _MM_SHUFFLE(1, 0, 3, 2)));
+            acc0 = _mm256_add_epi64(acc0, _mm256_mul_epu32(mixed0, _mm256_srli_epi64(mixed0, 32)));
+            acc1 = _mm256_add_epi64(acc1, _mm256_mul_epu32(mixed1, _mm256_srli_epi64(mixed1, 32)));
+            key0 = _mm256_add_epi64(key0, step0);
+            key1 = _mm256_add_epi64(key1, step1);
+        }
+
+        acc0 = ScrambleAvx2(acc0, scramble0);
+        acc1 = ScrambleAvx2(acc1, scramble1);
+    }
+
+    alignas(32) uint64_t acc[Lanes];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(acc), acc0);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(acc + 4), acc1);
+
+    return Merge(acc);
+}
+
+} //namespace
+
+/// <summary>
+/// Hash a page.
+/// </summary>
+/// <param name="page">PAGE_SIZE bytes</param>
+/// <param name="impl">The implementation to use</param>
+/// <returns>The hash</returns>
+uint64_t PTE::PageHash::Hash(const uint8_t* page, Impl impl)
+{
+    if (impl == Impl::Auto)
+    {
+        impl = CpuFeatures::HasAvx2() ? Impl::Avx2 : Impl::Scalar;
+    }
+
+    return impl == Impl::Avx2 ? HashAvx2(page) : HashScalar(page);
+}
+
+/// <summary>
+/// Hash consecutive pages.
+/// </summary>
+/// <param name="pages">count * PAGE_SIZE bytes</param>
+/// <param name="count">Number of pages</param>
+/// <param name="hashes">Hash per page</param>
+/// <param name="impl">The implementation to use</param>
+void PTE::PageHash::HashPages(const uint8_t* pages, size_t count, uint64_t* hashes, Impl impl)
+{
+    if (impl == Impl::Auto)
+    {
+        impl = CpuFeatures::HasAvx2() ? Impl::Avx2 : Impl::Scalar;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        hashes[i] = impl == Impl::Avx2 ? HashAvx2(pages + i * PAGE_SIZE) : HashScalar(pages + i * PAGE_SIZE);
+    }
+}
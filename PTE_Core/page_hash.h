@@ -0,0 +1,38 @@
+/*
+	page_hash.h
+
+	Content hash of the memory pages.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "include.h"
+
+namespace PTE
+{
+
+/// <summary>
+/// 64-bit hash of a whole page, used to find the pages with the same content.
+/// All the implementations return the same value.
+/// </summary>
+class PageHash
+{
+public:
+	//
+	// Hash implementation, Auto picks the best one supported by the CPU.
+	enum class Impl
+	{
+		Auto,
+		Scalar,
+		Avx2
+	};
+
+	static uint64_t Hash(const uint8_t* page, Impl impl = Impl::Auto);
+	static void HashPages(const uint8_t* pages, size_t count, uint64_t* hashes, Impl impl = Impl::Auto);
+};
+
+} //namespace PTE
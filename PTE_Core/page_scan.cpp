@@ -0,0 +1,240 @@
+/*
+    page_scan.cpp
+
+    Bulk reading of the resident pages of the processes.
+    The readable committed regions are cut into table windows, the page
+    tables of every window are read by the driver at once and the present
+    leaf entries select the pages read with ReadProcessMemory.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "page_scan.h"
+#include "census.h"
+#include "shared_frames.h"
+#include "timeline.h"
+#include "utils.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+PTE::PageScanner::PageScanner()
+{
+    m_device = Utils::OpenDevice();
+    m_deviceError = m_device == INVALID_HANDLE_VALUE ? GetLastError() : ERROR_SUCCESS;
+    m_buffer = BufferPool<IOCTL_ENUM_DATA>::Acquire();
+    m_data.resize(ChunkPages * PAGE_SIZE);
+}
+
+PTE::PageScanner::~PageScanner()
+{
+    if (m_device != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_device);
+    }
+}
+
+/// <summary>
+/// Pass the batch to the callback.
+/// </summary>
+void PTE::PageScanner::Flush()
+{
+    if (m_count != 0)
+    {
+        (*m_callback)(m_pid, m_pages, m_data.data(), m_count);
+        m_count = 0;
+    }
+}
+
+/// <summary>
+/// Read the pages of a range mapped by a single leaf entry.
+/// </summary>
+/// <param name="hProcess">Process handle</param>
+/// <param name="start">Start of the range, page aligned</param>
+/// <param name="end">End of the range, page aligned</param>
+/// <param name="leaf">The leaf entry mapping the range</param>
+/// <param name="range">The part of the region holding the range</param>
+void PTE::PageScanner::ReadRun(HANDLE hProcess, uint64_t start, uint64_t end, const LeafMapping& leaf, const Range& range)
+{
+    for (uint64_t va = start; va < end; )
+    {
+        const size_t pages = static_cast<size_t>(std::min<uint64_t>((end - va) / PAGE_SIZE, ChunkPages - m_count));
+        uint8_t* data = m_data.data() + m_count * PAGE_SIZE;
+
+        //
+        // The whole part at once, then page by page if some of them could not be read.
+        SIZE_T read{ 0 };
+        if (ReadProcessMemory(hProcess, reinterpret_cast<LPCVOID>(va), data, pages * PAGE_SIZE, &read))
+        {
+            for (size_t i = 0; i < pages; ++i, va += PAGE_SIZE)
+            {
+                m_pages[m_count++] = { .va = va, .pfn = (leaf.pa + (va - leaf.va)) >> 12, .kind = range.kind, .region = range.region };
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < pages; ++i, va += PAGE_SIZE)
+            {
+                if (ReadProcessMemory(hProcess, reinterpret_cast<LPCVOID>(va), m_data.data() + m_count * PAGE_SIZE, PAGE_SIZE, &read) &&
+                    read == PAGE_SIZE)
+                {
+                    m_pages[m_count++] = { .va = va, .pfn = (leaf.pa + (va - leaf.va)) >> 12, .kind = range.kind, .region = range.region };
+                }
+            }
+        }
+
+        if (m_count == ChunkPages)
+        {
+            Flush();
+        }
+    }
+}
+
+/// <summary>
+/// Read all the resident pages of the process.
+/// </summary>
+/// <param name="pid">Process id</param>
+/// <param name="callback">Called with every batch of the pages</param>
+/// <returns>Win32 error code, 0 on success</returns>
+unsigned long PTE::PageScanner::Scan(ULONG pid, const Callback& callback)
+{
+    if (m_device == INVALID_HANDLE_VALUE || !m_buffer)
+    {
+        return m_buffer ? m_deviceError : ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    m_regions.clear();
+
+    HANDLE hProcess = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, pid);
+    if (!hProcess)
+    {
+        return GetLastError();
+    }
+
+    unsigned long err = Regions::Enumerate(hProcess, m_regions);
+
+    //
+    // Guard pages would be committed by the read, the other ones would fail.
+    // The uncached and write-combined views are usually device memory,
+    // reading it may have side effects and its content is not a page of the RAM.
+    m_ranges.clear();
+    for (uint32_t index = 0; index < m_regions.size(); ++index)
+    {
+        const Region& region = m_regions[index];
+
+        if (region.State != MEM_COMMIT || (region.Protect & (PAGE_NOACCESS | PAGE_GUARD | PAGE_NOCACHE | PAGE_WRITECOMBINE)) != 0)
+        {
+            continue;
+        }
+
+        const uint64_t regionEnd = region.BaseAddress + region.RegionSize;
+        for (uint64_t start = region.BaseAddress; start < regionEnd; )
+        {
+            const uint64_t end = std::min(regionEnd, (start & ~(TableWindow - 1)) + TableWindow);
+            m_ranges.push_back({ .start = start, .end = end, .kind = SharedFrames::KindOf(region.Type), .region = index });
+            start = end;
+        }
+    }
+
+    m_pid = pid;
+    m_callback = &callback;
+    m_count = 0;
+
+    //
+    // One page tables snapshot per window, covering all the ranges in it.
+    for (size_t first = 0; first < m_ranges.size() && err == ERROR_SUCCESS; )
+    {
+        const uint64_t window = m_ranges[first].start & ~(TableWindow - 1);
+        size_t last = first;
+        while (last < m_ranges.size() && (m_ranges[last].start & ~(TableWindow - 1)) == window)
+        {
+            ++last;
+        }
+
+        err = Utils::ReadPageTables(m_device, pid, m_buffer.Get(), m_tables, m_ranges[first].start, m_ranges[last - 1].end);
+        if (err != ERROR_SUCCESS)
+        {
+            break;
+        }
+
+        //
+        // Both the leaves and the ranges are in the address order.
+        size_t range = first;
+        m_tables.ForEachLeaf([&](const LeafMapping& leaf)
+            {
+                while (range < last && m_ranges[range].end <= leaf.va)
+                {
+                    ++range;
+                }
+
+                for (size_t r = range; r < last && m_ranges[r].start < leaf.va + leaf.size; ++r)
+                {
+                    const uint64_t start = std::max(leaf.va, m_ranges[r].start);
+                    const uint64_t end = std::min(leaf.va + leaf.size, m_ranges[r].end);
+                    if (start < end)
+                    {
+                        ReadRun(hProcess, start, end, leaf, m_ranges[r]);
+                    }
+                }
+            });
+
+        first = last;
+    }
+
+    Flush();
+    m_callback = nullptr;
+
+    CloseHandle(hProcess);
+
+    return err;
+}
+
+/// <summary>
+/// Get the regions of the last scanned process.
+/// </summary>
+/// <returns>The regions, sorted by the base address</returns>
+const std::vector<PTE::Region>& PTE::PageScanner::GetRegions() const
+{
+    return m_regions;
+}
+
+/// <summary>
+/// Scan the processes on a pool of worker threads.
+/// The callback is called concurrently and must synchronize itself.
+/// </summary>
+/// <param name="pids">Processes to scan</param>
+/// <param name="threads">Number of worker threads, 0 to use all the cores</param>
+/// <param name="callback">Called with every batch of the pages</param>
+/// <returns>Win32 error code per process</returns>
+std::vector<unsigned long> PTE::PageScanner::Run(const std::vector<ULONG>& pids, unsigned int threads, const Callback& callback)
+{
+    std::vector<unsigned long> errors(pids.size(), ERROR_SUCCESS);
+
+    threads = Census::ThreadCount(threads, pids.size());
+
+    std::atomic<size_t> next{ 0 };
+    std::vector<std::thread> workers;
+
+    for (unsigned int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&]()
+            {
+                Timeline::NameThread("scan worker");
+
+                PageScanner scanner;
+
+                for (size_t i = next++; i < pids.size(); i = next++)
+                {
+                    errors[i] = scanner.Scan(pids[i], callback);
+                }
+            });
+    }
+
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    return errors;
+}
@@ -0,0 +1,99 @@
+/*
+	page_scan.h
+
+	Bulk reading of the resident pages of the processes.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "buffer_pool.h"
+#include "include.h"
+#include "page_tables.h"
+#include "regions.h"
+
+namespace PTE
+{
+
+/// <summary>
+/// A resident page read by the scanner.
+/// </summary>
+struct ScannedPage
+{
+	uint64_t va;
+	uint64_t pfn;
+
+	//
+	// MEMORY_KIND of the region
+	uint32_t kind;
+
+	//
+	// Index of the region in PageScanner::GetRegions()
+	uint32_t region;
+};
+
+/// <summary>
+/// Reads the content of the pages which are present in the page tables,
+/// so the scan does not fault in the paged out memory.
+/// The pages are passed to the callback in batches of at most ChunkPages.
+/// </summary>
+class PageScanner
+{
+public:
+	//
+	// Pages read at once
+	static constexpr size_t ChunkPages = 64;
+
+	//
+	// Range of the page tables snapshot, bounds the memory used for the tables.
+	static constexpr uint64_t TableWindow = 1ull << 30;
+
+	//
+	// Called with the process, the pages and their content, PAGE_SIZE bytes per page.
+	using Callback = std::function<void(ULONG pid, const ScannedPage* pages, const uint8_t* data, size_t count)>;
+
+	PageScanner();
+	~PageScanner();
+	PageScanner(const PageScanner&) = delete;
+	PageScanner& operator=(const PageScanner&) = delete;
+
+	unsigned long Scan(ULONG pid, const Callback& callback);
+	const std::vector<Region>& GetRegions() const;
+
+	static std::vector<unsigned long> Run(const std::vector<ULONG>& pids, unsigned int threads, const Callback& callback);
+
+private:
+	//
+	// Readable committed part of a region within a single table window
+	struct Range
+	{
+		uint64_t start;
+		uint64_t end;
+		uint32_t kind;
+		uint32_t region;
+	};
+
+	void ReadRun(HANDLE hProcess, uint64_t start, uint64_t end, const LeafMapping& leaf, const Range& range);
+	void Flush();
+
+	HANDLE m_device{ INVALID_HANDLE_VALUE };
+	unsigned long m_deviceError{ ERROR_SUCCESS };
+	BufferPool<IOCTL_ENUM_DATA>::Lease m_buffer;
+	PageTables m_tables;
+	std::vector<Region> m_regions;
+	std::vector<Range> m_ranges;
+
+	//
+	// The batch being filled
+	ULONG m_pid{ 0 };
+	const Callback* m_callback{ nullptr };
+	std::vector<uint8_t> m_data;
+	ScannedPage m_pages[ChunkPages]{ };
+	size_t m_count{ 0 };
+};
+
+} //namespace PTE
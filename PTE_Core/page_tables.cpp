@@ -0,0 +1,114 @@
+/*
+    page_tables.cpp
+
+    Decoding of the paging structures snapshot.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "page_tables.h"
+#include "ia32.hpp"
+
+/// <summary>
+/// Count the tables of the level in the snapshot.
+/// </summary>
+/// <param name="level">TABLE_LEVEL</param>
+/// <returns>Number of tables</returns>
+size_t PTE::PageTables::TableCount(ULONG level) const
+{
+    size_t count{ 0 };
+
+    for (const auto& table : Tables)
+    {
+        if (table.level == level)
+        {
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+/// <summary>
+/// Drop the snapshot content.
+/// </summary>
+void PTE::PageTables::Clear()
+{
+    CR3 = 0;
+    PAT = 0;
+    Tables.clear();
+}
+
+/// <summary>
+/// Add the tables of an enumeration response, the responses come in the walk order.
+/// </summary>
+/// <param name="response">The driver response</param>
+void PTE::PageTables::Append(const IOCTL_ENUM_RESPONSE& response)
+{
+    CR3 = response.regCR3;
+    PAT = response.regPAT;
+    Tables.insert(Tables.end(), response.tables, response.tables + response.count);
+}
+
+/// <summary>
+/// Check if a present entry maps the memory rather than pointing to the next table.
+/// </summary>
+/// <param name="level">TABLE_LEVEL of the table holding the entry</param>
+/// <param name="entry">Raw entry</param>
+/// <returns>True for the leaf entries</returns>
+bool PTE::PageTables::IsLeaf(ULONG level, uint64_t entry)
+{
+    switch (level)
+    {
+    case TABLE_LEVEL_PT:
+        return true;
+    case TABLE_LEVEL_PD:
+        return PDE_64_LARGE_PAGE(entry) != 0;
+    case TABLE_LEVEL_PDP:
+        return PDPTE_64_LARGE_PAGE(entry) != 0;
+    default:
+        return false;
+    }
+}
+
+/// <summary>
+/// Size of the memory covered by a single entry of the table.
+/// </summary>
+/// <param name="level">TABLE_LEVEL</param>
+/// <returns>Size in bytes</returns>
+uint64_t PTE::PageTables::EntrySize(ULONG level)
+{
+    static const uint64_t s_levelShift[TABLE_LEVEL_COUNT] = { 39, 30, 21, 12 };
+
+    return 1ull << s_levelShift[level < TABLE_LEVEL_COUNT ? level : TABLE_LEVEL_PT];
+}
+
+/// <summary>
+/// Decode a leaf entry.
+/// </summary>
+/// <param name="level">TABLE_LEVEL of the table holding the entry</param>
+/// <param name="va">The first virtual address mapped by the entry</param>
+/// <param name="entry">Raw entry</param>
+/// <returns>The mapping</returns>
+PTE::LeafMapping PTE::PageTables::MakeLeaf(ULONG level, uint64_t va, uint64_t entry)
+{
+    LeafMapping leaf{ .va = va, .pa = 0, .size = EntrySize(level), .entry = entry, .level = level };
+
+    //
+    // Large pages keep PAT in the bit 12, so their frame number starts higher.
+    switch (level)
+    {
+    case TABLE_LEVEL_PDP:
+        leaf.pa = PDPTE_1GB_64_PAGE_FRAME_NUMBER(entry) << 30;
+        break;
+    case TABLE_LEVEL_PD:
+        leaf.pa = PDE_2MB_64_PAGE_FRAME_NUMBER(entry) << 21;
+        break;
+    default:
+        leaf.pa = PTE_64_PAGE_FRAME_NUMBER(entry) << 12;
+        break;
+    }
+
+    return leaf;
+}
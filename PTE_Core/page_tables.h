@@ -0,0 +1,115 @@
+/*
+	page_tables.h
+
+	Snapshot of the process paging structures returned by the driver.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "include.h"
+
+namespace PTE
+{
+
+/// <summary>
+/// A leaf entry of the page tables: a virtual range mapped to the physical memory.
+/// </summary>
+struct LeafMapping
+{
+	uint64_t va;
+	uint64_t pa;
+
+	//
+	// 4KB, 2MB or 1GB
+	uint64_t size;
+
+	//
+	// Raw value of the leaf entry
+	uint64_t entry;
+
+	//
+	// TABLE_LEVEL of the table holding the entry
+	ULONG level;
+};
+
+/// <summary>
+/// Copy of the paging structures of a single process.
+/// </summary>
+class PageTables
+{
+public:
+	/// <summary>
+	/// Call the function for every present leaf entry in the virtual address order.
+	/// </summary>
+	/// <param name="func">Callable taking const LeafMapping&</param>
+	template <typename F>
+	void ForEachLeaf(F&& func) const
+	{
+		size_t cursor = 0;
+		while (cursor < Tables.size())
+		{
+			WalkTable(cursor, func);
+		}
+	}
+
+	size_t TableCount(ULONG level) const;
+
+	void Clear();
+	void Append(const IOCTL_ENUM_RESPONSE& response);
+
+	//
+	// CR3 of the process, as read by the driver.
+	uint64_t CR3{ 0 };
+
+	//
+	// IA32_PAT, as read by the driver.
+	uint64_t PAT{ 0 };
+
+	//
+	// The tables in the (baseVA, level) order, which is the depth-first walk order.
+	std::vector<TABLE_PAGE> Tables;
+
+private:
+	static bool IsLeaf(ULONG level, uint64_t entry);
+	static LeafMapping MakeLeaf(ULONG level, uint64_t va, uint64_t entry);
+	static uint64_t EntrySize(ULONG level);
+
+	/// <summary>
+	/// Walk the table at the cursor and all the tables below it.
+	/// Child tables directly follow their parent entry in the walk order.
+	/// </summary>
+	template <typename F>
+	void WalkTable(size_t& cursor, F& func) const
+	{
+		const TABLE_PAGE& table = Tables[cursor++];
+		const uint64_t size = EntrySize(table.level);
+
+		for (uint64_t i = 0; i < TABLE_SIZE; ++i)
+		{
+			const uint64_t entry = table.entries[i];
+			const uint64_t va = table.baseVA + i * size;
+
+			if ((entry & 1) == 0)
+			{
+				continue;
+			}
+
+			if (IsLeaf(table.level, entry))
+			{
+				func(MakeLeaf(table.level, va, entry));
+			}
+			else if (cursor < Tables.size() &&
+				Tables[cursor].level == table.level + 1 &&
+				Tables[cursor].baseVA == va)
+			{
+				WalkTable(cursor, func);
+			}
+		}
+	}
+};
+
+} //namespace PTE
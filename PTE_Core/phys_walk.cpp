@@ -0,0 +1,397 @@
+/*
+    phys_walk.cpp
+
+    Page walks over an image of the physical memory.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "phys_walk.h"
+#include "ia32.hpp"
+#include "stage_timer.h"
+#include "timeline.h"
+#include <cstring>
+
+namespace
+{
+
+//
+// Size of the memory covered by a single entry for each level.
+constexpr ULONG s_levelShift[TABLE_LEVEL_COUNT] = { 39, 30, 21, 12 };
+
+/// <summary>
+/// Index of the entry translating the address in the table of the level.
+/// </summary>
+inline size_t EntryIndex(ULONG level, uint64_t va)
+{
+    return (va >> s_levelShift[level]) % TABLE_SIZE;
+}
+
+/// <summary>
+/// Check if a present entry maps the memory rather than pointing to the next table.
+/// </summary>
+inline bool IsLeaf(ULONG level, uint64_t entry)
+{
+    return level == TABLE_LEVEL_PT || (level != TABLE_LEVEL_PML4 && PDE_64_LARGE_PAGE(entry));
+}
+
+/// <summary>
+/// Physical address of the memory mapped by a leaf entry.
+/// Large pages keep PAT in the bit 12, so their frame number starts higher.
+/// </summary>
+inline uint64_t LeafFrame(ULONG level, uint64_t entry)
+{
+    switch (level)
+    {
+    case TABLE_LEVEL_PDP:
+        return PDPTE_1GB_64_PAGE_FRAME_NUMBER(entry) << 30;
+    case TABLE_LEVEL_PD:
+        return PDE_2MB_64_PAGE_FRAME_NUMBER(entry) << 21;
+    default:
+        return PTE_64_PAGE_FRAME_NUMBER(entry) << 12;
+    }
+}
+
+/// <summary>
+/// Physical address of the table a non-leaf entry points to.
+/// </summary>
+inline uint64_t NextTable(uint64_t entry)
+{
+    return PDE_64_PAGE_FRAME_NUMBER(entry) << 12;
+}
+
+/// <summary>
+/// Read an entry of a table, the tables outside the memory read as not present.
+/// </summary>
+inline uint64_t ReadEntry(const uint64_t* table, size_t index)
+{
+    return table != nullptr ? table[index] : 0;
+}
+
+} //namespace
+
+/// <summary>
+/// Create the walker.
+/// </summary>
+/// <param name="memory">The physical memory</param>
+/// <param name="cr3">CR3 of the address space</param>
+PTE::PhysicalWalker::PhysicalWalker(const PhysicalView& memory, uint64_t cr3) :
+    m_memory(memory),
+    m_cr3(cr3)
+{
+}
+
+/// <summary>
+/// Walk the tables for a single address.
+/// </summary>
+/// <param name="va">Virtual address</param>
+/// <param name="result">The physical address and the entries read</param>
+/// <returns>True if the address is mapped</returns>
+bool PTE::PhysicalWalker::Translate(uint64_t va, Translation& result) const
+{
+    result = { };
+
+    const uint64_t* table = m_memory.Table(CR3_ADDRESS_OF_PAGE_DIRECTORY(m_cr3) << 12);
+    for (ULONG level = TABLE_LEVEL_PML4; level < TABLE_LEVEL_COUNT && table != nullptr; ++level)
+    {
+        const uint64_t entry = table[EntryIndex(level, va)];
+        result.Entries[result.Depth++] = entry;
+
+        if (!PTE_64_PRESENT(entry))
+        {
+            return false;
+        }
+
+        if (IsLeaf(level, entry))
+        {
+            result.PageSize = 1ull << s_levelShift[level];
+            result.PA = LeafFrame(level, entry) + (va & (result.PageSize - 1));
+            return true;
+        }
+
+        table = m_memory.Table(NextTable(entry));
+    }
+
+    return false;
+}
+
+/// <summary>
+/// Translate many addresses, the entries of the upper levels are kept while the addresses
+/// stay under them, so sorted or clustered addresses mostly read a single entry.
+/// </summary>
+/// <param name="addresses">Virtual addresses</param>
+/// <param name="count">Number of the addresses</param>
+/// <param name="pa">Physical addresses, 0 for the addresses not mapped</param>
+/// <param name="pageSize">Page sizes, 0 for the addresses not mapped</param>
+void PTE::PhysicalWalker::TranslateBatch(const uint64_t* addresses, size_t count, uint64_t* pa, uint64_t* pageSize) const
+{
+    TimelineScope scope(TimelineCategory::Walk, "translate batch", count);
+
+    const uint64_t* pml4 = m_memory.Table(CR3_ADDRESS_OF_PAGE_DIRECTORY(m_cr3) << 12);
+
+    //
+    // The entries of the last walk and the address bits above them.
+    uint64_t pml4Tag{ ~0ull };
+    uint64_t pdpTag{ ~0ull };
+    uint64_t pdTag{ ~0ull };
+    uint64_t pml4e{ 0 };
+    uint64_t pdpte{ 0 };
+    uint64_t pde{ 0 };
+    const uint64_t* pt{ nullptr };
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint64_t va = addresses[i];
+        pa[i] = 0;
+        pageSize[i] = 0;
+
+        if ((va >> 39) != pml4Tag)
+        {
+            pml4Tag = va >> 39;
+            pml4e = ReadEntry(pml4, EntryIndex(TABLE_LEVEL_PML4, va));
+            pdpTag = ~0ull;
+        }
+        if (!PML4E_64_PRESENT(pml4e))
+        {
+            continue;
+        }
+
+        if ((va >> 30) != pdpTag)
+        {
+            pdpTag = va >> 30;
+            pdpte = ReadEntry(m_memory.Table(NextTable(pml4e)), EntryIndex(TABLE_LEVEL_PDP, va));
+            pdTag = ~0ull;
+        }
+        if (!PDPTE_64_PRESENT(pdpte))
+        {
+            continue;
+        }
+        if (PDPTE_64_LARGE_PAGE(pdpte))
+        {
+            pa[i] = LeafFrame(TABLE_LEVEL_PDP, pdpte) + (va & ((1ull << 30) - 1));
+            pageSize[i] = 1ull << 30;
+            continue;
+        }
+
+        if ((va >> 21) != pdTag)
+        {
+            pdTag = va >> 21;
+            pde = ReadEntry(m_memory.Table(NextTable(pdpte)), EntryIndex(TABLE_LEVEL_PD, va));
+            pt = PDE_64_PRESENT(pde) && !PDE_64_LARGE_PAGE(pde) ? m_memory.Table(NextTable(pde)) : nullptr;
+        }
+        if (!PDE_64_PRESENT(pde))
+        {
+            continue;
+        }
+        if (PDE_64_LARGE_PAGE(pde))
+        {
+            pa[i] = LeafFrame(TABLE_LEVEL_PD, pde) + (va & ((1ull << 21) - 1));
+            pageSize[i] = 1ull << 21;
+            continue;
+        }
+
+        const uint64_t pte = ReadEntry(pt, EntryIndex(TABLE_LEVEL_PT, va));
+        if (PTE_64_PRESENT(pte))
+        {
+            pa[i] = LeafFrame(TABLE_LEVEL_PT, pte) + (va & (PAGE_SIZE - 1));
+            pageSize[i] = PAGE_SIZE;
+        }
+    }
+}
+
+/// <summary>
+/// Fill the response the way the driver does for IOCTL_CODE: the present entries
+/// of every table on the path, the entries translating the address and the content of the page.
+/// The walk stops at the large pages.
+/// </summary>
+/// <param name="va">Virtual address</param>
+/// <param name="response">Zeroed response, as the application sends it</param>
+void PTE::PhysicalWalker::Analyze(uint64_t va, IOCTL_RESPONSE& response) const
+{
+    TimelineScope scope(TimelineCategory::Walk, "analyze");
+    StageTimer walkTimer(response.times, TIMING_STAGE_WALK);
+
+    PHYSICAL_ADDRESS* frames[TABLE_LEVEL_COUNT] = { response.pa47_39, response.pa38_30, response.pa29_21, response.pa20_12 };
+    uint64_t* flags[TABLE_LEVEL_COUNT] = { &response.flagsPML4, &response.flagsPDP, &response.flagsPD, &response.flagsPT };
+
+    Translation translation;
+    const bool mapped = Translate(va, translation);
+
+    response.physAddress.QuadPart = static_cast<LONGLONG>(translation.PA);
+    response.regCR3 = m_cr3;
+
+    const uint64_t* table = m_memory.Table(CR3_ADDRESS_OF_PAGE_DIRECTORY(m_cr3) << 12);
+    for (ULONG level = TABLE_LEVEL_PML4; level < TABLE_LEVEL_COUNT && table != nullptr; ++level)
+    {
+        const uint64_t entry = table[EntryIndex(level, va)];
+        *flags[level] = entry;
+
+        for (size_t i = 0; i < TABLE_SIZE; ++i)
+        {
+            if (PTE_64_PRESENT(table[i]))
+            {
+                frames[level][i].QuadPart = static_cast<LONGLONG>(PTE_64_PAGE_FRAME_NUMBER(table[i]) << 12);
+            }
+        }
+
+        if (!PTE_64_PRESENT(entry) || IsLeaf(level, entry))
+        {
+            break;
+        }
+
+        table = m_memory.Table(NextTable(entry));
+    }
+
+    walkTimer.Stop();
+    StageTimer copyTimer(response.times, TIMING_STAGE_COPY);
+
+    const uint8_t* page = mapped ? m_memory.Page(translation.PA) : nullptr;
+    if (page != nullptr)
+    {
+        memcpy(response.Buffer.data(), page, PAGE_SIZE);
+    }
+}
+
+/// <summary>
+/// Copy the tables the way the driver does for IOCTL_ENUM_CODE.
+/// </summary>
+/// <param name="request">The enumeration request</param>
+/// <param name="response">The response</param>
+void PTE::PhysicalWalker::EnumTables(const IOCTL_ENUM_REQUEST& request, IOCTL_ENUM_RESPONSE& response) const
+{
+    response.count = 0;
+    response.nextVA = request.startVA;
+    response.nextLevel = request.startLevel;
+    response.regCR3 = m_cr3;
+    response.complete = EnumTable(TABLE_LEVEL_PML4, CR3_ADDRESS_OF_PAGE_DIRECTORY(m_cr3) << 12, 0, request, response);
+}
+
+/// <summary>
+/// Copy the tables of a range the way Utils::ReadPageTables reads them from the driver.
+/// </summary>
+/// <param name="data">Buffer of the requests</param>
+/// <param name="tables">The tables of the range</param>
+/// <param name="startVA">Start of the range</param>
+/// <param name="endVA">End of the range</param>
+/// <param name="tableBudget">Tables to copy at most</param>
+/// <returns>ERROR_NOT_ENOUGH_QUOTA if the range holds more tables than the budget, the tables
+/// copied until then are kept</returns>
+unsigned long PTE::PhysicalWalker::ReadPageTables(IOCTL_ENUM_DATA* data,
+    PageTables& tables,
+    uint64_t startVA,
+    uint64_t endVA,
+    uint64_t tableBudget) const
+{
+    tables.Clear();
+
+    data->request.startVA = startVA;
+    data->request.startLevel = TABLE_LEVEL_PML4;
+    data->request.endVA = endVA;
+    data->request.parents = startVA != 0;
+
+    TimelineScope scope(TimelineCategory::Walk, "read tables");
+
+    do
+    {
+        {
+            TimelineScope request(TimelineCategory::Request, "enum");
+            EnumTables(data->request, data->response);
+            request.SetArg(data->response.count);
+        }
+
+        //
+        // A real hierarchy has a table per 2MB at most, the hostile ones
+        // point all the entries to the same tables to get 512 times more.
+        if (tables.Tables.size() + data->response.count > tableBudget)
+        {
+            data->response.count = static_cast<ULONG>(tableBudget - tables.Tables.size());
+            tables.Append(data->response);
+            return ERROR_NOT_ENOUGH_QUOTA;
+        }
+
+        tables.Append(data->response);
+
+        data->request.startVA = data->response.nextVA;
+        data->request.startLevel = data->response.nextLevel;
+        data->request.parents = false;
+    } while (!data->response.complete && data->response.count != 0);
+
+    return ERROR_SUCCESS;
+}
+
+/// <summary>
+/// Copy a table and the tables below it into the response.
+/// </summary>
+/// <param name="level">Level of the table</param>
+/// <param name="pa">Physical address of the table</param>
+/// <param name="baseVA">The first virtual address translated through the table</param>
+/// <param name="request">The enumeration request</param>
+/// <param name="response">The response</param>
+/// <returns>False if the response is full</returns>
+bool PTE::PhysicalWalker::EnumTable(ULONG level,
+    uint64_t pa,
+    uint64_t baseVA,
+    const IOCTL_ENUM_REQUEST& request,
+    IOCTL_ENUM_RESPONSE& response) const
+{
+    const uint64_t* entries = m_memory.Table(pa);
+    if (entries == nullptr)
+    {
+        return true;
+    }
+
+    //
+    // Tables before the resume point were returned by the previous request,
+    // but their entries still need to be followed.
+    if (baseVA > request.startVA ||
+        (baseVA == request.startVA && level >= request.startLevel) ||
+        (request.parents && baseVA < request.startVA))
+    {
+        if (response.count == ENUM_TABLES_PER_REQUEST)
+        {
+            response.nextVA = baseVA;
+            response.nextLevel = level;
+            return false;
+        }
+
+        TABLE_PAGE& table = response.tables[response.count++];
+        table.baseVA = baseVA;
+        table.physAddress.QuadPart = static_cast<LONGLONG>(pa);
+        table.level = level;
+        table.reserved = 0;
+        memcpy(table.entries, entries, PAGE_SIZE);
+    }
+
+    if (level == TABLE_LEVEL_PT)
+    {
+        return true;
+    }
+
+    for (size_t i = 0; i < TABLE_SIZE; ++i)
+    {
+        const uint64_t entryVA = baseVA + (static_cast<uint64_t>(i) << s_levelShift[level]);
+        const uint64_t entryEnd = entryVA + (1ull << s_levelShift[level]);
+
+        if (entryEnd <= request.startVA)
+        {
+            continue;
+        }
+        if (entryVA >= request.endVA)
+        {
+            break;
+        }
+
+        if (!PDE_64_PRESENT(entries[i]) || IsLeaf(level, entries[i]))
+        {
+            continue;
+        }
+
+        if (!EnumTable(level + 1, NextTable(entries[i]), entryVA, request, response))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,103 @@
+/*
+	phys_walk.h
+
+	Page walks over an image of the physical memory, the walks the driver
+	does over the live memory.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "include.h"
+#include "page_tables.h"
+
+namespace PTE
+{
+
+/// <summary>
+/// A view of the physical memory, the physical address is the offset in the view.
+/// </summary>
+struct PhysicalView
+{
+	const uint8_t* Base{ nullptr };
+	uint64_t Size{ 0 };
+
+	/// <summary>
+	/// The page holding the physical address.
+	/// </summary>
+	/// <returns>The page or nullptr if it is outside the view</returns>
+	const uint8_t* Page(uint64_t pa) const
+	{
+		pa &= ~static_cast<uint64_t>(PAGE_SIZE - 1);
+		return Size >= PAGE_SIZE && pa <= Size - PAGE_SIZE ? Base + pa : nullptr;
+	}
+
+	/// <summary>
+	/// The table at the physical address.
+	/// </summary>
+	/// <returns>The entries or nullptr if the table is outside the view</returns>
+	const uint64_t* Table(uint64_t pa) const
+	{
+		return reinterpret_cast<const uint64_t*>(Page(pa));
+	}
+};
+
+/// <summary>
+/// Result of a single walk.
+/// </summary>
+struct Translation
+{
+	uint64_t PA{ 0 };
+
+	//
+	// 4KB, 2MB or 1GB, 0 if the address is not mapped
+	uint64_t PageSize{ 0 };
+
+	//
+	// Number of the entries read, the entries in the walk order
+	ULONG Depth{ 0 };
+	uint64_t Entries[TABLE_LEVEL_COUNT]{ };
+};
+
+/// <summary>
+/// Walks the hierarchy of a CR3 in the physical memory view.
+/// Tables outside the view end the walk as if the entry was not present.
+/// The images may come from crash dumps or be hostile: the frame numbers are masked,
+/// a walk never goes deeper than the four levels and the enumeration of the tables
+/// is limited by a budget, as the entries pointing to the same tables multiply them.
+/// </summary>
+class PhysicalWalker
+{
+public:
+	//
+	// Tables an enumeration copies at most by default, 1GB of copies
+	static constexpr uint64_t DefaultTableBudget = 1ull << 18;
+
+	PhysicalWalker(const PhysicalView& memory, uint64_t cr3);
+
+	bool Translate(uint64_t va, Translation& result) const;
+	void TranslateBatch(const uint64_t* addresses, size_t count, uint64_t* pa, uint64_t* pageSize) const;
+
+	void Analyze(uint64_t va, IOCTL_RESPONSE& response) const;
+	void EnumTables(const IOCTL_ENUM_REQUEST& request, IOCTL_ENUM_RESPONSE& response) const;
+	unsigned long ReadPageTables(IOCTL_ENUM_DATA* data,
+		PageTables& tables,
+		uint64_t startVA = 0,
+		uint64_t endVA = ~0ull,
+		uint64_t tableBudget = DefaultTableBudget) const;
+
+private:
+	bool EnumTable(ULONG level,
+		uint64_t pa,
+		uint64_t baseVA,
+		const IOCTL_ENUM_REQUEST& request,
+		IOCTL_ENUM_RESPONSE& response) const;
+
+	PhysicalView m_memory;
+	uint64_t m_cr3;
+};
+
+} //namespace PTE
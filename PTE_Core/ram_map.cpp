@@ -0,0 +1,373 @@
+/*
+    ram_map.cpp
+
+    Frame ranges of the physical RAM and the frame bitmaps bounded by them.
+    On Windows the ranges come from the physical memory resource list the
+    kernel publishes in the registry, the same list RAMMap shows.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "ram_map.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#ifdef _WIN32
+namespace
+{
+
+//
+// CM_RESOURCE_LIST layout, the structures are not in the user mode headers.
+// A full descriptor starts with the interface type, the bus number, the version,
+// the revision and the count of the partial descriptors of 20 bytes each.
+constexpr size_t FullDescriptorHeaderSize = 16;
+constexpr size_t PartialDescriptorSize = 20;
+constexpr uint8_t ResourceTypeMemory = 3;
+constexpr uint8_t ResourceTypeMemoryLarge = 7;
+constexpr uint16_t MemoryLarge40 = 0x200;
+constexpr uint16_t MemoryLarge48 = 0x400;
+constexpr uint16_t MemoryLarge64 = 0x800;
+
+/// <summary>
+/// Read a little endian value of the resource list.
+/// </summary>
+template <typename T>
+T ReadField(const uint8_t* data)
+{
+    T value;
+    memcpy(&value, data, sizeof(value));
+
+    return value;
+}
+
+} //namespace
+
+/// <summary>
+/// Load the RAM ranges of the system.
+/// Without the resource list all the frames below the installed memory and 4GB more,
+/// for the device hole below 4GB, are taken as RAM.
+/// </summary>
+/// <returns>Win32 error code, 0 on success</returns>
+unsigned long PTE::RamMap::LoadSystem()
+{
+    m_ranges.clear();
+
+    const wchar_t* key = L"HARDWARE\\RESOURCEMAP\\System Resources\\Physical Memory";
+    DWORD size{ 0 };
+    LSTATUS err = RegGetValueW(HKEY_LOCAL_MACHINE, key, L".Translated", RRF_RT_ANY, nullptr, nullptr, &size);
+
+    std::vector<uint8_t> list(size);
+    if (err == ERROR_SUCCESS)
+    {
+        err = RegGetValueW(HKEY_LOCAL_MACHINE, key, L".Translated", RRF_RT_ANY, nullptr, list.data(), &size);
+    }
+
+    if (err == ERROR_SUCCESS && size >= sizeof(ULONG))
+    {
+        const uint32_t fullCount = ReadField<uint32_t>(list.data());
+        size_t offset = sizeof(ULONG);
+
+        for (uint32_t full = 0; full < fullCount && offset + FullDescriptorHeaderSize <= size; ++full)
+        {
+            const uint32_t partialCount = ReadField<uint32_t>(list.data() + offset + 12);
+            offset += FullDescriptorHeaderSize;
+
+            for (uint32_t partial = 0; partial < partialCount && offset + PartialDescriptorSize <= size; ++partial)
+            {
+                const uint8_t* descriptor = list.data() + offset;
+                const uint8_t type = descriptor[0];
+                const uint16_t flags = ReadField<uint16_t>(descriptor + 2);
+                const uint64_t start = ReadField<uint64_t>(descriptor + 4);
+                uint64_t length = ReadField<uint32_t>(descriptor + 12);
+
+                if (type == ResourceTypeMemoryLarge)
+                {
+                    length <<= (flags & MemoryLarge64) ? 32 : (flags & MemoryLarge48) ? 16 : (flags & MemoryLarge40) ? 8 : 0;
+                }
+                if ((type == ResourceTypeMemory || type == ResourceTypeMemoryLarge) && length != 0)
+                {
+                    AddRange(start / PAGE_SIZE, length / PAGE_SIZE);
+                }
+
+                offset += PartialDescriptorSize;
+            }
+        }
+    }
+
+    if (m_ranges.empty())
+    {
+        ULONGLONG installedKb{ 0 };
+        if (!GetPhysicallyInstalledSystemMemory(&installedKb))
+        {
+            return GetLastError();
+        }
+
+        AddRange(0, installedKb * 1024 / PAGE_SIZE + (1ull << 32) / PAGE_SIZE);
+    }
+
+    Finish();
+
+    return err == ERROR_SUCCESS ? ERROR_SUCCESS : static_cast<unsigned long>(err);
+}
+#endif
+
+/// <summary>
+/// Add a range of the RAM.
+/// </summary>
+/// <param name="firstPfn">The first frame</param>
+/// <param name="frames">Number of the frames</param>
+void PTE::RamMap::AddRange(uint64_t firstPfn, uint64_t frames)
+{
+    m_ranges.push_back({ .Start = firstPfn, .End = firstPfn + frames });
+}
+
+/// <summary>
+/// Sort the ranges and merge the adjacent and overlapping ones, called after the last AddRange.
+/// </summary>
+void PTE::RamMap::Finish()
+{
+    std::sort(m_ranges.begin(), m_ranges.end(), [](const Range& left, const Range& right)
+        {
+            return left.Start < right.Start;
+        });
+
+    std::vector<Range> merged;
+    for (const auto& range : m_ranges)
+    {
+        if (range.Start >= range.End)
+        {
+            continue;
+        }
+        if (!merged.empty() && range.Start <= merged.back().End)
+        {
+            merged.back().End = std::max(merged.back().End, range.End);
+            continue;
+        }
+        merged.push_back(range);
+    }
+
+    m_ranges = std::move(merged);
+}
+
+/// <summary>
+/// Check if the frame is in the RAM.
+/// </summary>
+bool PTE::RamMap::Contains(uint64_t pfn) const
+{
+    auto it = std::upper_bound(m_ranges.begin(), m_ranges.end(), pfn, [](uint64_t value, const Range& range)
+        {
+            return value < range.Start;
+        });
+
+    return it != m_ranges.begin() && pfn < (it - 1)->End;
+}
+
+/// <summary>
+/// Number of the frames of the RAM.
+/// </summary>
+uint64_t PTE::RamMap::Frames() const
+{
+    uint64_t frames{ 0 };
+    for (const auto& range : m_ranges)
+    {
+        frames += range.End - range.Start;
+    }
+
+    return frames;
+}
+
+/// <summary>
+/// The ranges, sorted by the start.
+/// </summary>
+const std::vector<PTE::RamMap::Range>& PTE::RamMap::Ranges() const
+{
+    return m_ranges;
+}
+
+#ifdef _WIN32
+/// <summary>
+/// Get the map of the system, loaded on the first call.
+/// </summary>
+const PTE::RamMap& PTE::RamMap::System()
+{
+    static const RamMap s_map = []()
+        {
+            RamMap map;
+            map.LoadSystem();
+            return map;
+        }();
+
+    return s_map;
+}
+#endif
+
+/// <summary>
+/// Create a clear bitmap of the RAM.
+/// </summary>
+/// <param name="map">The RAM ranges</param>
+PTE::FrameBitmap::FrameBitmap(const RamMap& map) :
+    m_ranges(map.Ranges())
+{
+    //
+    // The offset is the index of the word of the frame 0 as if the range began there,
+    // adding the word of a frame of the range wraps it back into the array.
+    for (const auto& range : m_ranges)
+    {
+        m_offsets.push_back(m_wordCount - range.Start / 64);
+        m_wordCount += (range.End + 63) / 64 - range.Start / 64;
+    }
+
+    m_words = std::make_unique<std::atomic<uint64_t>[]>(m_wordCount);
+}
+
+/// <summary>
+/// Find the range holding the frame.
+/// </summary>
+/// <returns>Index of the range, or the count of the ranges if the frame is not in the RAM</returns>
+size_t PTE::FrameBitmap::FindRange(uint64_t pfn) const
+{
+    auto it = std::upper_bound(m_ranges.begin(), m_ranges.end(), pfn, [](uint64_t value, const RamMap::Range& range)
+        {
+            return value < range.Start;
+        });
+    if (it == m_ranges.begin() || pfn >= (it - 1)->End)
+    {
+        return m_ranges.size();
+    }
+
+    return (it - m_ranges.begin()) - 1;
+}
+
+/// <summary>
+/// Set the bit of a frame.
+/// </summary>
+/// <param name="pfn">Frame number</param>
+/// <returns>True if the bit was clear, false if it was set or the frame is not in the RAM</returns>
+bool PTE::FrameBitmap::TestAndSet(uint64_t pfn)
+{
+    const size_t range = FindRange(pfn);
+    if (range == m_ranges.size())
+    {
+        return false;
+    }
+
+    const uint64_t bit = 1ull << (pfn % 64);
+
+    return (m_words[m_offsets[range] + pfn / 64].fetch_or(bit, std::memory_order_relaxed) & bit) == 0;
+}
+
+/// <summary>
+/// Set the bits of a run of frames, the part outside of the RAM is skipped.
+/// </summary>
+/// <param name="firstPfn">The first frame</param>
+/// <param name="frames">Number of the frames</param>
+void PTE::FrameBitmap::SetRange(uint64_t firstPfn, uint64_t frames)
+{
+    const uint64_t end = firstPfn + frames;
+    auto it = std::upper_bound(m_ranges.begin(), m_ranges.end(), firstPfn, [](uint64_t value, const RamMap::Range& range)
+        {
+            return value < range.Start;
+        });
+    if (it != m_ranges.begin())
+    {
+        --it;
+    }
+
+    for (; it != m_ranges.end() && it->Start < end; ++it)
+    {
+        const uint64_t first = std::max(firstPfn, it->Start);
+        const uint64_t last = std::min(end, it->End);
+        if (first >= last)
+        {
+            continue;
+        }
+
+        //
+        // Partial words at the ends, whole words in between.
+        std::atomic<uint64_t>* words = m_words.get() + m_offsets[it - m_ranges.begin()];
+        for (uint64_t pfn = first; pfn < last; )
+        {
+            const uint64_t wordEnd = std::min(last, (pfn | 63) + 1);
+            const uint64_t count = wordEnd - pfn;
+            const uint64_t mask = count == 64 ? ~0ull : ((1ull << count) - 1) << (pfn % 64);
+            words[pfn / 64].fetch_or(mask, std::memory_order_relaxed);
+            pfn = wordEnd;
+        }
+    }
+}
+
+/// <summary>
+/// Number of the frames set.
+/// </summary>
+uint64_t PTE::FrameBitmap::Count() const
+{
+    uint64_t count{ 0 };
+    for (size_t word = 0; word < m_wordCount; ++word)
+    {
+        count += std::popcount(m_words[word].load(std::memory_order_relaxed));
+    }
+
+    return count;
+}
+
+/// <summary>
+/// Number of the frames set in a run of frames.
+/// </summary>
+/// <param name="firstPfn">The first frame</param>
+/// <param name="frames">Number of the frames</param>
+uint64_t PTE::FrameBitmap::Count(uint64_t firstPfn, uint64_t frames) const
+{
+    uint64_t count{ 0 };
+    const uint64_t end = firstPfn + frames;
+
+    for (size_t range = 0; range < m_ranges.size(); ++range)
+    {
+        const uint64_t first = std::max(firstPfn, m_ranges[range].Start);
+        const uint64_t last = std::min(end, m_ranges[range].End);
+
+        for (uint64_t pfn = first; pfn < last; )
+        {
+            const uint64_t wordEnd = std::min(last, (pfn | 63) + 1);
+            const uint64_t bits = wordEnd - pfn;
+            const uint64_t mask = bits == 64 ? ~0ull : ((1ull << bits) - 1) << (pfn % 64);
+            count += std::popcount(m_words[m_offsets[range] + pfn / 64].load(std::memory_order_relaxed) & mask);
+            pfn = wordEnd;
+        }
+    }
+
+    return count;
+}
+
+/// <summary>
+/// The highest frame set.
+/// </summary>
+/// <returns>Frame number, 0 if none is set</returns>
+uint64_t PTE::FrameBitmap::HighestFrame() const
+{
+    for (size_t range = m_ranges.size(); range-- > 0; )
+    {
+        const size_t firstWord = m_offsets[range] + m_ranges[range].Start / 64;
+        const size_t endWord = range + 1 < m_ranges.size() ? m_offsets[range + 1] + m_ranges[range + 1].Start / 64 : m_wordCount;
+
+        for (size_t word = endWord; word-- > firstWord; )
+        {
+            const uint64_t bits = m_words[word].load(std::memory_order_relaxed);
+            if (bits != 0)
+            {
+                return (word - m_offsets[range]) * 64 + 63 - std::countl_zero(bits);
+            }
+        }
+    }
+
+    return 0;
+}
+
+/// <summary>
+/// The RAM ranges of the bitmap.
+/// </summary>
+const std::vector<PTE::RamMap::Range>& PTE::FrameBitmap::Ranges() const
+{
+    return m_ranges;
+}
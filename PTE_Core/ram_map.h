@@ -0,0 +1,81 @@
+/*
+	ram_map.h
+
+	Frame ranges of the physical RAM and the frame bitmaps bounded by them.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "include.h"
+
+namespace PTE
+{
+
+/// <summary>
+/// Frame ranges of the physical RAM, without the device memory and the holes between the ranges.
+/// </summary>
+class RamMap
+{
+public:
+	//
+	// [Start, End) frames
+	struct Range
+	{
+		uint64_t Start;
+		uint64_t End;
+	};
+
+	unsigned long LoadSystem();
+	void AddRange(uint64_t firstPfn, uint64_t frames);
+	void Finish();
+
+	bool Contains(uint64_t pfn) const;
+	uint64_t Frames() const;
+	const std::vector<Range>& Ranges() const;
+
+	static const RamMap& System();
+
+private:
+	//
+	// Sorted by the start, not overlapping
+	std::vector<Range> m_ranges;
+};
+
+/// <summary>
+/// Bit per frame of the RAM, the frames outside of it are ignored, so a mapping
+/// of the device memory far above the RAM does not grow the bitmap.
+/// The bits are set atomically, the workers can share a bitmap.
+/// </summary>
+class FrameBitmap
+{
+public:
+	explicit FrameBitmap(const RamMap& map);
+
+	bool TestAndSet(uint64_t pfn);
+	void SetRange(uint64_t firstPfn, uint64_t frames);
+
+	uint64_t Count() const;
+	uint64_t Count(uint64_t firstPfn, uint64_t frames) const;
+	uint64_t HighestFrame() const;
+
+	const std::vector<RamMap::Range>& Ranges() const;
+
+private:
+	size_t FindRange(uint64_t pfn) const;
+
+	//
+	// The RAM ranges, each with the index of its first word.
+	// A range starts at a multiple of 64 frames in the words.
+	std::vector<RamMap::Range> m_ranges;
+	std::vector<size_t> m_offsets;
+	size_t m_wordCount{ 0 };
+	std::unique_ptr<std::atomic<uint64_t>[]> m_words;
+};
+
+} //namespace PTE
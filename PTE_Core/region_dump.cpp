@@ -0,0 +1,422 @@
+/*
+    region_dump.cpp
+
+    Streaming dump of a virtual address range of the target process.
+    Two chunk buffers are used: the reader thread fills one of them with
+    the page content and the translation, while the other one is formatted
+    and written to the file.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "region_dump.h"
+#include "buffer_pool.h"
+#include "hex_dump.h"
+#include "numa.h"
+#include "timeline.h"
+#include "utils.h"
+#include "ia32.hpp"
+#include <io.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+//
+// Longest page header of the annotated output.
+constexpr size_t MaxAnnotationSize = 128;
+
+//
+// Newline after the partial last line of a page.
+constexpr size_t MaxPageOverhead = MaxAnnotationSize + 1;
+
+constexpr uint64_t PageMask = ~static_cast<uint64_t>(PAGE_SIZE - 1);
+
+/// <summary>
+/// A chunk of the range with its translation.
+/// </summary>
+struct Chunk
+{
+    //
+    // [start, end) part of the range, within a single ChunkSize window
+    uint64_t start{ 0 };
+    uint64_t end{ 0 };
+
+    //
+    // Content of the window, indexed by the offset from the window start
+    std::vector<uint8_t> data;
+
+    //
+    // Per page of the window
+    bool readable[PTE::RegionDump::ChunkPages]{ };
+    uint64_t phys[PTE::RegionDump::ChunkPages]{ };
+    uint64_t entry[PTE::RegionDump::ChunkPages]{ };
+    ULONG level[PTE::RegionDump::ChunkPages]{ };
+
+    uint64_t Window() const
+    {
+        return start & ~(PTE::RegionDump::ChunkSize - 1);
+    }
+};
+
+/// <summary>
+/// Double buffer shared by the reader thread and the writer.
+/// </summary>
+struct Pipeline
+{
+    std::mutex lock;
+    std::condition_variable changed;
+    Chunk slots[2];
+    bool full[2]{ };
+
+    //
+    // Set by the writer on error, the reader stops.
+    bool stop{ false };
+
+    //
+    // Set by the reader after the last chunk.
+    bool done{ false };
+};
+
+/// <summary>
+/// Where the pages come from.
+/// </summary>
+struct Source
+{
+    ULONG pid{ 0 };
+    HANDLE hProcess{ nullptr };
+    HANDLE device{ INVALID_HANDLE_VALUE };
+    IOCTL_ENUM_DATA* buffer{ nullptr };
+    PTE::PageTables tables;
+};
+
+/// <summary>
+/// Read the committed accessible pages of the chunk.
+/// </summary>
+/// <param name="source">The process</param>
+/// <param name="chunk">The chunk to fill</param>
+void ReadContent(Source& source, Chunk& chunk)
+{
+    const uint64_t window = chunk.Window();
+    const uint64_t first = chunk.start & PageMask;
+    const uint64_t last = (chunk.end + PAGE_SIZE - 1) & PageMask;
+
+    memset(chunk.data.data(), 0, chunk.data.size());
+    memset(chunk.readable, 0, sizeof(chunk.readable));
+
+    MEMORY_BASIC_INFORMATION mbi;
+    uint64_t address = first;
+
+    while (address < last &&
+        VirtualQueryEx(source.hProcess, reinterpret_cast<LPCVOID>(address), &mbi, sizeof(mbi)))
+    {
+        const uint64_t regionEnd = std::min(last, reinterpret_cast<uint64_t>(mbi.BaseAddress) + mbi.RegionSize);
+        if (regionEnd <= address)
+        {
+            break;
+        }
+
+        if (mbi.State == MEM_COMMIT && (mbi.Protect & (PAGE_NOACCESS | PAGE_GUARD)) == 0)
+        {
+            //
+            // The whole part at once, then page by page if some of them could not be read.
+            SIZE_T read{ 0 };
+            if (ReadProcessMemory(source.hProcess,
+                reinterpret_cast<LPCVOID>(address),
+                chunk.data.data() + (address - window),
+                regionEnd - address,
+                &read))
+            {
+                for (uint64_t page = address; page < regionEnd; page += PAGE_SIZE)
+                {
+                    chunk.readable[(page - window) / PAGE_SIZE] = true;
+                }
+            }
+            else
+            {
+                for (uint64_t page = address; page < regionEnd; page += PAGE_SIZE)
+                {
+                    chunk.readable[(page - window) / PAGE_SIZE] = ReadProcessMemory(source.hProcess,
+                        reinterpret_cast<LPCVOID>(page),
+                        chunk.data.data() + (page - window),
+                        PAGE_SIZE,
+                        &read) && read == PAGE_SIZE;
+                }
+            }
+        }
+
+        address = regionEnd;
+    }
+}
+
+/// <summary>
+/// Translate the pages of the chunk.
+/// Done after reading the content, so the pages read are resident.
+/// </summary>
+/// <param name="source">The process</param>
+/// <param name="chunk">The chunk to fill</param>
+void Translate(Source& source, Chunk& chunk)
+{
+    const uint64_t window = chunk.Window();
+    const uint64_t first = chunk.start & PageMask;
+
+    memset(chunk.phys, 0, sizeof(chunk.phys));
+    memset(chunk.entry, 0, sizeof(chunk.entry));
+    memset(chunk.level, 0, sizeof(chunk.level));
+
+    if (source.device == INVALID_HANDLE_VALUE ||
+        PTE::Utils::ReadPageTables(source.device, source.pid, source.buffer, source.tables, first, chunk.end) != ERROR_SUCCESS)
+    {
+        return;
+    }
+
+    source.tables.ForEachLeaf([&](const PTE::LeafMapping& leaf)
+        {
+            const uint64_t from = std::max(leaf.va, first);
+            const uint64_t to = std::min(leaf.va + leaf.size, chunk.end);
+
+            for (uint64_t page = from; page < to; page += PAGE_SIZE)
+            {
+                const size_t index = (page - window) / PAGE_SIZE;
+                chunk.phys[index] = leaf.pa + (page - leaf.va);
+                chunk.entry[index] = leaf.entry;
+                chunk.level[index] = leaf.level;
+            }
+        });
+}
+
+/// <summary>
+/// Write the page header of the annotated output.
+/// </summary>
+/// <returns>Number of characters written</returns>
+size_t WriteAnnotation(char* out, uint64_t page, const Chunk& chunk, size_t index)
+{
+    static const char* s_pageSize[TABLE_LEVEL_COUNT] = { "512GB", "1GB", "2MB", "4KB" };
+
+    if (!chunk.readable[index])
+    {
+        return snprintf(out, MaxAnnotationSize, "# 0x%012llx not readable\n", static_cast<unsigned long long>(page));
+    }
+    if (chunk.entry[index] == 0)
+    {
+        return snprintf(out, MaxAnnotationSize, "# 0x%012llx not translated\n", static_cast<unsigned long long>(page));
+    }
+
+    const uint64_t entry = chunk.entry[index];
+    const uint16_t node = PTE::NumaMap::System().NodeOf(chunk.phys[index] / PAGE_SIZE);
+
+    return snprintf(out, MaxAnnotationSize, "# 0x%012llx -> 0x%012llx node %d %s entry 0x%016llx%s%s%s%s%s%s\n",
+        static_cast<unsigned long long>(page),
+        static_cast<unsigned long long>(chunk.phys[index]),
+        node == PTE::NumaMap::UnknownNode ? -1 : static_cast<int>(node),
+        s_pageSize[chunk.level[index]],
+        static_cast<unsigned long long>(entry),
+        PTE_64_WRITE(entry) ? " RW" : " RO",
+        PTE_64_SUPERVISOR(entry) ? " US" : "",
+        PTE_64_ACCESSED(entry) ? " A" : "",
+        PTE_64_DIRTY(entry) ? " D" : "",
+        PTE_64_GLOBAL(entry) ? " G" : "",
+        PTE_64_EXECUTE_DISABLE(entry) ? " NX" : "");
+}
+
+/// <summary>
+/// Format the chunk.
+/// </summary>
+/// <returns>Number of characters written</returns>
+size_t FormatChunk(const Chunk& chunk, PTE::DumpFormat format, char* out)
+{
+    const uint64_t window = chunk.Window();
+    char* pos = out;
+
+    for (uint64_t va = chunk.start; va < chunk.end; )
+    {
+        const uint64_t pageEnd = std::min((va & PageMask) + PAGE_SIZE, chunk.end);
+        const size_t index = (va - window) / PAGE_SIZE;
+
+        if (format == PTE::DumpFormat::Annotated)
+        {
+            pos += WriteAnnotation(pos, va & PageMask, chunk, index);
+        }
+
+        if (chunk.readable[index])
+        {
+            const uint64_t phys = chunk.phys[index] ? chunk.phys[index] + (va & ~PageMask) : 0;
+            pos += PTE::HexDump::Format(va, phys, chunk.data.data() + (va - window), pageEnd - va, pos);
+
+            //
+            // Partial last line of the page is not terminated by the formatter.
+            if (pos[-1] != '\n')
+            {
+                *pos++ = '\n';
+            }
+        }
+
+        va = pageEnd;
+    }
+
+    return pos - out;
+}
+
+/// <summary>
+/// Write the whole buffer to the file.
+/// </summary>
+/// <returns>Win32 error code, 0 on success</returns>
+unsigned long WriteAll(int fd, const char* data, size_t len)
+{
+    PTE::TimelineScope scope(PTE::TimelineCategory::Export, "write chunk", len);
+
+    while (len != 0)
+    {
+        const unsigned int part = static_cast<unsigned int>(std::min<size_t>(len, 1u << 30));
+        const int written = _write(fd, data, part);
+        if (written <= 0)
+        {
+            return ERROR_WRITE_FAULT;
+        }
+
+        data += written;
+        len -= written;
+    }
+
+    return ERROR_SUCCESS;
+}
+
+/// <summary>
+/// Fill the chunks one after another until the end of the range.
+/// </summary>
+void ReadChunks(Source& source, Pipeline& pipeline, uint64_t start, uint64_t end)
+{
+    PTE::Timeline::NameThread("dump reader");
+    size_t slot = 0;
+
+    for (uint64_t va = start; va < end; slot ^= 1)
+    {
+        {
+            std::unique_lock<std::mutex> guard(pipeline.lock);
+            pipeline.changed.wait(guard, [&]() { return !pipeline.full[slot] || pipeline.stop; });
+            if (pipeline.stop)
+            {
+                return;
+            }
+        }
+
+        //
+        // The slot is owned by the reader until it is marked full.
+        Chunk& chunk = pipeline.slots[slot];
+        chunk.start = va;
+        chunk.end = std::min(end, (va & ~(PTE::RegionDump::ChunkSize - 1)) + PTE::RegionDump::ChunkSize);
+
+        {
+            PTE::TimelineScope scope(PTE::TimelineCategory::Request, "read content", chunk.end - chunk.start);
+            ReadContent(source, chunk);
+        }
+        Translate(source, chunk);
+
+        va = chunk.end;
+
+        std::lock_guard<std::mutex> guard(pipeline.lock);
+        pipeline.full[slot] = true;
+        pipeline.changed.notify_all();
+    }
+
+    std::lock_guard<std::mutex> guard(pipeline.lock);
+    pipeline.done = true;
+    pipeline.changed.notify_all();
+}
+
+} //namespace
+
+/// <summary>
+/// Dump the virtual address range of the process.
+/// </summary>
+/// <param name="pid">Process id</param>
+/// <param name="start">Start of the range</param>
+/// <param name="end">End of the range</param>
+/// <param name="format">Output format</param>
+/// <param name="fd">Open file descriptor, written sequentially</param>
+/// <returns>Win32 error code, 0 on success</returns>
+unsigned long PTE::RegionDump::Write(ULONG pid, uint64_t start, uint64_t end, DumpFormat format, int fd)
+{
+    if (start >= end)
+    {
+        return ERROR_INVALID_PARAMETER;
+    }
+
+    Source source;
+    source.pid = pid;
+    source.hProcess = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, pid);
+    if (!source.hProcess)
+    {
+        return GetLastError();
+    }
+
+    //
+    // Without the driver the content is still dumped, but not translated.
+    source.device = Utils::OpenDevice();
+    BufferPool<IOCTL_ENUM_DATA>::Lease buffer = BufferPool<IOCTL_ENUM_DATA>::Acquire();
+    source.buffer = buffer.Get();
+    if (source.buffer == nullptr && source.device != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(source.device);
+        source.device = INVALID_HANDLE_VALUE;
+    }
+
+    Pipeline pipeline;
+    for (auto& chunk : pipeline.slots)
+    {
+        chunk.data.resize(ChunkSize);
+    }
+    std::vector<char> text(format == DumpFormat::Raw ? 0 : HexDump::MaxFormattedSize(ChunkSize) + ChunkPages * MaxPageOverhead);
+
+    std::thread reader(ReadChunks, std::ref(source), std::ref(pipeline), start, end);
+
+    unsigned long err = ERROR_SUCCESS;
+    for (size_t slot = 0; err == ERROR_SUCCESS; slot ^= 1)
+    {
+        {
+            std::unique_lock<std::mutex> guard(pipeline.lock);
+            pipeline.changed.wait(guard, [&]() { return pipeline.full[slot] || pipeline.done; });
+            if (!pipeline.full[slot])
+            {
+                break;
+            }
+        }
+
+        const Chunk& chunk = pipeline.slots[slot];
+        if (format == DumpFormat::Raw)
+        {
+            err = WriteAll(fd, reinterpret_cast<const char*>(chunk.data.data()) + (chunk.start - chunk.Window()), chunk.end - chunk.start);
+        }
+        else
+        {
+            size_t size{ 0 };
+            {
+                TimelineScope scope(TimelineCategory::Export, "format chunk", chunk.end - chunk.start);
+                size = FormatChunk(chunk, format, text.data());
+            }
+            err = WriteAll(fd, text.data(), size);
+        }
+
+        std::lock_guard<std::mutex> guard(pipeline.lock);
+        pipeline.full[slot] = false;
+        pipeline.stop = err != ERROR_SUCCESS;
+        pipeline.changed.notify_all();
+    }
+
+    reader.join();
+
+    if (source.device != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(source.device);
+    }
+    CloseHandle(source.hProcess);
+
+    return err;
+}
@@ -0,0 +1,49 @@
+/*
+	region_dump.h
+
+	Streaming dump of a virtual address range of the target process.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <cstdint>
+#include "include.h"
+
+namespace PTE
+{
+
+//
+// Output of the dump.
+enum class DumpFormat
+{
+	//
+	// Same lines as the memory view
+	Hex,
+
+	//
+	// The bytes as is, unreadable pages are zero filled to keep the offsets
+	Raw,
+
+	//
+	// Hex lines preceded by the translation of every page
+	Annotated
+};
+
+/// <summary>
+/// Writes a range of any size using a fixed amount of memory.
+/// The pages are read in chunks on a separate thread while the previous chunk is formatted.
+/// </summary>
+class RegionDump
+{
+public:
+	//
+	// Pages read at once, the chunks are aligned to their size.
+	static constexpr size_t ChunkPages = 64;
+	static constexpr size_t ChunkSize = ChunkPages * PAGE_SIZE;
+
+	static unsigned long Write(ULONG pid, uint64_t start, uint64_t end, DumpFormat format, int fd);
+};
+
+} //namespace PTE
@@ -0,0 +1,152 @@
+/*
+    regions.cpp
+
+    Enumeration and diffing of the process virtual regions.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "regions.h"
+#include <algorithm>
+#include <bit>
+
+#ifdef _WIN32
+/// <summary>
+/// Get all the regions of the process.
+/// </summary>
+/// <param name="hProcess">Process handle</param>
+/// <param name="regions">The regions, sorted by the base address</param>
+/// <returns>Win32 error code, 0 on success</returns>
+unsigned long PTE::Regions::Enumerate(HANDLE hProcess, std::vector<Region>& regions)
+{
+    MEMORY_BASIC_INFORMATION mbi;
+    uint8_t* address = 0;
+
+    regions.clear();
+
+    while (VirtualQueryEx(hProcess, address, &mbi, sizeof(mbi)))
+    {
+        address += mbi.RegionSize;
+
+        regions.push_back({ .BaseAddress = std::bit_cast<ULONG_PTR>(mbi.BaseAddress),
+            .AllocationBase = std::bit_cast<ULONG_PTR>(mbi.AllocationBase),
+            .RegionSize = mbi.RegionSize,
+            .State = mbi.State,
+            .Protect = mbi.Protect,
+            .Type = mbi.Type });
+    }
+
+    //
+    // The walk always ends with ERROR_INVALID_PARAMETER past the last region.
+    unsigned long err = GetLastError();
+    return err == ERROR_INVALID_PARAMETER ? ERROR_SUCCESS : err;
+}
+#endif
+
+/// <summary>
+/// Compare two region lists in a single pass.
+/// </summary>
+/// <param name="previous">The old list, sorted by the base address</param>
+/// <param name="current">The new list, sorted by the base address</param>
+/// <returns>Added, removed and changed regions</returns>
+PTE::RegionDiff PTE::Regions::Diff(const std::vector<Region>& previous, const std::vector<Region>& current)
+{
+    RegionDiff diff;
+    size_t i = 0;
+    size_t j = 0;
+
+    while (i < previous.size() && j < current.size())
+    {
+        if (previous[i].BaseAddress < current[j].BaseAddress)
+        {
+            diff.Removed.push_back(previous[i++]);
+        }
+        else if (current[j].BaseAddress < previous[i].BaseAddress)
+        {
+            diff.Added.push_back(current[j++]);
+        }
+        else
+        {
+            if (previous[i] != current[j])
+            {
+                diff.Changed.push_back(current[j]);
+            }
+            ++i;
+            ++j;
+        }
+    }
+
+    diff.Removed.insert(diff.Removed.end(), previous.begin() + i, previous.end());
+    diff.Added.insert(diff.Added.end(), current.begin() + j, current.end());
+
+    return diff;
+}
+
+/// <summary>
+/// Find the region holding the address.
+/// </summary>
+/// <param name="regions">The regions, sorted by the base address</param>
+/// <param name="va">Virtual address</param>
+/// <returns>The region or nullptr</returns>
+const PTE::Region* PTE::Regions::Find(const std::vector<Region>& regions, uint64_t va)
+{
+    auto it = std::upper_bound(regions.begin(), regions.end(), va,
+        [](uint64_t address, const Region& region) { return address < region.BaseAddress; });
+    if (it == regions.begin())
+    {
+        return nullptr;
+    }
+
+    const Region& region = *--it;
+
+    return va - region.BaseAddress < region.RegionSize ? &region : nullptr;
+}
+
+/// <summary>
+/// Start at the lowest address.
+/// </summary>
+/// <param name="regions">The regions, sorted by the base address</param>
+PTE::RegionCursor::RegionCursor(const std::vector<Region>& regions) :
+    m_regions(regions)
+{
+}
+
+/// <summary>
+/// Find the region holding the address, at or above the previous one.
+/// </summary>
+/// <param name="va">Virtual address</param>
+/// <returns>Index of the region, NoRegion in a gap</returns>
+size_t PTE::RegionCursor::Seek(uint64_t va)
+{
+    while (m_cursor < m_regions.size() && m_regions[m_cursor].BaseAddress + m_regions[m_cursor].RegionSize <= va)
+    {
+        ++m_cursor;
+    }
+
+    return m_cursor < m_regions.size() && m_regions[m_cursor].BaseAddress <= va ? m_cursor : NoRegion;
+}
+
+/// <summary>
+/// Get the piece of the range lying in a single region or in a single gap.
+/// </summary>
+/// <param name="va">Start of the range, at or above the previous one</param>
+/// <param name="end">End of the range</param>
+/// <param name="pieceEnd">End of the piece starting at va</param>
+/// <returns>Index of the region, NoRegion in a gap</returns>
+size_t PTE::RegionCursor::Next(uint64_t va, uint64_t end, uint64_t& pieceEnd)
+{
+    const size_t region = Seek(va);
+
+    pieceEnd = end;
+    if (region != NoRegion)
+    {
+        pieceEnd = std::min(end, m_regions[region].BaseAddress + m_regions[region].RegionSize);
+    }
+    else if (m_cursor < m_regions.size())
+    {
+        pieceEnd = std::min(end, m_regions[m_cursor].BaseAddress);
+    }
+
+    return region;
+}
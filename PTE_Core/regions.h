@@ -0,0 +1,82 @@
+/*
+	regions.h
+
+	Enumeration and diffing of the process virtual regions.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "include.h"
+
+namespace PTE
+{
+
+/// <summary>
+/// A virtual region, as returned by VirtualQueryEx.
+/// </summary>
+struct Region
+{
+	uint64_t BaseAddress;
+	uint64_t AllocationBase;
+	uint64_t RegionSize;
+	uint32_t State;
+	uint32_t Protect;
+	uint32_t Type;
+
+	bool operator==(const Region&) const = default;
+};
+
+/// <summary>
+/// Difference between two region lists.
+/// All the lists are sorted by the base address.
+/// </summary>
+struct RegionDiff
+{
+	std::vector<Region> Added;
+	std::vector<Region> Removed;
+
+	//
+	// The new state of the regions which kept the base address
+	std::vector<Region> Changed;
+
+	size_t Size() const
+	{
+		return Added.size() + Removed.size() + Changed.size();
+	}
+};
+
+/// <summary>
+/// Wrapper class for the region list helpers.
+/// </summary>
+class Regions
+{
+public:
+	static unsigned long Enumerate(HANDLE hProcess, std::vector<Region>& regions);
+	static RegionDiff Diff(const std::vector<Region>& previous, const std::vector<Region>& current);
+	static const Region* Find(const std::vector<Region>& regions, uint64_t va);
+};
+
+/// <summary>
+/// Follows the region list along the addresses of a walk, which only go up,
+/// and cuts the mappings at the region boundaries.
+/// </summary>
+class RegionCursor
+{
+public:
+	static constexpr size_t NoRegion = ~size_t{ 0 };
+
+	explicit RegionCursor(const std::vector<Region>& regions);
+
+	size_t Seek(uint64_t va);
+	size_t Next(uint64_t va, uint64_t end, uint64_t& pieceEnd);
+
+private:
+	const std::vector<Region>& m_regions;
+	size_t m_cursor{ 0 };
+};
+
+} //namespace PTE
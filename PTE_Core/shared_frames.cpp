@@ -0,0 +1,163 @@
+/*
+    shared_frames.cpp
+
+    Physical frames shared between the processes.
+    The references of all the processes are put in one array and
+    sorted by (PFN, process) with an LSD radix sort, so the processes
+    mapping a frame end up next to each other.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "shared_frames.h"
+#include <algorithm>
+
+namespace
+{
+
+//
+// The sort key is the PFN followed by the process index.
+constexpr unsigned int ProcessBits = 20;
+constexpr unsigned int DigitBits = 11;
+constexpr unsigned int Digits = (64 + DigitBits - 1) / DigitBits;
+constexpr size_t Buckets = size_t{ 1 } << DigitBits;
+
+} //namespace
+
+/// <summary>
+/// Get the sort key of the reference.
+/// </summary>
+uint64_t PTE::SharedFrames::Key(const FrameRef& frame)
+{
+    return (frame.pfn << ProcessBits) | frame.process;
+}
+
+/// <summary>
+/// Sort the references by PFN, then by process.
+/// </summary>
+/// <param name="frames">References of all the processes</param>
+void PTE::SharedFrames::Sort(std::vector<FrameRef>& frames)
+{
+    //
+    // All the digit histograms are built in one pass.
+    std::vector<size_t> counts(Digits * Buckets, 0);
+    for (const auto& frame : frames)
+    {
+        const uint64_t key = Key(frame);
+        for (unsigned int digit = 0; digit < Digits; ++digit)
+        {
+            ++counts[digit * Buckets + ((key >> (digit * DigitBits)) & (Buckets - 1))];
+        }
+    }
+
+    std::vector<FrameRef> scratch(frames.size());
+
+    for (unsigned int digit = 0; digit < Digits; ++digit)
+    {
+        size_t* count = counts.data() + digit * Buckets;
+
+        //
+        // Skip the digits equal for all the keys, the high ones usually are.
+        if (std::find(count, count + Buckets, frames.size()) != count + Buckets)
+        {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (size_t bucket = 0; bucket < Buckets; ++bucket)
+        {
+            const size_t size = count[bucket];
+            count[bucket] = offset;
+            offset += size;
+        }
+
+        for (const auto& frame : frames)
+        {
+            scratch[count[(Key(frame) >> (digit * DigitBits)) & (Buckets - 1)]++] = frame;
+        }
+
+        frames.swap(scratch);
+    }
+}
+
+/// <summary>
+/// Find the frames mapped by more than one process and the proportional set sizes.
+/// </summary>
+/// <param name="frames">References of all the processes, sorted in place</param>
+/// <param name="processCount">Number of processes, the references use indexes below it</param>
+/// <returns>Share per process</returns>
+std::vector<PTE::FrameShare> PTE::SharedFrames::Analyze(std::vector<FrameRef>& frames, size_t processCount)
+{
+    std::vector<FrameShare> result(processCount);
+
+    if (processCount < (size_t{ 1 } << ProcessBits))
+    {
+        Sort(frames);
+    }
+    else
+    {
+        std::sort(frames.begin(), frames.end(), [](const FrameRef& a, const FrameRef& b)
+            {
+                return a.pfn != b.pfn ? a.pfn < b.pfn : a.process < b.process;
+            });
+    }
+
+    size_t first = 0;
+    while (first < frames.size())
+    {
+        size_t last = first + 1;
+        size_t sharers = 1;
+
+        //
+        // The same process may map the frame twice, count it once.
+        while (last < frames.size() && frames[last].pfn == frames[first].pfn)
+        {
+            sharers += frames[last].process != frames[last - 1].process;
+            ++last;
+        }
+
+        for (size_t i = first; i < last; ++i)
+        {
+            if (i != first && frames[i].process == frames[i - 1].process)
+            {
+                continue;
+            }
+
+            FrameShare& share = result[frames[i].process];
+            share.PssFrames += static_cast<double>(frames[i].frames) / sharers;
+
+            if (sharers == 1)
+            {
+                share.PrivateFrames += frames[i].frames;
+            }
+            else
+            {
+                share.SharedFrames += frames[i].frames;
+                share.SharedKindFrames[frames[i].kind] += frames[i].frames;
+            }
+        }
+
+        first = last;
+    }
+
+    return result;
+}
+
+/// <summary>
+/// Get the kind of memory of a region.
+/// </summary>
+/// <param name="regionType">Type of the region, MEM_IMAGE, MEM_MAPPED or MEM_PRIVATE</param>
+/// <returns>MEMORY_KIND</returns>
+uint32_t PTE::SharedFrames::KindOf(uint32_t regionType)
+{
+    switch (regionType)
+    {
+    case MEM_IMAGE:
+        return MEMORY_KIND_IMAGE;
+    case MEM_MAPPED:
+        return MEMORY_KIND_MAPPED;
+    default:
+        return MEMORY_KIND_PRIVATE;
+    }
+}
@@ -0,0 +1,79 @@
+/*
+	shared_frames.h
+
+	Physical frames shared between the processes.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "include.h"
+
+namespace PTE
+{
+
+//
+// Type of the region a frame is mapped in.
+enum MEMORY_KIND : uint32_t
+{
+	MEMORY_KIND_IMAGE = 0,
+	MEMORY_KIND_MAPPED,
+	MEMORY_KIND_PRIVATE,
+	MEMORY_KIND_COUNT
+};
+
+/// <summary>
+/// A physical frame mapped by a process.
+/// Large pages are a single reference to their first frame.
+/// </summary>
+struct FrameRef
+{
+	uint64_t pfn;
+	uint32_t process;
+
+	//
+	// Number of 4KB frames, up to 512 * 512 for a 1GB page
+	uint32_t frames : 24;
+
+	//
+	// MEMORY_KIND of the region
+	uint32_t kind : 8;
+};
+
+/// <summary>
+/// Sharing of the resident memory of a process, in 4KB frames.
+/// </summary>
+struct FrameShare
+{
+	//
+	// Frames mapped by this process only
+	uint64_t PrivateFrames{ 0 };
+
+	//
+	// Frames also mapped by another process, by the kind of the region
+	uint64_t SharedFrames{ 0 };
+	uint64_t SharedKindFrames[MEMORY_KIND_COUNT]{ };
+
+	//
+	// Proportional set size: every frame divided by the number of processes mapping it
+	double PssFrames{ 0 };
+};
+
+/// <summary>
+/// Groups the frames of many processes by PFN.
+/// </summary>
+class SharedFrames
+{
+public:
+	static void Sort(std::vector<FrameRef>& frames);
+	static std::vector<FrameShare> Analyze(std::vector<FrameRef>& frames, size_t processCount);
+	static uint32_t KindOf(uint32_t regionType);
+
+private:
+	static uint64_t Key(const FrameRef& frame);
+};
+
+} //namespace PTE
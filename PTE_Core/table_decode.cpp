@@ -0,0 +1,217 @@
+/*
+    table_decode.cpp
+
+    Bulk decoding of the paging structure entries.
+    The vector implementations move the eight flags of every entry into
+    a single byte (P RW US A D PS G NX), so a single byte mask per flag
+    covers 32 or 64 entries.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "table_decode.h"
+#include "cpu_features.h"
+#include <bit>
+#include <immintrin.h>
+
+namespace
+{
+
+constexpr uint64_t PfnMask = 0x000FFFFFFFFFFull;
+
+//
+// Bit of the flag in the entry, in the order of the compact byte.
+constexpr unsigned int s_flagBits[8] = { 0, 1, 2, 5, 6, 7, 8, 63 };
+
+/// <summary>
+/// Get the bitmap of the flag by its position in the compact byte.
+/// </summary>
+uint64_t* FlagBitmap(PTE::TableBits& bits, size_t flag)
+{
+    uint64_t* const bitmaps[8] = { bits.present, bits.write, bits.user, bits.accessed,
+        bits.dirty, bits.large, bits.global, bits.noExecute };
+
+    return bitmaps[flag];
+}
+
+/// <summary>
+/// Reference implementation.
+/// </summary>
+void DecodeScalar(const uint64_t* entries, PTE::TableBits& bits)
+{
+    for (size_t word = 0; word < PTE::TableBits::Words; ++word)
+    {
+        uint64_t flags[8]{ };
+
+        for (size_t i = 0; i < 64; ++i)
+        {
+            const uint64_t entry = entries[word * 64 + i];
+
+            for (size_t flag = 0; flag < 8; ++flag)
+            {
+                flags[flag] |= ((entry >> s_flagBits[flag]) & 1) << i;
+            }
+            bits.pfn[word * 64 + i] = (entry >> 12) & PfnMask;
+        }
+
+        for (size_t flag = 0; flag < 8; ++flag)
+        {
+            FlagBitmap(bits, flag)[word] = flags[flag];
+        }
+    }
+}
+
+/// <summary>
+/// Move the flags of every entry into its low byte:
+/// bits 0..2 stay, bits 5..8 go to 3..6, bit 63 goes to 7.
+/// </summary>
+PTE_TARGET_AVX2 inline __m256i CompactAvx2(__m256i v)
+{
+    return _mm256_or_si256(_mm256_or_si256(
+        _mm256_and_si256(v, _mm256_set1_epi64x(0x07)),
+        _mm256_and_si256(_mm256_srli_epi64(v, 2), _mm256_set1_epi64x(0x78))),
+        _mm256_and_si256(_mm256_srli_epi64(v, 56), _mm256_set1_epi64x(0x80)));
+}
+
+/// <summary>
+/// Decode 32 entries, the bit i of the mask of a flag is the flag of the entry i.
+/// </summary>
+PTE_TARGET_AVX2 void DecodeAvx2Half(const uint64_t* entries, uint64_t* pfn, uint32_t (&masks)[8])
+{
+    //
+    // After the packs the pairs of entries are interleaved between the lanes,
+    // the qword permute and the shuffle put them back in order.
+    const __m256i order = _mm256_setr_epi8(0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15,
+        0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15);
+    const __m256i pfnMask = _mm256_set1_epi64x(PfnMask);
+    __m256i c[8];
+
+    for (size_t j = 0; j < 8; ++j)
+    {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(entries + j * 4));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pfn + j * 4), _mm256_and_si256(_mm256_srli_epi64(v, 12), pfnMask));
+        c[j] = CompactAvx2(v);
+    }
+
+    const __m256i lo = _mm256_packus_epi32(_mm256_packus_epi32(c[0], c[1]), _mm256_packus_epi32(c[2], c[3]));
+    const __m256i hi = _mm256_packus_epi32(_mm256_packus_epi32(c[4], c[5]), _mm256_packus_epi32(c[6], c[7]));
+    const __m256i bytes = _mm256_shuffle_epi8(
+        _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), _MM_SHUFFLE(3, 1, 2, 0)),
+        order);
+
+    //
+    // movemask takes the top bit of every byte. The 16-bit shift by at most 7
+    // does not carry the bits between the bytes of interest.
+    masks[7] = static_cast<uint32_t>(_mm256_movemask_epi8(bytes));
+    masks[6] = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_slli_epi16(bytes, 1)));
+    masks[5] = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_slli_epi16(bytes, 2)));
+    masks[4] = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_slli_epi16(bytes, 3)));
+    masks[3] = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_slli_epi16(bytes, 4)));
+    masks[2] = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_slli_epi16(bytes, 5)));
+    masks[1] = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_slli_epi16(bytes, 6)));
+    masks[0] = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_slli_epi16(bytes, 7)));
+}
+
+/// <summary>
+/// AVX2 implementation, 32 entries per step, the masks of two steps make a bitmap word.
+/// </summary>
+PTE_TARGET_AVX2 void DecodeAvx2(const uint64_t* entries, PTE::TableBits& bits)
+{
+    for (size_t word = 0; word < PTE::TableBits::Words; ++word)
+    {
+        uint32_t low[8];
+        uint32_t high[8];
+
+        DecodeAvx2Half(entries + word * 64, bits.pfn + word * 64, low);
+        DecodeAvx2Half(entries + word * 64 + 32, bits.pfn + word * 64 + 32, high);
+
+        for (size_t flag = 0; flag < 8; ++flag)
+        {
+            FlagBitmap(bits, flag)[word] = low[flag] | (static_cast<uint64_t>(high[flag]) << 32);
+        }
+    }
+}
+
+/// <summary>
+/// AVX-512 implementation, 64 entries per iteration.
+/// The compact bytes of 8 entries are narrowed with a single vpmovqb.
+/// </summary>
+PTE_TARGET_AVX512 void DecodeAvx512(const uint64_t* entries, PTE::TableBits& bits)
+{
+    const __m512i pfnMask = _mm512_set1_epi64(PfnMask);
+    const __m512i lowMask = _mm512_set1_epi64(0x07);
+    const __m512i midMask = _mm512_set1_epi64(0x78);
+    const __m512i nxMask = _mm512_set1_epi64(0x80);
+
+    for (size_t word = 0; word < PTE::TableBits::Words; ++word)
+    {
+        alignas(64) uint64_t compact[8];
+
+        for (size_t j = 0; j < 8; ++j)
+        {
+            const __m512i v = _mm512_loadu_si512(entries + word * 64 + j * 8);
+
+            _mm512_storeu_si512(bits.pfn + word * 64 + j * 8, _mm512_and_si512(_mm512_srli_epi64(v, 12), pfnMask));
+
+            const __m512i c = _mm512_or_si512(_mm512_or_si512(
+                _mm512_and_si512(v, lowMask),
+                _mm512_and_si512(_mm512_srli_epi64(v, 2), midMask)),
+                _mm512_and_si512(_mm512_srli_epi64(v, 56), nxMask));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(compact + j), _mm512_cvtepi64_epi8(c));
+        }
+
+        const __m512i bytes = _mm512_load_si512(compact);
+        for (size_t flag = 0; flag < 8; ++flag)
+        {
+            FlagBitmap(bits, flag)[word] = _mm512_test_epi8_mask(bytes, _mm512_set1_epi8(static_cast<char>(1 << flag)));
+        }
+    }
+}
+
+} //namespace
+
+/// <summary>
+/// Decode the flags and the frame numbers of all the entries of a table.
+/// </summary>
+/// <param name="entries">TABLE_SIZE raw entries</param>
+/// <param name="bits">The result</param>
+/// <param name="impl">The implementation to use</param>
+void PTE::TableDecoder::Decode(const uint64_t* entries, TableBits& bits, Impl impl)
+{
+    if (impl == Impl::Auto)
+    {
+        impl = CpuFeatures::HasAvx512() ? Impl::Avx512 : CpuFeatures::HasAvx2() ? Impl::Avx2 : Impl::Scalar;
+    }
+
+    switch (impl)
+    {
+    case Impl::Avx512:
+        DecodeAvx512(entries, bits);
+        break;
+    case Impl::Avx2:
+        DecodeAvx2(entries, bits);
+        break;
+    default:
+        DecodeScalar(entries, bits);
+        break;
+    }
+}
+
+/// <summary>
+/// Count the set bits of a table bitmap.
+/// </summary>
+/// <param name="bitmap">TableBits::Words words</param>
+/// <returns>Number of entries</returns>
+size_t PTE::TableDecoder::Count(const uint64_t* bitmap)
+{
+    size_t count{ 0 };
+
+    for (size_t word = 0; word < TableBits::Words; ++word)
+    {
+        count += std::popcount(bitmap[word]);
+    }
+
+    return count;
+}
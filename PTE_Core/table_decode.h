@@ -0,0 +1,63 @@
+/*
+	table_decode.h
+
+	Bulk decoding of the paging structure entries.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "include.h"
+
+namespace PTE
+{
+
+/// <summary>
+/// Flags of all the entries of a table as bitmaps, bit i is the entry i.
+/// </summary>
+struct TableBits
+{
+	static constexpr size_t Words = TABLE_SIZE / 64;
+
+	uint64_t present[Words];
+	uint64_t write[Words];
+	uint64_t user[Words];
+	uint64_t accessed[Words];
+	uint64_t dirty[Words];
+
+	//
+	// Bit 7: page size for PDPTE and PDE, PAT for PTE
+	uint64_t large[Words];
+	uint64_t global[Words];
+	uint64_t noExecute[Words];
+
+	//
+	// Bits 12..51 of every entry. For the large pages the low bits
+	// of the frame number hold PAT and must be masked by the caller.
+	uint64_t pfn[TABLE_SIZE];
+};
+
+/// <summary>
+/// Decodes a whole table at once with the widest vector extension available.
+/// </summary>
+class TableDecoder
+{
+public:
+	//
+	// Decoder implementation, Auto picks the best one supported by the CPU.
+	enum class Impl
+	{
+		Auto,
+		Scalar,
+		Avx2,
+		Avx512
+	};
+
+	static void Decode(const uint64_t* entries, TableBits& bits, Impl impl = Impl::Auto);
+	static size_t Count(const uint64_t* bitmap);
+};
+
+} //namespace PTE
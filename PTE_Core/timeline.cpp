@@ -0,0 +1,635 @@
+/*
+    timeline.cpp
+
+    Timeline of the tool activity: the driver requests, the walks, the cache misses
+    and the export phases, written as a Chrome trace or a Perfetto trace.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "timeline.h"
+#include "tsc_clock.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//
+// Keeps the rare paths out of the recording of an event.
+#if defined(_MSC_VER)
+#define PTE_NOINLINE __declspec(noinline)
+#else
+#define PTE_NOINLINE __attribute__((noinline))
+#endif
+
+namespace
+{
+
+const char* s_categoryNames[static_cast<size_t>(PTE::TimelineCategory::Count)] =
+{
+    "request",
+    "walk",
+    "cache",
+    "export"
+};
+
+//
+// The threads are all shown in the same process.
+constexpr uint64_t s_pid = 1;
+
+//
+// An event as recorded. The fields are atomic, so a ring can be read while its thread writes,
+// the relaxed accesses are plain moves.
+struct Slot
+{
+    std::atomic<uint64_t> start{ 0 };
+    std::atomic<uint64_t> duration{ 0 };
+    std::atomic<const char*> name{ nullptr };
+    std::atomic<uint64_t> arg{ 0 };
+
+    //
+    // Thread id in the upper half, instant flag and category in the lower
+    std::atomic<uint64_t> info{ 0 };
+};
+
+struct Ring
+{
+    std::unique_ptr<Slot[]> slots{ new Slot[PTE::Timeline::RingEvents] };
+
+    //
+    // Number of the events ever written, only the writing thread changes it
+    std::atomic<uint64_t> head{ 0 };
+
+    //
+    // The events before it were cleared
+    std::atomic<uint64_t> first{ 0 };
+};
+
+//
+// An event as read from a ring.
+struct Event
+{
+    uint32_t thread;
+    PTE::TimelineCategory category;
+    bool instant;
+    const char* name;
+    uint64_t start;
+    uint64_t duration;
+    uint64_t arg;
+};
+
+std::atomic<bool> s_enabled{ false };
+
+//
+// Started when the timeline is turned on, the zero of the timestamps.
+TscClock s_clock;
+
+//
+// The rings are kept after their threads end, for the timeline to hold their events.
+// Once cleared they go to the next new thread, every event carries the id of its thread.
+std::mutex s_registryLock;
+std::vector<std::unique_ptr<Ring>> s_rings;
+std::vector<Ring*> s_freeRings;
+std::map<uint32_t, std::string> s_threadNames;
+std::atomic<uint32_t> s_nextThread{ 1 };
+
+thread_local Ring* t_ring{ nullptr };
+thread_local uint32_t t_thread{ 0 };
+
+/// <summary>
+/// Returns the ring of the thread to the free list when the thread ends.
+/// </summary>
+struct RingLease
+{
+    ~RingLease()
+    {
+        if (t_ring != nullptr)
+        {
+            std::lock_guard<std::mutex> lock(s_registryLock);
+            s_freeRings.push_back(t_ring);
+            t_ring = nullptr;
+        }
+    }
+};
+
+thread_local RingLease t_lease;
+
+/// <summary>
+/// Id of the calling thread in the timeline.
+/// </summary>
+/// <returns>The id, 1 for the first thread recording an event</returns>
+uint32_t ThreadId()
+{
+    if (t_thread == 0)
+    {
+        t_thread = s_nextThread.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    return t_thread;
+}
+
+/// <summary>
+/// Take a cleared ring of an ended thread or allocate a new one for the calling thread.
+/// </summary>
+/// <returns>The ring of the thread</returns>
+Ring* AcquireRing()
+{
+    ThreadId();
+
+    std::lock_guard<std::mutex> lock(s_registryLock);
+    auto empty = std::find_if(s_freeRings.begin(), s_freeRings.end(), [](const Ring* ring)
+        {
+            return ring->head.load(std::memory_order_relaxed) == ring->first.load(std::memory_order_relaxed);
+        });
+    if (empty != s_freeRings.end())
+    {
+        t_ring = *empty;
+        s_freeRings.erase(empty);
+    }
+    else
+    {
+        s_rings.push_back(std::make_unique<Ring>());
+        t_ring = s_rings.back().get();
+    }
+
+    //
+    // Touching the lease registers its destructor for this thread.
+    (void)&t_lease;
+
+    return t_ring;
+}
+
+void PushFirst(PTE::TimelineCategory category, const char* name, uint64_t start, uint64_t duration, bool instant, uint64_t arg);
+
+/// <summary>
+/// Append an event to the ring of the calling thread.
+/// </summary>
+void Push(PTE::TimelineCategory category, const char* name, uint64_t start, uint64_t duration, bool instant, uint64_t arg)
+{
+    //
+    // The first event of the thread is a tail call, the others save no registers.
+    Ring* ring = t_ring;
+    if (ring == nullptr)
+    {
+        return PushFirst(category, name, start, duration, instant, arg);
+    }
+
+    const uint64_t head = ring->head.load(std::memory_order_relaxed);
+
+    //
+    // A reader seeing any of the fields written below also sees the head published before them,
+    // and drops the slot as overwritten.
+    std::atomic_thread_fence(std::memory_order_release);
+
+    Slot& slot = ring->slots[head & (PTE::Timeline::RingEvents - 1)];
+    slot.start.store(start, std::memory_order_relaxed);
+    slot.duration.store(duration, std::memory_order_relaxed);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.arg.store(arg, std::memory_order_relaxed);
+    slot.info.store((static_cast<uint64_t>(t_thread) << 32) | (instant ? 0x100 : 0) | static_cast<uint64_t>(category),
+        std::memory_order_relaxed);
+
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+/// <summary>
+/// Append the first event of the calling thread, taking a ring for it.
+/// </summary>
+PTE_NOINLINE void PushFirst(PTE::TimelineCategory category, const char* name, uint64_t start, uint64_t duration, bool instant, uint64_t arg)
+{
+    AcquireRing();
+    Push(category, name, start, duration, instant, arg);
+}
+
+/// <summary>
+/// Copy the events of all the rings, sorted by thread and time, the enclosing events first.
+/// </summary>
+/// <param name="events">The events</param>
+/// <param name="threadNames">Names of the threads</param>
+void Collect(std::vector<Event>& events, std::map<uint32_t, std::string>& threadNames)
+{
+    std::lock_guard<std::mutex> lock(s_registryLock);
+
+    threadNames = s_threadNames;
+    for (const auto& ring : s_rings)
+    {
+        const uint64_t head = ring->head.load(std::memory_order_acquire);
+        const uint64_t first = std::max(ring->first.load(std::memory_order_relaxed),
+            head > PTE::Timeline::RingEvents ? head - PTE::Timeline::RingEvents : 0);
+
+        const size_t begin = events.size();
+        for (uint64_t i = first; i < head; ++i)
+        {
+            const Slot& slot = ring->slots[i & (PTE::Timeline::RingEvents - 1)];
+            const uint64_t info = slot.info.load(std::memory_order_relaxed);
+            events.push_back({ static_cast<uint32_t>(info >> 32),
+                static_cast<PTE::TimelineCategory>(info & 0xFF),
+                (info & 0x100) != 0,
+                slot.name.load(std::memory_order_relaxed),
+                slot.start.load(std::memory_order_relaxed),
+                slot.duration.load(std::memory_order_relaxed),
+                slot.arg.load(std::memory_order_relaxed) });
+        }
+
+        //
+        // Drop the events the thread overwrote while they were copied.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t now = ring->head.load(std::memory_order_relaxed);
+        if (now >= first + PTE::Timeline::RingEvents)
+        {
+            const uint64_t lost = std::min<uint64_t>(now - PTE::Timeline::RingEvents + 1 - first, head - first);
+            events.erase(events.begin() + begin, events.begin() + begin + lost);
+        }
+    }
+
+    std::sort(events.begin(), events.end(), [](const Event& a, const Event& b)
+        {
+            if (a.thread != b.thread)
+            {
+                return a.thread < b.thread;
+            }
+            if (a.start != b.start)
+            {
+                return a.start < b.start;
+            }
+            return a.duration > b.duration;
+        });
+}
+
+/// <summary>
+/// Escape a string for JSON.
+/// </summary>
+/// <param name="text">The string</param>
+/// <returns>The escaped string, without the quotes</returns>
+std::string JsonEscape(std::string_view text)
+{
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned>(c));
+            escaped += code;
+        }
+        else
+        {
+            escaped += c;
+        }
+    }
+
+    return escaped;
+}
+
+//
+// Protocol buffers encoding of the Perfetto trace, only the fields written here.
+// Trace.packet = 1
+// TracePacket: timestamp = 8, trusted_packet_sequence_id = 10, track_event = 11, track_descriptor = 60
+// TrackEvent: debug_annotations = 4, type = 9, track_uuid = 11, categories = 22, name = 23
+// TrackDescriptor: uuid = 1, name = 2, thread = 4
+// ThreadDescriptor: pid = 1, tid = 2
+// DebugAnnotation: uint_value = 3, name = 10
+
+enum TrackEventType : uint64_t
+{
+    TYPE_SLICE_BEGIN = 1,
+    TYPE_SLICE_END = 2,
+    TYPE_INSTANT = 3
+};
+
+constexpr uint32_t s_sequenceId = 1;
+
+void PutVarint(std::string& out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+void PutVarintField(std::string& out, uint32_t field, uint64_t value)
+{
+    PutVarint(out, static_cast<uint64_t>(field) << 3);
+    PutVarint(out, value);
+}
+
+void PutBytesField(std::string& out, uint32_t field, std::string_view bytes)
+{
+    PutVarint(out, (static_cast<uint64_t>(field) << 3) | 2);
+    PutVarint(out, bytes.size());
+    out.append(bytes.data(), bytes.size());
+}
+
+/// <summary>
+/// Append a track event packet to the trace.
+/// </summary>
+/// <param name="trace">The trace</param>
+/// <param name="packet">Scratch buffer</param>
+/// <param name="event">Scratch buffer</param>
+/// <param name="timestamp">Time in nanoseconds</param>
+/// <param name="type">Begin, end or instant</param>
+/// <param name="source">The recorded event, its name and argument are not written for the ends</param>
+void PutTrackEvent(std::string& trace,
+    std::string& packet,
+    std::string& event,
+    uint64_t timestamp,
+    TrackEventType type,
+    const Event& source)
+{
+    event.clear();
+    PutVarintField(event, 9, type);
+    PutVarintField(event, 11, source.thread);
+    if (type != TYPE_SLICE_END)
+    {
+        PutBytesField(event, 22, s_categoryNames[static_cast<size_t>(source.category)]);
+        PutBytesField(event, 23, source.name);
+        if (source.arg != 0)
+        {
+            std::string annotation;
+            PutBytesField(annotation, 10, "arg");
+            PutVarintField(annotation, 3, source.arg);
+            PutBytesField(event, 4, annotation);
+        }
+    }
+
+    packet.clear();
+    PutVarintField(packet, 8, timestamp);
+    PutVarintField(packet, 10, s_sequenceId);
+    PutBytesField(packet, 11, event);
+
+    PutBytesField(trace, 1, packet);
+}
+
+} //namespace
+
+/// <summary>
+/// Turn the recording on or off. The recorded events are kept.
+/// </summary>
+/// <param name="enable">On or off</param>
+void PTE::Timeline::Enable(bool enable)
+{
+    std::lock_guard<std::mutex> lock(s_registryLock);
+
+    if (enable && !s_clock.Started())
+    {
+        s_clock.Start();
+    }
+
+    s_enabled.store(enable, std::memory_order_relaxed);
+}
+
+/// <summary>
+/// Whether the events are recorded.
+/// </summary>
+/// <returns>True if the timeline is on</returns>
+bool PTE::Timeline::Enabled()
+{
+    return s_enabled.load(std::memory_order_relaxed);
+}
+
+/// <summary>
+/// Name the calling thread in the timeline.
+/// </summary>
+/// <param name="name">The name</param>
+void PTE::Timeline::NameThread(const char* name)
+{
+    const uint32_t thread = ThreadId();
+
+    std::lock_guard<std::mutex> lock(s_registryLock);
+    s_threadNames[thread] = name;
+}
+
+/// <summary>
+/// Record an event that started at the given time and ends now.
+/// </summary>
+/// <param name="category">Category</param>
+/// <param name="name">Name, a string literal</param>
+/// <param name="startTicks">TSC at the start</param>
+/// <param name="arg">The argument shown with the event, a process id or a count</param>
+void PTE::Timeline::Complete(TimelineCategory category, const char* name, uint64_t startTicks, uint64_t arg)
+{
+    //
+    // The scopes check Enabled when they start, an event ending after the timeline was
+    // turned off is still recorded.
+    Push(category, name, startTicks, __rdtsc() - startTicks, false, arg);
+}
+
+/// <summary>
+/// Record an event without a duration.
+/// </summary>
+/// <param name="category">Category</param>
+/// <param name="name">Name, a string literal</param>
+/// <param name="arg">The argument shown with the event</param>
+void PTE::Timeline::Instant(TimelineCategory category, const char* name, uint64_t arg)
+{
+    if (Enabled())
+    {
+        Push(category, name, __rdtsc(), 0, true, arg);
+    }
+}
+
+/// <summary>
+/// Drop the recorded events.
+/// </summary>
+void PTE::Timeline::Clear()
+{
+    std::lock_guard<std::mutex> lock(s_registryLock);
+
+    for (const auto& ring : s_rings)
+    {
+        ring->first.store(ring->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+    }
+}
+
+/// <summary>
+/// Write the events in the Chrome trace event format, for chrome://tracing and Perfetto UI.
+/// </summary>
+/// <param name="path">Path of the trace</param>
+/// <returns>True if the trace was written</returns>
+bool PTE::Timeline::WriteChromeJson(const std::filesystem::path& path)
+{
+    std::vector<Event> events;
+    std::map<uint32_t, std::string> threadNames;
+    Collect(events, threadNames);
+
+    std::ofstream file(path, std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+
+    const double ticksPerUs = s_clock.TicksPerNanosecond() * 1000.0;
+    const char* separator = "\n";
+
+    file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+    char line[256];
+    for (const auto& [thread, name] : threadNames)
+    {
+        snprintf(line, sizeof(line), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%llu,\"tid\":%u,\"args\":{\"name\":\"",
+            separator,
+            static_cast<unsigned long long>(s_pid),
+            thread);
+        file << line << JsonEscape(name) << "\"}}";
+        separator = ",\n";
+    }
+
+    for (const auto& event : events)
+    {
+        const double ts = static_cast<double>(event.start - std::min(event.start, s_clock.StartTicks())) / ticksPerUs;
+        if (event.instant)
+        {
+            snprintf(line, sizeof(line), "%s{\"name\":\"", separator);
+            file << line << JsonEscape(event.name);
+            snprintf(line, sizeof(line), "\",\"cat\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%llu,\"tid\":%u,\"args\":{\"arg\":%llu}}",
+                s_categoryNames[static_cast<size_t>(event.category)],
+                ts,
+                static_cast<unsigned long long>(s_pid),
+                event.thread,
+                static_cast<unsigned long long>(event.arg));
+        }
+        else
+        {
+            snprintf(line, sizeof(line), "%s{\"name\":\"", separator);
+            file << line << JsonEscape(event.name);
+            snprintf(line, sizeof(line), "\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%llu,\"tid\":%u,\"args\":{\"arg\":%llu}}",
+                s_categoryNames[static_cast<size_t>(event.category)],
+                ts,
+                static_cast<double>(event.duration) / ticksPerUs,
+                static_cast<unsigned long long>(s_pid),
+                event.thread,
+                static_cast<unsigned long long>(event.arg));
+        }
+        file << line;
+        separator = ",\n";
+    }
+
+    file << "\n]}\n";
+
+    return static_cast<bool>(file);
+}
+
+/// <summary>
+/// Write the events as a Perfetto protobuf trace, a track per thread.
+/// The complete events become slice begin and end pairs.
+/// </summary>
+/// <param name="path">Path of the trace</param>
+/// <returns>True if the trace was written</returns>
+bool PTE::Timeline::WritePerfetto(const std::filesystem::path& path)
+{
+    std::vector<Event> events;
+    std::map<uint32_t, std::string> threadNames;
+    Collect(events, threadNames);
+
+    std::ofstream file(path, std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+
+    const double ticksPerNs = s_clock.TicksPerNanosecond();
+    auto ns = [ticksPerNs](uint64_t ticks)
+        {
+            return static_cast<uint64_t>(static_cast<double>(ticks - std::min(ticks, s_clock.StartTicks())) / ticksPerNs);
+        };
+
+    std::string trace;
+    std::string packet;
+    std::string message;
+    std::string thread;
+
+    //
+    // The tracks of the threads.
+    uint32_t lastThread{ 0 };
+    for (const auto& event : events)
+    {
+        if (event.thread == lastThread)
+        {
+            continue;
+        }
+        lastThread = event.thread;
+
+        auto name = threadNames.find(event.thread);
+        thread.clear();
+        PutVarintField(thread, 1, s_pid);
+        PutVarintField(thread, 2, event.thread);
+
+        message.clear();
+        PutVarintField(message, 1, event.thread);
+        PutBytesField(message, 2, name != threadNames.end() ? name->second : "thread " + std::to_string(event.thread));
+        PutBytesField(message, 4, thread);
+
+        packet.clear();
+        PutVarintField(packet, 10, s_sequenceId);
+        PutBytesField(packet, 60, message);
+        PutBytesField(trace, 1, packet);
+    }
+
+    //
+    // The slices of a thread nest, an enclosing event comes first and ends after the events it holds.
+    std::vector<const Event*> open;
+    auto closeUntil = [&](uint64_t ticks)
+        {
+            while (!open.empty() && open.back()->start + open.back()->duration <= ticks)
+            {
+                PutTrackEvent(trace, packet, message, ns(open.back()->start + open.back()->duration), TYPE_SLICE_END, *open.back());
+                open.pop_back();
+            }
+        };
+
+    for (size_t i = 0; i < events.size(); ++i)
+    {
+        const Event& event = events[i];
+        if (i != 0 && events[i - 1].thread != event.thread)
+        {
+            closeUntil(~0ull);
+        }
+
+        closeUntil(event.start);
+        if (event.instant)
+        {
+            PutTrackEvent(trace, packet, message, ns(event.start), TYPE_INSTANT, event);
+        }
+        else
+        {
+            PutTrackEvent(trace, packet, message, ns(event.start), TYPE_SLICE_BEGIN, event);
+            open.push_back(&event);
+        }
+
+        if (trace.size() >= (1 << 20))
+        {
+            file.write(trace.data(), trace.size());
+            trace.clear();
+        }
+    }
+    closeUntil(~0ull);
+
+    file.write(trace.data(), trace.size());
+
+    return static_cast<bool>(file);
+}
+
+/// <summary>
+/// Write the events as a Chrome trace if the path ends with ".json", as a Perfetto trace otherwise.
+/// </summary>
+/// <param name="path">Path of the trace</param>
+/// <returns>True if the trace was written</returns>
+bool PTE::Timeline::Write(const std::filesystem::path& path)
+{
+    return path.extension() == ".json" ? WriteChromeJson(path) : WritePerfetto(path);
+}
@@ -0,0 +1,96 @@
+/*
+	timeline.h
+
+	Timeline of the tool activity: the driver requests, the walks, the cache misses
+	and the export phases, written as a Chrome trace or a Perfetto trace.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+namespace PTE
+{
+
+enum class TimelineCategory : uint8_t
+{
+	Request = 0,
+	Walk,
+	Cache,
+	Export,
+	Count
+};
+
+/// <summary>
+/// Records the events into a ring per thread. A thread only writes its own ring, without locks,
+/// and the rings are read when the timeline is written. When a ring wraps the oldest events are lost.
+/// The names are not copied, they must be string literals.
+/// </summary>
+class Timeline
+{
+public:
+	//
+	// Events kept per thread, 640KB a ring
+	static constexpr size_t RingEvents = 1 << 14;
+
+	static void Enable(bool enable);
+	static bool Enabled();
+
+	static void NameThread(const char* name);
+
+	static void Complete(TimelineCategory category, const char* name, uint64_t startTicks, uint64_t arg = 0);
+	static void Instant(TimelineCategory category, const char* name, uint64_t arg = 0);
+	static void Clear();
+
+	static bool WriteChromeJson(const std::filesystem::path& path);
+	static bool WritePerfetto(const std::filesystem::path& path);
+	static bool Write(const std::filesystem::path& path);
+};
+
+/// <summary>
+/// Records its scope as a complete event if the timeline is on.
+/// </summary>
+class TimelineScope
+{
+public:
+	TimelineScope(TimelineCategory category, const char* name, uint64_t arg = 0) :
+		m_category(category),
+		m_name(name),
+		m_arg(arg),
+		m_start(Timeline::Enabled() ? __rdtsc() : 0)
+	{
+	}
+
+	~TimelineScope()
+	{
+		if (m_start != 0)
+		{
+			Timeline::Complete(m_category, m_name, m_start, m_arg);
+		}
+	}
+
+	TimelineScope(const TimelineScope&) = delete;
+	TimelineScope& operator=(const TimelineScope&) = delete;
+
+	/// <summary>
+	/// Set the argument known only at the end of the scope, a count for example.
+	/// </summary>
+	void SetArg(uint64_t arg) { m_arg = arg; }
+
+private:
+	TimelineCategory m_category;
+	const char* m_name;
+	uint64_t m_arg;
+	uint64_t m_start;
+};
+
+} //namespace PTE
@@ -0,0 +1,706 @@
+/*
+    tlb_sim.cpp
+
+    Simulator of the data TLB hierarchy replaying an address trace
+    against the page sizes of a captured process mapping.
+    The trace is a file of little endian 64-bit virtual addresses.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "tlb_sim.h"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <emmintrin.h>
+
+namespace
+{
+
+constexpr uint32_t s_pageShift[PTE::TlbSimulator::PageSizes] = { 12, 21, 30 };
+constexpr const char* s_pageName[PTE::TlbSimulator::PageSizes] = { "4k", "2m", "1g" };
+
+//
+// Tags are never all ones: the page number is at most 52 bits wide.
+constexpr uint64_t InvalidTag = ~0ull;
+
+//
+// Hints compared by a single SSE2 instruction
+constexpr uint32_t HintLanes = 8;
+
+//
+// Addresses replayed per read of the trace file
+constexpr size_t TraceChunk = 1 << 20;
+
+/// <summary>
+/// Parse a partition: the page sizes joined with '+', then "=<entries>x<ways>".
+/// </summary>
+/// <returns>True if the text is valid</returns>
+bool ParsePartition(const std::string& text, PTE::TlbPartition& partition)
+{
+    const size_t equals = text.find('=');
+    const size_t times = text.find('x', equals);
+    if (equals == std::string::npos || times == std::string::npos)
+    {
+        return false;
+    }
+
+    std::istringstream sizes(text.substr(0, equals));
+    std::string size;
+    while (std::getline(sizes, size, '+'))
+    {
+        std::transform(size.begin(), size.end(), size.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+
+        const auto it = std::find_if(std::begin(s_pageName), std::end(s_pageName),
+            [&](const char* name) { return size == name; });
+        if (it == std::end(s_pageName))
+        {
+            return false;
+        }
+        partition.SizeMask |= 1u << (it - std::begin(s_pageName));
+    }
+
+    try
+    {
+        partition.Entries = std::stoul(text.substr(equals + 1, times - equals - 1));
+        partition.Ways = std::stoul(text.substr(times + 1));
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+
+    return partition.SizeMask != 0 &&
+        partition.Ways != 0 &&
+        partition.Ways <= PTE::TlbSimulator::MaxWays &&
+        partition.Entries >= partition.Ways &&
+        partition.Entries % partition.Ways == 0;
+}
+
+/// <summary>
+/// Write the counters of a replay.
+/// </summary>
+void WriteStats(std::ofstream& report, const char* layout, const PTE::TlbConfig& config, const PTE::TlbStats& stats)
+{
+    for (size_t i = 0; i < stats.Levels.size(); ++i)
+    {
+        const PTE::TlbLevelStats& level = stats.Levels[i];
+        report << std::format("{},{},{},{},{:.6f},{}\n",
+            layout,
+            config.Levels[i].Name,
+            level.Lookups,
+            level.Misses,
+            level.MissRate(),
+            level.CoveredBytes / 1024);
+    }
+}
+
+} //namespace
+
+/// <summary>
+/// Data TLB of a recent desktop core: split first level, shared 4KB/2MB second level.
+/// </summary>
+PTE::TlbConfig PTE::TlbConfig::Default()
+{
+    TlbConfig config;
+    config.Levels.push_back({ "L1", { { 64, 4, 0b001 }, { 32, 4, 0b010 }, { 4, 4, 0b100 } } });
+    config.Levels.push_back({ "L2", { { 1536, 12, 0b011 }, { 16, 4, 0b100 } } });
+
+    return config;
+}
+
+/// <summary>
+/// Parse the configuration: the levels separated with ';', every level is
+/// "<name>:<partition>,<partition>..." and every partition is "<sizes>=<entries>x<ways>",
+/// for example "L1:4k=64x4,2m=32x4,1g=4x4;L2:4k+2m=1536x12,1g=16x4".
+/// </summary>
+/// <param name="text">Configuration text</param>
+/// <param name="config">Parsed configuration</param>
+/// <returns>True if the text is valid</returns>
+bool PTE::TlbConfig::Parse(const std::string& text, TlbConfig& config)
+{
+    config.Levels.clear();
+
+    std::istringstream levels(text);
+    std::string levelText;
+    while (std::getline(levels, levelText, ';'))
+    {
+        const size_t colon = levelText.find(':');
+        if (colon == std::string::npos || colon == 0)
+        {
+            return false;
+        }
+
+        TlbLevelConfig level{ levelText.substr(0, colon), {} };
+
+        std::istringstream partitions(levelText.substr(colon + 1));
+        std::string partitionText;
+        while (std::getline(partitions, partitionText, ','))
+        {
+            TlbPartition partition;
+            if (!ParsePartition(partitionText, partition))
+            {
+                return false;
+            }
+            level.Partitions.push_back(partition);
+        }
+
+        if (level.Partitions.empty())
+        {
+            return false;
+        }
+        config.Levels.push_back(std::move(level));
+    }
+
+    return !config.Levels.empty();
+}
+
+/// <summary>
+/// Share of the lookups which missed.
+/// </summary>
+double PTE::TlbLevelStats::MissRate() const
+{
+    return Lookups != 0 ? static_cast<double>(Misses) / Lookups : 0.0;
+}
+
+/// <summary>
+/// Collect the large pages of the snapshot.
+/// </summary>
+/// <param name="tables">Page tables of the process</param>
+void PTE::PageSizeMap::Build(const PageTables& tables)
+{
+    m_starts.clear();
+    m_sizes.clear();
+
+    tables.ForEachLeaf([&](const LeafMapping& leaf)
+        {
+            if (leaf.level != TABLE_LEVEL_PT)
+            {
+                Add(leaf.va, leaf.size);
+            }
+        });
+
+    Finish();
+}
+
+/// <summary>
+/// Add a large page, Finish must be called after the last one.
+/// </summary>
+/// <param name="va">The first virtual address of the page</param>
+/// <param name="size">2MB or 1GB</param>
+void PTE::PageSizeMap::Add(uint64_t va, uint64_t size)
+{
+    m_starts.push_back(va);
+    m_sizes.push_back(static_cast<uint8_t>(size >= (1ull << s_pageShift[2]) ? 2 : 1));
+}
+
+/// <summary>
+/// Sort the pages added out of order and find the range they span.
+/// </summary>
+void PTE::PageSizeMap::Finish()
+{
+    if (!std::is_sorted(m_starts.begin(), m_starts.end()))
+    {
+        Sort();
+    }
+
+    m_first = m_starts.empty() ? 0 : m_starts.front();
+    m_end = 0;
+    for (size_t i = 0; i < m_starts.size(); ++i)
+    {
+        m_end = std::max<uint64_t>(m_end, m_starts[i] + (1ull << s_pageShift[m_sizes[i]]));
+    }
+}
+
+/// <summary>
+/// Sort the pages by the virtual address.
+/// </summary>
+void PTE::PageSizeMap::Sort()
+{
+    std::vector<size_t> order(m_starts.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](size_t left, size_t right) { return m_starts[left] < m_starts[right]; });
+
+    std::vector<uint64_t> starts(order.size());
+    std::vector<uint8_t> sizes(order.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        starts[i] = m_starts[order[i]];
+        sizes[i] = m_sizes[order[i]];
+    }
+
+    m_starts = std::move(starts);
+    m_sizes = std::move(sizes);
+}
+
+/// <summary>
+/// Get the size of the page holding the address.
+/// </summary>
+/// <param name="va">Virtual address</param>
+/// <returns>0 for 4KB, 1 for 2MB and 2 for 1GB pages</returns>
+uint32_t PTE::PageSizeMap::SizeIndex(uint64_t va) const
+{
+    //
+    // Most of the addresses are outside of the large pages.
+    if (va < m_first || va >= m_end)
+    {
+        return 0;
+    }
+
+    //
+    // The last start not above the address, a search without branches on the address.
+    const uint64_t* base = m_starts.data();
+    for (size_t count = m_starts.size(); count > 1; )
+    {
+        const size_t half = count / 2;
+        base = base[half] <= va ? base + half : base;
+        count -= half;
+    }
+
+    const size_t index = base - m_starts.data();
+
+    return va - m_starts[index] < (1ull << s_pageShift[m_sizes[index]]) ? m_sizes[index] : 0;
+}
+
+/// <summary>
+/// Number of the 2MB and 1GB pages.
+/// </summary>
+size_t PTE::PageSizeMap::LargePages() const
+{
+    return m_starts.size();
+}
+
+/// <summary>
+/// Lay out the set arrays of all the levels in a single tag array.
+/// The number of sets is rounded down to a power of two, the ways are limited to MaxWays.
+/// </summary>
+/// <param name="config">TLB levels</param>
+PTE::TlbSimulator::TlbSimulator(const TlbConfig& config)
+{
+    size_t base = 0;
+    size_t hintBase = 0;
+    size_t setBase = 0;
+
+    for (const auto& levelConfig : config.Levels)
+    {
+        Level level{ };
+        std::fill(std::begin(level.partitionOf), std::end(level.partitionOf), -1);
+
+        for (const auto& partitionConfig : levelConfig.Partitions)
+        {
+            const uint32_t ways = std::clamp(partitionConfig.Ways, 1u, MaxWays);
+            const uint32_t sets = std::bit_floor(std::max(1u, partitionConfig.Entries / ways));
+
+            //
+            // A size listed in several partitions goes to the first one.
+            for (uint32_t size = 0; size < PageSizes; ++size)
+            {
+                if ((partitionConfig.SizeMask & (1u << size)) != 0 && level.partitionOf[size] < 0)
+                {
+                    level.partitionOf[size] = static_cast<int32_t>(level.partitions.size());
+                }
+            }
+
+            const uint32_t hintStride = (ways + HintLanes - 1) / HintLanes * HintLanes;
+            level.partitions.push_back({ .base = base,
+                .hintBase = hintBase,
+                .setBase = setBase,
+                .ways = ways,
+                .setMask = sets - 1,
+                .hintStride = hintStride,
+                .allWays = static_cast<uint32_t>(~0ull >> (64 - ways)) });
+
+            base += static_cast<size_t>(sets) * ways;
+            hintBase += static_cast<size_t>(sets) * hintStride;
+            setBase += sets;
+        }
+
+        m_levels.push_back(level);
+    }
+
+    m_tags.assign(base, InvalidTag);
+    m_hints.assign(hintBase, MakeHint(InvalidTag));
+    m_used.assign(setBase, 0);
+}
+
+/// <summary>
+/// Set the model the page walks of the last level misses are replayed through.
+/// </summary>
+/// <param name="walkModel">The model or nullptr, owned by the caller</param>
+void PTE::TlbSimulator::SetWalkModel(WalkModel* walkModel)
+{
+    m_walkModel = walkModel;
+}
+
+/// <summary>
+/// Drop all the entries and the counters.
+/// </summary>
+void PTE::TlbSimulator::Reset()
+{
+    std::fill(m_tags.begin(), m_tags.end(), InvalidTag);
+    std::fill(m_hints.begin(), m_hints.end(), MakeHint(InvalidTag));
+    std::fill(m_used.begin(), m_used.end(), 0);
+
+    for (auto& level : m_levels)
+    {
+        level.lookups = 0;
+        level.misses = 0;
+    }
+
+    m_accesses = 0;
+    m_walks = 0;
+    m_lastSize = -1;
+    m_lastPage = 0;
+    std::fill(std::begin(m_sizeWalks), std::end(m_sizeWalks), 0);
+}
+
+/// <summary>
+/// Tag of the page: the page number and the size, so the pages of different
+/// sizes never match in a shared partition.
+/// </summary>
+uint64_t PTE::TlbSimulator::MakeTag(uint64_t va, uint32_t sizeIndex)
+{
+    return ((va >> s_pageShift[sizeIndex]) << 2) | sizeIndex;
+}
+
+/// <summary>
+/// Hint of the tag. The tags of a set share the low bits of the page number,
+/// so the higher bits are folded in.
+/// </summary>
+uint16_t PTE::TlbSimulator::MakeHint(uint64_t tag)
+{
+    return static_cast<uint16_t>(tag ^ (tag >> 16) ^ (tag >> 32));
+}
+
+/// <summary>
+/// Compare the hints of all the ways of the set with the hint of the tag,
+/// then the tags of the ways which matched.
+/// </summary>
+/// <param name="partition">The partition</param>
+/// <param name="set">Set index</param>
+/// <param name="tag">Tag of the page</param>
+/// <returns>The way holding the tag, -1 if none</returns>
+int32_t PTE::TlbSimulator::FindWay(const Partition& partition, size_t set, uint64_t tag) const
+{
+    const uint64_t* tags = m_tags.data() + partition.base + set * partition.ways;
+    const uint16_t* hints = m_hints.data() + partition.hintBase + set * partition.hintStride;
+    const __m128i key = _mm_set1_epi16(static_cast<short>(MakeHint(tag)));
+
+    for (uint32_t group = 0; group < partition.ways; group += HintLanes)
+    {
+        //
+        // Two mask bits per 16-bit lane, the lanes past the last way are padding.
+        const __m128i row = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hints + group));
+        uint32_t lanes = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi16(row, key))) & 0x5555;
+
+        for (; lanes != 0; lanes &= lanes - 1)
+        {
+            const uint32_t way = group + std::countr_zero(lanes) / 2;
+            if (way < partition.ways && tags[way] == tag)
+            {
+                return static_cast<int32_t>(way);
+            }
+        }
+    }
+
+    return -1;
+}
+
+/// <summary>
+/// Mark the way as recently used. When all the ways are marked only this one stays marked.
+/// </summary>
+void PTE::TlbSimulator::Touch(const Partition& partition, size_t set, uint32_t way)
+{
+    uint32_t& used = m_used[partition.setBase + set];
+
+    used |= 1u << way;
+    if (used == partition.allWays)
+    {
+        used = 1u << way;
+    }
+}
+
+/// <summary>
+/// Probe the partition of the level caching the size of the page.
+/// The entries are filled with the sizes of the map, so the partitions
+/// of the other sizes can not hold the address and are not probed.
+/// </summary>
+/// <param name="level">TLB level</param>
+/// <param name="va">Virtual address</param>
+/// <param name="sizeIndex">Size of the page holding the address</param>
+/// <returns>True on a hit</returns>
+bool PTE::TlbSimulator::Lookup(Level& level, uint64_t va, uint32_t sizeIndex)
+{
+    ++level.lookups;
+
+    if (level.partitionOf[sizeIndex] >= 0)
+    {
+        const Partition& partition = level.partitions[level.partitionOf[sizeIndex]];
+        const size_t set = (va >> s_pageShift[sizeIndex]) & partition.setMask;
+
+        const int32_t way = FindWay(partition, set, MakeTag(va, sizeIndex));
+        if (way >= 0)
+        {
+            Touch(partition, set, static_cast<uint32_t>(way));
+            return true;
+        }
+    }
+
+    ++level.misses;
+
+    return false;
+}
+
+/// <summary>
+/// Insert the page into the first way not recently used and mark it.
+/// </summary>
+/// <param name="level">TLB level</param>
+/// <param name="va">Virtual address</param>
+/// <param name="sizeIndex">Size of the page</param>
+void PTE::TlbSimulator::Fill(Level& level, uint64_t va, uint32_t sizeIndex)
+{
+    //
+    // The size is not cached at this level, e.g. no 1GB entries in some first level TLBs.
+    if (level.partitionOf[sizeIndex] < 0)
+    {
+        return;
+    }
+
+    const Partition& partition = level.partitions[level.partitionOf[sizeIndex]];
+    const size_t set = (va >> s_pageShift[sizeIndex]) & partition.setMask;
+    const uint32_t way = std::countr_zero(~m_used[partition.setBase + set] & partition.allWays);
+    const uint64_t tag = MakeTag(va, sizeIndex);
+
+    m_tags[partition.base + set * partition.ways + way] = tag;
+    m_hints[partition.hintBase + set * partition.hintStride + way] = MakeHint(tag);
+    Touch(partition, set, way);
+}
+
+/// <summary>
+/// Replay the accesses. A hit fills the levels above the one which hit,
+/// a miss in all the levels walks the page tables and fills all of them.
+/// The map must stay the same until Reset.
+/// </summary>
+/// <param name="addresses">Virtual addresses</param>
+/// <param name="count">Number of the addresses</param>
+/// <param name="map">Page sizes of the process</param>
+void PTE::TlbSimulator::Replay(const uint64_t* addresses, size_t count, const PageSizeMap& map)
+{
+    const size_t levels = m_levels.size();
+    if (levels == 0)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint64_t va = addresses[i];
+
+        //
+        // The page of the previous access is marked as recently used in its first level set,
+        // another access to it only counts a hit. Most of the trace takes this path.
+        if (m_lastSize >= 0 && (va >> s_pageShift[m_lastSize]) == m_lastPage)
+        {
+            ++m_levels[0].lookups;
+            continue;
+        }
+
+        const uint32_t size = map.SizeIndex(va);
+
+        size_t hitLevel = 0;
+        while (hitLevel < levels && !Lookup(m_levels[hitLevel], va, size))
+        {
+            ++hitLevel;
+        }
+
+        if (hitLevel == levels)
+        {
+            ++m_walks;
+            ++m_sizeWalks[size];
+
+            if (m_walkModel != nullptr)
+            {
+                m_walkModel->Walk(va, size);
+            }
+        }
+
+        for (size_t level = 0; level < hitLevel; ++level)
+        {
+            Fill(m_levels[level], va, size);
+        }
+
+        m_lastSize = m_levels[0].partitionOf[size] >= 0 ? static_cast<int32_t>(size) : -1;
+        m_lastPage = va >> s_pageShift[size];
+    }
+
+    m_accesses += count;
+}
+
+/// <summary>
+/// Get the counters and the memory covered by the valid entries.
+/// </summary>
+PTE::TlbStats PTE::TlbSimulator::Stats() const
+{
+    TlbStats stats;
+    stats.Accesses = m_accesses;
+    stats.Walks = m_walks;
+    std::copy(std::begin(m_sizeWalks), std::end(m_sizeWalks), stats.SizeWalks);
+
+    for (const auto& level : m_levels)
+    {
+        TlbLevelStats levelStats{ .Lookups = level.lookups, .Misses = level.misses };
+
+        for (const auto& partition : level.partitions)
+        {
+            const size_t entries = static_cast<size_t>(partition.setMask + 1) * partition.ways;
+            for (size_t i = 0; i < entries; ++i)
+            {
+                const uint64_t tag = m_tags[partition.base + i];
+                if (tag != InvalidTag)
+                {
+                    levelStats.CoveredBytes += 1ull << s_pageShift[tag & 3];
+                }
+            }
+        }
+
+        stats.Levels.push_back(levelStats);
+    }
+
+    return stats;
+}
+
+/// <summary>
+/// Replay the trace file twice at once: with the page sizes of the mapping and with 4KB pages only.
+/// </summary>
+/// <param name="tracePath">File of 64-bit virtual addresses</param>
+/// <param name="map">Page sizes of the process</param>
+/// <param name="config">TLB levels</param>
+/// <param name="report">Results</param>
+/// <param name="walkModel">Model of the walks with the captured page sizes, optional</param>
+/// <returns>Win32 error code, 0 on success</returns>
+unsigned long PTE::TlbSimulator::ReplayFile(const std::wstring& tracePath,
+    const PageSizeMap& map,
+    const TlbConfig& config,
+    Report& report,
+    WalkModel* walkModel)
+{
+    std::ifstream trace(tracePath, std::ios::in | std::ios::binary);
+    if (!trace)
+    {
+        return ERROR_FILE_NOT_FOUND;
+    }
+
+    TlbSimulator actual(config);
+    TlbSimulator small(config);
+    actual.SetWalkModel(walkModel);
+    const PageSizeMap smallMap;
+
+    std::vector<uint64_t> addresses(TraceChunk);
+    std::chrono::steady_clock::duration elapsed{ };
+
+    while (trace)
+    {
+        trace.read(reinterpret_cast<char*>(addresses.data()), addresses.size() * sizeof(uint64_t));
+        const size_t count = static_cast<size_t>(trace.gcount()) / sizeof(uint64_t);
+        if (count == 0)
+        {
+            break;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        actual.Replay(addresses.data(), count, map);
+        elapsed += std::chrono::steady_clock::now() - start;
+
+        small.Replay(addresses.data(), count, smallMap);
+    }
+
+    report.Actual = actual.Stats();
+    report.Small = small.Stats();
+    if (walkModel != nullptr)
+    {
+        report.Walks = walkModel->Stats();
+    }
+    report.Seconds = std::chrono::duration<double>(elapsed).count();
+
+    return ERROR_SUCCESS;
+}
+
+/// <summary>
+/// Write the report as CSV: the counters of every level for both page layouts.
+/// </summary>
+/// <param name="path">Report path</param>
+/// <param name="pid">Process the page sizes come from</param>
+/// <param name="config">TLB levels</param>
+/// <param name="report">Results</param>
+/// <returns>True on success</returns>
+bool PTE::TlbSimulator::WriteReport(const std::wstring& path, ULONG pid, const TlbConfig& config, const Report& report)
+{
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file)
+    {
+        return false;
+    }
+
+    file << "layout,level,lookups,misses,miss_rate,covered_kb\n";
+    WriteStats(file, "actual", config, report.Actual);
+    WriteStats(file, "4k_only", config, report.Small);
+
+    const uint64_t accesses = report.Actual.Accesses;
+    auto perThousand = [&](uint64_t walks) { return accesses != 0 ? walks * 1000.0 / accesses : 0.0; };
+
+    file << std::format("# pid {}, {} accesses, {:.2f} M accesses/s\n",
+        pid, accesses, report.Seconds > 0 ? accesses / report.Seconds / 1e6 : 0.0);
+    file << std::format("# walks: {} ({:.3f} per 1000 accesses; 4k {} 2m {} 1g {}), 4k only: {} ({:.3f} per 1000 accesses)\n",
+        report.Actual.Walks,
+        perThousand(report.Actual.Walks),
+        report.Actual.SizeWalks[0],
+        report.Actual.SizeWalks[1],
+        report.Actual.SizeWalks[2],
+        report.Small.Walks,
+        perThousand(report.Small.Walks));
+
+    //
+    // The reach gained by the large pages: memory covered by the last level at the end of the trace.
+    if (!report.Actual.Levels.empty())
+    {
+        file << std::format("# last level reach {} KB, {} KB with 4k pages only\n",
+            report.Actual.Levels.back().CoveredBytes / 1024,
+            report.Small.Levels.back().CoveredBytes / 1024);
+    }
+
+    //
+    // Memory references of the walks and whether the table lines they read fit in the LLC.
+    const WalkStats& walks = report.Walks;
+    if (walks.Walks != 0)
+    {
+        auto hitRate = [&](ULONG level)
+            {
+                return walks.CacheLookups[level] != 0 ? static_cast<double>(walks.CacheHits[level]) / walks.CacheLookups[level] : 0.0;
+            };
+
+        file << std::format("# walk depth {:.3f} references, depth 1/2/3/4: {}/{}/{}/{}, no table: {}\n",
+            walks.AverageDepth(),
+            walks.Depth[1],
+            walks.Depth[2],
+            walks.Depth[3],
+            walks.Depth[4],
+            walks.Depth[0]);
+        file << std::format("# paging-structure cache hit rate pml4e {:.3f} pdpte {:.3f} pde {:.3f}\n",
+            hitRate(TABLE_LEVEL_PML4),
+            hitRate(TABLE_LEVEL_PDP),
+            hitRate(TABLE_LEVEL_PD));
+        file << std::format("# table footprint {} KB in {} lines of {} table pages\n",
+            walks.Lines * 64 / 1024,
+            walks.Lines,
+            walks.TablePages);
+    }
+
+    return static_cast<bool>(file);
+}
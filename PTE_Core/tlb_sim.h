@@ -0,0 +1,209 @@
+/*
+	tlb_sim.h
+
+	Simulator of the data TLB hierarchy replaying an address trace
+	against the page sizes of a captured process mapping.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "include.h"
+#include "page_tables.h"
+#include "walk_model.h"
+
+namespace PTE
+{
+
+/// <summary>
+/// A set associative array of a TLB level holding the pages of one or more sizes.
+/// </summary>
+struct TlbPartition
+{
+	uint32_t Entries{ 0 };
+	uint32_t Ways{ 0 };
+
+	//
+	// Bit 0 for 4KB, 1 for 2MB and 2 for 1GB pages
+	uint32_t SizeMask{ 0 };
+};
+
+/// <summary>
+/// A TLB level, the partitions are probed in parallel.
+/// </summary>
+struct TlbLevelConfig
+{
+	std::string Name;
+	std::vector<TlbPartition> Partitions;
+};
+
+/// <summary>
+/// The levels from the closest to the core, a miss in the last one walks the page tables.
+/// </summary>
+struct TlbConfig
+{
+	std::vector<TlbLevelConfig> Levels;
+
+	static TlbConfig Default();
+	static bool Parse(const std::string& text, TlbConfig& config);
+};
+
+/// <summary>
+/// Counters of a TLB level.
+/// </summary>
+struct TlbLevelStats
+{
+	uint64_t Lookups{ 0 };
+	uint64_t Misses{ 0 };
+
+	//
+	// Memory translated by the valid entries at the end of the replay
+	uint64_t CoveredBytes{ 0 };
+
+	double MissRate() const;
+};
+
+/// <summary>
+/// Counters of a replay.
+/// </summary>
+struct TlbStats
+{
+	uint64_t Accesses{ 0 };
+	uint64_t Walks{ 0 };
+
+	//
+	// Page walks by the size of the page found
+	uint64_t SizeWalks[3]{ };
+
+	std::vector<TlbLevelStats> Levels;
+};
+
+/// <summary>
+/// Page sizes of a process mapping. Only the large pages are kept,
+/// the rest of the address space is treated as 4KB pages.
+/// </summary>
+class PageSizeMap
+{
+public:
+	void Build(const PageTables& tables);
+	void Add(uint64_t va, uint64_t size);
+	void Finish();
+
+	uint32_t SizeIndex(uint64_t va) const;
+	size_t LargePages() const;
+
+private:
+	void Sort();
+
+	//
+	// Sorted by the virtual address
+	std::vector<uint64_t> m_starts;
+	std::vector<uint8_t> m_sizes;
+
+	//
+	// [m_first, m_end) spanned by the pages
+	uint64_t m_first{ 0 };
+	uint64_t m_end{ 0 };
+};
+
+/// <summary>
+/// Replays the accesses through the TLB levels. All the set arrays share a single
+/// tag array. Next to it a 16-bit hint of every tag lets a probe compare all the ways
+/// of a set at once, and a bit per way marks the recently used ones, the victim
+/// is the first way not marked (bit-PLRU).
+/// </summary>
+class TlbSimulator
+{
+public:
+	static constexpr uint32_t PageSizes = 3;
+
+	//
+	// Ways of a set at most, a bit per way in the recently used mask
+	static constexpr uint32_t MaxWays = 32;
+
+	explicit TlbSimulator(const TlbConfig& config);
+
+	void SetWalkModel(WalkModel* walkModel);
+	void Reset();
+	void Replay(const uint64_t* addresses, size_t count, const PageSizeMap& map);
+	TlbStats Stats() const;
+
+	/// <summary>
+	/// Results of the replay of a trace with the captured page sizes and with 4KB pages only.
+	/// </summary>
+	struct Report
+	{
+		TlbStats Actual;
+		TlbStats Small;
+
+		//
+		// Walks of the replay with the captured page sizes, if the walk model was given
+		WalkStats Walks;
+
+		double Seconds{ 0 };
+	};
+
+	static unsigned long ReplayFile(const std::wstring& tracePath,
+		const PageSizeMap& map,
+		const TlbConfig& config,
+		Report& report,
+		WalkModel* walkModel = nullptr);
+	static bool WriteReport(const std::wstring& path, ULONG pid, const TlbConfig& config, const Report& report);
+
+private:
+	struct Partition
+	{
+		//
+		// The first tag, the first hint and the first set of the partition
+		size_t base;
+		size_t hintBase;
+		size_t setBase;
+		uint32_t ways;
+		uint32_t setMask;
+
+		//
+		// Hints per set, the ways rounded up to the hints compared at once
+		uint32_t hintStride;
+		uint32_t allWays;
+	};
+
+	struct Level
+	{
+		std::vector<Partition> partitions;
+
+		//
+		// The partition caching each page size, -1 if the level does not cache it
+		int32_t partitionOf[PageSizes];
+
+		uint64_t lookups;
+		uint64_t misses;
+	};
+
+	bool Lookup(Level& level, uint64_t va, uint32_t sizeIndex);
+	void Fill(Level& level, uint64_t va, uint32_t sizeIndex);
+	int32_t FindWay(const Partition& partition, size_t set, uint64_t tag) const;
+	void Touch(const Partition& partition, size_t set, uint32_t way);
+
+	static uint64_t MakeTag(uint64_t va, uint32_t sizeIndex);
+	static uint16_t MakeHint(uint64_t tag);
+
+	std::vector<Level> m_levels;
+	std::vector<uint64_t> m_tags;
+	std::vector<uint16_t> m_hints;
+	std::vector<uint32_t> m_used;
+	WalkModel* m_walkModel{ nullptr };
+	uint64_t m_accesses{ 0 };
+	uint64_t m_walks{ 0 };
+	uint64_t m_sizeWalks[PageSizes]{ };
+
+	//
+	// Page of the previous access and its size index, -1 if the first level does not cache it
+	int32_t m_lastSize{ -1 };
+	uint64_t m_lastPage{ 0 };
+};
+
+} //namespace PTE
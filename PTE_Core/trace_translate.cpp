@@ -0,0 +1,666 @@
+/*
+    trace_translate.cpp
+
+    Bulk translation of (pid, va) address traces.
+    A chunk of records is sorted by a 64-bit key: the index of the process
+    in the chunk above the low 48 bits of the address. The sorted addresses
+    of a process are then translated by a merge pass over its leaf index.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "trace_translate.h"
+#include "timeline.h"
+#include "utils.h"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <fstream>
+
+namespace
+{
+
+constexpr uint64_t AddressMask = (1ull << 48) - 1;
+constexpr unsigned int AddressBits = 48;
+
+//
+// Process index in the sort key, the records of the processes over the limit are skipped.
+constexpr size_t MaxChunkProcesses = 1 << (64 - AddressBits);
+
+//
+// LSD radix sort digits
+constexpr unsigned int DigitBits = 16;
+constexpr size_t Buckets = 1 << DigitBits;
+constexpr unsigned int Digits = 64 / DigitBits;
+
+//
+// Read buffer of the trace and write buffer of the text output
+constexpr size_t ReadBufferSize = 4 << 20;
+constexpr size_t WriteBufferSize = 4 << 20;
+
+//
+// Longest text output line: "4294967295,0x<16>,0x<16>,1g,65535\n"
+constexpr size_t MaxLineSize = 10 + 3 + 16 + 3 + 16 + 3 + 1 + 5 + 1;
+
+const char s_hexLower[] = "0123456789abcdef";
+
+/// <summary>
+/// Restore the canonical address from its low 48 bits.
+/// </summary>
+uint64_t Canonical(uint64_t address)
+{
+    return static_cast<uint64_t>(static_cast<int64_t>(address << (64 - AddressBits)) >> (64 - AddressBits));
+}
+
+/// <summary>
+/// Sort the keys with an LSD radix sort, skipping the digits equal for all the keys.
+/// </summary>
+/// <param name="keys">Keys to sort</param>
+/// <param name="scratch">Buffer reused between the chunks</param>
+void SortKeys(std::vector<uint64_t>& keys, std::vector<uint64_t>& scratch)
+{
+    std::vector<size_t> counts(Digits * Buckets, 0);
+    for (const uint64_t key : keys)
+    {
+        for (unsigned int digit = 0; digit < Digits; ++digit)
+        {
+            ++counts[digit * Buckets + ((key >> (digit * DigitBits)) & (Buckets - 1))];
+        }
+    }
+
+    scratch.resize(keys.size());
+
+    for (unsigned int digit = 0; digit < Digits; ++digit)
+    {
+        size_t* count = counts.data() + digit * Buckets;
+        if (std::find(count, count + Buckets, keys.size()) != count + Buckets)
+        {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (size_t bucket = 0; bucket < Buckets; ++bucket)
+        {
+            const size_t size = count[bucket];
+            count[bucket] = offset;
+            offset += size;
+        }
+
+        for (const uint64_t key : keys)
+        {
+            scratch[count[(key >> (digit * DigitBits)) & (Buckets - 1)]++] = key;
+        }
+
+        keys.swap(scratch);
+    }
+}
+
+/// <summary>
+/// Append the decimal number.
+/// </summary>
+char* AppendDecimal(char* out, uint64_t value)
+{
+    char digits[20];
+    size_t count = 0;
+    do
+    {
+        digits[count++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    while (count != 0)
+    {
+        *out++ = digits[--count];
+    }
+
+    return out;
+}
+
+/// <summary>
+/// Append the number in hex with the 0x prefix and without the leading zeros.
+/// </summary>
+char* AppendHex(char* out, uint64_t value)
+{
+    *out++ = '0';
+    *out++ = 'x';
+
+    int shift = value != 0 ? (63 - std::countl_zero(value)) & ~3 : 0;
+    for (; shift >= 0; shift -= 4)
+    {
+        *out++ = s_hexLower[(value >> shift) & 0xF];
+    }
+
+    return out;
+}
+
+/// <summary>
+/// Format a line of the text output, the columns of the address not mapped are empty.
+/// </summary>
+/// <returns>Number of characters written</returns>
+size_t FormatLine(char* out, ULONG pid, uint64_t va, uint64_t pa, uint32_t pageSize, uint16_t node)
+{
+    char* pos = AppendDecimal(out, pid);
+    *pos++ = ',';
+    pos = AppendHex(pos, va);
+    *pos++ = ',';
+
+    if (pageSize != 0)
+    {
+        pos = AppendHex(pos, pa);
+        *pos++ = ',';
+        *pos++ = pageSize >= (1u << 30) ? '1' : pageSize >= (1u << 21) ? '2' : '4';
+        *pos++ = pageSize >= (1u << 30) ? 'g' : pageSize >= (1u << 21) ? 'm' : 'k';
+        *pos++ = ',';
+        if (node != PTE::NumaMap::UnknownNode)
+        {
+            pos = AppendDecimal(pos, node);
+        }
+    }
+    else
+    {
+        *pos++ = ',';
+        *pos++ = ',';
+    }
+    *pos++ = '\n';
+
+    return pos - out;
+}
+
+/// <summary>
+/// Streaming reader of the binary and the text traces.
+/// </summary>
+class TraceReader
+{
+public:
+    /// <summary>
+    /// Open the trace and tell the binary one by the control characters at its start.
+    /// </summary>
+    /// <returns>True on success</returns>
+    bool Open(const std::wstring& path)
+    {
+        m_file.open(path, std::ios::in | std::ios::binary);
+        if (!m_file)
+        {
+            return false;
+        }
+
+        m_data.resize(ReadBufferSize);
+        Fill();
+
+        const size_t probe = std::min<size_t>(m_end, 64);
+        m_binary = std::any_of(m_data.begin(), m_data.begin() + probe, [](char c)
+            {
+                const unsigned char byte = static_cast<unsigned char>(c);
+                return (byte < 0x20 && byte != '\t' && byte != '\r' && byte != '\n') || byte >= 0x7F;
+            });
+
+        return true;
+    }
+
+    /// <summary>
+    /// Read the next records.
+    /// </summary>
+    /// <param name="pids">Processes</param>
+    /// <param name="addresses">Virtual addresses</param>
+    /// <param name="max">Capacity of the arrays</param>
+    /// <param name="skipped">Incremented for every text line which is not a record</param>
+    /// <returns>Number of the records, 0 at the end of the trace</returns>
+    size_t Read(ULONG* pids, uint64_t* addresses, size_t max, uint64_t& skipped)
+    {
+        return m_binary ? ReadBinary(pids, addresses, max) : ReadText(pids, addresses, max, skipped);
+    }
+
+private:
+    /// <summary>
+    /// Move the unread data to the front of the buffer and read more after it.
+    /// </summary>
+    /// <returns>True if anything was read</returns>
+    bool Fill()
+    {
+        memmove(m_data.data(), m_data.data() + m_pos, m_end - m_pos);
+        m_end -= m_pos;
+        m_pos = 0;
+
+        if (m_eof || m_end == m_data.size())
+        {
+            return false;
+        }
+
+        m_file.read(m_data.data() + m_end, m_data.size() - m_end);
+        const size_t read = static_cast<size_t>(m_file.gcount());
+        m_end += read;
+        m_eof = !m_file;
+
+        return read != 0;
+    }
+
+    size_t ReadBinary(ULONG* pids, uint64_t* addresses, size_t max)
+    {
+        size_t count = 0;
+
+        while (count < max)
+        {
+            //
+            // A partial record at the end of the trace is dropped.
+            if (m_end - m_pos < sizeof(PTE::TraceRecord) && !Fill())
+            {
+                break;
+            }
+            if (m_end - m_pos < sizeof(PTE::TraceRecord))
+            {
+                continue;
+            }
+
+            PTE::TraceRecord record;
+            memcpy(&record, m_data.data() + m_pos, sizeof(record));
+            m_pos += sizeof(record);
+
+            pids[count] = record.Pid;
+            addresses[count] = record.VA;
+            ++count;
+        }
+
+        return count;
+    }
+
+    size_t ReadText(ULONG* pids, uint64_t* addresses, size_t max, uint64_t& skipped)
+    {
+        size_t count = 0;
+
+        while (count < max)
+        {
+            const char* begin = m_data.data() + m_pos;
+            const char* end = m_data.data() + m_end;
+            const char* newline = static_cast<const char*>(memchr(begin, '\n', end - begin));
+            if (newline == nullptr)
+            {
+                if (Fill())
+                {
+                    continue;
+                }
+
+                //
+                // The last line without the newline, Fill moved it to the front.
+                begin = m_data.data();
+                end = m_data.data() + m_end;
+                if (begin == end)
+                {
+                    break;
+                }
+                newline = end;
+            }
+
+            switch (ParseLine(begin, newline, pids[count], addresses[count]))
+            {
+            case LineType::Record:
+                ++count;
+                break;
+            case LineType::Invalid:
+                ++skipped;
+                break;
+            default:
+                break;
+            }
+
+            m_pos = (newline - m_data.data()) + (newline == end ? 0 : 1);
+        }
+
+        return count;
+    }
+
+    enum class LineType
+    {
+        Record,
+        Empty,
+        Invalid
+    };
+
+    /// <summary>
+    /// Parse "pid va": the decimal process id, a separator and the address in hex.
+    /// The rest of the line is ignored, the lines starting with '#' are comments.
+    /// </summary>
+    static LineType ParseLine(const char* pos, const char* end, ULONG& pid, uint64_t& address)
+    {
+        while (pos < end && (*pos == ' ' || *pos == '\t'))
+        {
+            ++pos;
+        }
+        if (pos == end || *pos == '#' || *pos == '\r')
+        {
+            return LineType::Empty;
+        }
+
+        uint64_t value = 0;
+        const char* digits = pos;
+        while (pos < end && *pos >= '0' && *pos <= '9' && pos - digits < 10)
+        {
+            value = value * 10 + (*pos++ - '0');
+        }
+        if (pos == digits || value > 0xFFFFFFFFull)
+        {
+            return LineType::Invalid;
+        }
+        pid = static_cast<ULONG>(value);
+
+        const char* separator = pos;
+        while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == ',' || *pos == ';' || *pos == ':'))
+        {
+            ++pos;
+        }
+        if (pos == separator)
+        {
+            return LineType::Invalid;
+        }
+
+        if (end - pos > 2 && pos[0] == '0' && (pos[1] == 'x' || pos[1] == 'X'))
+        {
+            pos += 2;
+        }
+
+        value = 0;
+        digits = pos;
+        for (; pos < end && pos - digits < 16; ++pos)
+        {
+            const char c = *pos;
+            const int nibble = c >= '0' && c <= '9' ? c - '0' :
+                c >= 'a' && c <= 'f' ? c - 'a' + 10 :
+                c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+            if (nibble < 0)
+            {
+                break;
+            }
+            value = (value << 4) | static_cast<uint64_t>(nibble);
+        }
+        if (pos == digits)
+        {
+            return LineType::Invalid;
+        }
+        address = value;
+
+        return LineType::Record;
+    }
+
+    std::ifstream m_file;
+    std::vector<char> m_data;
+    size_t m_pos{ 0 };
+    size_t m_end{ 0 };
+    bool m_eof{ false };
+    bool m_binary{ false };
+};
+
+} //namespace
+
+/// <summary>
+/// Open the driver for the page table reads.
+/// </summary>
+/// <param name="backend">Where the tables come from</param>
+/// <param name="numa">Node ranges of the frames</param>
+PTE::TraceTranslator::TraceTranslator(Backend backend, const NumaMap& numa) :
+    m_backend(backend),
+    m_numa(numa)
+{
+    m_device = Utils::OpenDevice();
+    m_deviceError = m_device == INVALID_HANDLE_VALUE ? GetLastError() : ERROR_SUCCESS;
+    m_buffer = BufferPool<IOCTL_ENUM_DATA>::Acquire();
+}
+
+PTE::TraceTranslator::~TraceTranslator()
+{
+    if (m_device != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_device);
+    }
+}
+
+/// <summary>
+/// Get the index of all the user tables of the process, read on the first use.
+/// </summary>
+/// <param name="pid">Process</param>
+/// <param name="stats">Counts the failed reads</param>
+/// <returns>The index, empty if the tables could not be read</returns>
+const PTE::LeafIndex& PTE::TraceTranslator::Snapshot(ULONG pid, TraceStats& stats)
+{
+    auto [it, inserted] = m_snapshots.try_emplace(pid);
+    if (inserted)
+    {
+        Timeline::Instant(TimelineCategory::Cache, "snapshot miss", pid);
+        if (Utils::ReadPageTables(m_device, pid, m_buffer.Get(), m_tables) == ERROR_SUCCESS)
+        {
+            it->second.Build(m_tables);
+        }
+        else
+        {
+            ++stats.TableErrors;
+        }
+        m_tables.Clear();
+    }
+
+    return it->second;
+}
+
+/// <summary>
+/// Translate the sorted addresses of a process.
+/// </summary>
+/// <param name="pid">Process</param>
+/// <param name="addresses">Sorted virtual addresses</param>
+/// <param name="count">Number of the addresses</param>
+/// <param name="pa">Physical addresses</param>
+/// <param name="pageSize">Page sizes</param>
+/// <param name="stats">Counts the failed reads</param>
+void PTE::TraceTranslator::TranslateProcess(ULONG pid,
+    const uint64_t* addresses,
+    size_t count,
+    uint64_t* pa,
+    uint32_t* pageSize,
+    TraceStats& stats)
+{
+    TimelineScope scope(TimelineCategory::Walk, "translate process", pid);
+
+    if (m_backend == Backend::Snapshot)
+    {
+        Snapshot(pid, stats).Translate(addresses, count, pa, pageSize);
+        return;
+    }
+
+    m_snapshots.try_emplace(pid);
+
+    //
+    // The addresses sharing the upper level indices are translated with the tables of their window.
+    for (size_t begin = 0; begin < count; )
+    {
+        const uint64_t window = addresses[begin] & ~(LiveWindow - 1);
+        size_t end = begin + 1;
+        while (end < count && addresses[end] - window < LiveWindow)
+        {
+            ++end;
+        }
+
+        m_window.Clear();
+        if (window < USER_ADDRESS_END)
+        {
+            if (Utils::ReadPageTables(m_device, pid, m_buffer.Get(), m_tables, window, window + LiveWindow) == ERROR_SUCCESS)
+            {
+                m_window.Build(m_tables);
+            }
+            else
+            {
+                ++stats.TableErrors;
+            }
+        }
+
+        m_window.Translate(addresses + begin, end - begin, pa + begin, pageSize + begin);
+        begin = end;
+    }
+}
+
+/// <summary>
+/// Translate the trace. The output is CSV, or TranslatedRecord if its name ends with ".bin".
+/// </summary>
+/// <param name="tracePath">Binary or text trace</param>
+/// <param name="outputPath">Output path</param>
+/// <param name="stats">Totals</param>
+/// <returns>Win32 error code, 0 on success</returns>
+unsigned long PTE::TraceTranslator::Run(const std::wstring& tracePath, const std::wstring& outputPath, TraceStats& stats)
+{
+    stats = {};
+
+    if (m_device == INVALID_HANDLE_VALUE)
+    {
+        return m_deviceError;
+    }
+    if (!m_buffer)
+    {
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    TraceReader reader;
+    if (!reader.Open(tracePath))
+    {
+        return ERROR_FILE_NOT_FOUND;
+    }
+
+    const bool binary = outputPath.size() >= 4 && outputPath.compare(outputPath.size() - 4, 4, L".bin") == 0;
+    std::ofstream output(outputPath, std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!output)
+    {
+        return ERROR_WRITE_FAULT;
+    }
+    if (!binary)
+    {
+        output << "pid,va,pa,page_size,node\n";
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<ULONG> pids(ChunkRecords);
+    VectorPool<uint64_t>::Lease addresses = VectorPool<uint64_t>::Acquire(ChunkRecords);
+    std::vector<uint64_t> keys;
+    std::vector<uint64_t> scratch;
+    VectorPool<uint64_t>::Lease pa = VectorPool<uint64_t>::Acquire(ChunkRecords);
+    VectorPool<uint32_t>::Lease pageSizes = VectorPool<uint32_t>::Acquire(ChunkRecords);
+    std::vector<ULONG> chunkPids;
+    std::unordered_map<ULONG, uint64_t> chunkIndex;
+    std::vector<char> text(WriteBufferSize + MaxLineSize);
+    std::vector<TranslatedRecord> records;
+
+    while (true)
+    {
+        TimelineScope chunk(TimelineCategory::Export, "chunk");
+
+        size_t count{ 0 };
+        {
+            TimelineScope read(TimelineCategory::Export, "read trace");
+            count = reader.Read(pids.data(), addresses.data(), ChunkRecords, stats.Skipped);
+        }
+        if (count == 0)
+        {
+            break;
+        }
+        chunk.SetArg(count);
+
+        //
+        // Consecutive records of the same process are common, look it up once per run.
+        chunkPids.clear();
+        chunkIndex.clear();
+        keys.clear();
+
+        ULONG lastPid = pids[0] + 1;
+        uint64_t lastIndex = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (pids[i] != lastPid)
+            {
+                auto [it, inserted] = chunkIndex.try_emplace(pids[i], chunkPids.size());
+                if (inserted)
+                {
+                    chunkPids.push_back(pids[i]);
+                }
+                lastPid = pids[i];
+                lastIndex = it->second;
+            }
+
+            if (lastIndex < MaxChunkProcesses)
+            {
+                keys.push_back((lastIndex << AddressBits) | (addresses[i] & AddressMask));
+            }
+        }
+
+        stats.Records += keys.size();
+        stats.Skipped += count - keys.size();
+
+        {
+            TimelineScope sort(TimelineCategory::Export, "sort");
+            SortKeys(keys, scratch);
+        }
+
+        for (size_t begin = 0; begin < keys.size(); )
+        {
+            const uint64_t index = keys[begin] >> AddressBits;
+            size_t end = begin;
+            for (; end < keys.size() && (keys[end] >> AddressBits) == index; ++end)
+            {
+                addresses[end] = Canonical(keys[end] & AddressMask);
+            }
+
+            const ULONG pid = chunkPids[index];
+            TranslateProcess(pid, addresses.data() + begin, end - begin, pa.data() + begin, pageSizes.data() + begin, stats);
+
+            TimelineScope write(TimelineCategory::Export, "write", end - begin);
+            size_t used = 0;
+            records.clear();
+            for (size_t i = begin; i < end; ++i)
+            {
+                const uint16_t node = pageSizes[i] != 0 ? m_numa.NodeOf(pa[i] / PAGE_SIZE) : NumaMap::UnknownNode;
+                stats.Translated += pageSizes[i] != 0;
+
+                if (binary)
+                {
+                    records.push_back({ .Pid = static_cast<uint32_t>(pid),
+                        .Node = node,
+                        .PageShift = static_cast<uint8_t>(pageSizes[i] != 0 ? std::countr_zero(pageSizes[i]) : 0),
+                        .Reserved = 0,
+                        .VA = addresses[i],
+                        .PA = pa[i] });
+                    continue;
+                }
+
+                used += FormatLine(text.data() + used, pid, addresses[i], pa[i], pageSizes[i], node);
+                if (used >= WriteBufferSize)
+                {
+                    output.write(text.data(), used);
+                    used = 0;
+                }
+            }
+
+            if (binary)
+            {
+                output.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(TranslatedRecord));
+            }
+            else
+            {
+                output.write(text.data(), used);
+            }
+
+            begin = end;
+        }
+    }
+
+    stats.Processes = m_snapshots.size();
+    stats.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!binary)
+    {
+        output << std::format("# {} records, {} translated, {} skipped, {} processes, {} table read errors, {:.1f} M records/s\n",
+            stats.Records,
+            stats.Translated,
+            stats.Skipped,
+            stats.Processes,
+            stats.TableErrors,
+            stats.Seconds > 0 ? stats.Records / stats.Seconds / 1e6 : 0.0);
+    }
+
+    return output ? ERROR_SUCCESS : ERROR_WRITE_FAULT;
+}
@@ -0,0 +1,122 @@
+/*
+	trace_translate.h
+
+	Bulk translation of (pid, va) address traces.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "buffer_pool.h"
+#include "include.h"
+#include "leaf_index.h"
+#include "numa.h"
+#include "page_tables.h"
+
+namespace PTE
+{
+
+/// <summary>
+/// Record of a binary trace.
+/// </summary>
+struct TraceRecord
+{
+	uint32_t Pid;
+	uint32_t Reserved;
+	uint64_t VA;
+};
+
+/// <summary>
+/// Record of a binary output, PA and PageShift are zero for the addresses not mapped.
+/// </summary>
+struct TranslatedRecord
+{
+	uint32_t Pid;
+	uint16_t Node;
+	uint8_t PageShift;
+	uint8_t Reserved;
+	uint64_t VA;
+	uint64_t PA;
+};
+
+/// <summary>
+/// Totals of a translation run.
+/// </summary>
+struct TraceStats
+{
+	uint64_t Records{ 0 };
+	uint64_t Translated{ 0 };
+
+	//
+	// Text lines which are not a (pid, va) record
+	uint64_t Skipped{ 0 };
+
+	uint64_t Processes{ 0 };
+
+	//
+	// Page table reads which failed, their addresses stay untranslated
+	uint64_t TableErrors{ 0 };
+
+	double Seconds{ 0 };
+};
+
+/// <summary>
+/// Translates a trace in chunks: the records of a chunk are sorted by the process
+/// and the address, so every process is translated by a single merge pass per
+/// table window. The output keeps this order.
+/// The trace is either binary TraceRecord or text lines "pid va" with the address in hex.
+/// </summary>
+class TraceTranslator
+{
+public:
+	//
+	// Snapshot reads all the tables of a process once, Live reads the tables
+	// of the windows touched by every chunk again.
+	enum class Backend
+	{
+		Snapshot,
+		Live
+	};
+
+	//
+	// Records sorted and translated at once
+	static constexpr size_t ChunkRecords = 1 << 22;
+
+	//
+	// Range of the page tables read at once by the live backend
+	static constexpr uint64_t LiveWindow = 1ull << 30;
+
+	TraceTranslator(Backend backend, const NumaMap& numa);
+	~TraceTranslator();
+	TraceTranslator(const TraceTranslator&) = delete;
+	TraceTranslator& operator=(const TraceTranslator&) = delete;
+
+	unsigned long Run(const std::wstring& tracePath, const std::wstring& outputPath, TraceStats& stats);
+
+private:
+	void TranslateProcess(ULONG pid, const uint64_t* addresses, size_t count, uint64_t* pa, uint32_t* pageSize, TraceStats& stats);
+	const LeafIndex& Snapshot(ULONG pid, TraceStats& stats);
+
+	Backend m_backend;
+	const NumaMap& m_numa;
+
+	HANDLE m_device{ INVALID_HANDLE_VALUE };
+	unsigned long m_deviceError{ ERROR_SUCCESS };
+	BufferPool<IOCTL_ENUM_DATA>::Lease m_buffer;
+	PageTables m_tables;
+
+	//
+	// Index of the current window of the live backend
+	LeafIndex m_window;
+
+	//
+	// Indexes of the snapshot backend, also the processes seen by the live one
+	std::unordered_map<ULONG, LeafIndex> m_snapshots;
+};
+
+} //namespace PTE
@@ -7,16 +7,25 @@
     
     2025
 */
-#include "main_form.h"
+#include "utils.h"
+#include "hex_dump.h"
+#include "latency.h"
+#include "stage_timer.h"
+#include "timeline.h"
+#include <algorithm>
 #include <iostream>
+#include <bit>
 #include <bitset>
-#include <format>
 #include <sstream>
 #include <iomanip>
 
 static const std::wstring s_wstrDriverName = L"PTE_Driver";
 static const std::wstring s_wstrDriverPath = PTE::Utils::GetCurrDir() + L"\\PTE_Driver.sys";
 
+//
+// Set when this process started the driver, a driver loaded by someone else stays loaded.
+static bool s_bDriverStarted = false;
+
 /// <summary>
 /// Get current directory path.
 /// </summary>
@@ -50,43 +59,9 @@ std::string PTE::Utils::LargeIntToHexString(const LARGE_INTEGER& li)
 /// <returns>The string with the memory information</returns>
 std::string PTE::Utils::GetPageData(ULONGLONG virt, LONGLONG phys, const uint8_t* data, size_t len)
 {
-    const short sAllignBy = 16;
-    std::string strResult;
-    std::string strAscii;
-
-    for (int i = 0; i < len; ++i)
-    {
-        //
-        // Add current address if this is the new line.
-        if (i % sAllignBy == 0)
-        {
-            strResult += std::format("0x{:012x}", virt + i);
-            strResult += " -> ";
-            strResult += std::format("0x{:012x} : ", phys + i);
-        }
-
-        strResult += std::format("{:02X} ", data[i]);
-        if (data[i] < 0x20)
-        {
-            strAscii += '.';
-        }
-        else
-        {
-            strAscii += data[i];
-        }
-
-        //
-        // New line
-        if ((i + 1) % sAllignBy == 0)
-        {
-            strResult += " ";
-            strResult += strAscii;
-            strResult += '\n';
-            strAscii.clear();
-        }
-    }
-
-    return strResult;
+    //
+    // Formatted into a single buffer sized up front.
+    return PTE::HexDump::Format(virt, static_cast<uint64_t>(phys), data, len);
 }
 
 /// <summary>
@@ -117,56 +92,45 @@ unsigned long long PTE::Utils::AssembleAddresss(const uint64_t ui1,
 /// </summary>
 /// <param name="hProcess">Process handle</param>
 /// <param name="address">Memory address</param>
-void PTE::Utils::Unpage(const HANDLE hProcess, const LPVOID address)
+/// <returns>Win32 error code, 0 on success</returns>
+unsigned long PTE::Utils::Unpage(const HANDLE hProcess, const LPVOID address)
 {
     //
     // Read a single byte to force address into the physical memory
     uint8_t buffer;
 
-    std::string strAddress = std::format("0x{:x}", static_cast<ULONGLONG>(PTE::MainForm::GetInstance()->GetCustomAddress()));
-
     if (ReadProcessMemory(hProcess, address, std::bit_cast<LPVOID>(&buffer), 1, nullptr) == 0)
     {
-        PTE::MainForm::GetInstance()->stripStatusLabel->Text = gcnew String("Failed to Unpage: [" + gcnew String(strAddress.data()) + "]");
-    }
-    else
-    {
-        PTE::MainForm::GetInstance()->stripStatusLabel->Text = gcnew String("Unpaged successfully: [" + gcnew String(strAddress.data()) + "]");
+        return GetLastError();
     }
-}
 
+    return ERROR_SUCCESS;
+}
 
 /// <summary>
 /// Try to open the process handle, apply debug privileges if necessary.
 /// </summary>
-/// <returns>Handle to the process or nullptr</returns>
-HANDLE PTE::Utils::OpenSelectedProcessPrivileged()
+/// <param name="pid">Process id</param>
+/// <param name="debugPrivileged">Whether the debug privileges are already acquired, set once they are</param>
+/// <param name="hProcess">Handle to the process or nullptr</param>
+/// <returns>Win32 error code, 0 on success</returns>
+unsigned long PTE::Utils::OpenProcessPrivileged(ULONG pid, bool& debugPrivileged, HANDLE& hProcess)
 {
-    DWORD pid = static_cast<ULONG>(PTE::MainForm::GetInstance()->dgvProcesses->CurrentRow->Cells["PID"]->Value);
-
-    //
-    // System process cannot be handled.
-    if (pid <= 4)
-    {
-        PTE::MainForm::GetInstance()->dgvMemory->Rows->Clear();
-        return nullptr;
-    }
-
-    HANDLE hProcess = OpenProcess(PROCESS_ALL_ACCESS, FALSE, pid);
+    hProcess = OpenProcess(PROCESS_ALL_ACCESS, FALSE, pid);
     if (hProcess)
     {
-        return hProcess;
+        return ERROR_SUCCESS;
     }
 
-    if (GetLastError() != ERROR_ACCESS_DENIED)
+    unsigned long err = GetLastError();
+    if (err != ERROR_ACCESS_DENIED)
     {
-        PTE::MainForm::GetInstance()->stripStatusLabel->Text = "Cannot get the handle to the process! Try running tool as Administrator.";
-        return nullptr;
+        return err;
     }
 
     //
     // If didn't open because of the privileges, try to open with privileges.
-    if (!PTE::MainForm::GetInstance()->IsDebugPrivileged())
+    if (!debugPrivileged)
     {
         //
         // Pseudo handle need not be closed
@@ -177,14 +141,7 @@ HANDLE PTE::Utils::OpenSelectedProcessPrivileged()
         // Try giving us debug privileges
         if (OpenProcessToken(hCurrentProcess, TOKEN_ADJUST_PRIVILEGES, &hToken) == TRUE)
         {
-            if (PTE::Utils::SetDebugPrivilege(hToken))
-            {
-                PTE::MainForm::GetInstance()->SetDebugPrivileged();
-            }
-            else
-            {
-                PTE::MainForm::GetInstance()->stripStatusLabel->Text = "Failed to get debug privileges:" + GetLastError();
-            }
+            debugPrivileged = PTE::Utils::SetDebugPrivilege(hToken);
             CloseHandle(hToken);
         }
     }
@@ -194,10 +151,10 @@ HANDLE PTE::Utils::OpenSelectedProcessPrivileged()
     hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
     if (!hProcess)
     {
-        PTE::MainForm::GetInstance()->stripStatusLabel->Text = "Cannot get the handle to the process. Try running tool as Administrator.";
-    };
+        return GetLastError();
+    }
 
-    return hProcess;
+    return ERROR_SUCCESS;
 }
 
 /// <summary>
@@ -245,8 +202,11 @@ unsigned long PTE::Utils::InitAndStartDriver()
         }
     }
 
-    if (StartServiceW(hService, 0, nullptr) != TRUE && 
-        GetLastError() != ERROR_SERVICE_ALREADY_RUNNING)
+    if (StartServiceW(hService, 0, nullptr) == TRUE)
+    {
+        s_bDriverStarted = true;
+    }
+    else if (GetLastError() != ERROR_SERVICE_ALREADY_RUNNING)
     {
         result = GetLastError();
         goto Exit;
@@ -266,13 +226,43 @@ Exit:
 }
 
 /// <summary>
-/// Attempt to stop and unregister the driver.
+/// Prepare a run without the UI: start the driver and get the debug privileges.
+/// </summary>
+/// <returns>Win32 error code, 0 on success</returns>
+unsigned long PTE::Utils::InitHeadless()
+{
+    unsigned long err = InitAndStartDriver();
+    if (err != 0)
+    {
+        return err;
+    }
+
+    //
+    // Debug privileges let us query the regions of the most processes.
+    HANDLE hToken = nullptr;
+    if (OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES, &hToken) == TRUE)
+    {
+        SetDebugPrivilege(hToken);
+        CloseHandle(hToken);
+    }
+
+    return 0;
+}
+
+/// <summary>
+/// Attempt to stop and unregister the driver if this process started it.
 /// </summary>
 /// <returns>True on success</returns>
 void PTE::Utils::StopAndDeleteDriver()
 {
     SERVICE_STATUS serviceStatus = { 0 };
 
+    if (!s_bDriverStarted)
+    {
+        return;
+    }
+    s_bDriverStarted = false;
+
     //
     // Do not attempt to output anything as we're terminating anyway.
     SC_HANDLE hManager = OpenSCManagerW(NULL, NULL, SC_MANAGER_CONNECT);
@@ -364,33 +354,128 @@ bool PTE::Utils::SetDebugPrivilege(const HANDLE hToken)
 /// <param name="address">The memory address we're interested in</param>
 /// <param name="data">The request and the response data</param>
 /// <param name="probe">Ask driver to page in the data</param>
-void PTE::Utils::SendIOCTL(ULONG pid, ULONGLONG address, IOCTL_DATA* data, bool probe)
+/// <returns>Win32 error code, 0 on success</returns>
+unsigned long PTE::Utils::SendIOCTL(ULONG pid, ULONGLONG address, IOCTL_DATA* data, bool probe)
 {
+    unsigned long result{ ERROR_SUCCESS };
     HANDLE device = INVALID_HANDLE_VALUE;
 
     data->address = std::bit_cast<PVOID>(address);
     data->pid = pid;
     data->probe = probe;
 
-    device = CreateFileW(L"\\\\.\\PTEDeviceLink",
-        GENERIC_WRITE | GENERIC_READ | GENERIC_EXECUTE,
-        0,
-        0,
-        OPEN_EXISTING,
-        FILE_ATTRIBUTE_SYSTEM,
-        0);
+    TimelineScope scope(TimelineCategory::Request, "translate", pid);
+
+    STAGE_TIMES& times = data->response.times;
+    times = { Latency::Enabled() };
+
+    {
+        StageTimer openTimer(times, TIMING_STAGE_OPEN);
+        device = OpenDevice();
+    }
     if (device == INVALID_HANDLE_VALUE)
     {
-        PTE::MainForm::GetInstance()->stripStatusLabel->Text = "Could not open device.";
-        return;
+        return GetLastError();
+    }
+
+    {
+        StageTimer ioctlTimer(times, TIMING_STAGE_IOCTL);
+        if (!DeviceIoControl(device, IOCTL_CODE, data, sizeof(*data), data, sizeof(*data), nullptr, nullptr))
+        {
+            result = GetLastError();
+        }
     }
 
-    if (!DeviceIoControl(device, IOCTL_CODE, data, sizeof(*data), data, sizeof(*data), nullptr, nullptr))
+    //
+    // What the driver did not time is the transport.
+    uint64_t driverTicks{ 0 };
+    for (ULONG stage = 0; stage < TIMING_STAGE_DRIVER_COUNT; ++stage)
     {
-        PTE::MainForm::GetInstance()->stripStatusLabel->Text = gcnew String("IOCTL failed: [" + GetLastError() + "]");
+        driverTicks += times.ticks[stage];
     }
+    times.ticks[TIMING_STAGE_IOCTL] -= std::min(times.ticks[TIMING_STAGE_IOCTL], driverTicks);
 
     CloseHandle(device);
 
-    return;
+    return result;
 }
+
+/// <summary>
+/// Open the driver device.
+/// </summary>
+/// <returns>Device handle or INVALID_HANDLE_VALUE</returns>
+HANDLE PTE::Utils::OpenDevice()
+{
+    return CreateFileW(L"\\\\.\\PTEDeviceLink",
+        GENERIC_WRITE | GENERIC_READ | GENERIC_EXECUTE,
+        0,
+        0,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_SYSTEM,
+        0);
+}
+
+/// <summary>
+/// Copy the user mode paging structures of the process.
+/// Does not touch the UI, so it can be called from any thread.
+/// The driver fails the request for a process it can not find, which gives ERROR_NOT_FOUND
+/// or ERROR_INVALID_PARAMETER for the system processes.
+/// </summary>
+/// <param name="device">The driver device handle</param>
+/// <param name="pid">Process id</param>
+/// <param name="data">Buffer for the request and the response, reused between the calls</param>
+/// <param name="tables">The snapshot</param>
+/// <param name="startVA">Start of the range to translate</param>
+/// <param name="endVA">End of the range to translate</param>
+/// <returns>Win32 error code, 0 on success</returns>
+unsigned long PTE::Utils::ReadPageTables(HANDLE device,
+    ULONG pid,
+    IOCTL_ENUM_DATA* data,
+    PTE::PageTables& tables,
+    uint64_t startVA,
+    uint64_t endVA)
+{
+    TimelineScope scope(TimelineCategory::Walk, "read tables", pid);
+
+    tables.Clear();
+
+    data->request.pid = pid;
+    data->request.startVA = startVA;
+    data->request.startLevel = TABLE_LEVEL_PML4;
+    data->request.endVA = endVA;
+
+    //
+    // The tables above a range in the middle of the address space begin before it.
+    data->request.parents = startVA != 0;
+
+    //
+    // The driver returns a limited number of tables at once,
+    // keep asking from the point where the previous response stopped.
+    do
+    {
+        DWORD returned{ 0 };
+        {
+            TimelineScope request(TimelineCategory::Request, "enum", pid);
+            if (!DeviceIoControl(device, IOCTL_ENUM_CODE, data, sizeof(*data), data, sizeof(*data), &returned, nullptr))
+            {
+                return GetLastError();
+            }
+        }
+
+        //
+        // A walk stops short only when the response is full,
+        // an empty one which is not complete means the process was not found.
+        if (!data->response.complete && data->response.count == 0)
+        {
+            return tables.Tables.empty() ? ERROR_NOT_FOUND : ERROR_INVALID_DATA;
+        }
+
+        tables.Append(data->response);
+
+        data->request.startVA = data->response.nextVA;
+        data->request.startLevel = data->response.nextLevel;
+        data->request.parents = false;
+    } while (!data->response.complete);
+
+    return ERROR_SUCCESS;
+}
\ No newline at end of file
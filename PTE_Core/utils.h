@@ -11,12 +11,14 @@
 #include <cstdint>
 #include <string>
 #include "include.h"
+#include "page_tables.h"
 
 namespace PTE
 {
 
 /// <summary>
 /// Wrapper class for static helper methods.
+/// Nothing here touches the UI, the errors are returned as Win32 codes.
 /// </summary>
 class Utils
 {
@@ -24,11 +26,19 @@ public:
 	static std::wstring GetCurrDir();
 	static bool IsElevated();
 	static void StopAndDeleteDriver();
-	static void Unpage(const HANDLE hProcess, const LPVOID address);
+	static unsigned long Unpage(const HANDLE hProcess, const LPVOID address);
 	static unsigned long InitAndStartDriver();
-	static void SendIOCTL(ULONG pid, ULONGLONG address, IOCTL_DATA* data, bool probe);
+	static unsigned long InitHeadless();
+	static unsigned long SendIOCTL(ULONG pid, ULONGLONG address, IOCTL_DATA* data, bool probe);
+	static HANDLE OpenDevice();
+	static unsigned long ReadPageTables(HANDLE device,
+		ULONG pid,
+		IOCTL_ENUM_DATA* data,
+		PageTables& tables,
+		uint64_t startVA = 0,
+		uint64_t endVA = USER_ADDRESS_END);
 	static bool SetDebugPrivilege(const HANDLE hToken);
-	static HANDLE OpenSelectedProcessPrivileged();
+	static unsigned long OpenProcessPrivileged(ULONG pid, bool& debugPrivileged, HANDLE& hProcess);
 	static unsigned long long AssembleAddresss(const uint64_t ui1, const uint64_t ui2, const uint64_t ui3, const uint64_t ui4);
 	static std::string GetPageData(ULONGLONG virt, LONGLONG phys, const uint8_t* data, size_t len);
 	static std::string LargeIntToHexString(const LARGE_INTEGER& li);
@@ -0,0 +1,191 @@
+/*
+    walk_model.cpp
+
+    Cost of the page walks: memory references per walk with the simulated
+    paging-structure caches and the cache lines of the tables they touch.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "walk_model.h"
+#include <algorithm>
+#include <bit>
+
+namespace
+{
+
+//
+// The address bits translated by an entry of every level.
+constexpr uint32_t s_levelShift[TABLE_LEVEL_COUNT] = { 39, 30, 21, 12 };
+
+constexpr uint64_t InvalidTag = ~0ull;
+constexpr uint64_t CanonicalMask = (1ull << 48) - 1;
+constexpr uint32_t LineShift = 6;
+
+} //namespace
+
+/// <summary>
+/// Entries read per walk.
+/// </summary>
+double PTE::WalkStats::AverageDepth() const
+{
+    return Walks != 0 ? static_cast<double>(References) / Walks : 0.0;
+}
+
+/// <summary>
+/// Index the tables of the snapshot and lay out the paging-structure caches.
+/// </summary>
+/// <param name="tables">Page tables of the process</param>
+/// <param name="config">Paging-structure caches</param>
+PTE::WalkModel::WalkModel(const PageTables& tables, const WalkCacheConfig& config)
+{
+    for (const auto& table : tables.Tables)
+    {
+        if (table.level < TABLE_LEVEL_COUNT)
+        {
+            m_tables.emplace(TableKey(table.level, table.baseVA), table.physAddress.QuadPart);
+        }
+    }
+
+    size_t base = 0;
+    for (ULONG level = TABLE_LEVEL_PML4; level < TABLE_LEVEL_PT; ++level)
+    {
+        const uint32_t ways = std::max(1u, config.Ways[level]);
+        const uint32_t sets = std::bit_floor(std::max(1u, config.Entries[level] / ways));
+
+        m_caches[level] = { base, ways, sets - 1 };
+        base += static_cast<size_t>(sets) * ways;
+    }
+
+    m_tags.assign(base, InvalidTag);
+}
+
+/// <summary>
+/// Drop the cached entries and the counters.
+/// </summary>
+void PTE::WalkModel::Reset()
+{
+    std::fill(m_tags.begin(), m_tags.end(), InvalidTag);
+    m_stats = {};
+    m_lines.clear();
+    m_pages.clear();
+}
+
+/// <summary>
+/// Key of the table translating the address at the level: the first address it translates and the level.
+/// The tables cover at least 2MB, so the low bits of the address are free.
+/// </summary>
+uint64_t PTE::WalkModel::TableKey(ULONG level, uint64_t va)
+{
+    const uint32_t coverageShift = s_levelShift[level] + 9;
+    const uint64_t baseVA = coverageShift >= 48 ? 0 : (va & CanonicalMask) & ~((1ull << coverageShift) - 1);
+
+    return baseVA | level;
+}
+
+/// <summary>
+/// Look up the entry of the level translating the address in its paging-structure cache.
+/// </summary>
+/// <returns>True on a hit</returns>
+bool PTE::WalkModel::Probe(ULONG level, uint64_t va)
+{
+    const Cache& cache = m_caches[level];
+    const uint64_t tag = (va & CanonicalMask) >> s_levelShift[level];
+    uint64_t* set = m_tags.data() + cache.base + (tag & cache.setMask) * cache.ways;
+
+    for (uint32_t way = 0; way < cache.ways; ++way)
+    {
+        if (set[way] == tag)
+        {
+            for (uint32_t w = way; w > 0; --w)
+            {
+                set[w] = set[w - 1];
+            }
+            set[0] = tag;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/// <summary>
+/// Cache the entry of the level translating the address, evicting the least recently used one.
+/// </summary>
+void PTE::WalkModel::Fill(ULONG level, uint64_t va)
+{
+    const Cache& cache = m_caches[level];
+    const uint64_t tag = (va & CanonicalMask) >> s_levelShift[level];
+    uint64_t* set = m_tags.data() + cache.base + (tag & cache.setMask) * cache.ways;
+
+    for (uint32_t w = cache.ways - 1; w > 0; --w)
+    {
+        set[w] = set[w - 1];
+    }
+    set[0] = tag;
+}
+
+/// <summary>
+/// Walk the tables for a TLB miss.
+/// </summary>
+/// <param name="va">Virtual address</param>
+/// <param name="sizeIndex">0 for 4KB, 1 for 2MB and 2 for 1GB pages</param>
+void PTE::WalkModel::Walk(uint64_t va, uint32_t sizeIndex)
+{
+    const ULONG leaf = TABLE_LEVEL_PT - std::min<ULONG>(sizeIndex, TABLE_LEVEL_PD);
+
+    //
+    // Only the non-leaf entries are cached, the deepest hit skips the levels above it.
+    ULONG start = TABLE_LEVEL_PML4;
+    for (ULONG level = leaf; level-- > TABLE_LEVEL_PML4; )
+    {
+        ++m_stats.CacheLookups[level];
+        if (Probe(level, va))
+        {
+            ++m_stats.CacheHits[level];
+            start = level + 1;
+            break;
+        }
+    }
+
+    uint32_t references = 0;
+    for (ULONG level = start; level <= leaf; ++level)
+    {
+        //
+        // No table: the entry above is not present and ends the walk.
+        auto it = m_tables.find(TableKey(level, va));
+        if (it == m_tables.end())
+        {
+            break;
+        }
+
+        const uint64_t entryPA = it->second + (((va >> s_levelShift[level]) & (TABLE_SIZE - 1)) * sizeof(uint64_t));
+        m_lines.insert(entryPA >> LineShift);
+        m_pages.insert(it->second / PAGE_SIZE);
+        ++references;
+
+        //
+        // The entry above points to this table, so it is cached.
+        if (level > start)
+        {
+            Fill(level - 1, va);
+        }
+    }
+
+    ++m_stats.Walks;
+    m_stats.References += references;
+    ++m_stats.Depth[references];
+}
+
+/// <summary>
+/// Get the counters and the footprint of the walks.
+/// </summary>
+PTE::WalkStats PTE::WalkModel::Stats() const
+{
+    WalkStats stats = m_stats;
+    stats.Lines = m_lines.size();
+    stats.TablePages = m_pages.size();
+
+    return stats;
+}
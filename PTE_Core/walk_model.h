@@ -0,0 +1,95 @@
+/*
+	walk_model.h
+
+	Cost of the page walks: memory references per walk with the simulated
+	paging-structure caches and the cache lines of the tables they touch.
+
+	Dmitry Podvigalkin
+
+	2025
+*/
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "include.h"
+#include "page_tables.h"
+
+namespace PTE
+{
+
+/// <summary>
+/// Sizes of the paging-structure caches of the PML4, PDPT and PD entries.
+/// </summary>
+struct WalkCacheConfig
+{
+	uint32_t Entries[TABLE_LEVEL_PT]{ 2, 4, 32 };
+	uint32_t Ways[TABLE_LEVEL_PT]{ 2, 4, 4 };
+};
+
+/// <summary>
+/// Counters of the walks.
+/// </summary>
+struct WalkStats
+{
+	uint64_t Walks{ 0 };
+	uint64_t References{ 0 };
+
+	//
+	// Walks by the number of the entries read, 0 when the snapshot has no table for the address
+	uint64_t Depth[TABLE_LEVEL_COUNT + 1]{ };
+
+	//
+	// Lookups and hits of the paging-structure caches, by the level of the cached entry
+	uint64_t CacheLookups[TABLE_LEVEL_PT]{ };
+	uint64_t CacheHits[TABLE_LEVEL_PT]{ };
+
+	//
+	// Distinct 64 byte lines and table pages read by the walks
+	uint64_t Lines{ 0 };
+	uint64_t TablePages{ 0 };
+
+	double AverageDepth() const;
+};
+
+/// <summary>
+/// Replays the page walks of the TLB misses through the tables of a snapshot.
+/// The walk starts below the deepest paging-structure cache hit and reads an entry
+/// per level, like AnalyzeAddress does, until the leaf or a missing table.
+/// </summary>
+class WalkModel
+{
+public:
+	explicit WalkModel(const PageTables& tables, const WalkCacheConfig& config = {});
+
+	void Reset();
+	void Walk(uint64_t va, uint32_t sizeIndex);
+	WalkStats Stats() const;
+
+private:
+	struct Cache
+	{
+		size_t base;
+		uint32_t ways;
+		uint32_t setMask;
+	};
+
+	bool Probe(ULONG level, uint64_t va);
+	void Fill(ULONG level, uint64_t va);
+
+	static uint64_t TableKey(ULONG level, uint64_t va);
+
+	//
+	// Physical addresses of the tables keyed by the level and the first address they translate
+	std::unordered_map<uint64_t, uint64_t> m_tables;
+
+	Cache m_caches[TABLE_LEVEL_PT]{ };
+	std::vector<uint64_t> m_tags;
+
+	WalkStats m_stats;
+	std::unordered_set<uint64_t> m_lines;
+	std::unordered_set<uint64_t> m_pages;
+};
+
+} //namespace PTE
@@ -32,6 +32,7 @@
 #include <array>
 #include <intrin.h>
 #include "include.h"
+#include "stage_timer.h"
 #include "pte_driver.h"
 #pragma warning( push )
 #pragma warning( disable : 4201 )
@@ -171,6 +172,12 @@ NTSTATUS Ioctl::HandleIOCTL(PDEVICE_OBJECT /*deviceObject*/, PIRP irp)
 
 	PIO_STACK_LOCATION stackLocation = IoGetCurrentIrpStackLocation(irp);
 
+	if (stackLocation->Parameters.DeviceIoControl.IoControlCode == IOCTL_ENUM_CODE &&
+		irp->AssociatedIrp.SystemBuffer != nullptr)
+	{
+		return HandleEnumIOCTL(irp);
+	}
+
 	if (stackLocation->Parameters.DeviceIoControl.IoControlCode != IOCTL_CODE ||
 		irp->AssociatedIrp.SystemBuffer == nullptr)
 	{
@@ -202,6 +209,42 @@ NTSTATUS Ioctl::HandleIOCTL(PDEVICE_OBJECT /*deviceObject*/, PIRP irp)
 	return status;
 }
 
+/// <summary>
+/// Handle the page tables enumeration Ioctl from the user mode.
+/// </summary>
+/// <param name="irp">I/O request packet</param>
+/// <returns>Status</returns>
+NTSTATUS Ioctl::HandleEnumIOCTL(PIRP irp)
+{
+	NTSTATUS status{ STATUS_BUFFER_TOO_SMALL };
+
+	PIO_STACK_LOCATION stackLocation = IoGetCurrentIrpStackLocation(irp);
+
+	//
+	// The response is large, so the system buffer is used directly
+	// instead of being locked for the second time.
+	if (stackLocation->Parameters.DeviceIoControl.InputBufferLength < sizeof(IOCTL_ENUM_DATA) ||
+		stackLocation->Parameters.DeviceIoControl.OutputBufferLength < sizeof(IOCTL_ENUM_DATA))
+	{
+		irp->IoStatus.Information = 0;
+	}
+	else
+	{
+		IOCTL_ENUM_DATA* request = static_cast<IOCTL_ENUM_DATA*>(irp->AssociatedIrp.SystemBuffer);
+
+		//
+		// A process which can not be found fails the request,
+		// so it is not taken for a process mapping nothing.
+		status = GetTablesForProcess(request->request, request->response);
+		irp->IoStatus.Information = NT_SUCCESS(status) ? sizeof(*request) : 0;
+	}
+
+	irp->IoStatus.Status = status;
+	IoCompleteRequest(irp, IO_NO_INCREMENT);
+
+	return status;
+}
+
 /// <summary>
 /// Check if supplied address is valid.
 /// </summary>
@@ -219,6 +262,8 @@ bool Ioctl::IsAddressValid(void* address)
 /// <param name="data">The structure used for the output</param>
 void Ioctl::AnalyzeAddress(PVOID address, IOCTL_RESPONSE& data)
 {
+	StageTimer walkTimer(data.times, TIMING_STAGE_WALK);
+
 	ULONG_PTR ullAddress = std::bit_cast<ULONGLONG>(address);
 
 	USHORT b47_39 = static_cast<USHORT>(BYTES_47_39(ullAddress));
@@ -238,6 +283,7 @@ void Ioctl::AnalyzeAddress(PVOID address, IOCTL_RESPONSE& data)
 	data.regCR0 = __readcr0();
 	data.regCR2 = __readcr2();
 	data.regCR3 = cr3.flags;
+	data.regPAT = __readmsr(IA32_PAT);
 
 	PHYSICAL_ADDRESS physAddress;
 
@@ -257,7 +303,7 @@ void Ioctl::AnalyzeAddress(PVOID address, IOCTL_RESPONSE& data)
 		return;
 	}
 
-	data.flagsPML4 = virtPML4->flags;
+	data.flagsPML4 = virtPML4[b47_39].flags;
 
 	//
 	// Iterate through the table and collect valid indexes
@@ -295,7 +341,7 @@ void Ioctl::AnalyzeAddress(PVOID address, IOCTL_RESPONSE& data)
 		return;
 	}
 
-	data.flagsPDP = virtPDP->flags;
+	data.flagsPDP = virtPDP[b38_30].flags;
 
 	for (auto i = 0; i < TABLE_SIZE; i++)
 	{
@@ -314,7 +360,9 @@ void Ioctl::AnalyzeAddress(PVOID address, IOCTL_RESPONSE& data)
 	// PD
 	//
 	
-	if (!virtPDP[b38_30].present)
+	//
+	// A 1GB page ends the walk, the entry points to the data, not to a PD.
+	if (!virtPDP[b38_30].present || virtPDP[b38_30].large_page)
 	{
 		return;
 	}
@@ -329,7 +377,7 @@ void Ioctl::AnalyzeAddress(PVOID address, IOCTL_RESPONSE& data)
 		return;
 	}
 
-	data.flagsPD = virtPD->flags;
+	data.flagsPD = virtPD[b29_21].flags;
 
 	for (auto i = 0; i < TABLE_SIZE; i++)
 	{
@@ -346,7 +394,9 @@ void Ioctl::AnalyzeAddress(PVOID address, IOCTL_RESPONSE& data)
 	// PT
 	//
 
-	if (!virtPD[b29_21].present)
+	//
+	// Same for a 2MB page.
+	if (!virtPD[b29_21].present || virtPD[b29_21].large_page)
 	{
 		return;
 	}
@@ -363,7 +413,7 @@ void Ioctl::AnalyzeAddress(PVOID address, IOCTL_RESPONSE& data)
 		return;
 	}
 
-	data.flagsPT = virtPT->flags;
+	data.flagsPT = virtPT[b20_12].flags;
 
 	for (auto i = 0; i < TABLE_SIZE; i++)
 	{
@@ -389,6 +439,8 @@ void Ioctl::AnalyzeAddress(PVOID address, IOCTL_RESPONSE& data)
 
 	//
 	// Copy the data in the page
+	walkTimer.Stop();
+	StageTimer copyTimer(data.times, TIMING_STAGE_COPY);
 	if (IsAddressValid(address))
 	{
 		memcpy(&data.Buffer, address, PAGE_SIZE);
@@ -416,6 +468,7 @@ void Ioctl::GetDataForAddress(ULONG ulPID, PVOID address, IOCTL_RESPONSE& data,
 	HANDLE hProcess = ULongToHandle(ulPID);
 	PEPROCESS pe = nullptr;
 
+	StageTimer lookupTimer(data.times, TIMING_STAGE_LOOKUP);
 	NTSTATUS status = PsLookupProcessByProcessId(hProcess, &pe);
 	if (!NT_SUCCESS(status) || pe == nullptr)
 	{
@@ -435,9 +488,12 @@ void Ioctl::GetDataForAddress(ULONG ulPID, PVOID address, IOCTL_RESPONSE& data,
 		DbgPrintEx(DPFLTR_IHVDRIVER_ID, DPFLTR_ERROR_LEVEL, ("Error opening PEPROCESS\n"));
 		return;
 	}
+	lookupTimer.Stop();
 
 	//
 	// We need to be in the context of the process.
+	// Paging the data in is counted as a part of the attach.
+	StageTimer attachTimer(data.times, TIMING_STAGE_ATTACH);
 	KAPC_STATE state{ };
 	KeStackAttachProcess(pe, &state);
 	
@@ -446,10 +502,12 @@ void Ioctl::GetDataForAddress(ULONG ulPID, PVOID address, IOCTL_RESPONSE& data,
 	if (probe)
 	{
 		MdlScoped mdl(address, PAGE_SIZE, IoReadAccess);
+		attachTimer.Stop();
 		AnalyzeAddress(address, data);
 	}
 	else
 	{
+		attachTimer.Stop();
 		AnalyzeAddress(address, data);
 	}
 
@@ -457,3 +515,147 @@ void Ioctl::GetDataForAddress(ULONG ulPID, PVOID address, IOCTL_RESPONSE& data,
 
 	ZwClose(hProcess);
 }
+
+
+/// <summary>
+/// Copy a paging structure and the structures below it into the response.
+/// </summary>
+/// <param name="level">Level of the table</param>
+/// <param name="physAddress">Physical address of the table</param>
+/// <param name="baseVA">The first virtual address translated through the table</param>
+/// <param name="request">The enumeration request</param>
+/// <param name="data">The structure used for the output</param>
+/// <returns>False if the response is full</returns>
+bool Ioctl::EnumTable(ULONG level,
+	PHYSICAL_ADDRESS physAddress,
+	ULONGLONG baseVA,
+	const IOCTL_ENUM_REQUEST& request,
+	IOCTL_ENUM_RESPONSE& data)
+{
+	//
+	// Size of the memory covered by a single entry for each level.
+	static const ULONG s_levelShift[TABLE_LEVEL_COUNT] = { 39, 30, 21, 12 };
+
+	uint64_t* entries = reinterpret_cast<uint64_t*>(MmGetVirtualForPhysical(physAddress));
+	if (!IsAddressValid(entries))
+	{
+		return true;
+	}
+
+	//
+	// Tables before the resume point were returned by the previous request,
+	// but their entries still need to be followed.
+	// The walk only reaches the tables before startVA if they cover it.
+	if (baseVA > request.startVA ||
+		(baseVA == request.startVA && level >= request.startLevel) ||
+		(request.parents && baseVA < request.startVA))
+	{
+		if (data.count == ENUM_TABLES_PER_REQUEST)
+		{
+			data.nextVA = baseVA;
+			data.nextLevel = level;
+			return false;
+		}
+
+		TABLE_PAGE& table = data.tables[data.count++];
+		table.baseVA = baseVA;
+		table.physAddress = physAddress;
+		table.level = level;
+		table.reserved = 0;
+		memcpy(table.entries, entries, PAGE_SIZE);
+	}
+
+	if (level == TABLE_LEVEL_PT)
+	{
+		return true;
+	}
+
+	for (auto i = 0; i < TABLE_SIZE; i++)
+	{
+		ULONGLONG entryVA = baseVA + (static_cast<ULONGLONG>(i) << s_levelShift[level]);
+		ULONGLONG entryEnd = entryVA + (1ull << s_levelShift[level]);
+
+		if (entryEnd <= request.startVA)
+		{
+			continue;
+		}
+		if (entryVA >= request.endVA)
+		{
+			break;
+		}
+
+		//
+		// Skip the holes and the large pages, the latter have no table below them.
+		if (!PDE_64_PRESENT(entries[i]) ||
+			(level != TABLE_LEVEL_PML4 && PDE_64_LARGE_PAGE(entries[i])))
+		{
+			continue;
+		}
+
+		PHYSICAL_ADDRESS physNext{ 0 };
+		physNext.QuadPart = PDE_64_PAGE_FRAME_NUMBER(entries[i]) << PAGE_SHIFT;
+
+		if (!EnumTable(level + 1, physNext, entryVA, request, data))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Copy the user mode paging structures of the process.
+/// </summary>
+/// <param name="request">The enumeration request</param>
+/// <param name="data">The structure used for the output</param>
+/// <returns>STATUS_INVALID_PARAMETER for the system processes, STATUS_NOT_FOUND if there is no such process</returns>
+NTSTATUS Ioctl::GetTablesForProcess(const IOCTL_ENUM_REQUEST& request, IOCTL_ENUM_RESPONSE& data)
+{
+	data.count = 0;
+	data.complete = false;
+	data.nextVA = request.startVA;
+	data.nextLevel = request.startLevel;
+
+	//
+	// Ignore system processes
+	if (request.pid <= 4)
+	{
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	PEPROCESS pe = nullptr;
+
+	NTSTATUS status = PsLookupProcessByProcessId(ULongToHandle(request.pid), &pe);
+	if (!NT_SUCCESS(status) || pe == nullptr)
+	{
+		DbgPrintEx(DPFLTR_IHVDRIVER_ID, DPFLTR_ERROR_LEVEL, "Failed to find the process [%lu].\n", request.pid);
+		return STATUS_NOT_FOUND;
+	}
+
+	//
+	// The kernel half, with the self-map, is never copied whatever the caller asks for.
+	IOCTL_ENUM_REQUEST bounded = request;
+	bounded.endVA = request.endVA < USER_ADDRESS_END ? request.endVA : USER_ADDRESS_END;
+
+	//
+	// The tables of the process are only reachable from its own context.
+	KAPC_STATE state{ };
+	KeStackAttachProcess(pe, &state);
+
+	cr3 cr3;
+	cr3.flags = __readcr3();
+	data.regCR3 = cr3.flags;
+	data.regPAT = __readmsr(IA32_PAT);
+
+	PHYSICAL_ADDRESS physAddress{ 0 };
+	physAddress.QuadPart = cr3.address_of_page_directory << PAGE_SHIFT;
+
+	data.complete = EnumTable(TABLE_LEVEL_PML4, physAddress, 0, bounded, data);
+
+	KeUnstackDetachProcess(&state);
+
+	ObDereferenceObject(pe);
+
+	return STATUS_SUCCESS;
+}
\ No newline at end of file
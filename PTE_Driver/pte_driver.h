@@ -27,13 +27,23 @@ public:
 
 	static NTSTATUS HandleIOCTL(PDEVICE_OBJECT deviceObject, PIRP irp);
 
+	static NTSTATUS HandleEnumIOCTL(PIRP irp);
+
 	static void AnalyzeAddress(PVOID address, IOCTL_RESPONSE& data);
 
 	static void GetDataForAddress(ULONG pid, PVOID address, IOCTL_RESPONSE& data, bool probe);
 
+	static NTSTATUS GetTablesForProcess(const IOCTL_ENUM_REQUEST& request, IOCTL_ENUM_RESPONSE& data);
+
 	static bool IsAddressValid(void* address);
 
 private:
+	static bool EnumTable(ULONG level,
+		PHYSICAL_ADDRESS physAddress,
+		ULONGLONG baseVA,
+		const IOCTL_ENUM_REQUEST& request,
+		IOCTL_ENUM_RESPONSE& data);
+
 	//
 	// Wrapper for MDL to manage memory
 	class MdlScoped
@@ -0,0 +1,107 @@
+/*
+    replay_main.cpp
+
+    Runs the fuzzing harness without libFuzzer: replays the inputs given on the
+    command line or, without arguments, mutates a generated image for a while.
+
+    pte_walk_fuzz [input ...]
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "image_builder.h"
+#include "ia32.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+namespace
+{
+
+//
+// Mutated inputs of the run without arguments.
+constexpr size_t s_mutations = 5000;
+
+/// <summary>
+/// A small image with the tricks of the hostile tables: a self-map entry, a table
+/// pointed to from all the entries of its parent and a PFN far outside the image.
+/// </summary>
+std::vector<uint8_t> MakeSeed()
+{
+    constexpr uint64_t imageSize = 64 * PAGE_SIZE;
+    constexpr uint64_t va = 0x7FF600000000ull;
+
+    PTE::ImageBuilder builder(imageSize);
+    const uint64_t cr3 = builder.CreateRoot();
+    for (uint64_t i = 0; i < 16; ++i)
+    {
+        builder.Map(cr3, va + i * PAGE_SIZE, builder.AllocateFrame(), PAGE_SIZE);
+    }
+    builder.Map(cr3, va + (1ull << 30), 0, 1ull << 21);
+
+    const uint64_t root = CR3_ADDRESS_OF_PAGE_DIRECTORY(cr3) << 12;
+    builder.SetEntry(root, 0x1ED, root | 0x3);
+    builder.SetEntry(root, 0x100, 0x7FFFFFFFF000ull | 0x3);
+
+    //
+    // Every entry of the PML4's upper half points to the PML4 itself.
+    for (size_t i = 0x101; i < TABLE_SIZE; ++i)
+    {
+        builder.SetEntry(root, i, root | 0x3);
+    }
+
+    std::vector<uint8_t> input(3 * sizeof(uint64_t));
+    memcpy(input.data(), &cr3, sizeof(cr3));
+    memcpy(input.data() + sizeof(uint64_t), &va, sizeof(va));
+    input.insert(input.end(), builder.Data(), builder.Data() + builder.View().Size);
+
+    return input;
+}
+
+} //namespace
+
+int main(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::ifstream file(argv[i], std::ios::binary);
+        std::vector<uint8_t> input{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+
+    if (argc > 1)
+    {
+        printf("%d inputs replayed\n", argc - 1);
+        return 0;
+    }
+
+    //
+    // Flip the bytes of the header and the tables, truncate now and then.
+    const std::vector<uint8_t> seed = MakeSeed();
+    std::mt19937_64 random(1);
+    std::vector<uint8_t> input;
+    for (size_t i = 0; i < s_mutations; ++i)
+    {
+        input = seed;
+        for (uint64_t flips = 1 + random() % 16; flips != 0; --flips)
+        {
+            input[random() % input.size()] ^= static_cast<uint8_t>(1 + random() % 255);
+        }
+        if (random() % 8 == 0)
+        {
+            input.resize(random() % input.size());
+        }
+
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+
+    printf("%zu mutations passed\n", s_mutations);
+
+    return 0;
+}
@@ -0,0 +1,144 @@
+/*
+    walk_fuzz.cpp
+
+    Fuzzing harness of the physical memory walker against hostile page tables.
+    The input is a header followed by the image of the physical memory:
+    every walk must end, stay within its work limits and read inside the image only.
+
+    Dmitry Podvigalkin
+
+    2025
+*/
+#include "phys_walk.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+namespace
+{
+
+//
+// Tables a single input may enumerate, small enough to keep the runs fast.
+constexpr uint64_t s_tableBudget = 2 * ENUM_TABLES_PER_REQUEST;
+
+/// <summary>
+/// The start of the input.
+/// </summary>
+struct FuzzHeader
+{
+    uint64_t CR3;
+    uint64_t VA;
+
+    //
+    // Start of the enumerated range, the range ends at the top of the address space
+    uint64_t StartVA;
+};
+
+/// <summary>
+/// Stop the run on a broken invariant, the fuzzer keeps the input as a crash.
+/// </summary>
+void Check(bool condition, const char* what)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "walk_fuzz: %s\n", what);
+        abort();
+    }
+}
+
+/// <summary>
+/// Check the result of a single walk.
+/// </summary>
+void CheckTranslation(uint64_t va, bool mapped, const PTE::Translation& translation)
+{
+    Check(translation.Depth <= TABLE_LEVEL_COUNT, "walk deeper than four levels");
+    if (!mapped)
+    {
+        Check(translation.PA == 0 && translation.PageSize == 0, "unmapped address with a translation");
+        return;
+    }
+
+    Check(translation.PageSize == PAGE_SIZE || translation.PageSize == (1ull << 21) || translation.PageSize == (1ull << 30),
+        "unknown page size");
+    Check((translation.PA & (translation.PageSize - 1)) == (va & (translation.PageSize - 1)), "page offset lost");
+}
+
+} //namespace
+
+/// <summary>
+/// Run the walks over a single input.
+/// </summary>
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    if (size < sizeof(FuzzHeader))
+    {
+        return 0;
+    }
+
+    FuzzHeader header;
+    memcpy(&header, data, sizeof(header));
+
+    //
+    // An exact copy, so the sanitizer catches any read past the image.
+    // The image is usually not a multiple of the page, its last partial page must not be read.
+    const size_t imageSize = size - sizeof(header);
+    std::unique_ptr<uint8_t[]> image(new uint8_t[imageSize != 0 ? imageSize : 1]);
+    memcpy(image.get(), data + sizeof(header), imageSize);
+
+    const PTE::PhysicalView view{ image.get(), imageSize };
+    const PTE::PhysicalWalker walker(view, header.CR3);
+
+    //
+    // The single walks against the batched ones, over the neighbours sharing the upper entries.
+    const uint64_t addresses[] = {
+        header.VA,
+        header.VA + PAGE_SIZE,
+        header.VA + (1ull << 21),
+        header.VA + (1ull << 30),
+        header.VA ^ (1ull << 39),
+        header.StartVA,
+    };
+    constexpr size_t count = sizeof(addresses) / sizeof(addresses[0]);
+    uint64_t pa[count];
+    uint64_t pageSize[count];
+    walker.TranslateBatch(addresses, count, pa, pageSize);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        PTE::Translation translation;
+        const bool mapped = walker.Translate(addresses[i], translation);
+        CheckTranslation(addresses[i], mapped, translation);
+        Check(pa[i] == translation.PA && pageSize[i] == translation.PageSize, "batched walk differs from the single one");
+    }
+
+    //
+    // The buffers are large, they are kept between the runs.
+    static auto request = std::make_unique<IOCTL_DATA>();
+    static auto enumData = std::make_unique<IOCTL_ENUM_DATA>();
+    static PTE::PageTables tables;
+
+    memset(request.get(), 0, sizeof(IOCTL_DATA));
+    walker.Analyze(header.VA, request->response);
+
+    //
+    // The enumeration is bounded by the budget however the entries alias the tables.
+    const unsigned long err = walker.ReadPageTables(enumData.get(), tables, header.StartVA, ~0ull, s_tableBudget);
+    Check(err == ERROR_SUCCESS || err == ERROR_NOT_ENOUGH_QUOTA, "unexpected enumeration error");
+    Check(tables.Tables.size() <= s_tableBudget, "enumeration over the budget");
+
+    for (const auto& table : tables.Tables)
+    {
+        Check(table.level < TABLE_LEVEL_COUNT, "table of an unknown level");
+        Check(view.Table(static_cast<uint64_t>(table.physAddress.QuadPart)) != nullptr, "table outside the image");
+    }
+
+    uint64_t leaves{ 0 };
+    tables.ForEachLeaf([&](const PTE::LeafMapping&)
+        {
+            ++leaves;
+        });
+    Check(leaves <= tables.Tables.size() * TABLE_SIZE, "more leaves than entries");
+
+    return 0;
+}